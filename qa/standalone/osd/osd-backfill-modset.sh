@@ -0,0 +1,184 @@
+#!/usr/bin/env bash
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Library Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Library Public License for more details.
+#
+
+# Incremental backfill (osd_pg_modset_bits > 0) that is interrupted
+# part way through, while clients keep writing, must still leave the
+# replica identical to the primary.
+
+source $CEPH_ROOT/qa/standalone/ceph-helpers.sh
+
+function run() {
+    local dir=$1
+    shift
+
+    export CEPH_MON="127.0.0.1:7156" # git grep '\<7156\>' : there must be only one
+    export CEPH_ARGS
+    CEPH_ARGS+="--fsid=$(uuidgen) --auth-supported=none "
+    CEPH_ARGS+="--mon-host=$CEPH_MON "
+    # a short log, so that a replica down for a little while needs backfill
+    CEPH_ARGS+="--osd_min_pg_log_entries=10 --osd_max_pg_log_entries=20 "
+    CEPH_ARGS+="--osd_pg_log_trim_min=5 --osd_pg_modset_bits=8 "
+    # and a slow one, so that it can be interrupted
+    CEPH_ARGS+="--osd_max_backfills=1 --osd_recovery_max_active=1 "
+    CEPH_ARGS+="--osd_backfill_scan_min=4 --osd_backfill_scan_max=8 "
+    CEPH_ARGS+="--osd_recovery_sleep=0.1 "
+
+    local funcs=${@:-$(set | sed -n -e 's/^\(TEST_[0-9a-z_]*\) .*/\1/p')}
+    for func in $funcs ; do
+        setup $dir || return 1
+        $func $dir || return 1
+        teardown $dir || return 1
+    done
+}
+
+function write_objects() {
+    local dir=$1
+    local gen=$2
+    local first=$3
+    local last=$4
+
+    for j in $(seq $first $last) ; do
+        echo "obj-$j generation $gen" > $dir/expected/obj-$j
+        rados -p test put obj-$j $dir/expected/obj-$j || return 1
+    done
+}
+
+function remove_objects() {
+    local dir=$1
+    local first=$2
+    local last=$3
+
+    for j in $(seq $first $last) ; do
+        rados -p test rm obj-$j || return 1
+        rm -f $dir/expected/obj-$j
+    done
+}
+
+function wait_for_backfilling() {
+    for i in $(seq 1 120) ; do
+        if ceph pg dump pgs --format=json 2>/dev/null | \
+            jq -r '.pg_stats[0].state' | grep -q backfilling ; then
+            return 0
+        fi
+        sleep 0.5
+    done
+    return 1
+}
+
+function check_pg() {
+    local dir=$1
+    local pgid=$2
+
+    pg_deep_scrub $pgid || return 1
+    local errors=$(ceph pg $pgid query | \
+        jq '.info.stats.stat_sum.num_scrub_errors')
+    test "$errors" = "0" || return 1
+    ceph pg dump pgs 2>/dev/null | grep "^$pgid " | \
+        grep -q inconsistent && return 1
+
+    # and clients see what they wrote, whichever replica serves it
+    for f in $dir/expected/* ; do
+        local obj=$(basename $f)
+        rados -p test get $obj $dir/got || return 1
+        cmp $f $dir/got || return 1
+    done
+    test "$(rados -p test ls | wc -l)" = "$(ls $dir/expected | wc -l)" || return 1
+}
+
+# bring a replica back far enough behind that it needs backfill, and
+# return once that backfill is under way
+function start_backfill() {
+    local dir=$1
+    local replica=$2
+
+    kill_daemons $dir TERM osd.$replica || return 1
+    ceph osd down osd.$replica
+    # overwrite some objects, create more, remove a few: well past the log
+    write_objects $dir 2 1 50 || return 1
+    write_objects $dir 2 201 300 || return 1
+    remove_objects $dir 151 170 || return 1
+
+    activate_osd $dir $replica || return 1
+    wait_for_backfilling || return 1
+}
+
+function setup_pool() {
+    local dir=$1
+
+    run_mon $dir a || return 1
+    run_mgr $dir x || return 1
+    for osd in 0 1 2 ; do
+        run_osd $dir $osd || return 1
+    done
+    create_pool test 1 1
+    ceph osd pool set test size 3
+    ceph osd pool set test min_size 2
+    wait_for_clean || return 1
+
+    mkdir -p $dir/expected
+    write_objects $dir 1 1 200 || return 1
+    wait_for_clean || return 1
+}
+
+function TEST_modset_backfill_paused() {
+    local dir=$1
+
+    setup_pool $dir || return 1
+    local pgid=$(get_pg test obj-1)
+    local primary=$(get_primary test obj-1)
+    local replica=$(get_not_primary test obj-1)
+
+    start_backfill $dir $replica || return 1
+    # the replica was complete, so only the changed buckets are backfilled
+    grep -q "activate peer osd.$replica only needs backfill of" \
+        $dir/osd.$primary.log || return 1
+
+    ceph osd set nobackfill
+    write_objects $dir 3 25 75 || return 1
+    write_objects $dir 3 301 350 || return 1
+    remove_objects $dir 1 10 || return 1
+    ceph osd unset nobackfill
+
+    wait_for_clean || return 1
+    check_pg $dir $pgid || return 1
+}
+
+function TEST_modset_backfill_restarted() {
+    local dir=$1
+
+    setup_pool $dir || return 1
+    local pgid=$(get_pg test obj-1)
+    local primary=$(get_primary test obj-1)
+    local replica=$(get_not_primary test obj-1)
+
+    start_backfill $dir $replica || return 1
+    grep -q "activate peer osd.$replica only needs backfill of" \
+        $dir/osd.$primary.log || return 1
+
+    # stop the target part way, write some more, and let it start over
+    kill_daemons $dir TERM osd.$replica || return 1
+    ceph osd down osd.$replica
+    write_objects $dir 3 25 75 || return 1
+    write_objects $dir 3 301 350 || return 1
+    remove_objects $dir 1 10 || return 1
+    activate_osd $dir $replica || return 1
+
+    wait_for_clean || return 1
+    check_pg $dir $pgid || return 1
+}
+
+main osd-backfill-modset "$@"
+
+# Local Variables:
+# compile-command: "make -j4 && ../qa/run-standalone.sh osd-backfill-modset.sh"
+# End:
@@ -0,0 +1,85 @@
+#!/usr/bin/env bash
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Library Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Library Public License for more details.
+#
+
+source $CEPH_ROOT/qa/standalone/ceph-helpers.sh
+
+function run() {
+    local dir=$1
+    shift
+
+    export CEPH_MON="127.0.0.1:7155" # git grep '\<7155\>' : there must be only one
+    export CEPH_ARGS
+    CEPH_ARGS+="--fsid=$(uuidgen) --auth-supported=none "
+    CEPH_ARGS+="--mon-host=$CEPH_MON "
+
+    local funcs=${@:-$(set | sed -n -e 's/^\(TEST_[0-9a-z_]*\) .*/\1/p')}
+    for func in $funcs ; do
+        setup $dir || return 1
+        $func $dir || return 1
+        teardown $dir || return 1
+    done
+}
+
+# restart every osd at once, so that each loads its pgs on several
+# threads and peers with batched notifies and queries, and check that
+# the pgs come back clean with their data
+function TEST_restart_load_pgs() {
+    local dir=$1
+    local objects=50
+
+    run_mon $dir a || return 1
+    run_mgr $dir x || return 1
+    local args="--osd-load-pgs-threads=4 --osd-peering-batch-max=8"
+    for id in 0 1 2 ; do
+        run_osd $dir $id $args || return 1
+    done
+
+    create_pool test 32 32 || return 1
+    wait_for_clean || return 1
+
+    dd if=/dev/urandom of=$dir/data bs=4k count=4 2> /dev/null
+    for i in $(seq 1 $objects) ; do
+        rados -p test put obj$i $dir/data || return 1
+    done
+
+    kill_daemons $dir TERM osd || return 1
+    for id in 0 1 2 ; do
+        activate_osd $dir $id $args || return 1
+    done
+    wait_for_clean || return 1
+
+    for id in 0 1 2 ; do
+        grep -q "load_pgs opened [1-9][0-9]* pgs in .* with 4 threads" \
+            $dir/osd.$id.log || return 1
+        # every loaded pg has gone active since boot
+        test "$(ceph daemon osd.$id perf dump | \
+            jq '.osd.boot_pgs_pending')" = "0" || return 1
+    done
+    local batched=0
+    for id in 0 1 2 ; do
+        batched=$(( batched + $(ceph daemon osd.$id perf dump | \
+            jq '.osd.peering_batched') ))
+    done
+    test $batched -gt 0 || return 1
+
+    for i in $(seq 1 $objects) ; do
+        rados -p test get obj$i $dir/out || return 1
+        cmp $dir/data $dir/out || return 1
+    done
+}
+
+main osd-boot-pgs "$@"
+
+# Local Variables:
+# compile-command: "cd ../.. ; make -j4 && test/osd/osd-boot-pgs.sh"
+# End:
@@ -121,7 +121,10 @@ int main(int argc, const char **argv)
   map<string,string> defaults = {
     // We want to enable leveldb's log, while allowing users to override this
     // option, therefore we will pass it as a default argument to global_init().
-    { "leveldb_log", "" }
+    { "leveldb_log", "" },
+    // the object store writes client data with direct I/O, and can skip
+    // realigning it when it was received into recycled aligned buffers
+    { "ms_async_rx_pool_size", "16M" }
   };
   auto cct = global_init(
     &defaults,
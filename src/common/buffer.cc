@@ -13,7 +13,10 @@
  */
 
 #include <atomic>
+#include <cstddef>
 #include <cstring>
+#include <mutex>
+#include <vector>
 #include <errno.h>
 #include <limits.h>
 
@@ -53,8 +56,11 @@ static ceph::spinlock debug_lock;
   static std::atomic<unsigned> buffer_cached_crc { 0 };
   static std::atomic<unsigned> buffer_cached_crc_adjusted { 0 };
   static std::atomic<unsigned> buffer_missed_crc { 0 };
+  static std::atomic<uint64_t> buffer_missed_crc_bytes { 0 };
 
   static bool buffer_track_crc = get_env_bool("CEPH_BUFFER_TRACK");
+  // handy for tools like valgrind and asan, which can't see into the slabs
+  static bool buffer_slab = !get_env_bool("CEPH_BUFFER_NO_SLAB");
 
   void buffer::track_cached_crc(bool b) {
     buffer_track_crc = b;
@@ -70,6 +76,10 @@ static ceph::spinlock debug_lock;
     return buffer_missed_crc;
   }
 
+  uint64_t buffer::get_missed_crc_bytes() {
+    return buffer_missed_crc_bytes;
+  }
+
   const char * buffer::error::what() const throw () {
     return "buffer::exception";
   }
@@ -85,6 +95,213 @@ static ceph::spinlock debug_lock;
   buffer::error_code::error_code(int error) :
     buffer::malformed_input(cpp_strerror(error).c_str()), code(error) {}
 
+  namespace {
+  /*
+   * Per-thread caches of freed small blocks, by size class, behind
+   * raw_combined and ptr_node: busy bufferlists make and free these at
+   * a great rate.
+   *
+   * Every block remembers the cache it was handed out by.  Freeing it on
+   * the owning thread pushes it on a local list; freeing it anywhere
+   * else pushes it on the owner's remote list with a CAS, and the owner
+   * takes the remote list back in one go once its local list runs dry.
+   * A cache outlives its thread, since blocks may still be on their way
+   * back to it, and is adopted by the next thread that needs one.
+   *
+   * Cached blocks are counted in mempool buffer_slab, so that what the
+   * caches hold shows up in dump_mempools.
+   */
+  class slab_cache {
+  public:
+    /// classes split each power of two into STEPS, as tcmalloc does, so
+    /// that a block wastes at most a quarter of its size
+    static constexpr unsigned STEPS_ORDER = 2;
+    static constexpr unsigned STEPS = 1 << STEPS_ORDER;
+    static constexpr unsigned MIN_ORDER = 6;
+    static constexpr unsigned MAX_ORDER = 12;
+    static constexpr size_t MIN_SIZE = 1 << MIN_ORDER;
+    static constexpr size_t MAX_SIZE = 1 << MAX_ORDER;
+    static constexpr unsigned NUM_CLASSES =
+      (MAX_ORDER - MIN_ORDER) * STEPS + 1;
+    /// per class, local and remote each: under 1MB a thread in all
+    static constexpr size_t MAX_CACHED_BYTES = 16 * 1024;
+
+    /// the class of blocks of at least size bytes, or -1 if too big
+    static int size_class(size_t size) {
+      if (size > MAX_SIZE) {
+	return -1;
+      }
+      if (size <= MIN_SIZE) {
+	return 0;
+      }
+      // size is in (2^order, 2^(order+1)]
+      unsigned order = 63 - __builtin_clzll(size - 1);
+      size_t step = (size_t(1) << order) >> STEPS_ORDER;
+      size_t steps = (size - (size_t(1) << order) + step - 1) / step;
+      return (order - MIN_ORDER) * STEPS + steps;
+    }
+
+    static size_t class_size(int c) {
+      if (c == 0) {
+	return MIN_SIZE;
+      }
+      unsigned order = MIN_ORDER + (c - 1) / STEPS;
+      size_t steps = (c - 1) % STEPS + 1;
+      return (size_t(1) << order) + (steps << (order - STEPS_ORDER));
+    }
+
+    /// get a block of class c, and the cache to give it back to
+    static void *allocate(int c, slab_cache **owner) {
+      slab_cache *m = buffer_slab ? get_mine() : nullptr;
+      *owner = m;
+      if (m) {
+	auto& l = m->local[c];
+	if (!l.head && m->remote_count[c].load(std::memory_order_relaxed)) {
+	  m->take_remote(c);
+	}
+	if (l.head) {
+	  free_block *b = l.head;
+	  l.head = b->next;
+	  --l.count;
+	  account(-1, c);
+	  return b;
+	}
+      }
+      void *p = ::malloc(class_size(c));
+      if (!p) {
+	throw buffer::bad_alloc();
+      }
+      return p;
+    }
+
+    static void release(void *p, int c, slab_cache *owner) {
+      if (!owner) {
+	::free(p);
+	return;
+      }
+      auto b = static_cast<free_block*>(p);
+      size_t max = MAX_CACHED_BYTES / class_size(c);
+      if (owner == mine) {
+	auto& l = owner->local[c];
+	if (l.count >= max) {
+	  ::free(p);
+	  return;
+	}
+	b->next = l.head;
+	l.head = b;
+	++l.count;
+	account(1, c);
+	return;
+      }
+      if (owner->remote_count[c].fetch_add(1, std::memory_order_relaxed) >=
+	  max) {
+	owner->remote_count[c].fetch_sub(1, std::memory_order_relaxed);
+	::free(p);
+	return;
+      }
+      account(1, c);
+      b->next = owner->remote[c].load(std::memory_order_relaxed);
+      while (!owner->remote[c].compare_exchange_weak(
+	       b->next, b, std::memory_order_release,
+	       std::memory_order_relaxed)) {
+      }
+    }
+
+  private:
+    struct free_block {
+      free_block *next;
+    };
+    struct local_list {
+      free_block *head = nullptr;
+      size_t count = 0;
+    };
+    local_list local[NUM_CLASSES];
+    std::atomic<free_block*> remote[NUM_CLASSES] = {};
+    std::atomic<size_t> remote_count[NUM_CLASSES] = {};
+
+    static thread_local slab_cache *mine;
+    static thread_local bool exited;
+
+    // adopts a cache when a thread first allocates, orphans it at exit
+    struct holder_t {
+      holder_t() {
+	std::lock_guard l{orphans_lock()};
+	if (orphans().empty()) {
+	  mine = new slab_cache;
+	} else {
+	  mine = orphans().back();
+	  orphans().pop_back();
+	}
+      }
+      ~holder_t() {
+	slab_cache *m = mine;
+	mine = nullptr;
+	exited = true;
+	for (int c = 0; c < (int)NUM_CLASSES; ++c) {
+	  m->take_remote(c);
+	  m->free_local(c);
+	}
+	std::lock_guard l{orphans_lock()};
+	orphans().push_back(m);
+      }
+    };
+
+    // never destroyed: threads may exit after static destructors ran
+    static std::mutex& orphans_lock() {
+      static auto l = new std::mutex;
+      return *l;
+    }
+    static std::vector<slab_cache*>& orphans() {
+      static auto o = new std::vector<slab_cache*>;
+      return *o;
+    }
+
+    static slab_cache *get_mine() {
+      if (likely(mine != nullptr)) {
+	return mine;
+      }
+      if (exited) {
+	return nullptr;
+      }
+      static thread_local holder_t holder;
+      return mine;
+    }
+
+    static void account(ssize_t n, int c) {
+      static auto& pool = mempool::get_pool(mempool::mempool_buffer_slab);
+      pool.adjust_count(n, n * (ssize_t)class_size(c));
+    }
+
+    void take_remote(int c) {
+      free_block *b = remote[c].exchange(nullptr, std::memory_order_acquire);
+      size_t n = 0;
+      auto& l = local[c];
+      while (b) {
+	free_block *next = b->next;
+	b->next = l.head;
+	l.head = b;
+	b = next;
+	++n;
+      }
+      l.count += n;
+      remote_count[c].fetch_sub(n, std::memory_order_relaxed);
+    }
+
+    void free_local(int c) {
+      auto& l = local[c];
+      account(-(ssize_t)l.count, c);
+      while (l.head) {
+	free_block *next = l.head->next;
+	::free(l.head);
+	l.head = next;
+      }
+      l.count = 0;
+    }
+  };
+  thread_local slab_cache *slab_cache::mine = nullptr;
+  thread_local bool slab_cache::exited = false;
+  } // anonymous namespace
+
   /*
    * raw_combined is always placed within a single allocation along
    * with the data buffer.  the data goes at the beginning, and
@@ -92,11 +309,17 @@ static ceph::spinlock debug_lock;
    */
   class buffer::raw_combined : public buffer::raw {
     size_t alignment;
+    slab_cache *slab_owner;
+    int slab_class;  ///< -1 if not from a slab
   public:
     raw_combined(char *dataptr, unsigned l, unsigned align,
-		 int mempool)
+		 int mempool, slab_cache *owner, int cls)
       : raw(dataptr, l, mempool),
-	alignment(align) {
+	alignment(align), slab_owner(owner), slab_class(cls) {
+      if (cls >= 0) {
+	// the whole block is ours for as long as we live
+	_set_slack(slab_cache::class_size(cls) - l);
+      }
     }
     raw* clone_empty() override {
       return create(len, alignment);
@@ -111,25 +334,38 @@ static ceph::spinlock debug_lock;
 				  alignof(buffer::raw_combined));
       size_t datalen = round_up_to(len, alignof(buffer::raw_combined));
 
+      char *ptr = 0;
+      slab_cache *owner = nullptr;
+      // malloc's alignment is all the slabs promise
+      int cls = align <= alignof(std::max_align_t) ?
+	slab_cache::size_class(rawlen + datalen) : -1;
+      if (cls >= 0) {
+	ptr = (char *)slab_cache::allocate(cls, &owner);
+      } else {
 #ifdef DARWIN
-      char *ptr = (char *) valloc(rawlen + datalen);
+	ptr = (char *) valloc(rawlen + datalen);
 #else
-      char *ptr = 0;
-      int r = ::posix_memalign((void**)(void*)&ptr, align, rawlen + datalen);
-      if (r)
-	throw bad_alloc();
+	int r = ::posix_memalign((void**)(void*)&ptr, align, rawlen + datalen);
+	if (r)
+	  throw bad_alloc();
 #endif /* DARWIN */
+      }
       if (!ptr)
 	throw bad_alloc();
 
       // actual data first, since it has presumably larger alignment restriction
       // then put the raw_combined at the end
-      return new (ptr + datalen) raw_combined(ptr, len, align, mempool);
+      return new (ptr + datalen) raw_combined(ptr, len, align, mempool,
+					      owner, cls);
     }
 
     static void operator delete(void *ptr) {
       raw_combined *raw = (raw_combined *)ptr;
-      ::free((void *)raw->data);
+      if (raw->slab_class >= 0) {
+	slab_cache::release(raw->data, raw->slab_class, raw->slab_owner);
+      } else {
+	::free((void *)raw->data);
+      }
     }
   };
 
@@ -1195,9 +1431,20 @@ static ceph::spinlock debug_lock;
     std::unique_ptr<buffer::ptr_node, buffer::ptr_node::disposer> nb)
   {
     unsigned pos = 0;
+    // crc of the leading nodes whose crcs are cached, carried over to
+    // the new buffer so its crc need not read them again
+    unsigned crc_len = 0;
+    uint32_t crc = -1;
     for (auto& node : _buffers) {
       nb->copy_in(pos, node.length(), node.c_str(), false);
       pos += node.length();
+      pair<uint32_t, uint32_t> ccrc;
+      if (crc_len + node.length() == pos && node.length() &&
+	  node.get_raw()->get_crc({node.offset(),
+				   node.offset() + node.length()}, &ccrc)) {
+	crc = ccrc.second ^ ceph_crc32c(ccrc.first ^ crc, NULL, node.length());
+	crc_len = pos;
+      }
     }
     _memcopy_count += pos;
     _carriage = &always_empty_bptr;
@@ -1207,6 +1454,11 @@ static ceph::spinlock debug_lock;
       _buffers.push_back(*nb.release());
     }
     invalidate_crc();
+    if (crc_len) {
+      auto& node = _buffers.front();
+      node.get_raw()->set_crc({node.offset(), node.offset() + crc_len},
+			      make_pair((uint32_t)-1, crc));
+    }
     last_p = begin();
   }
 
@@ -2014,6 +2266,7 @@ __u32 buffer::list::crc32c(__u32 crc) const
   int cache_misses = 0;
   int cache_hits = 0;
   int cache_adjusts = 0;
+  uint64_t missed_bytes = 0;
 
   for (const auto& node : _buffers) {
     if (node.length()) {
@@ -2040,7 +2293,20 @@ __u32 buffer::list::crc32c(__u32 crc) const
       } else {
 	cache_misses++;
 	uint32_t base = crc;
-	crc = ceph_crc32c(crc, (unsigned char*)node.c_str(), node.length());
+	// chain together whatever pieces of this range are cached, the
+	// same way, and only read what is left
+	size_t pos = ofs.first, to;
+	while (pos < ofs.second &&
+	       r->get_crc_prefix(pos, ofs.second, &to, &ccrc)) {
+	  crc = ccrc.second ^ ceph_crc32c(ccrc.first ^ crc, NULL, to - pos);
+	  pos = to;
+	}
+	if (pos < ofs.second) {
+	  crc = ceph_crc32c(crc,
+			    (unsigned char*)node.c_str() + (pos - ofs.first),
+			    ofs.second - pos);
+	  missed_bytes += ofs.second - pos;
+	}
 	r->set_crc(ofs, make_pair(base, crc));
       }
     }
@@ -2053,6 +2319,8 @@ __u32 buffer::list::crc32c(__u32 crc) const
       buffer_cached_crc += cache_hits;
     if (cache_misses)
       buffer_missed_crc += cache_misses;
+    if (missed_bytes)
+      buffer_missed_crc_bytes += missed_bytes;
   }
 
   return crc;
@@ -2183,6 +2451,34 @@ buffer::list buffer::list::static_from_string(string& s) {
   // const makes me generally sad.
 }
 
+namespace {
+  // ahead of every ptr_node, which is carved from the slabs like this
+  struct ptr_node_header {
+    slab_cache *owner;
+    int cls;
+  };
+  constexpr size_t ptr_node_header_size =
+    round_up_to(sizeof(ptr_node_header), alignof(std::max_align_t));
+}
+
+void *buffer::ptr_node::operator new(size_t size)
+{
+  int cls = slab_cache::size_class(size + ptr_node_header_size);
+  ceph_assert(cls >= 0);
+  slab_cache *owner;
+  auto h = static_cast<ptr_node_header*>(slab_cache::allocate(cls, &owner));
+  h->owner = owner;
+  h->cls = cls;
+  return reinterpret_cast<char*>(h) + ptr_node_header_size;
+}
+
+void buffer::ptr_node::operator delete(void *p)
+{
+  auto h = reinterpret_cast<ptr_node_header*>(
+    static_cast<char*>(p) - ptr_node_header_size);
+  slab_cache::release(h, h->cls, h->owner);
+}
+
 bool buffer::ptr_node::dispose_if_hypercombined(
   buffer::ptr_node* const delete_this)
 {
@@ -0,0 +1,83 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace ceph::common {
+
+/**
+ * mpsc_queue: unbounded lock-free multi-producer single-consumer queue
+ *
+ * push() links the item onto the head of a LIFO list with a
+ * compare-and-swap, so producers never block each other; a producer only
+ * retries when another push lands in between.  The consumer detaches the
+ * whole list with an exchange and reverses it, which yields every item
+ * pushed so far in push order.  Items pushed by one thread, or by threads that
+ * order their pushes by other means (e.g., a pg lock), are consumed in
+ * that order.
+ *
+ * Any number of threads may push concurrently.  Only one thread at a time
+ * may call drain(); callers serialize it with their own lock.  empty() is
+ * a hint that may be called from any thread.
+ */
+template <typename T>
+class mpsc_queue {
+  struct node {
+    T item;
+    node *next = nullptr;
+    explicit node(T&& i) : item(std::move(i)) {}
+  };
+  std::atomic<node*> head = {nullptr};
+
+public:
+  mpsc_queue() = default;
+  mpsc_queue(const mpsc_queue&) = delete;
+  mpsc_queue& operator=(const mpsc_queue&) = delete;
+  ~mpsc_queue() {
+    drain([](T&&) {});
+  }
+
+  void push(T&& item) {
+    node *n = new node(std::move(item));
+    n->next = head.load(std::memory_order_relaxed);
+    // seq_cst, so that a consumer going to sleep after checking empty()
+    // and a producer checking for sleepers afterwards cannot both miss
+    while (!head.compare_exchange_weak(n->next, n)) {
+    }
+  }
+
+  bool empty() const {
+    return head.load() == nullptr;
+  }
+
+  /// pass each queued item to f in push order; returns the number drained
+  template <typename F>
+  unsigned drain(F&& f) {
+    node *n = head.exchange(nullptr);
+    if (!n) {
+      return 0;
+    }
+    // reverse into fifo order
+    node *fifo = nullptr;
+    while (n) {
+      node *next = n->next;
+      n->next = fifo;
+      fifo = n;
+      n = next;
+    }
+    unsigned count = 0;
+    while (fifo) {
+      node *next = fifo->next;
+      f(std::move(fifo->item));
+      delete fifo;
+      fifo = next;
+      ++count;
+    }
+    return count;
+  }
+};
+
+}
@@ -6,6 +6,10 @@
 #include <cstring>
 #include <errno.h>
 #include <iostream>
+#include <string_view>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
 
 #include "include/stringify.h"
 #include "common/safe_io.h"
@@ -184,6 +188,95 @@ int set_cpu_affinity_all_threads(size_t cpu_set_size, cpu_set_t *cpu_set)
   return 0;
 }
 
+int set_cpu_affinity_threads(const std::set<std::string>& name_prefixes,
+			     size_t cpu_set_size,
+			     cpu_set_t *cpu_set,
+			     unsigned *num_threads)
+{
+  std::set<std::string> ls;
+  std::string path = "/proc/"s + stringify(getpid()) + "/task";
+  int r = easy_readdir(path, &ls);
+  if (r < 0) {
+    return r;
+  }
+  unsigned n = 0;
+  for (auto& i : ls) {
+    pid_t tid = atoll(i.c_str());
+    if (!tid) {
+      continue;
+    }
+    std::string fn = path + "/" + i + "/comm";
+    int fd = ::open(fn.c_str(), O_RDONLY);
+    if (fd < 0) {
+      continue;  // raced with thread exit
+    }
+    char buf[32];
+    r = safe_read(fd, &buf, sizeof(buf) - 1);
+    ::close(fd);
+    if (r <= 0) {
+      continue;
+    }
+    buf[r] = 0;
+    while (r > 0 && ::isspace(buf[--r])) {
+      buf[r] = 0;
+    }
+    if (!thread_name_matches(buf, name_prefixes)) {
+      continue;
+    }
+    if (sched_setaffinity(tid, cpu_set_size, cpu_set) < 0) {
+      return -errno;
+    }
+    ++n;
+  }
+  if (num_threads) {
+    *num_threads = n;
+  }
+  return 0;
+}
+
+int set_numa_memory_preferred(int node)
+{
+  // from linux/mempolicy.h, which we avoid to not depend on libnuma headers
+  const int mpol_default = 0;
+  const int mpol_preferred = 1;
+  if (node < 0) {
+    if (syscall(SYS_set_mempolicy, mpol_default, nullptr, 0) < 0) {
+      return -errno;
+    }
+    return 0;
+  }
+  const unsigned long bits = sizeof(unsigned long) * 8;
+  if ((unsigned)node >= bits * 16) {
+    return -EINVAL;
+  }
+  unsigned long mask[16] = {0};
+  mask[node / bits] = 1ul << (node % bits);
+  if (syscall(SYS_set_mempolicy, mpol_preferred, mask, bits * 16) < 0) {
+    return -errno;
+  }
+  return 0;
+}
+
+int get_numa_node_stat(int node, numa_node_stat_t *stat)
+{
+  std::string fn = "/sys/devices/system/node/node";
+  fn += stringify(node);
+  fn += "/numastat";
+  int fd = ::open(fn.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return -errno;
+  }
+  char buf[1024];
+  int r = safe_read(fd, &buf, sizeof(buf) - 1);
+  ::close(fd);
+  if (r < 0) {
+    return r;
+  }
+  buf[r] = 0;
+  parse_numa_node_stat(buf, stat);
+  return 0;
+}
+
 #elif defined(__FreeBSD__)
 
 int parse_cpu_set_list(const char *s,
@@ -218,4 +311,66 @@ int set_cpu_affinity_all_threads(size_t cpu_set_size,
   return -ENOTSUP;
 }
 
+int set_cpu_affinity_threads(const std::set<std::string>& name_prefixes,
+			     size_t cpu_set_size,
+			     cpu_set_t *cpu_set,
+			     unsigned *num_threads)
+{
+  return -ENOTSUP;
+}
+
+int set_numa_memory_preferred(int node)
+{
+  return -ENOTSUP;
+}
+
+int get_numa_node_stat(int node, numa_node_stat_t *stat)
+{
+  return -ENOTSUP;
+}
+
 #endif
+
+
+numa_placement_t pick_numa_placement(int subsystem_node, int osd_node,
+				     bool prefer_local_memory)
+{
+  numa_placement_t p;
+  p.node = subsystem_node >= 0 ? subsystem_node : osd_node;
+  p.prefer_local_memory = p.node >= 0 && prefer_local_memory;
+  return p;
+}
+
+bool thread_name_matches(std::string_view name,
+			 const std::set<std::string>& name_prefixes)
+{
+  for (auto& prefix : name_prefixes) {
+    if (name.substr(0, prefix.size()) == prefix) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void parse_numa_node_stat(const char *buf, numa_node_stat_t *stat)
+{
+  // lines of "<name> <count>"
+  const char *p = buf;
+  while (*p) {
+    const char *eol = strchr(p, '\n');
+    std::string line = eol ? std::string(p, eol - p) : std::string(p);
+    char name[32];
+    unsigned long long v;
+    if (sscanf(line.c_str(), "%31s %llu", name, &v) == 2) {
+      if (strcmp(name, "local_node") == 0) {
+	stat->local_node = v;
+      } else if (strcmp(name, "other_node") == 0) {
+	stat->other_node = v;
+      }
+    }
+    if (!eol) {
+      break;
+    }
+    p = eol + 1;
+  }
+}
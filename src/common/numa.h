@@ -7,6 +7,7 @@
 #include <sched.h>
 #include <ostream>
 #include <set>
+#include <string_view>
 
 int parse_cpu_set_list(const char *s,
 		       size_t *cpu_set_size,
@@ -22,3 +23,34 @@ int get_numa_node_cpu_set(int node,
 
 int set_cpu_affinity_all_threads(size_t cpu_set_size,
 				 cpu_set_t *cpu_set);
+
+/// set affinity for threads whose name starts with any of name_prefixes
+int set_cpu_affinity_threads(const std::set<std::string>& name_prefixes,
+			     size_t cpu_set_size,
+			     cpu_set_t *cpu_set,
+			     unsigned *num_threads);
+
+/// prefer memory on numa node for the calling thread (-1 for default)
+int set_numa_memory_preferred(int node);
+
+/// system-wide page allocation counts from a node's numastat
+struct numa_node_stat_t {
+  uint64_t local_node = 0;  ///< allocated here by a task running here
+  uint64_t other_node = 0;  ///< allocated here by a task running elsewhere
+};
+int get_numa_node_stat(int node, numa_node_stat_t *stat);
+/// parse the contents of a node's numastat into stat
+void parse_numa_node_stat(const char *buf, numa_node_stat_t *stat);
+
+/// whether a thread name starts with any of name_prefixes
+bool thread_name_matches(std::string_view name,
+			 const std::set<std::string>& name_prefixes);
+
+/// where a group of osd threads goes
+struct numa_placement_t {
+  int node = -1;                     ///< -1 to leave them alone
+  bool prefer_local_memory = false;  ///< prefer allocating on node
+};
+/// a subsystem's own node if set (>= 0), else the osd's node
+numa_placement_t pick_numa_placement(int subsystem_node, int osd_node,
+				     bool prefer_local_memory);
@@ -942,6 +942,11 @@ std::vector<Option> get_global_options() {
     .set_default(0)
     .set_description("Size of TCP socket receive buffer"),
 
+    Option("ms_tcp_zerocopy_min_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Send with MSG_ZEROCOPY when at least this much data is queued (0 to disable)")
+    .set_long_description("With the posix stack on Linux, sends of at least this many bytes let the kernel transmit directly from our buffers instead of copying them into the socket buffer; the buffers are held until the kernel reports them done.  This only pays off for large sends; 64K or more is a reasonable value.  Connections over loopback, or through devices the kernel must copy for anyway, stop using it after the first such report."),
+
     Option("ms_tcp_prefetch_max_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(4_K)
     .set_description("Maximum amount of data to prefetch out of the socket receive buffer"),
@@ -1120,6 +1125,29 @@ std::vector<Option> get_global_options() {
     .set_min_max(1, 24)
     .set_description("Threadpool size for AsyncMessenger (ms_type=async)"),
 
+    Option("ms_async_event_driver", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("epoll")
+    .set_enum_allowed({"epoll", "io_uring"})
+    .set_description("Event driver for the AsyncMessenger worker threads")
+    .set_long_description("io_uring watches sockets with multishot poll requests and sends mask changes to the kernel along with each wait, saving the syscall per change.  It needs a build with liburing and a kernel with multishot poll (5.13 or later); otherwise epoll (or kqueue/select on other platforms) is used.")
+    .add_see_also("ms_async_op_threads"),
+
+    Option("ms_async_rx_pool_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Bytes of free page-aligned receive buffers each AsyncMessenger worker keeps for reuse")
+    .set_long_description("Message data is received into page-aligned buffers so that it can be written with direct I/O without being copied to realign it.  Buffers freed once a message is done with are kept, up to this many bytes per worker, for the next message.  0 disables the recycling.  ceph-osd defaults this to 16M, other daemons and clients to 0.  What the pools hold shows up as msgr_rx_pool in dump_mempools.")
+    .add_see_also("ms_async_rx_pool_max_buffer"),
+
+    Option("ms_async_rx_pool_max_buffer", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(8_M)
+    .set_description("Largest receive buffer that is recycled")
+    .add_see_also("ms_async_rx_pool_size"),
+
+    Option("ms_max_channels", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1024)
+    .set_description("Maximum number of logical sessions multiplexed over one msgr2 connection (0 to refuse them)")
+    .set_long_description("Entities on one host, e.g. the clients behind a local proxy, can share a single connection to a peer instead of each opening their own, which saves the peer a socket and its buffers and timers per entity.  This bounds how many such channels one connection may carry, on both ends."),
+
     Option("ms_async_max_op_threads", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(5)
     .set_description("Maximum threadpool size of AsyncMessenger")
@@ -1137,6 +1165,11 @@ std::vector<Option> get_global_options() {
     .set_default(128_K)
     .set_description(""),
 
+    Option("ms_async_rdma_registered_pool_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(256_M)
+    .set_description("Bytes of freed registered tx buffers to keep for reuse")
+    .set_long_description("Buffers from NetworkStack::create_tx_buffer() are registered with the device so they can be sent without a copy. Registering memory is expensive, so freed buffers are kept, up to this many bytes, for the next caller."),
+
     Option("ms_async_rdma_send_buffers", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(1_K)
     .set_description(""),
@@ -1382,6 +1415,13 @@ std::vector<Option> get_global_options() {
     .add_service("mon")
     .set_description("granularity of PG placement calculation background work"),
 
+    Option("mon_osd_mapping_incremental", Option::TYPE_BOOL, Option::LEVEL_DEV)
+    .set_default(true)
+    .add_service("mon")
+    .set_description("recompute only the PGs an osdmap incremental may remap")
+    .set_long_description("When the OSDMap advances by a single epoch, use the incremental to find the PGs whose placement may have changed (by the crush subtree of reweighted OSDs, the pgs mapped to OSDs that went up or down, and pg_temp/upmap keys) and recalculate only those.")
+    .add_see_also("mon_osd_mapping_pgs_per_chunk"),
+
     Option("mon_clean_pg_upmaps_per_chunk", Option::TYPE_UINT, Option::LEVEL_DEV)
     .set_default(256)
     .add_service("mon")
@@ -2343,6 +2383,11 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("objecter_balance_reads_by_load", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Send balanced reads to a lightly loaded replica")
+    .set_long_description("For reads flagged to be balanced across replicas of a replicated pool, compare two random members of the acting set and send the read to the one with the lower reply latency times queued ops, instead of a random one."),
+
     Option("filer_max_purge_ops", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(10)
     .set_description("Max in-flight operations for purging a striped range (e.g., MDS journal)"),
@@ -2400,6 +2445,35 @@ std::vector<Option> get_global_options() {
     .set_description("set affinity to a numa node (-1 for none)")
     .add_see_also("osd_numa_auto_affinity"),
 
+    Option("osd_numa_node_op_shards", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(-1)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("numa node for op shard worker threads (-1 to follow the osd)")
+    .set_long_description("Op shard workers pin themselves to this node and, if osd_numa_prefer_local_memory is set, prefer to allocate from it. If -1, the node chosen by osd_numa_node or osd_numa_auto_affinity is used.")
+    .add_see_also("osd_numa_node")
+    .add_see_also("osd_numa_prefer_local_memory"),
+
+    Option("osd_numa_node_messenger", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(-1)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("numa node for async messenger worker threads (-1 to follow the osd)")
+    .set_long_description("Typically the numa node of the network interface.")
+    .add_see_also("osd_numa_node"),
+
+    Option("osd_numa_node_objectstore", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(-1)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("numa node for objectstore threads (-1 to follow the osd)")
+    .set_long_description("Applies to BlueStore kv, aio and discard threads and rocksdb background threads. Typically the numa node of the storage device.")
+    .add_see_also("osd_numa_node"),
+
+    Option("osd_numa_prefer_local_memory", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("op shard workers prefer allocating memory from their numa node")
+    .set_long_description("Only has an effect when op shards are placed on a numa node, by osd_numa_node_op_shards, osd_numa_node or osd_numa_auto_affinity.  Keeps the memory they allocate next to them, at the cost of filling that node first while others have memory free.")
+    .add_see_also("osd_numa_node_op_shards"),
+
     Option("osd_smart_report_timeout", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(5)
     .set_description("Timeout (in seconds) for smarctl to run, default is set to 5"),
@@ -2909,11 +2983,51 @@ std::vector<Option> get_global_options() {
     .set_long_description("Only considered for osd_op_queue = mClockScheduler")
     .add_see_also("osd_op_queue"),
 
+    Option("osd_mclock_scheduler_background_scrub_res", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(8_M)
+    .set_description("Bytes/sec of scrub reads reserved for each scrubbing PG")
+    .set_long_description("Only considered for osd_op_queue = mClockScheduler")
+    .add_see_also("osd_op_queue"),
+
+    Option("osd_mclock_scheduler_background_scrub_wgt", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1)
+    .set_description("Share of each scrubbing PG over reservation, per byte read")
+    .set_long_description("Only considered for osd_op_queue = mClockScheduler. Scrub is charged per byte while other classes are charged per item, so the weight must be scaled up accordingly to let scrub compete for spare capacity.")
+    .add_see_also("osd_op_queue"),
+
+    Option("osd_mclock_scheduler_background_scrub_lim", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(100_G)
+    .set_description("Bytes/sec limit of scrub reads for each scrubbing PG")
+    .set_long_description("Only considered for osd_op_queue = mClockScheduler")
+    .add_see_also("osd_op_queue"),
+
     Option("osd_mclock_scheduler_anticipation_timeout", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
     .set_default(0.0)
     .set_description("mclock anticipation timeout in seconds")
     .set_long_description("the amount of time that mclock waits until the unused resource is forfeited"),
 
+    Option("osd_mclock_max_capacity_iops", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.0)
+    .set_min(0.0)
+    .set_description("Small random write IOPS the OSD device can sustain")
+    .set_long_description("Used by the mclock scheduler to charge client ops in units of small IOs according to their size. If 0, the OSD measures it at startup when osd_mclock_cost_calibrate_on_start is set; otherwise every client op costs 1.")
+    .add_see_also("osd_mclock_max_capacity_bandwidth")
+    .add_see_also("osd_mclock_cost_calibrate_on_start"),
+
+    Option("osd_mclock_max_capacity_bandwidth", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Large write bytes/sec the OSD device can sustain")
+    .set_long_description("Used by the mclock scheduler together with osd_mclock_max_capacity_iops. If 0, the OSD measures it at startup when osd_mclock_cost_calibrate_on_start is set.")
+    .add_see_also("osd_mclock_max_capacity_iops")
+    .add_see_also("osd_mclock_cost_calibrate_on_start"),
+
+    Option("osd_mclock_cost_calibrate_on_start", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Benchmark the object store at startup to calibrate the mclock cost model")
+    .set_long_description("Only considered for osd_op_queue = mclock_scheduler. Runs a short 4 KiB random write and 4 MiB sequential write bench before the OSD boots and fills in whichever of osd_mclock_max_capacity_iops and osd_mclock_max_capacity_bandwidth is 0. The results are not persisted, so the bench runs on every boot; set the two capacities explicitly to avoid it.")
+    .add_see_also("osd_mclock_max_capacity_iops")
+    .add_see_also("osd_mclock_max_capacity_bandwidth"),
+
     Option("osd_ignore_stale_divergent_priors", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description(""),
@@ -3135,6 +3249,36 @@ std::vector<Option> get_global_options() {
     .set_default(10)
     .set_description(""),
 
+    Option("osd_recovery_max_batch", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1)
+    .set_min(1)
+    .set_description("Upper bound on how many objects each recovery slot "
+		     "may cover when recovering small objects")
+    .set_long_description("While recovery is limited by the number of active "
+			  "recovery operations rather than by bytes, and "
+			  "recovered objects are small, the OSD lets each of "
+			  "osd_recovery_max_active slots (and each push "
+			  "message's osd_max_push_objects) cover up to this "
+			  "many objects, so that they travel in fewer, larger "
+			  "push messages that each apply as one transaction.  "
+			  "This raises the number of objects in flight to up "
+			  "to osd_recovery_max_active times this value.  1 "
+			  "disables this.")
+    .add_service("osd")
+    .add_see_also("osd_recovery_max_active")
+    .add_see_also("osd_max_push_objects")
+    .add_see_also("osd_recovery_max_bytes_per_sec"),
+
+    Option("osd_recovery_max_bytes_per_sec", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Recovery bandwidth this OSD aims to stay under (0 "
+		     "for no limit)")
+    .set_long_description("When recovery goes faster than this, the recovery "
+			  "batch shrinks and, once down to one object per "
+			  "slot, recovery is deferred to make up the excess.")
+    .add_service("osd")
+    .add_see_also("osd_recovery_max_batch"),
+
     Option("osd_max_scrubs", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(1)
     .set_description("Maximum concurrent scrubs on a single OSD"),
@@ -3204,6 +3348,20 @@ std::vector<Option> get_global_options() {
     .set_description("Maximum number of objects to scrub in a single chunk")
     .add_see_also("osd_scrub_chunk_min"),
 
+    Option("osd_scrub_target_duration", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Target duration in seconds of a PG scrub, 0 to pace scrubs statically")
+    .set_long_description("When set, the chunk size adapts (between osd_scrub_chunk_min and osd_scrub_chunk_max) to finish the scrub in about this time, and osd_scrub_sleep is skipped while the scrub is behind schedule. Chunks shrink whenever one takes longer than osd_scrub_chunk_max_duration, since writes to its objects are blocked meanwhile.")
+    .add_see_also("osd_scrub_chunk_max_duration")
+    .add_see_also("osd_scrub_chunk_min")
+    .add_see_also("osd_scrub_chunk_max")
+    .add_see_also("osd_scrub_sleep"),
+
+    Option("osd_scrub_chunk_max_duration", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.5)
+    .set_description("Longest a scrub chunk may take before the chunk size is reduced")
+    .add_see_also("osd_scrub_target_duration"),
+
     Option("osd_scrub_sleep", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
     .set_default(0)
     .set_description("Duration to inject a delay during scrubbing"),
@@ -3242,6 +3400,19 @@ std::vector<Option> get_global_options() {
     .set_default(512_K)
     .set_description("Number of bytes to read from an object at a time during deep scrub"),
 
+    Option("osd_deep_scrub_store_digest", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Let the object store compute data digests during deep scrub")
+    .set_long_description("When the object store keeps its own crc32c data checksums (e.g., BlueStore), it verifies them while reading and composes the data digest from them, instead of handing the data to the OSD to be checksummed a second time.")
+    .add_see_also("osd_deep_scrub_store_digest_queue_depth"),
+
+    Option("osd_deep_scrub_store_digest_queue_depth", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(8)
+    .set_min(1)
+    .set_description("Number of osd_deep_scrub_stride sized ranges the object store is asked to digest at once during deep scrub")
+    .add_see_also("osd_deep_scrub_store_digest")
+    .add_see_also("osd_deep_scrub_stride"),
+
     Option("osd_deep_scrub_keys", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(1024)
     .set_description("Number of keys to read from an object at a time during deep scrub"),
@@ -3323,6 +3494,29 @@ std::vector<Option> get_global_options() {
     .add_see_also("osd_min_pg_log_entries")
     .add_see_also("osd_max_pg_log_entries"),
 
+    Option("osd_pg_log_dups_per_key", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("how many dup entries to store per pg log omap key")
+    .set_long_description("Dup entries created when the pg log is trimmed are written as segments of up to this many entries per omap key, so trimming writes and deletes a few keys instead of one per entry.  0 writes one key per dup.  Segments are stored under new dup_<version>.seg keys, which older releases and ceph-objectstore-tool cannot read; do not enable this while an OSD may still be downgraded.")
+    .add_service("osd")
+    .add_see_also("osd_pg_log_dups_tracked"),
+
+    Option("osd_pg_modset_bits", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_min_max(0, 16)
+    .set_description("track recently modified objects in 2^N hash buckets per pg")
+    .set_long_description("Each pg remembers which buckets of its hash range recent log entries touched, well past the end of the pg log.  When a replica that was complete comes back too far behind for log based recovery, backfill then only scans and copies the buckets that changed since.  0 (the default) disables this, and backfill always scans the whole pg; 10 is a reasonable value when enabling it.")
+    .add_service("osd")
+    .add_see_also("osd_pg_modset_entries"),
+
+    Option("osd_pg_modset_entries", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(20000)
+    .set_min(1)
+    .set_description("log entries per generation of the modified bucket set")
+    .set_long_description("The modified bucket set keeps two generations of this many log entries, so incremental backfill is possible for a replica that is up to twice this many entries behind.  Longer generations reach further back but mark more of the pg as modified.")
+    .add_service("osd")
+    .add_see_also("osd_pg_modset_bits"),
+
     Option("osd_object_clean_region_max_num_intervals", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(10)
     .set_description("number of intervals in clean_offsets")
@@ -3698,6 +3892,34 @@ std::vector<Option> get_global_options() {
     .set_default(255)
     .set_description(""),
 
+    Option("osd_load_pgs_threads", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(8)
+    .set_min(1)
+    .set_description("Number of threads reading PG metadata at OSD startup")
+    .set_long_description("Each PG's info, log and missing set are read from "
+			  "the object store when the OSD starts; this many "
+			  "PGs are read in parallel.")
+    .add_service("osd"),
+
+    Option("osd_peering_batch_max", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(64)
+    .set_description("Maximum number of PG notifies or queries coalesced "
+		     "into one message to a peer OSD")
+    .set_long_description("Peering notifies and queries from the PGs of an "
+			  "op shard are held and sent to each peer OSD as one "
+			  "message once this many are queued, the shard goes "
+			  "idle, or osd_peering_batch_max_delay passes.  Values "
+			  "of 0 or 1 send each one as it is generated.")
+    .add_service("osd")
+    .add_see_also("osd_peering_batch_max_delay"),
+
+    Option("osd_peering_batch_max_delay", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.005)
+    .set_description("Longest time (seconds) a busy op shard holds peering "
+		     "notifies and queries for coalescing")
+    .add_service("osd")
+    .add_see_also("osd_peering_batch_max"),
+
     Option("osd_snap_trim_priority", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(5)
     .set_description(""),
@@ -97,6 +97,10 @@ inline uint64_t generate_client_cookie() {
       1, std::numeric_limits<uint64_t>::max());
 }
 
+// channels are not implemented here, so don't offer them
+const uint64_t msgr2_supported_features =
+  CEPH_MSGR2_SUPPORTED_FEATURES & ~CEPH_MSGR2_FEATURE_CHANNELS;
+
 } // namespace anonymous
 
 template <>
@@ -496,7 +500,7 @@ seastar::future<entity_type_t, entity_addr_t> ProtocolV2::banner_exchange()
 {
   // 1. prepare and send banner
   bufferlist banner_payload;
-  encode((uint64_t)CEPH_MSGR2_SUPPORTED_FEATURES, banner_payload, 0);
+  encode((uint64_t)msgr2_supported_features, banner_payload, 0);
   encode((uint64_t)CEPH_MSGR2_REQUIRED_FEATURES, banner_payload, 0);
 
   bufferlist bl;
@@ -507,7 +511,7 @@ seastar::future<entity_type_t, entity_addr_t> ProtocolV2::banner_exchange()
   logger().debug("{} SEND({}) banner: len_payload={}, supported={}, "
                  "required={}, banner=\"{}\"",
                  conn, bl.length(), len_payload,
-                 CEPH_MSGR2_SUPPORTED_FEATURES, CEPH_MSGR2_REQUIRED_FEATURES,
+                 msgr2_supported_features, CEPH_MSGR2_REQUIRED_FEATURES,
                  CEPH_BANNER_V2_PREFIX);
   INTERCEPT_CUSTOM(custom_bp_t::BANNER_WRITE, bp_type_t::WRITE);
   return write_flush(std::move(bl)).then([this] {
@@ -562,7 +566,7 @@ seastar::future<entity_type_t, entity_addr_t> ProtocolV2::banner_exchange()
                      peer_supported_features, peer_required_features);
 
       // Check feature bit compatibility
-      uint64_t supported_features = CEPH_MSGR2_SUPPORTED_FEATURES;
+      uint64_t supported_features = msgr2_supported_features;
       uint64_t required_features = CEPH_MSGR2_REQUIRED_FEATURES;
       if ((required_features & peer_supported_features) != required_features) {
         logger().error("{} peer does not support all required features"
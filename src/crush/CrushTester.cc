@@ -2,6 +2,7 @@
 // vim: ts=8 sw=2 smarttab
 
 #include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
 
@@ -805,3 +806,82 @@ int CrushTester::compare(CrushWrapper& crush2)
   }
   return ret;
 }
+
+int CrushTester::bench()
+{
+  if (min_rule < 0 || max_rule < 0) {
+    min_rule = 0;
+    max_rule = crush.get_max_rules() - 1;
+  }
+  if (min_x < 0 || max_x < 0) {
+    min_x = 0;
+    max_x = 1024 * 1024 - 1;
+  }
+
+  // initial osd weights
+  vector<__u32> weight;
+  for (int o = 0; o < crush.get_max_devices(); o++) {
+    if (device_weight.count(o)) {
+      weight.push_back(device_weight[o]);
+    } else if (crush.check_item_present(o)) {
+      weight.push_back(0x10000);
+    } else {
+      weight.push_back(0);
+    }
+  }
+
+  // make adjustments
+  adjust_weights(weight);
+
+  vector<int> xs;
+  for (int x = min_x; x <= max_x; ++x) {
+    uint32_t real_x = x;
+    if (pool_id != -1) {
+      real_x = crush_hash32_2(CRUSH_HASH_RJENKINS1, x, (uint32_t)pool_id);
+    }
+    xs.push_back(real_x);
+  }
+
+  int ret = 0;
+  for (int r = min_rule; r < crush.get_max_rules() && r <= max_rule; r++) {
+    if (!crush.rule_exists(r)) {
+      continue;
+    }
+    if (ruleset >= 0 &&
+	crush.get_rule_mask_ruleset(r) != ruleset) {
+      continue;
+    }
+    int minr = min_rep, maxr = max_rep;
+    if (min_rep < 0 || max_rep < 0) {
+      minr = crush.get_rule_mask_min_size(r);
+      maxr = crush.get_rule_mask_max_size(r);
+    }
+    for (int nr = minr; nr <= maxr; nr++) {
+      vector<vector<int>> single(xs.size()), batch;
+      auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < xs.size(); ++i) {
+	crush.do_rule(r, xs[i], single[i], nr, weight, 0);
+      }
+      auto mid = std::chrono::steady_clock::now();
+      crush.do_rule_batch(r, xs, &batch, nr, weight, 0);
+      auto end = std::chrono::steady_clock::now();
+      std::chrono::duration<double> single_time = mid - start;
+      std::chrono::duration<double> batch_time = end - mid;
+      int bad = 0;
+      for (size_t i = 0; i < xs.size(); ++i) {
+	if (single[i] != batch[i]) {
+	  ++bad;
+	}
+      }
+      if (bad) {
+	ret = -1;
+      }
+      cout << "rule " << r << " (" << crush.get_rule_name(r)
+	   << ") num_rep " << nr << ": " << xs.size() << " mappings"
+	   << ", single " << xs.size() / single_time.count() << "/s"
+	   << ", batch " << xs.size() / batch_time.count() << "/s"
+	   << ", " << bad << " mismatched" << std::endl;
+    }
+  }
+  return ret;
+}
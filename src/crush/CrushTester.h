@@ -359,6 +359,11 @@ public:
   void check_overlapped_rules() const;
   int test();
   int test_with_fork(int timeout);
+  /**
+   * time do_rule one input at a time against do_rule_batch over the
+   * same inputs, and check that both give the same mappings
+   */
+  int bench();
 
   int compare(CrushWrapper& other);
 };
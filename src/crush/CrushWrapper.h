@@ -1586,6 +1586,28 @@ public:
       out[i] = rawout[i];
   }
 
+  /// map each of xs through the rule, as do_rule would; out[i] is for xs[i]
+  template<typename WeightVector>
+  void do_rule_batch(int rule, const std::vector<int>& xs,
+		     std::vector<std::vector<int>> *out, int maxout,
+		     const WeightVector& weight,
+		     uint64_t choose_args_index) const {
+    std::vector<int> rawout(xs.size() * maxout);
+    std::vector<int> lens(xs.size());
+    std::vector<char> work(crush_work_size(crush, maxout));
+    crush_init_workspace(crush, work.data());
+    crush_choose_arg_map arg_map = choose_args_get_with_fallback(
+      choose_args_index);
+    crush_do_rule_batch(crush, rule, xs.data(), xs.size(), rawout.data(),
+			maxout, lens.data(), &weight[0], weight.size(),
+			work.data(), arg_map.args);
+    out->resize(xs.size());
+    for (size_t i = 0; i < xs.size(); i++) {
+      auto p = rawout.begin() + i * maxout;
+      (*out)[i].assign(p, p + std::max(lens[i], 0));
+    }
+  }
+
   int _choose_type_stack(
     CephContext *cct,
     const std::vector<std::pair<int,int>>& stack,
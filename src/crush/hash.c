@@ -120,6 +120,60 @@ __u32 crush_hash32_3(int type, __u32 a, __u32 b, __u32 c)
 	}
 }
 
+#if defined(__GNUC__) && !defined(__KERNEL__)
+/*
+ * The same mix as crush_hash32_rjenkins1_3, computed for
+ * CRUSH_HASH_LANES values of b at once.  Generic vector arithmetic wraps
+ * just like the scalar __u32 ops, so the results are bit-identical; the
+ * compiler lowers it to whatever SIMD width the target has (or to scalar
+ * code if it has none).
+ */
+typedef __u32 crush_hash_vec_t
+	__attribute__((vector_size(CRUSH_HASH_LANES * sizeof(__u32))));
+
+static void crush_hash32_rjenkins1_3_vec(__u32 sa, const __s32 *sb, __u32 sc,
+					 __u32 *out)
+{
+	crush_hash_vec_t a, b, c, x, y, hash;
+	const crush_hash_vec_t zero = {0};
+
+	memcpy(&b, sb, sizeof(b));
+	a = zero + sa;
+	c = zero + sc;
+	x = zero + 231232;
+	y = zero + 1232;
+	hash = (zero + crush_hash_seed) ^ a ^ b ^ c;
+	crush_hashmix(a, b, hash);
+	crush_hashmix(c, x, hash);
+	crush_hashmix(y, a, hash);
+	crush_hashmix(b, x, hash);
+	crush_hashmix(y, c, hash);
+	memcpy(out, &hash, sizeof(hash));
+}
+#endif
+
+/*
+ * Hash (a, b[i], c) for i in [0, n), with the same results as calling
+ * crush_hash32_3 for each i.
+ */
+void crush_hash32_3_n(int type, __u32 a, const __s32 *b, __u32 c,
+		      __u32 *out, unsigned int n)
+{
+	unsigned int i = 0;
+
+	if (type != CRUSH_HASH_RJENKINS1) {
+		for (i = 0; i < n; i++)
+			out[i] = 0;
+		return;
+	}
+#if defined(__GNUC__) && !defined(__KERNEL__)
+	for (; i + CRUSH_HASH_LANES <= n; i += CRUSH_HASH_LANES)
+		crush_hash32_rjenkins1_3_vec(a, b + i, c, out + i);
+#endif
+	for (; i < n; i++)
+		out[i] = crush_hash32_rjenkins1_3(a, b[i], c);
+}
+
 __u32 crush_hash32_4(int type, __u32 a, __u32 b, __u32 c, __u32 d)
 {
 	switch (type) {
@@ -78,6 +78,33 @@ extern int crush_do_rule(const struct crush_map *map,
 			 const __u32 *weights, int weight_max,
 			 void *cwin, const struct crush_choose_arg *choose_args);
 
+/** @ingroup API
+ *
+ * Map each of the __n__ inputs in __x__ as crush_do_rule() would,
+ * sharing one workspace and one lookup of the rule and choose_args.
+ * The result for x[i] is stored in result[i * result_max] and its
+ * size in result_len[i]; results are identical to calling
+ * crush_do_rule() for each input.
+ *
+ * @param map the crush_map
+ * @param ruleno a positive integer < __CRUSH_MAX_RULES__
+ * @param x the __n__ values to map
+ * @param n the number of values in __x__
+ * @param result an array of items of size __n__ * __result_max__
+ * @param result_max the maximum number of items per input
+ * @param result_len an array of size __n__ for the result sizes
+ * @param weights an array of weights of size __weight_max__
+ * @param weight_max the size of the __weights__ array
+ * @param cwin must be an char array initialized by crush_init_workspace
+ * @param choose_args weights and ids for each known bucket
+ */
+extern void crush_do_rule_batch(const struct crush_map *map,
+				int ruleno, const int *x, int n,
+				int *result, int result_max, int *result_len,
+				const __u32 *weights, int weight_max,
+				void *cwin,
+				const struct crush_choose_arg *choose_args);
+
 /* Returns the exact amount of workspace that will need to be used
    for a given combination of crush_map and result_max. The caller can
    then allocate this much on its own, either on the stack, in a
@@ -134,6 +134,8 @@ inline namespace v14_2_0 {
   int get_cached_crc_adjusted();
   /// count of crc cache misses
   int get_missed_crc();
+  /// bytes read to compute crcs the cache could not supply
+  uint64_t get_missed_crc_bytes();
   /// enable/disable tracking of cached crcs
   void track_cached_crc(bool b);
 
@@ -397,6 +399,10 @@ inline namespace v14_2_0 {
 
     ~ptr_node() = default;
 
+    // from per-thread slabs, see buffer.cc
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+
     static std::unique_ptr<ptr_node, disposer>
     create(ceph::unique_leakable_ptr<raw> r) {
       return create_hypercombined(std::move(r));
@@ -34,11 +34,21 @@ inline namespace v14_2_0 {
 			 alignof(ptr_node)>::type bptr_storage;
     char *data;
     unsigned len;
+    /// allocated beyond len, e.g. up to a slab class; charged to the
+    /// mempool along with it
+    unsigned slack = 0;
     std::atomic<unsigned> nref { 0 };
     int mempool;
 
-    std::pair<size_t, size_t> last_crc_offset {std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::max()};
-    std::pair<uint32_t, uint32_t> last_crc_val;
+    // crc32c of the last few byte ranges asked for; list::crc32c()
+    // stitches a range together from cached pieces where it can
+    struct crc_entry_t {
+      uint32_t from = 0, to = 0;  ///< unused if empty
+      uint32_t seed = 0, crc = 0;
+    };
+    static constexpr unsigned CRC_CACHE_SIZE = 4;
+    crc_entry_t crc_cache[CRC_CACHE_SIZE];
+    unsigned crc_cache_next = 0;
 
     mutable ceph::spinlock crc_spinlock;
 
@@ -52,14 +62,21 @@ inline namespace v14_2_0 {
     }
     virtual ~raw() {
       mempool::get_pool(mempool::pool_index_t(mempool)).adjust_count(
-	-1, -(int)len);
+	-1, -(int)(len + slack));
     }
 
     void _set_len(unsigned l) {
       mempool::get_pool(mempool::pool_index_t(mempool)).adjust_count(
-	-1, -(int)len);
+	-1, -(int)(len + slack));
       len = l;
-      mempool::get_pool(mempool::pool_index_t(mempool)).adjust_count(1, len);
+      mempool::get_pool(mempool::pool_index_t(mempool)).adjust_count(
+	1, len + slack);
+    }
+
+    void _set_slack(unsigned s) {
+      mempool::get_pool(mempool::pool_index_t(mempool)).adjust_count(
+	0, (int)s - (int)slack);
+      slack = s;
     }
 
     void reassign_to_mempool(int pool) {
@@ -67,9 +84,10 @@ inline namespace v14_2_0 {
 	return;
       }
       mempool::get_pool(mempool::pool_index_t(mempool)).adjust_count(
-	-1, -(int)len);
+	-1, -(int)(len + slack));
       mempool = pool;
-      mempool::get_pool(mempool::pool_index_t(pool)).adjust_count(1, len);
+      mempool::get_pool(mempool::pool_index_t(pool)).adjust_count(
+	1, len + slack);
     }
 
     void try_assign_to_mempool(int pool) {
@@ -102,22 +120,55 @@ public:
     bool get_crc(const std::pair<size_t, size_t> &fromto,
 		 std::pair<uint32_t, uint32_t> *crc) const {
       std::lock_guard lg(crc_spinlock);
-      if (last_crc_offset == fromto) {
-        *crc = last_crc_val;
-        return true;
+      for (auto& e : crc_cache) {
+	if (e.from != e.to && e.from == fromto.first && e.to == fromto.second) {
+	  *crc = std::make_pair(e.seed, e.crc);
+	  return true;
+	}
       }
       return false;
     }
+    /// find the longest cached range [from, *to) that ends by limit
+    bool get_crc_prefix(size_t from, size_t limit, size_t *to,
+			std::pair<uint32_t, uint32_t> *crc) const {
+      std::lock_guard lg(crc_spinlock);
+      const crc_entry_t *best = nullptr;
+      for (auto& e : crc_cache) {
+	if (e.from != e.to && e.from == from && e.to <= limit &&
+	    (!best || e.to > best->to)) {
+	  best = &e;
+	}
+      }
+      if (!best) {
+	return false;
+      }
+      *to = best->to;
+      *crc = std::make_pair(best->seed, best->crc);
+      return true;
+    }
     void set_crc(const std::pair<size_t, size_t> &fromto,
 		 const std::pair<uint32_t, uint32_t> &crc) {
       std::lock_guard lg(crc_spinlock);
-      last_crc_offset = fromto;
-      last_crc_val = crc;
+      crc_entry_t *slot = nullptr;
+      for (auto& e : crc_cache) {
+	if (e.from == fromto.first && e.to == fromto.second) {
+	  slot = &e;
+	  break;
+	}
+      }
+      if (!slot) {
+	slot = &crc_cache[crc_cache_next++ % CRC_CACHE_SIZE];
+      }
+      slot->from = fromto.first;
+      slot->to = fromto.second;
+      slot->seed = crc.first;
+      slot->crc = crc.second;
     }
     void invalidate_crc() {
       std::lock_guard lg(crc_spinlock);
-      last_crc_offset.first = std::numeric_limits<size_t>::max();
-      last_crc_offset.second = std::numeric_limits<size_t>::max();
+      for (auto& e : crc_cache) {
+	e.from = e.to = 0;
+      }
     }
   };
 
@@ -0,0 +1,375 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+#ifndef CEPH_COW_MAP_H
+#define CEPH_COW_MAP_H
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "include/ceph_assert.h"
+#include "include/encoding.h"
+#include "include/mempool.h"
+
+/**
+ * cow_map: a sorted map made of immutable, reference-counted chunks
+ *
+ * Copying a cow_map copies only the chunk pointers, and a write clones
+ * only the chunk it touches if that chunk is still shared, so a map and
+ * its copy share everything they have in common.  Chunk boundaries are
+ * a function of the keys alone: a chunk ends after a key whose hash is
+ * a multiple of TARGET_CHUNK, or once it reaches MAX_CHUNK entries.  Two
+ * maps built independently (e.g., decoded from consecutive epochs) with
+ * mostly the same contents therefore have mostly identical chunks, and
+ * dedup() can make them share those.
+ *
+ * Only const iteration is offered; write through operator[] or erase().
+ * Chunks and the chunk index are accounted to mempool pool_ix.
+ */
+template <class Key, class T, mempool::pool_index_t pool_ix,
+	  class Hash = std::hash<Key>>
+class cow_map {
+public:
+  typedef std::pair<Key, T> value_type;
+
+private:
+  static constexpr size_t TARGET_CHUNK = 32;
+  static constexpr size_t MAX_CHUNK = 4 * TARGET_CHUNK;
+
+  typedef std::vector<value_type,
+		      mempool::pool_allocator<pool_ix, value_type>> chunk_t;
+  typedef std::shared_ptr<chunk_t> chunk_ref;
+  std::vector<chunk_ref, mempool::pool_allocator<pool_ix, chunk_ref>> chunks;
+  size_t num = 0;
+
+  static bool is_boundary(const Key& k) {
+    // mix, since std::hash is often the identity on integers
+    uint64_t h = Hash()(k);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h % TARGET_CHUNK == 0;
+  }
+  static chunk_ref new_chunk() {
+    return std::allocate_shared<chunk_t>(
+      mempool::pool_allocator<pool_ix, chunk_t>());
+  }
+
+  /// index of the chunk that holds (or would hold) k
+  size_t chunk_for(const Key& k) const {
+    auto p = std::lower_bound(
+      chunks.begin(), chunks.end(), k,
+      [](const chunk_ref& c, const Key& k) { return c->back().first < k; });
+    if (p == chunks.end()) {
+      return chunks.size() - 1;
+    }
+    return p - chunks.begin();
+  }
+
+  /// make chunks[i] safe to modify in place
+  chunk_t& unshare(size_t i) {
+    if (chunks[i].use_count() > 1) {
+      auto c = new_chunk();
+      *c = *chunks[i];
+      chunks[i] = std::move(c);
+    }
+    return *chunks[i];
+  }
+
+  /**
+   * restore the canonical chunking after chunks[i] changed.  Cuts after
+   * chunk i are only affected up to the next chunk that ends at a
+   * boundary key, so merge up to there and re-cut.
+   */
+  void rechunk(size_t i) {
+    size_t end = i + 1;
+    while (end < chunks.size() &&
+	   (chunks[end - 1]->empty() ||
+	    !is_boundary(chunks[end - 1]->back().first))) {
+      ++end;
+    }
+    chunk_t all(mempool::pool_allocator<pool_ix, value_type>{});
+    for (size_t j = i; j < end; ++j) {
+      for (auto& v : *chunks[j]) {
+	all.push_back(v);
+      }
+    }
+    decltype(chunks) cut;
+    chunk_ref c;
+    for (auto& v : all) {
+      if (!c) {
+	c = new_chunk();
+      }
+      c->push_back(std::move(v));
+      if (is_boundary(c->back().first) || c->size() >= MAX_CHUNK) {
+	cut.push_back(std::move(c));
+      }
+    }
+    if (c) {
+      cut.push_back(std::move(c));
+    }
+    // keep the old chunks that came out the same; they may be shared
+    for (auto& n : cut) {
+      for (size_t j = i; j < end; ++j) {
+	if (*chunks[j] == *n) {
+	  n = chunks[j];
+	  break;
+	}
+      }
+    }
+    chunks.erase(chunks.begin() + i, chunks.begin() + end);
+    chunks.insert(chunks.begin() + i, cut.begin(), cut.end());
+  }
+
+  /// append in key order, cutting chunks as we go
+  void push_back(value_type&& v) {
+    if (chunks.empty() ||
+	is_boundary(chunks.back()->back().first) ||
+	chunks.back()->size() >= MAX_CHUNK) {
+      chunks.push_back(new_chunk());
+    }
+    chunks.back()->push_back(std::move(v));
+    ++num;
+  }
+
+public:
+  class const_iterator {
+    const cow_map *m = nullptr;
+    size_t chunk = 0, pos = 0;
+    friend class cow_map;
+    const_iterator(const cow_map *m, size_t chunk, size_t pos)
+      : m(m), chunk(chunk), pos(pos) {}
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename cow_map::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type* pointer;
+    typedef const value_type& reference;
+
+    const_iterator() = default;
+    reference operator*() const {
+      return (*m->chunks[chunk])[pos];
+    }
+    pointer operator->() const {
+      return &(*m->chunks[chunk])[pos];
+    }
+    const_iterator& operator++() {
+      if (++pos == m->chunks[chunk]->size()) {
+	++chunk;
+	pos = 0;
+      }
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator r = *this;
+      ++*this;
+      return r;
+    }
+    bool operator==(const const_iterator& o) const {
+      return chunk == o.chunk && pos == o.pos;
+    }
+    bool operator!=(const const_iterator& o) const {
+      return !(*this == o);
+    }
+  };
+  typedef const_iterator iterator;
+
+  cow_map() = default;
+  cow_map(const cow_map&) = default;
+  cow_map(cow_map&& o) : chunks(std::move(o.chunks)), num(o.num) {
+    o.chunks.clear();
+    o.num = 0;
+  }
+  cow_map& operator=(const cow_map&) = default;
+  cow_map& operator=(cow_map&& o) {
+    chunks = std::move(o.chunks);
+    num = o.num;
+    o.chunks.clear();
+    o.num = 0;
+    return *this;
+  }
+
+  size_t size() const {
+    return num;
+  }
+  bool empty() const {
+    return num == 0;
+  }
+  void clear() {
+    chunks.clear();
+    num = 0;
+  }
+
+  const_iterator begin() const {
+    return const_iterator(this, 0, 0);
+  }
+  const_iterator end() const {
+    return const_iterator(this, chunks.size(), 0);
+  }
+  const_iterator find(const Key& k) const {
+    if (chunks.empty()) {
+      return end();
+    }
+    size_t i = chunk_for(k);
+    auto& c = *chunks[i];
+    auto p = std::lower_bound(
+      c.begin(), c.end(), k,
+      [](const value_type& v, const Key& k) { return v.first < k; });
+    if (p == c.end() || p->first != k) {
+      return end();
+    }
+    return const_iterator(this, i, p - c.begin());
+  }
+  size_t count(const Key& k) const {
+    return find(k) == end() ? 0 : 1;
+  }
+
+  /// a reference to the (unshared) value for k, inserting it if needed
+  T& operator[](const Key& k) {
+    if (chunks.empty()) {
+      push_back(value_type(k, T()));
+      return chunks.back()->back().second;
+    }
+    size_t i = chunk_for(k);
+    auto& c = unshare(i);
+    auto p = std::lower_bound(
+      c.begin(), c.end(), k,
+      [](const value_type& v, const Key& k) { return v.first < k; });
+    if (p != c.end() && p->first == k) {
+      return p->second;
+    }
+    c.insert(p, value_type(k, T()));
+    ++num;
+    rechunk(i);
+    i = chunk_for(k);
+    auto& d = *chunks[i];
+    p = std::lower_bound(
+      d.begin(), d.end(), k,
+      [](const value_type& v, const Key& k) { return v.first < k; });
+    ceph_assert(p != d.end() && p->first == k);
+    return p->second;
+  }
+
+  size_t erase(const Key& k) {
+    auto it = find(k);
+    if (it == end()) {
+      return 0;
+    }
+    auto& c = unshare(it.chunk);
+    c.erase(c.begin() + it.pos);
+    --num;
+    rechunk(it.chunk);
+    return 1;
+  }
+
+  /// share every chunk that has identical contents in o
+  void dedup(const cow_map& o) {
+    size_t j = 0;
+    for (auto& c : chunks) {
+      const Key& first = c->front().first;
+      while (j < o.chunks.size() && o.chunks[j]->front().first < first) {
+	++j;
+      }
+      if (j == o.chunks.size()) {
+	break;
+      }
+      if (c != o.chunks[j] && *c == *o.chunks[j]) {
+	c = o.chunks[j];
+      }
+    }
+  }
+
+  /// number of chunks shared with o (for stats and tests)
+  size_t num_shared_chunks(const cow_map& o) const {
+    size_t n = 0, j = 0;
+    for (auto& c : chunks) {
+      while (j < o.chunks.size() &&
+	     o.chunks[j]->front().first < c->front().first) {
+	++j;
+      }
+      if (j < o.chunks.size() && c == o.chunks[j]) {
+	++n;
+      }
+    }
+    return n;
+  }
+  size_t num_chunks() const {
+    return chunks.size();
+  }
+
+  bool operator==(const cow_map& o) const {
+    return num == o.num && std::equal(begin(), end(), o.begin());
+  }
+  bool operator!=(const cow_map& o) const {
+    return !(*this == o);
+  }
+
+  // encoded like a std::map<Key,T>
+  void encode(ceph::buffer::list &bl) const {
+    using ceph::encode;
+    encode((uint32_t)num, bl);
+    for (auto& c : chunks) {
+      for (auto& v : *c) {
+	encode(v.first, bl);
+	encode(v.second, bl);
+      }
+    }
+  }
+  void decode(ceph::buffer::list::const_iterator& p) {
+    using ceph::decode;
+    clear();
+    uint32_t n;
+    decode(n, p);
+    while (n--) {
+      value_type v;
+      decode(v.first, p);
+      decode(v.second, p);
+      if (chunks.empty() || chunks.back()->back().first < v.first) {
+	push_back(std::move(v));
+      } else {
+	(*this)[v.first] = std::move(v.second);
+      }
+    }
+  }
+};
+
+template <class Key, class T, mempool::pool_index_t pool_ix, class Hash>
+inline void encode(const cow_map<Key, T, pool_ix, Hash>& m,
+		   ceph::buffer::list& bl) {
+  m.encode(bl);
+}
+template <class Key, class T, mempool::pool_index_t pool_ix, class Hash>
+inline void decode(cow_map<Key, T, pool_ix, Hash>& m,
+		   ceph::buffer::list::const_iterator& p) {
+  m.decode(p);
+}
+
+template <class Key, class T, mempool::pool_index_t pool_ix, class Hash>
+inline std::ostream& operator<<(std::ostream& out,
+				const cow_map<Key, T, pool_ix, Hash>& m)
+{
+  out << "{";
+  bool first = true;
+  for (const auto &p : m) {
+    if (!first)
+      out << ",";
+    out << p.first << "=" << p.second;
+    first = false;
+  }
+  out << "}";
+  return out;
+}
+
+#endif
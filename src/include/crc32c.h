@@ -50,6 +50,21 @@ static inline uint32_t ceph_crc32c(uint32_t crc, unsigned char const *data, unsi
   return ceph_crc32c_func(crc, data, length);
 }
 
+/**
+ * extend a crc32c over a buffer whose own crc32c is already known
+ *
+ * Returns the value ceph_crc32c(crc, data, length) would produce, given
+ * only seg_crc == ceph_crc32c(-1, data, length), without touching data.
+ *
+ * @param crc initial value
+ * @param seg_crc crc32c of the buffer, seeded with -1
+ * @param length length of buffer
+ */
+static inline uint32_t ceph_crc32c_extend(uint32_t crc, uint32_t seg_crc, unsigned length)
+{
+  return seg_crc ^ ceph_crc32c(crc ^ 0xffffffff, 0, length);
+}
+
 #ifdef __cplusplus
 }
 #endif
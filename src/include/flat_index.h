@@ -0,0 +1,233 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+#ifndef CEPH_FLAT_INDEX_H
+#define CEPH_FLAT_INDEX_H
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "include/ceph_assert.h"
+#include "include/mempool.h"
+
+/**
+ * flat_index: a hash index of pointers to objects that carry their own key
+ *
+ * This replaces an unordered_map<Key,T*> whose key is a copy of a field
+ * of *T.  Each slot of the open-addressed (linear probing) table holds
+ * just the pointer and its hash; the key is read back through KeyOf, so
+ * it is neither copied nor allocated per element.  Erase uses backward
+ * shift deletion, so the table has no tombstones.
+ *
+ * The pointed-to objects must stay put (and keep their keys) while they
+ * are indexed.  Any insert or erase invalidates iterators.  Iterators
+ * present the usual ->first (the key) and ->second (the pointer).
+ */
+template <class Key, class T, class KeyOf, mempool::pool_index_t pool_ix,
+	  class Hash = std::hash<Key>>
+class flat_index {
+  struct slot_t {
+    T *p = nullptr;
+    size_t hash = 0;
+  };
+  std::vector<slot_t, mempool::pool_allocator<pool_ix, slot_t>> slots;
+  size_t num = 0;
+
+  static size_t hash_of(const Key& k) {
+    // mix, since std::hash is often the identity on integers
+    uint64_t h = Hash()(k);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+  }
+  size_t mask() const {
+    return slots.size() - 1;
+  }
+
+  /// slot holding k, or the empty slot where it would go
+  size_t probe(const Key& k, size_t h) const {
+    size_t i = h & mask();
+    while (slots[i].p &&
+	   (slots[i].hash != h || !(KeyOf()(*slots[i].p) == k))) {
+      i = (i + 1) & mask();
+    }
+    return i;
+  }
+
+  void rehash(size_t cap) {
+    decltype(slots) old(cap);
+    old.swap(slots);
+    for (auto& s : old) {
+      if (s.p) {
+	size_t i = s.hash & mask();
+	while (slots[i].p) {
+	  i = (i + 1) & mask();
+	}
+	slots[i] = s;
+      }
+    }
+  }
+
+  static size_t capacity_for(size_t n) {
+    // keep the load factor at or below 3/4
+    size_t cap = 16;
+    while (cap * 3 < n * 4) {
+      cap <<= 1;
+    }
+    return cap;
+  }
+
+public:
+  struct value_type {
+    const Key& first;
+    T *second;
+  };
+
+  class const_iterator {
+    const flat_index *m = nullptr;
+    size_t pos = 0;
+    friend class flat_index;
+    const_iterator(const flat_index *m, size_t pos) : m(m), pos(pos) {
+      skip();
+    }
+    void skip() {
+      while (pos < m->slots.size() && !m->slots[pos].p) {
+	++pos;
+      }
+    }
+    struct arrow_t {
+      value_type v;
+      const value_type *operator->() const {
+	return &v;
+      }
+    };
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename flat_index::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type* pointer;
+    typedef value_type reference;
+
+    const_iterator() = default;
+    value_type operator*() const {
+      T *p = m->slots[pos].p;
+      return value_type{KeyOf()(*p), p};
+    }
+    arrow_t operator->() const {
+      return arrow_t{**this};
+    }
+    const_iterator& operator++() {
+      ++pos;
+      skip();
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator r = *this;
+      ++*this;
+      return r;
+    }
+    bool operator==(const const_iterator& o) const {
+      return pos == o.pos;
+    }
+    bool operator!=(const const_iterator& o) const {
+      return pos != o.pos;
+    }
+  };
+  typedef const_iterator iterator;
+
+  size_t size() const {
+    return num;
+  }
+  bool empty() const {
+    return num == 0;
+  }
+  /// drop all entries and release the table
+  void clear() {
+    decltype(slots)().swap(slots);
+    num = 0;
+  }
+  void reserve(size_t n) {
+    size_t cap = capacity_for(n);
+    if (cap > slots.size()) {
+      rehash(cap);
+    }
+  }
+
+  const_iterator begin() const {
+    return const_iterator(this, 0);
+  }
+  const_iterator end() const {
+    return const_iterator(this, slots.size());
+  }
+  const_iterator find(const Key& k) const {
+    if (slots.empty()) {
+      return end();
+    }
+    size_t i = probe(k, hash_of(k));
+    return slots[i].p ? const_iterator(this, i) : end();
+  }
+  size_t count(const Key& k) const {
+    return find(k) == end() ? 0 : 1;
+  }
+
+  /// index p under KeyOf(*p), replacing whatever had the same key
+  void insert_or_assign(T *p) {
+    ceph_assert(p);
+    if ((num + 1) * 4 > slots.size() * 3) {
+      rehash(capacity_for(num + 1));
+    }
+    size_t h = hash_of(KeyOf()(*p));
+    size_t i = probe(KeyOf()(*p), h);
+    if (!slots[i].p) {
+      ++num;
+    }
+    slots[i].p = p;
+    slots[i].hash = h;
+  }
+
+  void erase(const_iterator it) {
+    size_t i = it.pos;
+    ceph_assert(i < slots.size() && slots[i].p);
+    slots[i] = slot_t();
+    --num;
+    // pull back any following entry whose home slot is at or before i
+    size_t j = i;
+    while (true) {
+      j = (j + 1) & mask();
+      if (!slots[j].p) {
+	break;
+      }
+      size_t home = slots[j].hash & mask();
+      if (((j - home) & mask()) >= ((j - i) & mask())) {
+	slots[i] = slots[j];
+	slots[j] = slot_t();
+	i = j;
+      }
+    }
+  }
+  size_t erase(const Key& k) {
+    auto it = find(k);
+    if (it == end()) {
+      return 0;
+    }
+    erase(it);
+    return 1;
+  }
+
+  /// bytes used by the table (for stats and tests)
+  size_t bytes() const {
+    return slots.capacity() * sizeof(slot_t);
+  }
+};
+
+#endif
@@ -158,6 +158,7 @@ namespace mempool {
   f(bluefs)			      \
   f(buffer_anon)		      \
   f(buffer_meta)		      \
+  f(buffer_slab)		      \
   f(osd)			      \
   f(osd_mapbl)			      \
   f(osd_pglog)			      \
@@ -165,6 +166,7 @@ namespace mempool {
   f(osdmap_mapping)		      \
   f(pgmap)			      \
   f(mds_co)			      \
+  f(msgr_rx_pool)		      \
   f(unittest_1)			      \
   f(unittest_2)
 
@@ -52,15 +52,24 @@
 #define DEFINE_MSGR2_FEATURE(bit, incarnation, name)               \
 	const static uint64_t CEPH_MSGR2_FEATURE_##name = (1ULL << bit); \
 	const static uint64_t CEPH_MSGR2_FEATUREMASK_##name =            \
-			(1ULL << bit | CEPH_FEATURE_INCARNATION_##incarnation);
+			(1ULL << bit | CEPH_MSGR2_INCARNATION_##incarnation);
 
 #define HAVE_MSGR2_FEATURE(x, name) \
 	(((x) & (CEPH_MSGR2_FEATUREMASK_##name)) == (CEPH_MSGR2_FEATUREMASK_##name))
 
 
-#define CEPH_MSGR2_SUPPORTED_FEATURES (0ull)
+/*
+ * Bits are assigned upstream from the bottom (0 is REVISION_1, 1 is
+ * COMPRESSION), so features of our own are taken from the top and can
+ * never be misread by an upstream peer.
+ */
+
+/* logical sessions (channels) multiplexed over one connection */
+DEFINE_MSGR2_FEATURE(63, 1, CHANNELS)
+
+#define CEPH_MSGR2_SUPPORTED_FEATURES (CEPH_MSGR2_FEATURE_CHANNELS)
 
-#define CEPH_MSGR2_REQUIRED_FEATURES (CEPH_MSGR2_SUPPORTED_FEATURES)
+#define CEPH_MSGR2_REQUIRED_FEATURES (0ull)
 
 
 /*
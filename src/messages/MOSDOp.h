@@ -21,6 +21,7 @@
 #include "MOSDFastDispatchOp.h"
 #include "include/ceph_features.h"
 #include "common/hobject.h"
+#include "msg/MessagePool.h"
 
 /*
  * OSD op
@@ -65,6 +66,7 @@ private:
 
 public:
   friend class MOSDOpReply;
+  MESSAGE_POOL_CLASS_HELPERS(MOSDOp);
 
   ceph_tid_t get_client_tid() { return header.tid; }
   void set_snapid(const snapid_t& s) {
@@ -135,6 +135,8 @@ public:
   */
 
 public:
+  MESSAGE_POOL_CLASS_HELPERS(MOSDOpReply);
+
   MOSDOpReply()
     : Message{CEPH_MSG_OSD_OPREPLY, HEAD_VERSION, COMPAT_VERSION},
     bdata_encode(false) {
@@ -19,7 +19,7 @@
 
 class MOSDPGScan : public MOSDFastDispatchOp {
 private:
-  static constexpr int HEAD_VERSION = 2;
+  static constexpr int HEAD_VERSION = 3;
   static constexpr int COMPAT_VERSION = 2;
 
 public:
@@ -40,6 +40,7 @@ public:
   pg_shard_t from;
   spg_t pgid;
   hobject_t begin, end;
+  pg_bucket_set_t dirty;  ///< get_digest: only list objects in these buckets
 
   epoch_t get_map_epoch() const override {
     return map_epoch;
@@ -68,6 +69,9 @@ public:
 
     decode(from, p);
     decode(pgid.shard, p);
+    if (header.version >= 3) {
+      decode(dirty, p);
+    }
   }
 
   void encode_payload(uint64_t features) override {
@@ -85,6 +89,7 @@ public:
     encode(end, payload);
     encode(from, payload);
     encode(pgid.shard, payload);
+    encode(dirty, payload);
   }
 
   MOSDPGScan()
@@ -106,8 +111,10 @@ public:
   void print(ostream& out) const override {
     out << "pg_scan(" << get_op_name(op)
 	<< " " << pgid
-	<< " " << begin << "-" << end
-	<< " e " << map_epoch << "/" << query_epoch
+	<< " " << begin << "-" << end;
+    if (dirty.is_tracking())
+      out << " " << dirty;
+    out << " e " << map_epoch << "/" << query_epoch
 	<< ")";
   }
 private:
@@ -749,6 +749,8 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
   // walk through incrementals
   MonitorDBStore::TransactionRef t;
   size_t tx_size = 0;
+  mapping_inc.reset();
+  const epoch_t first_inc_epoch = osdmap.epoch + 1;
   while (version > osdmap.epoch) {
     bufferlist inc_bl;
     int err = get_version(osdmap.epoch+1, inc_bl);
@@ -771,6 +773,9 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
     OSDMap::Incremental inc(inc_bl);
     err = osdmap.apply_incremental(inc);
     ceph_assert(err == 0);
+    if (version == first_inc_epoch) {
+      mapping_inc = std::make_unique<OSDMap::Incremental>(inc);
+    }
 
     if (!t)
       t.reset(new MonitorDBStore::Transaction);
@@ -976,10 +981,19 @@ void OSDMonitor::start_mapping()
   }
   if (!osdmap.get_pools().empty()) {
     auto fin = new C_UpdateCreatingPGs(this, osdmap.get_epoch());
-    mapping_job = mapping.start_update(osdmap, mapper,
-				       g_conf()->mon_osd_mapping_pgs_per_chunk);
+    if (mapping_inc && mapping_inc->epoch == osdmap.get_epoch() &&
+	g_conf().get_val<bool>("mon_osd_mapping_incremental")) {
+      mapping_job = mapping.start_update(
+	osdmap, *mapping_inc, mapper,
+	g_conf()->mon_osd_mapping_pgs_per_chunk);
+    } else {
+      mapping_job = mapping.start_update(
+	osdmap, mapper,
+	g_conf()->mon_osd_mapping_pgs_per_chunk);
+    }
     dout(10) << __func__ << " started mapping job " << mapping_job.get()
-	     << " at " << fin->start << dendl;
+	     << " at " << fin->start << " for " << mapping.get_num_updated_pgs()
+	     << "/" << mapping.get_num_pgs() << " pgs" << dendl;
     mapping_job->set_finish_event(fin);
   } else {
     dout(10) << __func__ << " no pools, no mapping job" << dendl;
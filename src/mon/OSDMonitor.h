@@ -393,6 +393,8 @@ private:
   ParallelPGMapper mapper;                        ///< for background pg work
   OSDMapMapping mapping;                          ///< pg <-> osd mappings
   unique_ptr<ParallelPGMapper::Job> mapping_job;  ///< background mapping job
+  /// the incremental that produced osdmap, if we applied exactly one
+  std::unique_ptr<OSDMap::Incremental> mapping_inc;
   void start_mapping();
 
   void update_logger();
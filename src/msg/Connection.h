@@ -209,6 +209,26 @@ public:
     return CEPH_CON_MODE_CRC;
   }
 
+  /**
+   * Open a logical session for the given entity over this Connection.
+   *
+   * Messages sent on the returned Connection share this one's socket,
+   * and the peer sees them as coming from a Connection of their own,
+   * from the named entity.  Only lossy msgr2 connections whose peer
+   * supports it can do this.
+   *
+   * The peer addresses the channel as this end's address with the
+   * given nonce, so that the entity can be blocklisted on its own.
+   * The nonce must differ from this end's and from those of its other
+   * open channels.
+   *
+   * @return the channel, or nullptr if it could not be opened
+   */
+  virtual ceph::ref_t<Connection> open_channel(const entity_name_t& name,
+					       uint32_t nonce) {
+    return nullptr;
+  }
+
   void post_rx_buffer(ceph_tid_t tid, ceph::buffer::list& bl) {
 #if 0
     std::lock_guard l{lock};
@@ -0,0 +1,149 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_MESSAGEPOOL_H
+#define CEPH_MSG_MESSAGEPOOL_H
+
+#include <atomic>
+#include <new>
+#include <vector>
+
+#include "common/ceph_mutex.h"
+
+/**
+ * MessagePool: recycled storage for hot message types
+ *
+ * Messages such as MOSDOp are decoded by a messenger worker for every
+ * op and freed by whichever thread drops the last reference, usually
+ * some other one.  Each thread keeps a small cache of freed objects of
+ * the type; a thread that frees more than it allocates hands the surplus
+ * in batches to a shared depot, and a thread that runs dry refills from
+ * it, so the depot lock is taken once per batch rather than per message.
+ *
+ * Only storage is recycled: constructors and destructors run as usual.
+ * Use MESSAGE_POOL_CLASS_HELPERS(T) in the class to route its operator
+ * new and delete here.
+ */
+template <typename T>
+class MessagePool {
+  static constexpr unsigned BATCH = 32;
+  static constexpr unsigned MAX_CACHED = 2 * BATCH;  ///< per thread
+  static constexpr unsigned MAX_DEPOT = 64;          ///< batches
+
+  struct depot_t {
+    ceph::mutex lock = ceph::make_mutex("MessagePool::depot");
+    std::vector<std::vector<void*>> batches;
+  };
+  // never destroyed, a thread may give its cache back at any time
+  static depot_t& depot() {
+    static depot_t *d = new depot_t;
+    return *d;
+  }
+
+  struct cache_t {
+    std::vector<void*> free;
+    cache_t() {
+      free.reserve(MAX_CACHED);
+    }
+    ~cache_t() {
+      while (!free.empty()) {
+	flush();
+      }
+    }
+    void flush() {
+      size_t n = std::min<size_t>(free.size(), BATCH);
+      std::vector<void*> batch(free.end() - n, free.end());
+      free.resize(free.size() - n);
+      {
+	auto& d = depot();
+	std::lock_guard l(d.lock);
+	if (d.batches.size() < MAX_DEPOT) {
+	  d.batches.push_back(std::move(batch));
+	  return;
+	}
+      }
+      for (auto p : batch) {
+	::operator delete(p);
+      }
+      released += batch.size();
+    }
+    bool refill() {
+      std::vector<void*> batch;
+      {
+	auto& d = depot();
+	std::lock_guard l(d.lock);
+	if (d.batches.empty()) {
+	  return false;
+	}
+	batch = std::move(d.batches.back());
+	d.batches.pop_back();
+      }
+      free.insert(free.end(), batch.begin(), batch.end());
+      return true;
+    }
+  };
+  static cache_t& cache() {
+    static thread_local cache_t c;
+    return c;
+  }
+
+  // only the slow paths are counted, to keep the fast path thread-local
+  static inline std::atomic<uint64_t> allocated = {0};
+  static inline std::atomic<uint64_t> released = {0};
+
+public:
+  static void *allocate(size_t size) {
+    if (size != sizeof(T)) {
+      // a subclass
+      return ::operator new(size);
+    }
+    auto& c = cache();
+    if (c.free.empty() && !c.refill()) {
+      allocated.fetch_add(1, std::memory_order_relaxed);
+      return ::operator new(size);
+    }
+    void *p = c.free.back();
+    c.free.pop_back();
+    return p;
+  }
+
+  static void release(void *p, size_t size) {
+    if (size != sizeof(T)) {
+      ::operator delete(p);
+      return;
+    }
+    auto& c = cache();
+    if (c.free.size() >= MAX_CACHED) {
+      c.flush();
+    }
+    c.free.push_back(p);
+  }
+
+  /// objects of this type allocated from the heap so far
+  static uint64_t get_allocated() {
+    return allocated.load(std::memory_order_relaxed);
+  }
+  /// objects of this type given back to the heap so far
+  static uint64_t get_released() {
+    return released.load(std::memory_order_relaxed);
+  }
+};
+
+#define MESSAGE_POOL_CLASS_HELPERS(T)					\
+  static void *operator new(size_t size) {				\
+    return MessagePool<T>::allocate(size);				\
+  }									\
+  static void operator delete(void *p, size_t size) {			\
+    MessagePool<T>::release(p, size);					\
+  }
+
+#endif
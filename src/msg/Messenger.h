@@ -750,6 +750,23 @@ public:
     }
   }
 
+  /**
+   * Notify each Dispatcher of an authenticated Connection whose
+   * authentication did not go through the AuthServer, such as a
+   * channel inheriting that of the connection it is carried on.
+   *
+   * @param con Pointer to the new Connection.
+   * @return the first nonzero Dispatcher result, or 0
+   */
+  int ms_deliver_handle_authentication(Connection *con) {
+    for (const auto& dispatcher : dispatchers) {
+      int r = dispatcher->ms_handle_authentication(con);
+      if (r)
+	return r;
+    }
+    return 0;
+  }
+
   /**
    * Notify each Dispatcher of a Connection which may have lost
    * Messages. Call this function whenever you detect that a lossy Connection
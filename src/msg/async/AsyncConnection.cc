@@ -158,6 +158,12 @@ int AsyncConnection::get_con_mode() const
   return protocol->get_con_mode();
 }
 
+ConnectionRef AsyncConnection::open_channel(const entity_name_t& name,
+					   uint32_t nonce)
+{
+  return protocol->open_channel(name, nonce);
+}
+
 bool AsyncConnection::is_msgr2() const
 {
   return protocol->proto_type == 2;
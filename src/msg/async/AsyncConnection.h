@@ -140,6 +140,9 @@ public:
 
   int get_con_mode() const override;
 
+  ConnectionRef open_channel(const entity_name_t& name,
+			     uint32_t nonce) override;
+
   bool is_unregistered() const {
     return unregistered;
   }
@@ -245,6 +248,7 @@ private:
   friend class Protocol;
   friend class ProtocolV1;
   friend class ProtocolV2;
+  friend class ChannelConnection;
 }; /* AsyncConnection */
 
 using AsyncConnectionRef = ceph::ref_t<AsyncConnection>;
@@ -0,0 +1,90 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "ChannelConnection.h"
+#include "Protocol.h"
+#include "msg/Message.h"
+#include "msg/Messenger.h"
+
+#define dout_subsys ceph_subsys_ms
+#undef dout_prefix
+#define dout_prefix *_dout << "-- channel " << id << " on " << parent << " "
+
+ChannelConnection::ChannelConnection(CephContext *cct,
+				     AsyncConnection *parent, uint16_t id,
+				     const entity_name_t& name, uint32_t nonce,
+				     bool accepted)
+  : Connection(cct, parent->get_messenger()),
+    parent(parent), id(id), name(name), nonce(nonce), accepted(accepted)
+{
+  entity_addrvec_t addrs = parent->get_peer_addrs();
+  if (accepted) {
+    // the opener's address, but its own instance of it
+    for (auto& a : addrs.v) {
+      a.set_nonce(nonce);
+    }
+  }
+  peer_addrs = addrs;
+  set_features(parent->get_features());
+  peer_caps_info = parent->get_peer_caps_info();
+  peer_name = parent->get_peer_entity_name();
+  if (accepted) {
+    // ProtocolV2::handle_channel_open only accepts names the parent may
+    // act for
+    peer_type = name.type();
+    peer_id = name.num();
+    peer_global_id = name.num();
+  } else {
+    peer_type = parent->get_peer_type();
+    peer_id = parent->get_peer_id();
+    peer_global_id = parent->get_peer_global_id();
+  }
+}
+
+bool ChannelConnection::is_connected()
+{
+  return !closed && parent->is_connected();
+}
+
+int ChannelConnection::send_message(Message *m)
+{
+  if (closed) {
+    ldout(msgr->cct, 10) << __func__ << " channel closed, drop message "
+			 << *m << dendl;
+    m->put();
+    return 0;
+  }
+  m->get_header().reserved = id;
+  return parent->send_message(m);
+}
+
+void ChannelConnection::send_keepalive()
+{
+  parent->send_keepalive();
+}
+
+void ChannelConnection::mark_down()
+{
+  if (!closed.exchange(true)) {
+    parent->protocol->close_channel(id);
+  }
+}
+
+entity_addr_t ChannelConnection::get_peer_socket_addr() const
+{
+  return parent->get_peer_socket_addr();
+}
+
+int ChannelConnection::get_con_mode() const
+{
+  return parent->get_con_mode();
+}
@@ -0,0 +1,67 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_ASYNC_CHANNELCONNECTION_H
+#define CEPH_MSG_ASYNC_CHANNELCONNECTION_H
+
+#include <atomic>
+
+#include "AsyncConnection.h"
+
+/*
+ * ChannelConnection is a logical session carried over a msgr2
+ * AsyncConnection (its parent) alongside the parent's own messages, so
+ * that many entities on one host can talk to a peer over one socket.
+ *
+ * On the side that opened it, the channel's peer is the parent's peer;
+ * on the accepting side it is the entity named when the channel was
+ * opened, which inherits the parent's authentication and caps.  Only
+ * lossy connections carry channels: when the parent fails, every
+ * channel on it is reset along with it.
+ *
+ * The channel id travels in the message header's reserved field.
+ */
+class ChannelConnection : public Connection {
+  AsyncConnectionRef parent;
+  const uint16_t id;
+  const entity_name_t name;  ///< entity on the opening side
+  const uint32_t nonce;      ///< of the opening side's address for it
+  const bool accepted;       ///< we are the accepting side
+  std::atomic<bool> closed = {false};
+
+  FRIEND_MAKE_REF(ChannelConnection);
+  ChannelConnection(CephContext *cct, AsyncConnection *parent, uint16_t id,
+		    const entity_name_t& name, uint32_t nonce, bool accepted);
+
+public:
+  uint16_t get_channel_id() const { return id; }
+  const entity_name_t& get_entity_name() const { return name; }
+  uint32_t get_nonce() const { return nonce; }
+  bool is_accepted() const { return accepted; }
+  AsyncConnection *get_parent() { return parent.get(); }
+
+  /// the channel went away with its parent or was closed by the peer
+  void set_closed() { closed = true; }
+
+  bool is_connected() override;
+  bool is_msgr2() const override { return true; }
+  int send_message(Message *m) override;
+  void send_keepalive() override;
+  void mark_down() override;
+  void mark_disposable() override {}
+  entity_addr_t get_peer_socket_addr() const override;
+  int get_con_mode() const override;
+};
+
+using ChannelConnectionRef = ceph::ref_t<ChannelConnection>;
+
+#endif
@@ -22,6 +22,10 @@
 #include "dpdk/EventDPDK.h"
 #endif
 
+#ifdef HAVE_LIBURING
+#include "EventIoUring.h"
+#endif
+
 #ifdef HAVE_EPOLL
 #include "EventEpoll.h"
 #else
@@ -113,6 +117,18 @@ int EventCenter::init(int nevent, unsigned center_id, const std::string &type)
     driver = new DPDKDriver(cct);
 #endif
   } else {
+#ifdef HAVE_LIBURING
+    if (cct->_conf.get_val<std::string>("ms_async_event_driver") ==
+	"io_uring") {
+      if (IoUringDriver::supported()) {
+	driver = new IoUringDriver(cct);
+      } else {
+	ldout(cct, 1) << __func__ << " io_uring with multishot poll not "
+		      << "supported by this kernel, falling back" << dendl;
+      }
+    }
+    if (!driver) {
+#endif
 #ifdef HAVE_EPOLL
   driver = new EpollDriver(cct);
 #else
@@ -121,6 +137,9 @@ int EventCenter::init(int nevent, unsigned center_id, const std::string &type)
 #else
   driver = new SelectDriver(cct);
 #endif
+#endif
+#ifdef HAVE_LIBURING
+    }
 #endif
   }
 
@@ -0,0 +1,232 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "common/errno.h"
+#include "EventIoUring.h"
+
+#define dout_subsys ceph_subsys_ms
+
+#undef dout_prefix
+#define dout_prefix *_dout << "IoUringDriver."
+
+// newer than some liburing headers we build against
+#ifndef IORING_POLL_ADD_MULTI
+#define IORING_POLL_ADD_MULTI (1U << 0)
+#endif
+#ifndef IORING_CQE_F_MORE
+#define IORING_CQE_F_MORE (1U << 1)
+#endif
+
+// user_data of the poll for an fd is (gen << 32 | fd); everything else
+// we submit (poll removal, timeouts) completes with this and is ignored
+static constexpr uint64_t UDATA_INTERNAL = ~0ull;
+static constexpr uint32_t GEN_MASK = 0x7fffffff;
+
+static uint64_t poll_udata(int fd, uint32_t gen)
+{
+  return (uint64_t)(gen & GEN_MASK) << 32 | (uint32_t)fd;
+}
+
+bool IoUringDriver::supported()
+{
+  struct io_uring r;
+  if (io_uring_queue_init(4, &r, 0) < 0) {
+    return false;
+  }
+  int p[2];
+  if (::pipe(p) < 0) {
+    io_uring_queue_exit(&r);
+    return false;
+  }
+  // a kernel without multishot poll fails the request with -EINVAL;
+  // one with it posts a completion that says more will follow
+  bool ok = false;
+  struct io_uring_sqe *sqe = io_uring_get_sqe(&r);
+  io_uring_prep_poll_add(sqe, p[0], POLLIN);
+  sqe->len = IORING_POLL_ADD_MULTI;
+  if (::write(p[1], "x", 1) == 1 &&
+      io_uring_submit_and_wait(&r, 1) >= 0) {
+    struct io_uring_cqe *cqe;
+    if (io_uring_peek_cqe(&r, &cqe) == 0) {
+      ok = cqe->res > 0 && (cqe->flags & IORING_CQE_F_MORE);
+      io_uring_cqe_seen(&r, cqe);
+    }
+  }
+  io_uring_queue_exit(&r);
+  ::close(p[0]);
+  ::close(p[1]);
+  return ok;
+}
+
+int IoUringDriver::init(EventCenter *c, int nevent)
+{
+  int r = io_uring_queue_init(1024, &ring, 0);
+  if (r < 0) {
+    lderr(cct) << __func__ << " unable to set up io_uring: "
+	       << cpp_strerror(r) << dendl;
+    return r;
+  }
+  ring_inited = true;
+  fds.resize(nevent);
+  return 0;
+}
+
+struct io_uring_sqe *IoUringDriver::get_sqe()
+{
+  struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+  if (!sqe) {
+    // sq is full; hand what we have to the kernel to make room
+    io_uring_submit(&ring);
+    sqe = io_uring_get_sqe(&ring);
+  }
+  ceph_assert(sqe);
+  return sqe;
+}
+
+void IoUringDriver::arm(int fd)
+{
+  fd_state_t &st = fds[fd];
+  short events = 0;
+  if (st.mask & EVENT_READABLE)
+    events |= POLLIN;
+  if (st.mask & EVENT_WRITABLE)
+    events |= POLLOUT;
+  ++st.gen;
+  struct io_uring_sqe *sqe = get_sqe();
+  io_uring_prep_poll_add(sqe, fd, events);
+  sqe->len = IORING_POLL_ADD_MULTI;
+  sqe->user_data = poll_udata(fd, st.gen);
+}
+
+void IoUringDriver::disarm(int fd)
+{
+  struct io_uring_sqe *sqe = get_sqe();
+  io_uring_prep_poll_remove(
+    sqe, (void*)(uintptr_t)poll_udata(fd, fds[fd].gen));
+  sqe->user_data = UDATA_INTERNAL;
+}
+
+int IoUringDriver::add_event(int fd, int cur_mask, int add_mask)
+{
+  ldout(cct, 20) << __func__ << " add event fd=" << fd << " cur_mask=" << cur_mask
+		 << " add_mask=" << add_mask << dendl;
+  if ((size_t)fd >= fds.size()) {
+    fds.resize(fd + 1);
+  }
+  // a poll's mask can't be changed in place, so replace it
+  if (cur_mask != EVENT_NONE) {
+    disarm(fd);
+  }
+  fds[fd].mask = cur_mask | add_mask;
+  arm(fd);
+  return 0;
+}
+
+int IoUringDriver::del_event(int fd, int cur_mask, int delmask)
+{
+  ldout(cct, 20) << __func__ << " del event fd=" << fd << " cur_mask=" << cur_mask
+		 << " delmask=" << delmask << dendl;
+  if ((size_t)fd >= fds.size() || fds[fd].mask == EVENT_NONE) {
+    return 0;
+  }
+  disarm(fd);
+  fds[fd].mask = cur_mask & ~delmask;
+  if (fds[fd].mask != EVENT_NONE) {
+    arm(fd);
+  }
+  return 0;
+}
+
+int IoUringDriver::resize_events(int newsize)
+{
+  if ((size_t)newsize > fds.size()) {
+    fds.resize(newsize);
+  }
+  return 0;
+}
+
+int IoUringDriver::event_wait(vector<FiredFileEvent> &fired_events,
+			      struct timeval *tvp)
+{
+  // queued mask changes go in with the wait
+  int r;
+  if (io_uring_cq_ready(&ring) ||
+      (tvp && tvp->tv_sec == 0 && tvp->tv_usec == 0)) {
+    r = io_uring_submit(&ring);
+  } else if (!tvp) {
+    r = io_uring_submit_and_wait(&ring, 1);
+  } else {
+    // completes on the first other completion, or on expiry
+    ts.tv_sec = tvp->tv_sec;
+    ts.tv_nsec = tvp->tv_usec * 1000;
+    struct io_uring_sqe *sqe = get_sqe();
+    io_uring_prep_timeout(sqe, &ts, 1, 0);
+    sqe->user_data = UDATA_INTERNAL;
+    r = io_uring_submit_and_wait(&ring, 1);
+  }
+  if (r < 0 && r != -EINTR && r != -ETIME) {
+    lderr(cct) << __func__ << " io_uring_enter failed: "
+	       << cpp_strerror(r) << dendl;
+    return 0;
+  }
+
+  struct io_uring_cqe *cqe;
+  unsigned head, seen = 0;
+  io_uring_for_each_cqe(&ring, head, cqe) {
+    ++seen;
+    uint64_t ud = cqe->user_data;
+    if (ud == UDATA_INTERNAL) {
+      continue;
+    }
+    int fd = (int)(uint32_t)ud;
+    if ((size_t)fd >= fds.size()) {
+      continue;
+    }
+    fd_state_t &st = fds[fd];
+    if ((uint32_t)(ud >> 32) != (st.gen & GEN_MASK) ||
+	st.mask == EVENT_NONE) {
+      continue;  // from a poll we have since replaced or removed
+    }
+    int mask = 0;
+    if (cqe->res < 0) {
+      ldout(cct, 10) << __func__ << " poll on fd=" << fd << " failed: "
+		     << cpp_strerror(cqe->res) << dendl;
+      mask = EVENT_READABLE | EVENT_WRITABLE;
+    } else {
+      if (cqe->res & POLLIN)
+	mask |= EVENT_READABLE;
+      if (cqe->res & POLLOUT)
+	mask |= EVENT_WRITABLE;
+      if (cqe->res & (POLLERR | POLLHUP))
+	mask |= EVENT_READABLE | EVENT_WRITABLE;
+    }
+    if (!(cqe->flags & IORING_CQE_F_MORE) && cqe->res != -EBADF) {
+      // the kernel ended the poll (e.g., cq overflow); start another
+      arm(fd);
+    }
+    if (st.fired < 0) {
+      st.fired = fired_events.size();
+      fired_events.push_back(FiredFileEvent{fd, mask});
+    } else {
+      fired_events[st.fired].mask |= mask;
+    }
+  }
+  io_uring_cq_advance(&ring, seen);
+
+  for (auto& e : fired_events) {
+    fds[e.fd].fired = -1;
+  }
+  return fired_events.size();
+}
@@ -0,0 +1,64 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_EVENTIOURING_H
+#define CEPH_MSG_EVENTIOURING_H
+
+#include <liburing.h>
+
+#include "Event.h"
+
+/**
+ * IoUringDriver: file events from multishot poll requests on an io_uring
+ *
+ * Each watched fd has one multishot IORING_OP_POLL_ADD outstanding,
+ * which posts a completion whenever the fd is woken, much like an
+ * EPOLLET registration.  Mask changes are queued as sqes and go to the
+ * kernel with the next wait, so the epoll_ctl calls a connection makes
+ * as it toggles EVENT_WRITABLE no longer cost a syscall each.
+ */
+class IoUringDriver : public EventDriver {
+  struct fd_state_t {
+    int mask = EVENT_NONE;
+    uint32_t gen = 0;    ///< generation of the outstanding poll
+    int fired = -1;      ///< index in fired_events during event_wait
+  };
+
+  CephContext *cct;
+  struct io_uring ring;
+  bool ring_inited = false;
+  std::vector<fd_state_t> fds;
+  struct __kernel_timespec ts;  ///< for the timeout sqe, live until it fires
+
+  struct io_uring_sqe *get_sqe();
+  void arm(int fd);
+  void disarm(int fd);
+
+ public:
+  explicit IoUringDriver(CephContext *c) : cct(c) {}
+  ~IoUringDriver() override {
+    if (ring_inited)
+      io_uring_queue_exit(&ring);
+  }
+
+  /// true if the kernel has io_uring with multishot poll
+  static bool supported();
+
+  int init(EventCenter *c, int nevent) override;
+  int add_event(int fd, int cur_mask, int add_mask) override;
+  int del_event(int fd, int cur_mask, int del_mask) override;
+  int resize_events(int newsize) override;
+  int event_wait(vector<FiredFileEvent> &fired_events,
+		 struct timeval *tp) override;
+};
+
+#endif
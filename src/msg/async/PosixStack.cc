@@ -19,8 +19,12 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 #include <algorithm>
+#include <deque>
 
 #include "PosixStack.h"
 
@@ -37,15 +41,93 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "PosixStack "
 
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define POSIX_MSG_ZEROCOPY
+#endif
+
 class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   NetHandler &handler;
   int _fd;
   entity_addr_t sa;
   bool connected;
+  Worker *worker;
+
+  // With MSG_ZEROCOPY the kernel transmits straight from our pages, so
+  // whatever we sent that way is kept here until the completion for
+  // its sendmsg call shows up on the socket error queue.
+  uint64_t zerocopy_min_size = 0;   ///< 0 if not sending zero copy
+  uint32_t zerocopy_seq = 0;        ///< kernel id of the next zc sendmsg
+  std::deque<std::pair<uint32_t, bufferlist>> zerocopy_pending; ///< last id
+  uint64_t zerocopy_bytes = 0, zerocopy_fallback = 0;
+
+  void init_zerocopy() {
+#ifdef POSIX_MSG_ZEROCOPY
+    zerocopy_min_size =
+      worker->cct->_conf.get_val<Option::size_t>("ms_tcp_zerocopy_min_size");
+    if (!zerocopy_min_size) {
+      return;
+    }
+    int on = 1;
+    if (::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) < 0) {
+      int r = errno;
+      ldout(worker->cct, 5) << __func__ << " SO_ZEROCOPY not supported: "
+			    << cpp_strerror(r) << dendl;
+      zerocopy_min_size = 0;
+    }
+#endif
+  }
+
+  /// release what the kernel is done with; keep going until EAGAIN
+  void reap_zerocopy() {
+#ifdef POSIX_MSG_ZEROCOPY
+    while (!zerocopy_pending.empty()) {
+      char control[CMSG_SPACE(sizeof(struct sock_extended_err)) * 2];
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (::recvmsg(_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+	break;
+      }
+      for (auto cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+	if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+	      (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+	  continue;
+	}
+	auto serr = reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+	if (serr->ee_errno != 0 ||
+	    serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+	  continue;
+	}
+	if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+	  // the device can't take our pages (e.g., loopback); pinning
+	  // them is then pure overhead, so stop asking
+	  ++zerocopy_fallback;
+	  worker->perf_logger->inc(l_msgr_send_zerocopy_fallback);
+	  if (zerocopy_min_size) {
+	    ldout(worker->cct, 10) << __func__ << " kernel copied zero copy "
+				   << "send to " << sa << ", disabling"
+				   << dendl;
+	    zerocopy_min_size = 0;
+	  }
+	}
+	// TCP completes in order: [ee_info, ee_data] covers everything
+	// up to ee_data that is still outstanding
+	uint32_t done = serr->ee_data;
+	while (!zerocopy_pending.empty() &&
+	       (int32_t)(zerocopy_pending.front().first - done) <= 0) {
+	  zerocopy_pending.pop_front();
+	}
+      }
+    }
+#endif
+  }
 
  public:
-  explicit PosixConnectedSocketImpl(NetHandler &h, const entity_addr_t &sa, int f, bool connected)
-      : handler(h), _fd(f), sa(sa), connected(connected) {}
+  explicit PosixConnectedSocketImpl(NetHandler &h, const entity_addr_t &sa, int f, bool connected, Worker *w)
+      : handler(h), _fd(f), sa(sa), connected(connected), worker(w) {
+    init_zerocopy();
+  }
 
   int is_connected() override {
     if (connected)
@@ -67,6 +149,8 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t read(char *buf, size_t len) override {
+    // completions raise EPOLLERR, which lands us here
+    reap_zerocopy();
     ssize_t r = ::read(_fd, buf, len);
     if (r < 0)
       r = -errno;
@@ -75,21 +159,35 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 
   // return the sent length
   // < 0 means error occurred
-  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more)
+  // *zc is cleared if a zero copy send must fall back to copying, and
+  // counts up the kernel ids of the zero copy sendmsg calls made
+  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more,
+			    bool *zc = nullptr, uint32_t *zc_seq = nullptr)
   {
     size_t sent = 0;
     while (1) {
       MSGR_SIGPIPE_STOPPER;
       ssize_t r;
-      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+      int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+#ifdef POSIX_MSG_ZEROCOPY
+      if (zc && *zc)
+        flags |= MSG_ZEROCOPY;
+#endif
+      r = ::sendmsg(fd, &msg, flags);
       if (r < 0) {
         if (errno == EINTR) {
           continue;
         } else if (errno == EAGAIN) {
           break;
+        } else if (errno == ENOBUFS && zc && *zc) {
+          // out of optmem for pinned pages; copy this time
+          *zc = false;
+          continue;
         }
         return -errno;
       }
+      if (zc && *zc)
+        ++*zc_seq;
 
       sent += r;
       if (len == sent) break;
@@ -111,6 +209,9 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t send(bufferlist &bl, bool more) override {
+    reap_zerocopy();
+    bool zc = zerocopy_min_size && bl.length() >= zerocopy_min_size;
+    bool zc_sent = false;
     size_t sent_bytes = 0;
     auto pb = std::cbegin(bl.buffers());
     uint64_t left_pbrs = std::size(bl.buffers());
@@ -130,7 +231,11 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 	msglen += pb->length();
 	++pb;
       }
-      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
+      uint32_t seq = zerocopy_seq;
+      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more,
+			     zc ? &zc : nullptr, &zerocopy_seq);
+      if (zerocopy_seq != seq)
+        zc_sent = true;
       if (r < 0)
         return r;
 
@@ -147,7 +252,14 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
         bl.splice(sent_bytes, bl.length()-sent_bytes, &swapped);
         bl.swap(swapped);
       } else {
-        bl.clear();
+        swapped.swap(bl);
+      }
+      if (zc_sent) {
+        // hold the sent prefix (now in swapped) until the kernel is
+        // done with the last zero copy call that referenced it
+        zerocopy_bytes += sent_bytes;
+        worker->perf_logger->inc(l_msgr_send_zerocopy_bytes, sent_bytes);
+        zerocopy_pending.emplace_back(zerocopy_seq - 1, std::move(swapped));
       }
     }
 
@@ -157,6 +269,15 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     ::shutdown(_fd, SHUT_RDWR);
   }
   void close() override {
+    reap_zerocopy();
+    if (zerocopy_bytes || zerocopy_fallback) {
+      ldout(worker->cct, 10) << __func__ << " " << sa << " sent "
+			     << zerocopy_bytes << " bytes zero copy, "
+			     << zerocopy_fallback << " copied by the kernel, "
+			     << zerocopy_pending.size() << " sends outstanding"
+			     << dendl;
+    }
+    zerocopy_pending.clear();
     ::close(_fd);
   }
   int fd() const override {
@@ -212,7 +333,7 @@ int PosixServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &op
   out->set_sockaddr((sockaddr*)&ss);
   handler.set_priority(sd, opt.priority, out->get_family());
 
-  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true));
+  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true, w));
   *sock = ConnectedSocket(std::move(csi));
   return 0;
 }
@@ -281,7 +402,7 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
 
   net.set_priority(sd, opts.priority, addr.get_family());
   *socket = ConnectedSocket(
-      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock)));
+      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock, this)));
   return 0;
 }
 
@@ -132,6 +132,13 @@ public:
   virtual void write_event() = 0;
   virtual bool is_queued() = 0;
 
+  // multiplexed logical sessions (see ChannelConnection)
+  virtual ConnectionRef open_channel(const entity_name_t& name,
+				     uint32_t nonce) {
+    return nullptr;
+  }
+  virtual void close_channel(uint16_t id) {}
+
   int get_con_mode() const {
     return auth_meta->con_mode;
   }
@@ -97,6 +97,9 @@ ProtocolV2::ProtocolV2(AsyncConnection *connection)
 }
 
 ProtocolV2::~ProtocolV2() {
+  out_incoming.drain([](out_queue_entry_t&& entry) {
+    entry.m->put();
+  });
 }
 
 void ProtocolV2::connect() {
@@ -119,6 +122,7 @@ bool ProtocolV2::is_connected() { return can_write; }
 void ProtocolV2::discard_out_queue() {
   ldout(cct, 10) << __func__ << " started" << dendl;
 
+  take_incoming();
   for (list<Message *>::iterator p = sent.begin(); p != sent.end(); ++p) {
     ldout(cct, 20) << __func__ << " discard " << *p << dendl;
     (*p)->put();
@@ -172,6 +176,7 @@ void ProtocolV2::stop() {
 
   reset_recv_state();
   discard_out_queue();
+  reset_channels();
 
   connection->_stop();
 
@@ -313,6 +318,7 @@ CtPtr ProtocolV2::_fault() {
   connection->write_lock.lock();
 
   can_write = false;
+  take_incoming();
   // requeue sent items
   requeue_sent();
 
@@ -416,36 +422,49 @@ void ProtocolV2::send_message(Message *m) {
     prepare_send_message(f, m);
   }
 
-  std::lock_guard<std::mutex> l(connection->write_lock);
-  bool is_prepared = can_fast_prepare;
-  // "features" changes will change the payload encoding
-  if (can_fast_prepare && (!can_write || connection->get_features() != f)) {
-    // ensure the correctness of message encoding
-    m->clear_payload();
-    is_prepared = false;
-    ldout(cct, 10) << __func__ << " clear encoded buffer previous " << f
-                   << " != " << connection->get_features() << dendl;
+  ldout(cct, 5) << __func__ << " enqueueing message m=" << m
+                << " type=" << m->get_type() << " " << *m << dendl;
+  m->queue_start = ceph::mono_clock::now();
+  m->trace.event("async enqueueing message");
+  out_incoming.push(out_queue_entry_t{can_fast_prepare, m, f});
+
+  // Wake the writer only if nobody has since it last took the queued
+  // messages; a burst of senders then costs one wakeup and one trip
+  // through write_lock instead of one each.
+  if (out_wakeup_pending.exchange(true)) {
+    return;
   }
+  std::lock_guard<std::mutex> l(connection->write_lock);
   if (state == CLOSED) {
     ldout(cct, 10) << __func__ << " connection closed."
-                   << " Drop message " << m << dendl;
-    m->put();
-  } else {
-    ldout(cct, 5) << __func__ << " enqueueing message m=" << m
-                  << " type=" << m->get_type() << " " << *m << dendl;
-    m->queue_start = ceph::mono_clock::now();
-    m->trace.event("async enqueueing message");
-    out_queue[m->get_priority()].emplace_back(
-      out_queue_entry_t{is_prepared, m});
-    ldout(cct, 15) << __func__ << " inline write is denied, reschedule m=" << m
-                   << dendl;
-    if (((!replacing && can_write) || state == STANDBY) && !write_in_progress) {
-      write_in_progress = true;
-      connection->center->dispatch_event_external(connection->write_handler);
-    }
+                   << " Drop queued messages" << dendl;
+    discard_out_queue();
+  } else if (((!replacing && can_write) || state == STANDBY) &&
+             !write_in_progress) {
+    write_in_progress = true;
+    connection->center->dispatch_event_external(connection->write_handler);
   }
 }
 
+// Move what send_message() queued into out_queue.  Must hold write_lock.
+void ProtocolV2::take_incoming() {
+  // clear first: a sender that finds it clear after we look will wake us
+  out_wakeup_pending = false;
+  out_incoming.drain([this](out_queue_entry_t&& entry) {
+    // "features" changes will change the payload encoding
+    if (entry.is_prepared &&
+        (!can_write || entry.features != connection->get_features())) {
+      // ensure the correctness of message encoding
+      entry.m->clear_payload();
+      entry.is_prepared = false;
+      ldout(cct, 10) << "take_incoming clear encoded buffer previous "
+                     << entry.features << " != "
+                     << connection->get_features() << dendl;
+    }
+    out_queue[entry.m->get_priority()].push_back(entry);
+  });
+}
+
 void ProtocolV2::send_keepalive() {
   ldout(cct, 10) << __func__ << dendl;
   std::lock_guard<std::mutex> l(connection->write_lock);
@@ -610,6 +629,10 @@ void ProtocolV2::write_event() {
     auto start = ceph::mono_clock::now();
     bool more;
     do {
+      // a channel must be open before its first message goes out
+      append_channel_frames();
+      take_incoming();
+
       const auto out_entry = _get_next_outgoing();
       if (!out_entry.m) {
         break;
@@ -620,7 +643,7 @@ void ProtocolV2::write_event() {
         sent.push_back(out_entry.m);
         out_entry.m->get();
       }
-      more = !out_queue.empty();
+      more = !out_queue.empty() || !out_incoming.empty();
       connection->write_lock.unlock();
 
       // send_message or requeue messages may not encode message
@@ -649,6 +672,12 @@ void ProtocolV2::write_event() {
       }
     } while (can_write);
     write_in_progress = false;
+    // anything queued since our last look, whose sender saw us busy
+    out_wakeup_pending = false;
+    if (can_write && !out_incoming.empty()) {
+      write_in_progress = true;
+      connection->center->dispatch_event_external(connection->write_handler);
+    }
 
     // if r > 0 mean data still lefted, so no need _try_send.
     if (r == 0) {
@@ -665,6 +694,10 @@ void ProtocolV2::write_event() {
         r = connection->_try_send();
       }
     }
+    if (session_stream_handlers.tx &&
+        out_queue.empty() && out_incoming.empty()) {
+      session_stream_handlers.tx->release_tx_buffers();
+    }
     connection->write_lock.unlock();
 
     connection->logger->tinc(l_msgr_running_send_time,
@@ -704,7 +737,8 @@ void ProtocolV2::write_event() {
 }
 
 bool ProtocolV2::is_queued() {
-  return !out_queue.empty() || connection->is_queued();
+  return !out_queue.empty() || !out_incoming.empty() ||
+         connection->is_queued();
 }
 
 uint32_t ProtocolV2::get_onwire_size(const uint32_t logical_size) const {
@@ -909,6 +943,7 @@ CtPtr ProtocolV2::_handle_peer_banner_payload(rx_buffer_t &&buffer, int r) {
   }
 
   this->peer_required_features = peer_required_features;
+  this->peer_supported_features = peer_supported_features;
   if (this->peer_required_features == 0) {
     this->connection_features = msgr2_required;
   }
@@ -1147,6 +1182,8 @@ CtPtr ProtocolV2::handle_read_frame_dispatch() {
     case Tag::KEEPALIVE2_ACK:
     case Tag::ACK:
     case Tag::WAIT:
+    case Tag::CHANNEL_OPEN:
+    case Tag::CHANNEL_CLOSE:
       return handle_frame_payload();
     case Tag::MESSAGE:
       return handle_message();
@@ -1169,8 +1206,19 @@ CtPtr ProtocolV2::read_frame_segment() {
   const auto& cur_rx_desc = rx_segments_desc.at(rx_segments_data.size());
   rx_buffer_t rx_buffer;
   try {
-    rx_buffer = buffer::ptr_node::create(buffer::create_aligned(
-      get_onwire_size(cur_rx_desc.length), cur_rx_desc.alignment));
+    const auto onwire_size = get_onwire_size(cur_rx_desc.length);
+    if (cur_rx_desc.alignment == segment_t::PAGE_SIZE_ALIGNMENT &&
+	onwire_size) {
+      // message data: page-aligned and recycled, so that it can go to
+      // the object store's direct I/O without being realigned
+      bool hit;
+      rx_buffer = buffer::ptr_node::create(
+	connection->worker->rx_pool.get(onwire_size, &hit));
+      connection->logger->inc(hit ? l_msgr_rx_pool_hit : l_msgr_rx_pool_miss);
+    } else {
+      rx_buffer = buffer::ptr_node::create(buffer::create_aligned(
+	onwire_size, cur_rx_desc.alignment));
+    }
   } catch (std::bad_alloc&) {
     // Catching because of potential issues with satisfying alignment.
     ldout(cct, 20) << __func__ << " can't allocate aligned rx_buffer "
@@ -1202,9 +1250,10 @@ CtPtr ProtocolV2::handle_read_frame_segment(rx_buffer_t &&rx_buffer, int r) {
 
     auto& new_seg = rx_segments_data.back();
     if (new_seg.length()) {
-      auto padded = session_stream_handlers.rx->authenticated_decrypt_update(
-          std::move(new_seg), segment_t::DEFAULT_ALIGNMENT);
       const auto idx = rx_segments_data.size() - 1;
+      // keep the plaintext as aligned as the segment asked for
+      auto padded = session_stream_handlers.rx->authenticated_decrypt_update(
+          std::move(new_seg), rx_segments_desc[idx].alignment);
       new_seg.clear();
       padded.splice(0, rx_segments_desc[idx].length, &new_seg);
 
@@ -1270,6 +1319,10 @@ CtPtr ProtocolV2::handle_frame_payload() {
       return handle_message_ack(payload);
     case Tag::WAIT:
       return handle_wait(payload);
+    case Tag::CHANNEL_OPEN:
+      return handle_channel_open(payload);
+    case Tag::CHANNEL_CLOSE:
+      return handle_channel_close(payload);
     default:
       ceph_abort();
   }
@@ -1292,6 +1345,7 @@ CtPtr ProtocolV2::ready() {
   {
     std::lock_guard<std::mutex> l(connection->write_lock);
     can_write = true;
+    take_incoming();
     if (!out_queue.empty()) {
       connection->center->dispatch_event_external(connection->write_handler);
     }
@@ -1403,6 +1457,29 @@ CtPtr ProtocolV2::handle_message() {
 		<< " off " << current_header.data_off
                 << dendl;
 
+  // the reserved field only names a channel if channels were negotiated;
+  // otherwise it is passed through as it always was
+  const bool demux = current_header.reserved &&
+    connection->policy.lossy &&
+    HAVE_MSGR2_FEATURE(peer_supported_features, CHANNELS);
+  ChannelConnectionRef channel;
+  if (demux) {
+    std::lock_guard<std::mutex> l(channel_lock);
+    auto p = channels.find(current_header.reserved);
+    if (p != channels.end()) {
+      channel = p->second;
+    }
+  }
+  if (demux && !channel) {
+    // it raced with the channel's close
+    ldout(cct, 1) << __func__ << " dropping message for unknown channel "
+		  << current_header.reserved << dendl;
+    in_seq = current_header.seq;
+    reset_throttle();
+    state = READY;
+    return CONTINUE(read_frame);
+  }
+
   INTERCEPT(16);
   ceph_msg_header header{current_header.seq,
                          current_header.tid,
@@ -1413,9 +1490,10 @@ CtPtr ProtocolV2::handle_message() {
                          init_le32(msg_frame.middle_len()),
                          init_le32(msg_frame.data_len()),
                          current_header.data_off,
-                         peer_name,
+                         (channel && channel->is_accepted() ?
+			    channel->get_entity_name() : peer_name),
                          current_header.compat_version,
-                         current_header.reserved,
+                         (channel ? init_le16(0) : current_header.reserved),
                          init_le32(0)};
   ceph_msg_footer footer{init_le32(0), init_le32(0),
 	                 init_le32(0), init_le64(0), current_header.flags};
@@ -1424,7 +1502,7 @@ CtPtr ProtocolV2::handle_message() {
       msg_frame.front(),
       msg_frame.middle(),
       msg_frame.data(),
-      connection);
+      channel ? static_cast<Connection*>(channel.get()) : connection);
   if (!message) {
     ldout(cct, 1) << __func__ << " decode message failed " << dendl;
     return _fault();
@@ -1709,6 +1787,190 @@ CtPtr ProtocolV2::handle_message_ack(ceph::bufferlist &payload)
   return CONTINUE(read_frame);
 }
 
+ConnectionRef ProtocolV2::open_channel(const entity_name_t& name,
+				       uint32_t nonce)
+{
+  std::lock_guard<std::mutex> l(connection->write_lock);
+  if (!can_write || !connection->policy.lossy ||
+      !HAVE_MSGR2_FEATURE(peer_supported_features, CHANNELS)) {
+    ldout(cct, 10) << __func__ << " " << name
+		   << " not supported on this connection" << dendl;
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> cl(channel_lock);
+  if (channels.size() >= cct->_conf.get_val<uint64_t>("ms_max_channels")) {
+    ldout(cct, 1) << __func__ << " " << name << " too many channels ("
+		  << channels.size() << ")" << dendl;
+    return nullptr;
+  }
+  do {
+    ++last_channel_id;
+  } while (last_channel_id == 0 || channels.count(last_channel_id));
+  auto channel = ceph::make_ref<ChannelConnection>(
+    cct, connection, last_channel_id, name, nonce, false);
+  channels[last_channel_id] = channel;
+  ldout(cct, 10) << __func__ << " " << name << " nonce " << nonce
+		 << " channel=" << last_channel_id << dendl;
+  queue_channel_frame({true, last_channel_id, name, nonce});
+  return channel;
+}
+
+void ProtocolV2::close_channel(uint16_t id)
+{
+  std::lock_guard<std::mutex> l(connection->write_lock);
+  {
+    std::lock_guard<std::mutex> cl(channel_lock);
+    if (!channels.erase(id)) {
+      return;
+    }
+  }
+  ldout(cct, 10) << __func__ << " channel=" << id << dendl;
+  if (state != CLOSED) {
+    queue_channel_frame({false, id, entity_name_t(), 0});
+  }
+}
+
+// write_lock must be held
+void ProtocolV2::queue_channel_frame(const channel_frame_t& f)
+{
+  pending_channel_frames.push_back(f);
+  if (can_write && !write_in_progress) {
+    write_in_progress = true;
+    connection->center->dispatch_event_external(connection->write_handler);
+  }
+}
+
+// write_lock must be held
+void ProtocolV2::append_channel_frames()
+{
+  for (auto& f : pending_channel_frames) {
+    if (f.open) {
+      auto frame = ChannelOpenFrame::Encode(f.id, f.name, f.nonce);
+      connection->outgoing_bl.append(
+	frame.get_buffer(session_stream_handlers));
+    } else {
+      auto frame = ChannelCloseFrame::Encode(f.id);
+      connection->outgoing_bl.append(
+	frame.get_buffer(session_stream_handlers));
+    }
+  }
+  pending_channel_frames.clear();
+}
+
+// write_lock must be held
+void ProtocolV2::reset_channels()
+{
+  pending_channel_frames.clear();
+  std::map<uint16_t, ChannelConnectionRef> dead;
+  {
+    std::lock_guard<std::mutex> l(channel_lock);
+    dead.swap(channels);
+  }
+  for (auto& [id, channel] : dead) {
+    ldout(cct, 10) << __func__ << " channel=" << id << dendl;
+    channel->set_closed();
+    connection->dispatch_queue->queue_reset(channel.get());
+  }
+}
+
+CtPtr ProtocolV2::handle_channel_open(ceph::bufferlist &payload)
+{
+  ldout(cct, 20) << __func__
+		 << " payload.length()=" << payload.length() << dendl;
+
+  if (state != READY) {
+    lderr(cct) << __func__ << " not in ready state!" << dendl;
+    return _fault();
+  }
+
+  auto channel_open = ChannelOpenFrame::Decode(payload);
+  const uint16_t id = channel_open.channel_id();
+  const entity_name_t name = channel_open.entity();
+  const uint32_t nonce = channel_open.nonce();
+  ldout(cct, 10) << __func__ << " " << name << " nonce " << nonce
+		 << " channel=" << id << dendl;
+
+  if (id == 0) {
+    lderr(cct) << __func__ << " bad channel id" << dendl;
+    return _fault();
+  }
+
+  // a channel speaks for the entity it names, with the caps of the one
+  // that authenticated.  that is only safe for names it may act for
+  // anyway: its own, or any of its kind if its caps allow everything.
+  const bool may_proxy =
+    name.type() == connection->get_peer_type() &&
+    (name.num() == static_cast<int64_t>(connection->get_peer_global_id()) ||
+     connection->get_peer_caps_info().allow_all);
+  ChannelConnectionRef channel;
+  {
+    std::lock_guard<std::mutex> l(channel_lock);
+    // each channel gets an address of its own, to be blocklisted by
+    // without fencing the connection or its other channels
+    bool nonce_ok = nonce != 0 &&
+      nonce != connection->get_peer_addr().get_nonce();
+    for (auto& [cid, c] : channels) {
+      nonce_ok = nonce_ok && c->get_nonce() != nonce;
+    }
+    if (connection->policy.lossy &&
+	may_proxy &&
+	nonce_ok &&
+	!channels.count(id) &&
+	channels.size() < cct->_conf.get_val<uint64_t>("ms_max_channels")) {
+      channel = ceph::make_ref<ChannelConnection>(
+	cct, connection, id, name, nonce, true);
+    }
+  }
+  if (channel && messenger->ms_deliver_handle_authentication(
+	channel.get()) < 0) {
+    channel.reset();
+  }
+  if (!channel) {
+    ldout(cct, 1) << __func__ << " refusing " << name << " channel=" << id
+		  << dendl;
+    std::lock_guard<std::mutex> l(connection->write_lock);
+    queue_channel_frame({false, id, entity_name_t(), 0});
+    return CONTINUE(read_frame);
+  }
+
+  {
+    std::lock_guard<std::mutex> l(channel_lock);
+    channels[id] = channel;
+  }
+  connection->dispatch_queue->queue_accept(channel.get());
+  messenger->ms_deliver_handle_fast_accept(channel.get());
+  return CONTINUE(read_frame);
+}
+
+CtPtr ProtocolV2::handle_channel_close(ceph::bufferlist &payload)
+{
+  ldout(cct, 20) << __func__
+		 << " payload.length()=" << payload.length() << dendl;
+
+  if (state != READY) {
+    lderr(cct) << __func__ << " not in ready state!" << dendl;
+    return _fault();
+  }
+
+  auto channel_close = ChannelCloseFrame::Decode(payload);
+  ChannelConnectionRef channel;
+  {
+    std::lock_guard<std::mutex> l(channel_lock);
+    auto p = channels.find(channel_close.channel_id());
+    if (p != channels.end()) {
+      channel = std::move(p->second);
+      channels.erase(p);
+    }
+  }
+  ldout(cct, 10) << __func__ << " channel=" << channel_close.channel_id()
+		 << (channel ? "" : " (unknown)") << dendl;
+  if (channel) {
+    channel->set_closed();
+    connection->dispatch_queue->queue_reset(channel.get());
+  }
+  return CONTINUE(read_frame);
+}
+
 /* Client Protocol Methods */
 
 CtPtr ProtocolV2::start_client_banner_exchange() {
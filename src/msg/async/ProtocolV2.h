@@ -6,7 +6,9 @@
 
 #include <boost/container/static_vector.hpp>
 
+#include "ChannelConnection.h"
 #include "Protocol.h"
+#include "common/mpsc_queue.h"
 #include "crypto_onwire.h"
 #include "frames_v2.h"
 
@@ -74,6 +76,7 @@ private:
   entity_name_t peer_name;
   State state;
   uint64_t peer_required_features;
+  uint64_t peer_supported_features = 0;
 
   uint64_t client_cookie;
   uint64_t server_cookie;
@@ -87,8 +90,15 @@ private:
   struct out_queue_entry_t {
     bool is_prepared {false};
     Message* m {nullptr};
+    uint64_t features {0};  ///< what a prepared m was encoded with
   };
   std::map<int, std::list<out_queue_entry_t>> out_queue;
+  // send_message() queues here without taking write_lock; the writer
+  // moves messages into out_queue's priority lanes under it.  Only the
+  // first sender after the writer last looked takes the lock to wake
+  // it, see send_message().
+  ceph::common::mpsc_queue<out_queue_entry_t> out_incoming;
+  std::atomic<bool> out_wakeup_pending = {false};
   std::list<Message *> sent;
   std::atomic<uint64_t> out_seq{0};
   std::atomic<uint64_t> in_seq{0};
@@ -115,6 +125,19 @@ private:
   bool keepalive;
   bool write_in_progress = false;
 
+  // logical sessions carried over this connection, by channel id
+  std::mutex channel_lock;
+  std::map<uint16_t, ChannelConnectionRef> channels;
+  uint16_t last_channel_id = 0;
+  struct channel_frame_t {
+    bool open;
+    uint16_t id;
+    entity_name_t name;
+    uint32_t nonce;
+  };
+  // opens/closes to go out ahead of the next message; under write_lock
+  std::list<channel_frame_t> pending_channel_frames;
+
   ostream &_conn_prefix(std::ostream *_dout);
   void run_continuation(Ct<ProtocolV2> *pcontinuation);
   void run_continuation(Ct<ProtocolV2> &continuation);
@@ -135,12 +158,16 @@ private:
   void reset_throttle();
   Ct<ProtocolV2> *_fault();
   void discard_out_queue();
+  void take_incoming();
   void reset_session();
   void prepare_send_message(uint64_t features, Message *m);
   out_queue_entry_t _get_next_outgoing();
   ssize_t write_message(Message *m, bool more);
   void append_keepalive();
   void append_keepalive_ack(utime_t &timestamp);
+  void queue_channel_frame(const channel_frame_t& f);
+  void append_channel_frames();
+  void reset_channels();
   void handle_message_ack(uint64_t seq);
 
   CONTINUATION_DECL(ProtocolV2, _wait_for_peer_banner);
@@ -185,6 +212,9 @@ private:
 
   Ct<ProtocolV2> *handle_message_ack(ceph::bufferlist &payload);
 
+  Ct<ProtocolV2> *handle_channel_open(ceph::bufferlist &payload);
+  Ct<ProtocolV2> *handle_channel_close(ceph::bufferlist &payload);
+
 public:
   uint64_t connection_features;
 
@@ -203,6 +233,10 @@ public:
   virtual void write_event() override;
   virtual bool is_queued() override;
 
+  virtual ConnectionRef open_channel(const entity_name_t& name,
+				     uint32_t nonce) override;
+  virtual void close_channel(uint16_t id) override;
+
 private:
   // Client Protocol
   CONTINUATION_DECL(ProtocolV2, start_client_banner_exchange);
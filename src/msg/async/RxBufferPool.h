@@ -0,0 +1,125 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_ASYNC_RXBUFFERPOOL_H
+#define CEPH_MSG_ASYNC_RXBUFFERPOOL_H
+
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "common/ceph_mutex.h"
+#include "common/deleter.h"
+#include "include/buffer.h"
+#include "include/intarith.h"
+#include "include/mempool.h"
+#include "include/page.h"
+
+/**
+ * RxBufferPool: recycled page-aligned buffers for received message data
+ *
+ * Message data segments are read straight into these, so payloads land
+ * page aligned and padded to whole pages, and the object store can hand
+ * them to direct I/O as they are instead of copying them into a fresh
+ * aligned buffer.  Recycling also spares us an mmap/munmap and the page
+ * faults for every large message.
+ *
+ * Buffers go back on the free lists when their last reference is
+ * dropped, from whatever thread that happens on, and are released to
+ * the heap once the pool holds max_bytes.  The free buffers are counted
+ * in mempool msgr_rx_pool.
+ */
+class RxBufferPool {
+  struct state_t {
+    ceph::mutex lock = ceph::make_mutex("RxBufferPool::lock");
+    std::map<size_t, std::vector<char*>> free;  ///< by buffer size
+    size_t free_bytes = 0;
+    size_t max_bytes;
+
+    explicit state_t(size_t max) : max_bytes(max) {}
+    ~state_t() {
+      for (auto& p : free) {
+	for (auto buf : p.second) {
+	  account(-1, -(ssize_t)p.first);
+	  std::free(buf);
+	}
+      }
+    }
+    static void account(ssize_t n, ssize_t bytes) {
+      mempool::get_pool(mempool::mempool_msgr_rx_pool).adjust_count(n, bytes);
+    }
+    void put(char *buf, size_t size) {
+      {
+	std::lock_guard l(lock);
+	if (free_bytes + size <= max_bytes) {
+	  free[size].push_back(buf);
+	  free_bytes += size;
+	  account(1, size);
+	  return;
+	}
+      }
+      std::free(buf);
+    }
+  };
+  std::shared_ptr<state_t> state;
+  size_t max_buffer;
+
+ public:
+  RxBufferPool(size_t max_bytes, size_t max_buffer)
+    : state(std::make_shared<state_t>(max_bytes)), max_buffer(max_buffer) {}
+
+  /**
+   * get a page-aligned buffer
+   *
+   * @param len length of the returned ptr; the buffer behind it is
+   *            rounded up to whole pages
+   * @param hit set to whether the buffer was recycled
+   */
+  ceph::bufferptr get(size_t len, bool *hit) {
+    size_t size = round_up_to(std::max<size_t>(len, 1), CEPH_PAGE_SIZE);
+    *hit = false;
+    if (size > max_buffer || !state->max_bytes) {
+      return ceph::bufferptr(ceph::buffer::create_aligned(len, CEPH_PAGE_SIZE));
+    }
+    char *buf = nullptr;
+    {
+      std::lock_guard l(state->lock);
+      auto p = state->free.find(size);
+      if (p != state->free.end() && !p->second.empty()) {
+	buf = p->second.back();
+	p->second.pop_back();
+	state->free_bytes -= size;
+	state_t::account(-1, -(ssize_t)size);
+	*hit = true;
+      }
+    }
+    if (!buf) {
+      buf = static_cast<char*>(std::aligned_alloc(CEPH_PAGE_SIZE, size));
+      if (!buf) {
+	throw std::bad_alloc();
+      }
+    }
+    ceph::bufferptr bp(ceph::buffer::claim_buffer(
+      size, buf,
+      make_deleter([s = state, buf, size] { s->put(buf, size); })));
+    bp.set_length(len);
+    return bp;
+  }
+
+  size_t get_free_bytes() const {
+    std::lock_guard l(state->lock);
+    return state->free_bytes;
+  }
+};
+
+#endif
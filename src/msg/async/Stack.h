@@ -19,6 +19,7 @@
 
 #include "include/spinlock.h"
 #include "common/perf_counters.h"
+#include "RxBufferPool.h"
 #include "msg/msg_types.h"
 #include "msg/async/Event.h"
 
@@ -210,6 +211,12 @@ enum {
   l_msgr_send_messages_queue_lat,
   l_msgr_handle_ack_lat,
 
+  l_msgr_send_zerocopy_bytes,
+  l_msgr_send_zerocopy_fallback,
+
+  l_msgr_rx_pool_hit,
+  l_msgr_rx_pool_miss,
+
   l_msgr_last,
 };
 
@@ -227,12 +234,15 @@ class Worker {
 
   std::atomic_uint references;
   EventCenter center;
+  RxBufferPool rx_pool;  ///< for message data segments
 
   Worker(const Worker&) = delete;
   Worker& operator=(const Worker&) = delete;
 
   Worker(CephContext *c, unsigned worker_id)
-    : cct(c), perf_logger(NULL), id(worker_id), references(0), center(c) {
+    : cct(c), perf_logger(NULL), id(worker_id), references(0), center(c),
+      rx_pool(c->_conf.get_val<Option::size_t>("ms_async_rx_pool_size"),
+	      c->_conf.get_val<Option::size_t>("ms_async_rx_pool_max_buffer")) {
     char name[128];
     sprintf(name, "AsyncMessenger::Worker-%u", id);
     // initialize perf_logger
@@ -253,6 +263,12 @@ class Worker {
     plb.add_time_avg(l_msgr_send_messages_queue_lat, "msgr_send_messages_queue_lat", "Network sent messages lat");
     plb.add_time_avg(l_msgr_handle_ack_lat, "msgr_handle_ack_lat", "Connection handle ack lat");
 
+    plb.add_u64_counter(l_msgr_send_zerocopy_bytes, "msgr_send_zerocopy_bytes", "Network bytes sent without copying", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_send_zerocopy_fallback, "msgr_send_zerocopy_fallback", "Zero copy sends the kernel copied anyway");
+
+    plb.add_u64_counter(l_msgr_rx_pool_hit, "msgr_rx_pool_hit", "Data segments received into a recycled aligned buffer");
+    plb.add_u64_counter(l_msgr_rx_pool_miss, "msgr_rx_pool_miss", "Data segments that needed a new aligned buffer");
+
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
   }
@@ -327,6 +343,11 @@ class NetworkStack {
           CephContext *c, const string &t, unsigned i);
   // backend need to override this method if supports zero copy read
   virtual bool support_zero_copy_read() const { return false; }
+  /// a buffer for data to be sent, which the stack may be able to send
+  /// without copying it
+  virtual ceph::bufferptr create_tx_buffer(unsigned len) {
+    return ceph::buffer::create_page_aligned(len);
+  }
   // backend need to override this method if backend doesn't support shared
   // listen table.
   // For example, posix backend has in kernel global listen table. If one
@@ -8,6 +8,7 @@
 
 #include "common/debug.h"
 #include "common/ceph_crypto.h"
+#include "include/intarith.h"
 #include "include/types.h"
 
 #define dout_subsys ceph_subsys_ms
@@ -19,6 +20,9 @@ static constexpr const std::size_t AESGCM_IV_LEN{12};
 static constexpr const std::size_t AESGCM_TAG_LEN{16};
 static constexpr const std::size_t AESGCM_BLOCK_LEN{16};
 
+// frames up to a quarter of this share one output allocation
+static constexpr const std::size_t TX_ARENA_LEN{64 << 10};
+
 struct nonce_t {
   std::uint32_t random_seq;
   std::uint64_t random_rest;
@@ -34,7 +38,12 @@ using key_t = std::array<std::uint8_t, AESGCM_KEY_LEN>;
 class AES128GCM_OnWireTxHandler : public ceph::crypto::onwire::TxHandler {
   CephContext* const cct;
   std::unique_ptr<EVP_CIPHER_CTX, decltype(&::EVP_CIPHER_CTX_free)> ectx;
-  ceph::bufferlist buffer;
+  // ciphertext of consecutive small frames is carved out of one arena
+  // rather than each getting a page of its own
+  ceph::bufferptr arena;
+  unsigned arena_used = 0;
+  ceph::bufferptr buffer;  ///< the current frame's ciphertext
+  unsigned buffer_used = 0;
   nonce_t nonce;
   static_assert(sizeof(nonce) == AESGCM_IV_LEN);
 
@@ -73,6 +82,13 @@ public:
 
   void authenticated_encrypt_update(const ceph::bufferlist& plaintext) override;
   ceph::bufferlist authenticated_encrypt_final() override;
+
+  void release_tx_buffers() override {
+    // whatever frames were carved from the arena hold it until they
+    // are written out; an idle connection need not keep it beyond that
+    arena = ceph::bufferptr();
+    arena_used = 0;
+  }
 };
 
 void AES128GCM_OnWireTxHandler::reset_tx_handler(
@@ -83,8 +99,19 @@ void AES128GCM_OnWireTxHandler::reset_tx_handler(
     throw std::runtime_error("EVP_EncryptInit_ex failed");
   }
 
-  buffer.reserve(std::accumulate(std::begin(update_size_sequence),
-    std::end(update_size_sequence), AESGCM_TAG_LEN));
+  const std::size_t len = std::accumulate(std::begin(update_size_sequence),
+    std::end(update_size_sequence), AESGCM_TAG_LEN);
+  if (len > TX_ARENA_LEN / 4) {
+    buffer = ceph::buffer::create_page_aligned(len);
+  } else {
+    if (arena_used + len > arena.length()) {
+      arena = ceph::buffer::create_page_aligned(TX_ARENA_LEN);
+      arena_used = 0;
+    }
+    buffer = ceph::bufferptr(arena, arena_used, len);
+    arena_used += p2roundup<std::size_t>(len, AESGCM_BLOCK_LEN);
+  }
+  buffer_used = 0;
 
   ++nonce.random_seq;
 }
@@ -92,13 +119,13 @@ void AES128GCM_OnWireTxHandler::reset_tx_handler(
 void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
   const ceph::bufferlist& plaintext)
 {
-  auto filler = buffer.append_hole(plaintext.length());
+  ceph_assert(buffer_used + plaintext.length() <= buffer.length());
 
   for (const auto& plainbuf : plaintext.buffers()) {
     int update_len = 0;
 
     if(1 != EVP_EncryptUpdate(ectx.get(),
-	reinterpret_cast<unsigned char*>(filler.c_str()),
+	reinterpret_cast<unsigned char*>(buffer.c_str() + buffer_used),
 	&update_len,
 	reinterpret_cast<const unsigned char*>(plainbuf.c_str()),
 	plainbuf.length())) {
@@ -106,21 +133,22 @@ void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
     }
     ceph_assert_always(update_len >= 0);
     ceph_assert(static_cast<unsigned>(update_len) == plainbuf.length());
-    filler.advance(update_len);
+    buffer_used += update_len;
   }
 
   ldout(cct, 15) << __func__
 		 << " plaintext.length()=" << plaintext.length()
-		 << " buffer.length()=" << buffer.length()
+		 << " buffer_used=" << buffer_used
 		 << dendl;
 }
 
 ceph::bufferlist AES128GCM_OnWireTxHandler::authenticated_encrypt_final()
 {
   int final_len = 0;
-  auto filler = buffer.append_hole(AESGCM_BLOCK_LEN);
+  ceph_assert(buffer_used + AESGCM_TAG_LEN <= buffer.length());
+  auto* tag = buffer.c_str() + buffer_used;
   if(1 != EVP_EncryptFinal_ex(ectx.get(),
-	reinterpret_cast<unsigned char*>(filler.c_str()),
+	reinterpret_cast<unsigned char*>(tag),
 	&final_len)) {
     throw std::runtime_error("EVP_EncryptFinal_ex failed");
   }
@@ -129,15 +157,20 @@ ceph::bufferlist AES128GCM_OnWireTxHandler::authenticated_encrypt_final()
   static_assert(AESGCM_BLOCK_LEN == AESGCM_TAG_LEN);
   if(1 != EVP_CIPHER_CTX_ctrl(ectx.get(),
 	EVP_CTRL_GCM_GET_TAG, AESGCM_TAG_LEN,
-	filler.c_str())) {
+	tag)) {
     throw std::runtime_error("EVP_CIPHER_CTX_ctrl failed");
   }
+  buffer_used += AESGCM_TAG_LEN;
 
   ldout(cct, 15) << __func__
-		 << " buffer.length()=" << buffer.length()
+		 << " buffer_used=" << buffer_used
 		 << " final_len=" << final_len
 		 << dendl;
-  return std::move(buffer);
+  buffer.set_length(buffer_used);
+  ceph::bufferlist out;
+  out.push_back(std::move(buffer));
+  buffer_used = 0;
+  return out;
 }
 
 // RX PART
@@ -201,8 +234,27 @@ ceph::bufferlist AES128GCM_OnWireRxHandler::authenticated_decrypt_update(
   ceph_assert(ciphertext.length() > 0);
   //ceph_assert(ciphertext.length() % AESGCM_BLOCK_LEN == 0);
 
-  // NOTE: we might consider in-place transformations in the future. AFAIK
-  // OpenSSL's might sustain that but lack of clear confirmation postpones.
+  // GCM decrypts in place (out == in).  Do so when the ciphertext is a
+  // buffer nobody else can see that already has the alignment asked
+  // for, as the segments ProtocolV2 reads are; that keeps e.g. message
+  // data in the page-aligned buffer it was received into.
+  if (ciphertext.get_num_buffers() == 1) {
+    auto& cipherbuf = ciphertext.front();
+    if (cipherbuf.raw_nref() == 1 && cipherbuf.is_aligned(alignment)) {
+      auto* buf = reinterpret_cast<unsigned char*>(
+	const_cast<char*>(cipherbuf.c_str()));
+      int update_len = 0;
+      if (1 != EVP_DecryptUpdate(ectx.get(), buf, &update_len,
+				 buf, cipherbuf.length())) {
+	throw std::runtime_error("EVP_DecryptUpdate failed");
+      }
+      ceph_assert_always(update_len >= 0);
+      ceph_assert(cipherbuf.length() == static_cast<unsigned>(update_len));
+      ciphertext.invalidate_crc();
+      return std::move(ciphertext);
+    }
+  }
+
   auto plainnode = ceph::buffer::ptr_node::create(buffer::create_aligned(
     ciphertext.length(), alignment));
   auto* plainbuf = reinterpret_cast<unsigned char*>(plainnode->c_str());
@@ -74,6 +74,11 @@ struct TxHandler {
   // Generates authentication signature and returns bufferlist crafted
   // basing on plaintext from preceding call to _update().
   virtual ceph::bufferlist authenticated_encrypt_final() = 0;
+
+  // Called when the client has nothing more queued to encrypt. Memory
+  // kept around for the next frames may be released; frames already
+  // returned by _final() stay valid.
+  virtual void release_tx_buffers() {}
 };
 
 class RxHandler {
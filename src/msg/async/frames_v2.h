@@ -52,7 +52,9 @@ enum class Tag : __u8 {
   MESSAGE,
   KEEPALIVE2,
   KEEPALIVE2_ACK,
-  ACK
+  ACK,
+  CHANNEL_OPEN,
+  CHANNEL_CLOSE
 };
 
 struct segment_t {
@@ -673,6 +675,34 @@ protected:
   using ControlFrame::ControlFrame;
 };
 
+struct ChannelOpenFrame : public ControlFrame<ChannelOpenFrame,
+                                              uint16_t,  // channel id
+                                              entity_name_t,  // entity
+                                              uint32_t> {  // addr nonce
+  static const Tag tag = Tag::CHANNEL_OPEN;
+  using ControlFrame::Encode;
+  using ControlFrame::Decode;
+
+  inline uint16_t &channel_id() { return get_val<0>(); }
+  inline entity_name_t &entity() { return get_val<1>(); }
+  inline uint32_t &nonce() { return get_val<2>(); }
+
+protected:
+  using ControlFrame::ControlFrame;
+};
+
+struct ChannelCloseFrame : public ControlFrame<ChannelCloseFrame,
+                                               uint16_t> {  // channel id
+  static const Tag tag = Tag::CHANNEL_CLOSE;
+  using ControlFrame::Encode;
+  using ControlFrame::Decode;
+
+  inline uint16_t &channel_id() { return get_val<0>(); }
+
+protected:
+  using ControlFrame::ControlFrame;
+};
+
 // This class is used for encoding/decoding header of the message frame.
 // Body is processed almost independently with the sole junction point
 // being the `extra_payload_len` passed to get_buffer().
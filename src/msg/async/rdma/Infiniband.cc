@@ -18,6 +18,8 @@
 #include "common/errno.h"
 #include "common/debug.h"
 #include "RDMAStack.h"
+#include "common/deleter.h"
+#include "include/intarith.h"
 #include <sys/time.h>
 #include <sys/resource.h>
 
@@ -935,7 +937,9 @@ Infiniband::MemoryManager::MemoryManager(CephContext *c, Device *d, ProtectionDo
                    c->_conf->ms_async_rdma_receive_buffers :  2 * c->_conf->ms_async_rdma_receive_queue_len) :
                   // rx pool is infinite, we can set any initial size that we want
                    2 * c->_conf->ms_async_rdma_receive_queue_len,
-                   device->device_attr.max_mr_size / (sizeof(Chunk) + cct->_conf->ms_async_rdma_buffer_size))
+                   device->device_attr.max_mr_size / (sizeof(Chunk) + cct->_conf->ms_async_rdma_buffer_size)),
+    registered(std::make_shared<registered_t>(
+      c->_conf.get_val<Option::size_t>("ms_async_rdma_registered_pool_size")))
 {
 }
 
@@ -943,6 +947,7 @@ Infiniband::MemoryManager::~MemoryManager()
 {
   if (send)
     delete send;
+  registered->shutdown();
 }
 
 void* Infiniband::MemoryManager::huge_pages_malloc(size_t size)
@@ -1006,6 +1011,104 @@ int Infiniband::MemoryManager::get_send_buffers(std::vector<Chunk*> &c, size_t b
   return send->get_buffers(c, bytes);
 }
 
+void Infiniband::MemoryManager::registered_t::shutdown()
+{
+  std::lock_guard l{lock};
+  for (auto& p : free) {
+    for (auto buf : p.second) {
+      release(buf);
+    }
+  }
+  free.clear();
+  free_bytes = 0;
+  // buffers still out there keep their memory, but not their mr
+  for (auto& p : regions) {
+    ibv_dereg_mr(p.second);
+  }
+  regions.clear();
+  nregions = 0;
+  dead = true;
+}
+
+void Infiniband::MemoryManager::registered_t::release(char *buf)
+{
+  auto p = regions.find(buf);
+  ceph_assert(p != regions.end());
+  ibv_dereg_mr(p->second);
+  regions.erase(p);
+  --nregions;
+  std::free(buf);
+}
+
+void Infiniband::MemoryManager::registered_t::put(char *buf, size_t size)
+{
+  std::lock_guard l{lock};
+  if (dead) {
+    std::free(buf);
+  } else if (free_bytes + size <= max_bytes) {
+    free[size].push_back(buf);
+    free_bytes += size;
+  } else {
+    release(buf);
+  }
+}
+
+ceph::bufferptr Infiniband::MemoryManager::create_registered_buffer(size_t len)
+{
+  size_t size = round_up_to(std::max<size_t>(len, 1), CEPH_PAGE_SIZE);
+  char *buf = nullptr;
+  {
+    std::lock_guard l{registered->lock};
+    auto p = registered->free.find(size);
+    if (p != registered->free.end() && !p->second.empty()) {
+      buf = p->second.back();
+      p->second.pop_back();
+      registered->free_bytes -= size;
+    }
+  }
+  if (!buf) {
+    buf = static_cast<char*>(std::aligned_alloc(CEPH_PAGE_SIZE, size));
+    if (!buf) {
+      throw std::bad_alloc();
+    }
+    ibv_mr *mr = ibv_reg_mr(pd->pd, buf, size, IBV_ACCESS_LOCAL_WRITE);
+    if (!mr) {
+      // still usable, just copied into a tx chunk when sent
+      lderr(cct) << __func__ << " failed to register " << size << " bytes: "
+                 << cpp_strerror(errno) << dendl;
+      std::free(buf);
+      return ceph::bufferptr(ceph::buffer::create_page_aligned(len));
+    }
+    std::lock_guard l{registered->lock};
+    registered->regions[buf] = mr;
+    ++registered->nregions;
+  }
+  ceph::bufferptr bp(ceph::buffer::claim_buffer(
+    size, buf,
+    make_deleter([r = registered, buf, size] { r->put(buf, size); })));
+  bp.set_length(len);
+  return bp;
+}
+
+bool Infiniband::MemoryManager::get_registered_lkey(const char *c, size_t len,
+                                                    uint32_t *lkey)
+{
+  if (!registered->nregions) {
+    return false;
+  }
+  std::lock_guard l{registered->lock};
+  auto p = registered->regions.upper_bound(c);
+  if (p == registered->regions.begin()) {
+    return false;
+  }
+  --p;
+  if (c + len > p->first + p->second->length) {
+    return false;
+  }
+  *lkey = p->second->lkey;
+  return true;
+}
+
 static std::atomic<bool> init_prereq = {false};
 
 void Infiniband::verify_prereq(CephContext *cct) {
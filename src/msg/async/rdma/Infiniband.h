@@ -26,6 +26,8 @@
 
 #include <atomic>
 #include <functional>
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -36,6 +38,7 @@
 #include "common/errno.h"
 #include "common/ceph_mutex.h"
 #include "common/perf_counters.h"
+#include "include/buffer.h"
 #include "msg/msg_types.h"
 #include "msg/async/net_handler.h"
 
@@ -47,6 +50,10 @@
 #define PSN_MSK ((1 << PSN_LEN) - 1)
 
 #define BEACON_WRID 0xDEADBEEF
+// tags the wr_id of a send posted straight from a registered buffer,
+// which points to its Infiniband::RegisteredTx; chunks and queue pairs
+// are aligned, so their wr_ids never have the low bit set
+#define REGISTERED_TX_WRID 0x1ull
 
 struct ib_cm_meta_t {
   uint16_t lid;
@@ -183,6 +190,7 @@ enum {
 
   l_msgr_rdma_tx_chunks,
   l_msgr_rdma_tx_bytes,
+  l_msgr_rdma_tx_registered_bytes,
   l_msgr_rdma_rx_chunks,
   l_msgr_rdma_rx_bytes,
   l_msgr_rdma_pending_sent_conns,
@@ -368,6 +376,17 @@ class Infiniband {
       rxbuf_pool_ctx.set_stat_logger(logger);
     }
 
+    /**
+     * Buffers registered with the device up front, for callers that
+     * want their data sent without a copy into a tx chunk.  They are
+     * handed out as bufferptrs, recycled by size when the last reference
+     * drops, and deregistered once ms_async_rdma_registered_pool_size
+     * bytes are already cached.
+     */
+    ceph::bufferptr create_registered_buffer(size_t len);
+    /// find the lkey of the registered buffer holding [c, c + len)
+    bool get_registered_lkey(const char *c, size_t len, uint32_t *lkey);
+
     CephContext  *cct;
    private:
     // TODO: Cluster -> TxPool txbuf_pool
@@ -379,6 +398,25 @@ class Infiniband {
     MemPoolContext rxbuf_pool_ctx;
     mem_pool     rxbuf_pool;
 
+    struct registered_t {
+      ceph::mutex lock = ceph::make_mutex("MemoryManager::registered_lock");
+      std::map<const char*, ibv_mr*> regions;     ///< by address
+      std::map<size_t, std::vector<char*>> free;  ///< by size
+      std::atomic<size_t> nregions = {0};
+      size_t free_bytes = 0;
+      size_t max_bytes;
+      bool dead = false;  ///< regions deregistered, pd going away
+
+      explicit registered_t(size_t max) : max_bytes(max) {}
+      void put(char *buf, size_t size);
+      void release(char *buf);
+      void shutdown();
+    };
+    // shared with the buffers handed out, which may outlive us; we
+    // deregister everything before the pd is deallocated, and what comes
+    // back later is just freed
+    std::shared_ptr<registered_t> registered;
+
 
     void* huge_pages_malloc(size_t size);
     void  huge_pages_free(void *ptr);
@@ -579,6 +617,20 @@ class Infiniband {
   int get_async_fd() { return device->ctxt->async_fd; }
   bool is_tx_buffer(const char* c) { return memory_manager->is_tx_buffer(c);}
   Chunk *get_tx_chunk_by_buffer(const char *c) { return memory_manager->get_tx_chunk_by_buffer(c); }
+  ceph::bufferptr create_registered_buffer(size_t len) {
+    return memory_manager->create_registered_buffer(len);
+  }
+  bool get_registered_lkey(const char *c, size_t len, uint32_t *lkey) {
+    return memory_manager->get_registered_lkey(c, len, lkey);
+  }
+
+  /// a send from a registered buffer, held until its completion
+  struct RegisteredTx {
+    ceph::bufferptr bp;
+    /// unused tx chunk, so that registered sends share the tx pool's
+    /// bound on work requests in flight
+    MemoryManager::Chunk *credit = nullptr;
+  };
   static const char* wc_status_to_string(int status);
   static const char* qp_state_string(int status);
   uint32_t get_rx_queue_len() const { return rx_queue_len; }
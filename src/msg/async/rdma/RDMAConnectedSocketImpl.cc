@@ -396,30 +396,64 @@ ssize_t RDMAConnectedSocketImpl::submit(bool more)
   if (!bytes)
     return 0;
 
+  std::vector<tx_segment_t> segments;
   std::vector<Chunk*> tx_buffers;
   auto it = std::cbegin(pending_bl.buffers());
   auto copy_start = it;
   size_t total_copied = 0, wait_copy_len = 0;
+  // copy what we have passed over so far into tx chunks
+  auto copy_pending = [&]() {
+    size_t copied = tx_copy_chunk(tx_buffers, wait_copy_len, copy_start, it);
+    total_copied += copied;
+    for (auto chunk : tx_buffers) {
+      segments.push_back(tx_segment_t{chunk});
+    }
+    tx_buffers.clear();
+    bool done = copied == wait_copy_len;
+    wait_copy_len = 0;
+    return done;
+  };
+  // the peer receives into chunks of this size, so no send may be longer
+  const uint32_t max_send = ib->get_memory_manager()->get_tx_buffer_size();
   while (it != pending_bl.buffers().end()) {
+    uint32_t lkey;
     if (ib->is_tx_buffer(it->raw_c_str())) {
-      if (wait_copy_len) {
-        size_t copied = tx_copy_chunk(tx_buffers, wait_copy_len, copy_start, it);
-        total_copied += copied;
-        if (copied < wait_copy_len)
-          goto sending;
-        wait_copy_len = 0;
-      }
+      if (wait_copy_len && !copy_pending())
+        goto sending;
       ceph_assert(copy_start == it);
-      tx_buffers.push_back(ib->get_tx_chunk_by_buffer(it->raw_c_str()));
+      segments.push_back(
+        tx_segment_t{ib->get_tx_chunk_by_buffer(it->raw_c_str())});
       total_copied += it->length();
       ++copy_start;
+    } else if (ib->get_registered_lkey(it->c_str(), it->length(), &lkey)) {
+      if (wait_copy_len && !copy_pending())
+        goto sending;
+      ceph_assert(copy_start == it);
+      // each send is charged a tx chunk, so that with the copied ones
+      // they never outnumber what the QP's send queue holds
+      uint32_t wrs = (it->length() + max_send - 1) / max_send;
+      std::vector<Chunk*> credits;
+      worker->get_reged_mem(this, credits, (size_t)wrs * max_send);
+      for (uint32_t i = 0; i < credits.size(); ++i) {
+        uint32_t off = i * max_send;
+        uint32_t len = std::min(max_send, it->length() - off);
+        segments.push_back(tx_segment_t{
+          nullptr, bufferptr(*it, off, len), lkey, credits[i]});
+        total_copied += len;
+      }
+      if (credits.size() < wrs) {
+        // the rest stays in pending_bl until chunks come back
+        worker->perf_logger->inc(l_msgr_rdma_tx_no_mem);
+        goto sending;
+      }
+      ++copy_start;
     } else {
       wait_copy_len += it->length();
     }
     ++it;
   }
   if (wait_copy_len)
-    total_copied += tx_copy_chunk(tx_buffers, wait_copy_len, copy_start, it);
+    copy_pending();
 
  sending:
   if (total_copied == 0)
@@ -435,9 +469,9 @@ ssize_t RDMAConnectedSocketImpl::submit(bool more)
   }
 
   ldout(cct, 20) << __func__ << " left bytes: " << pending_bl.length() << " in buffers "
-                 << pending_bl.buffers().size() << " tx chunks " << tx_buffers.size() << dendl;
+                 << pending_bl.buffers().size() << " tx segments " << segments.size() << dendl;
 
-  int r = post_work_request(tx_buffers);
+  int r = post_work_request(segments);
   if (r < 0)
     return r;
 
@@ -445,28 +479,45 @@ ssize_t RDMAConnectedSocketImpl::submit(bool more)
   return pending_bl.length() ? -EAGAIN : 0;
 }
 
-int RDMAConnectedSocketImpl::post_work_request(std::vector<Chunk*> &tx_buffers)
+int RDMAConnectedSocketImpl::post_work_request(std::vector<tx_segment_t> &segments)
 {
-  ldout(cct, 20) << __func__ << " QP: " << local_qpn << " " << tx_buffers[0] << dendl;
-  vector<Chunk*>::iterator current_buffer = tx_buffers.begin();
-  ibv_sge isge[tx_buffers.size()];
+  ldout(cct, 20) << __func__ << " QP: " << local_qpn << " " << segments.size()
+                 << " segments" << dendl;
+  auto current_segment = segments.begin();
+  ibv_sge isge[segments.size()];
   uint32_t current_sge = 0;
-  ibv_send_wr iswr[tx_buffers.size()];
+  ibv_send_wr iswr[segments.size()];
   uint32_t current_swr = 0;
   ibv_send_wr* pre_wr = NULL;
-  uint32_t num = 0; 
+  uint32_t num = 0, chunks = 0;
 
   // FIPS zeroization audit 20191115: these memsets are not security related.
   memset(iswr, 0, sizeof(iswr));
   memset(isge, 0, sizeof(isge));
  
-  while (current_buffer != tx_buffers.end()) {
-    isge[current_sge].addr = reinterpret_cast<uint64_t>((*current_buffer)->buffer);
-    isge[current_sge].length = (*current_buffer)->get_offset();
-    isge[current_sge].lkey = (*current_buffer)->mr->lkey;
-    ldout(cct, 25) << __func__ << " sending buffer: " << *current_buffer << " length: " << isge[current_sge].length  << dendl;
-
-    iswr[current_swr].wr_id = reinterpret_cast<uint64_t>(*current_buffer);
+  while (current_segment != segments.end()) {
+    if (Chunk *chunk = current_segment->chunk; chunk) {
+      isge[current_sge].addr = reinterpret_cast<uint64_t>(chunk->buffer);
+      isge[current_sge].length = chunk->get_offset();
+      isge[current_sge].lkey = chunk->mr->lkey;
+      ldout(cct, 25) << __func__ << " sending buffer: " << chunk << " length: " << isge[current_sge].length  << dendl;
+      iswr[current_swr].wr_id = reinterpret_cast<uint64_t>(chunk);
+      worker->perf_logger->inc(l_msgr_rdma_tx_bytes, isge[current_sge].length);
+      ++chunks;
+    } else {
+      auto& bp = current_segment->registered;
+      isge[current_sge].addr = reinterpret_cast<uint64_t>(bp.c_str());
+      isge[current_sge].length = bp.length();
+      isge[current_sge].lkey = current_segment->lkey;
+      ldout(cct, 25) << __func__ << " sending registered buffer: " << (void*)bp.c_str()
+                     << " length: " << isge[current_sge].length << dendl;
+      // hold the buffer until the send completes
+      iswr[current_swr].wr_id =
+        reinterpret_cast<uint64_t>(new Infiniband::RegisteredTx{
+            std::move(bp), current_segment->credit}) |
+        REGISTERED_TX_WRID;
+      worker->perf_logger->inc(l_msgr_rdma_tx_registered_bytes, isge[current_sge].length);
+    }
     iswr[current_swr].next = NULL;
     iswr[current_swr].sg_list = &isge[current_sge];
     iswr[current_swr].num_sge = 1;
@@ -474,24 +525,35 @@ int RDMAConnectedSocketImpl::post_work_request(std::vector<Chunk*> &tx_buffers)
     iswr[current_swr].send_flags = IBV_SEND_SIGNALED;
 
     num++;
-    worker->perf_logger->inc(l_msgr_rdma_tx_bytes, isge[current_sge].length);
     if (pre_wr)
       pre_wr->next = &iswr[current_swr];
     pre_wr = &iswr[current_swr];
     ++current_sge;
     ++current_swr;
-    ++current_buffer;
+    ++current_segment;
   }
 
   ibv_send_wr *bad_tx_work_request = nullptr;
   if (ibv_post_send(qp->get_qp(), iswr, &bad_tx_work_request)) {
+    int r = errno;
     ldout(cct, 1) << __func__ << " failed to send data"
                   << " (most probably should be peer not ready): "
-                  << cpp_strerror(errno) << dendl;
+                  << cpp_strerror(r) << dendl;
     worker->perf_logger->inc(l_msgr_rdma_tx_failed);
-    return -errno;
+    // registered buffers not posted will not see a completion
+    std::vector<Chunk*> credits;
+    for (auto wr = bad_tx_work_request; wr; wr = wr->next) {
+      if (wr->wr_id & REGISTERED_TX_WRID) {
+        auto tx = reinterpret_cast<Infiniband::RegisteredTx*>(
+          wr->wr_id & ~REGISTERED_TX_WRID);
+        credits.push_back(tx->credit);
+        delete tx;
+      }
+    }
+    dispatcher->post_tx_buffer(credits);
+    return -r;
   }
-  worker->perf_logger->inc(l_msgr_rdma_tx_chunks, tx_buffers.size());
+  worker->perf_logger->inc(l_msgr_rdma_tx_chunks, chunks);
   ldout(cct, 20) << __func__ << " qp state is " << get_qp_state() << dendl;
   return 0;
 }
@@ -535,6 +535,16 @@ void RDMADispatcher::handle_tx_event(ibv_wc *cqe, int n)
       }
     }
 
+    if (response->wr_id & REGISTERED_TX_WRID) {
+      // sent straight from a registered buffer, which we can let go now,
+      // and the tx chunk it was charged goes back to the pool
+      auto tx = reinterpret_cast<Infiniband::RegisteredTx*>(
+        response->wr_id & ~REGISTERED_TX_WRID);
+      tx_chunks.push_back(tx->credit);
+      delete tx;
+      continue;
+    }
+
     auto chunk = reinterpret_cast<Chunk *>(response->wr_id);
     //TX completion may come either from
     // 1) regular send message, WCE wr_id points to chunk
@@ -665,6 +675,7 @@ RDMAWorker::RDMAWorker(CephContext *c, unsigned worker_id)
 
   plb.add_u64_counter(l_msgr_rdma_tx_chunks, "tx_chunks", "The number of tx chunks transmitted");
   plb.add_u64_counter(l_msgr_rdma_tx_bytes, "tx_bytes", "The bytes of tx chunks transmitted", NULL, 0, unit_t(UNIT_BYTES));
+  plb.add_u64_counter(l_msgr_rdma_tx_registered_bytes, "tx_registered_bytes", "The bytes transmitted straight from registered buffers", NULL, 0, unit_t(UNIT_BYTES));
   plb.add_u64_counter(l_msgr_rdma_rx_chunks, "rx_chunks", "The number of rx chunks transmitted");
   plb.add_u64_counter(l_msgr_rdma_rx_bytes, "rx_bytes", "The bytes of rx chunks transmitted", NULL, 0, unit_t(UNIT_BYTES));
   plb.add_u64_counter(l_msgr_rdma_pending_sent_conns, "pending_sent_conns", "The count of pending sent conns");
@@ -794,6 +805,12 @@ RDMAStack::~RDMAStack()
   }
 }
 
+bufferptr RDMAStack::create_tx_buffer(unsigned len)
+{
+  ib->init();
+  return ib->create_registered_buffer(len);
+}
+
 void RDMAStack::spawn_worker(unsigned i, std::function<void ()> &&func)
 {
   threads.resize(i+1);
@@ -194,10 +194,18 @@ class RDMAConnectedSocketImpl : public ConnectedSocketImpl {
   bool pending;
   int post_backlog = 0;
 
+  /// one send work request: a tx chunk, or a piece of a registered buffer
+  struct tx_segment_t {
+    Chunk *chunk = nullptr;
+    bufferptr registered;
+    uint32_t lkey = 0;
+    Chunk *credit = nullptr;  ///< tx chunk charged for a registered send
+  };
+
   void notify();
   void buffer_prefetch(void);
   ssize_t read_buffers(char* buf, size_t len);
-  int post_work_request(std::vector<Chunk*>&);
+  int post_work_request(std::vector<tx_segment_t>&);
   size_t tx_copy_chunk(std::vector<Chunk*> &tx_buffers, size_t req_copy_len,
       decltype(std::cbegin(pending_bl.buffers()))& start,
       const decltype(std::cbegin(pending_bl.buffers()))& end);
@@ -341,6 +349,7 @@ class RDMAStack : public NetworkStack {
   virtual ~RDMAStack();
   virtual bool support_zero_copy_read() const override { return false; }
   virtual bool nonblock_connect_need_writable_event() const override { return false; }
+  virtual bufferptr create_tx_buffer(unsigned len) override;
 
   virtual void spawn_worker(unsigned i, std::function<void ()> &&func) override;
   virtual void join_worker(unsigned i) override;
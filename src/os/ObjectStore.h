@@ -541,6 +541,47 @@ public:
      return total;
    }
 
+  /// a byte range of an object to be digested by read_crc32c()
+  struct crc32c_read_t {
+    ghobject_t oid;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    uint32_t crc = -1;  ///< [in] initial value, [out] crc32c of the range
+    int r = 0;          ///< [out] bytes digested, or negative error code
+
+    crc32c_read_t(const ghobject_t& oid, uint64_t offset, uint64_t length)
+      : oid(oid), offset(offset), length(length) {}
+  };
+
+  /**
+   * read_crc32c -- compute the crc32c of byte ranges of several objects
+   *
+   * Equivalent to a read() of each range followed by a crc32c over the
+   * returned data, and the default version does exactly that.  A store
+   * keeping its own crc32c data checksums may instead issue the reads
+   * for all ranges at once and, after verifying its checksums, compose
+   * the result from them rather than hashing the data a second time.
+   *
+   * Note: as with read(), a range past the end of the object digests
+   * 0 bytes and leaves crc untouched.
+   *
+   * @param c collection for objects
+   * @param reqs ranges to be digested; results are returned in place
+   * @param op_flags is CEPH_OSD_OP_FLAG_*
+   */
+  virtual void read_crc32c(
+    CollectionHandle &c,
+    std::vector<crc32c_read_t>& reqs,
+    uint32_t op_flags = 0) {
+    for (auto& req : reqs) {
+      ceph::buffer::list bl;
+      req.r = read(c, req.oid, req.offset, req.length, bl, op_flags);
+      if (req.r > 0) {
+        req.crc = bl.crc32c(req.crc);
+      }
+    }
+  }
+
   /**
    * dump_onode -- dumps onode metadata in human readable form,
      intended primiarily for debugging
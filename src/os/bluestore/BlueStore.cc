@@ -4568,6 +4568,10 @@ void BlueStore::_init_logger()
     "Sum for compress ops rejected due to low net gain of space");
   b.add_u64_counter(l_bluestore_write_pad_bytes, "write_pad_bytes",
 		    "Sum for write-op padded bytes", NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_write_direct_aligned, "write_direct_aligned",
+		    "Direct writes submitted from the caller's buffers as they were");
+  b.add_u64_counter(l_bluestore_write_direct_realigned, "write_direct_realigned",
+		    "Direct writes whose buffers had to be copied to realign them");
   b.add_u64_counter(l_bluestore_deferred_write_ops, "deferred_write_ops",
 		    "Sum for deferred write op");
   b.add_u64_counter(l_bluestore_deferred_write_bytes, "deferred_write_bytes",
@@ -4650,6 +4654,13 @@ void BlueStore::_init_logger()
                     "Read EIO errors propagated to high level callers");
   b.add_u64_counter(l_bluestore_reads_with_retries, "bluestore_reads_with_retries",
                     "Read operations that required at least one retry due to failed checksum validation");
+  b.add_u64_counter(l_bluestore_read_crc32c_bytes, "bluestore_read_crc32c_bytes",
+                    "Bytes digested by read_crc32c",
+                    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_read_crc32c_composed_bytes,
+                    "bluestore_read_crc32c_composed_bytes",
+                    "Bytes digested by read_crc32c from blob checksums without rehashing",
+                    NULL, 0, unit_t(UNIT_BYTES));
   b.add_u64(l_bluestore_fragmentation, "bluestore_fragmentation_micros",
             "How fragmented bluestore free space is (free extents / max possible number of free extents) * 1000");
   b.add_time_avg(l_bluestore_omap_seek_to_first_lat, "omap_seek_to_first_lat",
@@ -9664,6 +9675,112 @@ int BlueStore::_generate_read_result_bl(
   return 0;
 }
 
+int BlueStore::_generate_read_result_crc32c(
+  OnodeRef o,
+  uint64_t offset,
+  size_t length,
+  ready_regions_t& ready_regions,
+  vector<bufferlist>& compressed_blob_bls,
+  blobs2read_t& blobs2read,
+  bool* csum_error,
+  uint32_t* crc)
+{
+  // logical offset -> (length, crc32c seeded with -1), for the regions
+  // whose digest is composed from verified blob checksums
+  map<uint64_t, pair<uint64_t, uint32_t>> composed;
+  uint64_t composed_bytes = 0;
+  auto p = compressed_blob_bls.begin();
+  for (auto& [bptr, r2r] : blobs2read) {
+    const bluestore_blob_t& blob = bptr->get_blob();
+    dout(20) << __func__ << "  blob " << *bptr << std::hex
+             << " need 0x" << r2r << std::dec << dendl;
+    if (blob.is_compressed()) {
+      // the checksums cover the compressed data; hash what we return
+      ceph_assert(p != compressed_blob_bls.end());
+      bufferlist& compressed_bl = *p++;
+      if (_verify_csum(o, &blob, 0, compressed_bl,
+                       r2r.front().regs.front().logical_offset) < 0) {
+        *csum_error = true;
+        return -EIO;
+      }
+      bufferlist raw_bl;
+      auto r = _decompress(compressed_bl, &raw_bl);
+      if (r < 0)
+        return r;
+      for (auto& req : r2r) {
+        for (auto& r : req.regs) {
+          ready_regions[r.logical_offset].substr_of(
+            raw_bl, r.blob_xoffset, r.length);
+        }
+      }
+      continue;
+    }
+    // only whole crc32c chunks can be composed, and only if we trust them
+    bool composable = blob.csum_type == Checksummer::CSUM_CRC32C &&
+      !cct->_conf->bluestore_ignore_data_csum;
+    uint64_t csum_chunk = composable ? blob.get_csum_chunk_size() : 0;
+    for (auto& req : r2r) {
+      if (_verify_csum(o, &blob, req.r_off, req.bl,
+                       req.regs.front().logical_offset) < 0) {
+        *csum_error = true;
+        return -EIO;
+      }
+      for (const auto& r : req.regs) {
+        if (!composable ||
+            r.blob_xoffset % csum_chunk ||
+            r.length % csum_chunk) {
+          ready_regions[r.logical_offset].substr_of(req.bl, r.front, r.length);
+          continue;
+        }
+        uint32_t c = -1;
+        for (uint64_t x = r.blob_xoffset; x < r.blob_xoffset + r.length;
+             x += csum_chunk) {
+          c = ceph_crc32c_extend(c, blob.get_csum_item(x / csum_chunk),
+                                 csum_chunk);
+        }
+        composed[r.logical_offset] = make_pair(r.length, c);
+        composed_bytes += r.length;
+      }
+    }
+  }
+
+  // fold everything, in logical order, into the caller's crc
+  auto pr = ready_regions.begin();
+  auto pc = composed.begin();
+  uint64_t pos = offset;
+  uint64_t end = offset + length;
+  while (pos < end) {
+    if (pr != ready_regions.end() && pr->first == pos) {
+      *crc = pr->second.crc32c(*crc);
+      pos += pr->second.length();
+      ++pr;
+    } else if (pc != composed.end() && pc->first == pos) {
+      *crc = ceph_crc32c_extend(*crc, pc->second.second, pc->second.first);
+      pos += pc->second.first;
+      ++pc;
+    } else {
+      uint64_t next = end;
+      if (pr != ready_regions.end()) {
+        next = std::min(next, pr->first);
+      }
+      if (pc != composed.end()) {
+        next = std::min(next, pc->first);
+      }
+      ceph_assert(next > pos);
+      dout(30) << __func__ << " zeros for 0x" << std::hex << pos << "~"
+               << (next - pos) << std::dec << dendl;
+      *crc = ceph_crc32c(*crc, nullptr, next - pos);
+      pos = next;
+    }
+  }
+  ceph_assert(pos == end);
+  ceph_assert(pr == ready_regions.end());
+  ceph_assert(pc == composed.end());
+  logger->inc(l_bluestore_read_crc32c_bytes, length);
+  logger->inc(l_bluestore_read_crc32c_composed_bytes, composed_bytes);
+  return length;
+}
+
 int BlueStore::_do_read(
   Collection *c,
   OnodeRef o,
@@ -10137,6 +10254,132 @@ int BlueStore::_do_readv(
   return bl.length();
 }
 
+void BlueStore::read_crc32c(
+  CollectionHandle &c_,
+  std::vector<crc32c_read_t>& reqs,
+  uint32_t op_flags)
+{
+  auto start = mono_clock::now();
+  Collection *c = static_cast<Collection *>(c_.get());
+  const coll_t &cid = c->get_cid();
+  dout(15) << __func__ << " " << cid << " " << reqs.size() << " ranges"
+           << dendl;
+  if (!c->exists) {
+    for (auto& req : reqs) {
+      req.r = -ENOENT;
+    }
+    return;
+  }
+
+  int read_cache_policy = 0;
+  if (op_flags & CEPH_OSD_OP_FLAG_BYPASS_CLEAN_CACHE) {
+    read_cache_policy = BufferSpace::BYPASS_CLEAN_CACHE;
+  }
+
+  struct pending_read_t {
+    OnodeRef o;
+    uint64_t length = 0;
+    ready_regions_t ready_regions;
+    vector<bufferlist> compressed_blob_bls;
+    blobs2read_t blobs2read;
+  };
+  vector<pending_read_t> pending(reqs.size());
+
+  std::shared_lock l(c->lock);
+
+  // issue the raw reads for all ranges at once
+  IOContext ioc(cct, NULL, true); // allow EIO
+  for (size_t i = 0; i < reqs.size(); ++i) {
+    auto& req = reqs[i];
+    auto& pr = pending[i];
+    OnodeRef o = c->get_onode(req.oid, false);
+    if (!o || !o->exists) {
+      req.r = -ENOENT;
+      continue;
+    }
+    if (req.offset >= o->onode.size) {
+      req.r = 0;
+      continue;
+    }
+    pr.length = std::min(req.length, o->onode.size - req.offset);
+    o->extent_map.fault_range(db, req.offset, pr.length);
+    _read_cache(o, req.offset, pr.length, read_cache_policy,
+                pr.ready_regions, pr.blobs2read);
+    int r = _prepare_read_ioc(pr.blobs2read, &pr.compressed_blob_bls, &ioc);
+    // we always issue aio for reading, so errors other than EIO are not allowed
+    if (r < 0) {
+      req.r = r;
+      continue;
+    }
+    pr.o = o;
+  }
+
+  bool eio = false;
+  auto num_ios = reqs.size();
+  if (ioc.has_pending_aios()) {
+    num_ios = ioc.get_num_ios();
+    bdev->aio_submit(&ioc);
+    dout(20) << __func__ << " waiting for aio" << dendl;
+    ioc.aio_wait();
+    int r = ioc.get_return_value();
+    if (r < 0) {
+      ceph_assert(r == -EIO); // no other errors allowed
+      eio = true;
+    }
+  }
+  log_latency_fn(__func__,
+    l_bluestore_read_wait_aio_lat,
+    mono_clock::now() - start,
+    cct->_conf->bluestore_log_op_age,
+    [&](auto lat) { return ", num_ios = " + stringify(num_ios); }
+  );
+
+  for (size_t i = 0; i < reqs.size(); ++i) {
+    auto& req = reqs[i];
+    auto& pr = pending[i];
+    if (!pr.o) {
+      continue;
+    }
+    int r = -EIO;
+    uint32_t crc = req.crc;
+    bool csum_error = false;
+    if (!eio) {
+      r = _generate_read_result_crc32c(pr.o, req.offset, pr.length,
+                                       pr.ready_regions,
+                                       pr.compressed_blob_bls,
+                                       pr.blobs2read,
+                                       &csum_error, &crc);
+    }
+    if (r < 0) {
+      // we can't tell which range the EIO belongs to, and csum errors may
+      // be spurious; let the regular read path sort it out and retry.
+      bufferlist bl;
+      r = _do_read(c, pr.o, req.offset, pr.length, bl, op_flags);
+      crc = bl.crc32c(req.crc);
+    }
+    if (r == -EIO) {
+      logger->inc(l_bluestore_read_eio);
+    }
+    if (r >= 0 && _debug_data_eio(req.oid)) {
+      r = -EIO;
+      derr << __func__ << " " << c->cid << " " << req.oid << " INJECT EIO"
+           << dendl;
+    }
+    req.r = r;
+    if (r >= 0) {
+      req.crc = crc;
+    }
+    dout(10) << __func__ << " " << cid << " " << req.oid
+             << " 0x" << std::hex << req.offset << "~" << req.length
+             << " crc 0x" << req.crc << std::dec
+             << " = " << req.r << dendl;
+  }
+  log_latency(__func__,
+    l_bluestore_read_lat,
+    mono_clock::now() - start,
+    cct->_conf->bluestore_log_op_age);
+}
+
 int BlueStore::dump_onode(CollectionHandle &c_,
   const ghobject_t& oid,
   const string& section_name,
@@ -12877,6 +13120,7 @@ void BlueStore::_do_write_small(
 	      b->get_blob().map_bl(
 		b_off, bl,
 		[&](uint64_t offset, bufferlist& t) {
+		  _note_write_alignment(t, wctx->buffered);
 		  bdev->aio_write(offset, t,
 				  &txc->ioc, wctx->buffered);
 		});
@@ -13475,6 +13719,7 @@ int BlueStore::_do_alloc_write(
 	b->get_blob().map_bl(
 	  b_off, *l,
 	  [&](uint64_t offset, bufferlist& t) {
+	    _note_write_alignment(t, false);
 	    bdev->aio_write(offset, t, &txc->ioc, false);
 	  });
 	logger->inc(l_bluestore_write_small_new);
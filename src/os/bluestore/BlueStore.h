@@ -94,6 +94,8 @@ enum {
   l_bluestore_compress_success_count,
   l_bluestore_compress_rejected_count,
   l_bluestore_write_pad_bytes,
+  l_bluestore_write_direct_aligned,
+  l_bluestore_write_direct_realigned,
   l_bluestore_deferred_write_ops,
   l_bluestore_deferred_write_bytes,
   l_bluestore_write_penalty_read_ops,
@@ -130,6 +132,8 @@ enum {
   l_bluestore_gc_merged,
   l_bluestore_read_eio,
   l_bluestore_reads_with_retries,
+  l_bluestore_read_crc32c_bytes,
+  l_bluestore_read_crc32c_composed_bytes,
   l_bluestore_fragmentation,
   l_bluestore_omap_seek_to_first_lat,
   l_bluestore_omap_upper_bound_lat,
@@ -2667,6 +2671,16 @@ private:
     bool* csum_error,
     bufferlist& bl);
 
+  int _generate_read_result_crc32c(
+    OnodeRef o,
+    uint64_t offset,
+    size_t length,
+    ready_regions_t& ready_regions,
+    vector<bufferlist>& compressed_blob_bls,
+    blobs2read_t& blobs2read,
+    bool* csum_error,
+    uint32_t* crc);
+
   int _do_read(
     Collection *c,
     OnodeRef o,
@@ -2699,6 +2713,11 @@ public:
     bufferlist& bl,
     uint32_t op_flags) override;
 
+  void read_crc32c(
+    CollectionHandle &c,
+    std::vector<crc32c_read_t>& reqs,
+    uint32_t op_flags = 0) override;
+
   int dump_onode(CollectionHandle &c, const ghobject_t& oid,
     const string& section_name, Formatter *f) override;
 
@@ -3043,6 +3062,17 @@ private:
     uint64_t offset, uint64_t length,
     bufferlist::iterator& blp,
     WriteContext *wctx);
+  /// count whether the device will copy a direct write to realign it
+  void _note_write_alignment(const bufferlist& bl, bool buffered) {
+    if (buffered) {
+      return;
+    }
+    if (bl.is_aligned_size_and_memory(block_size, block_size)) {
+      logger->inc(l_bluestore_write_direct_aligned);
+    } else {
+      logger->inc(l_bluestore_write_direct_realigned);
+    }
+  }
   int _do_alloc_write(
     TransContext *txc,
     CollectionRef c,
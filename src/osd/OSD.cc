@@ -148,6 +148,7 @@
 #include "perfglue/heap_profiler.h"
 
 #include "osd/OpRequest.h"
+#include "osd/scheduler/mClockScheduler.h"
 
 #include "auth/AuthAuthorizeHandler.h"
 #include "auth/RotatingKeyRing.h"
@@ -321,6 +322,22 @@ ceph::signedspan OSDService::get_mnow()
   return ceph::mono_clock::now() - osd->startup_time;
 }
 
+void OSDService::boot_pg_active(spg_t pgid)
+{
+  auto up = boot_up_stamp.load();
+  auto now = ceph::mono_clock::now();
+  if (up != ceph::mono_time()) {
+    logger->tinc(l_osd_boot_pg_active_lat, now - up);
+  }
+  unsigned left = --boot_pgs_pending;
+  logger->set(l_osd_boot_pgs_pending, left);
+  dout(20) << __func__ << " " << pgid << ", " << left << " left" << dendl;
+  if (left == 0) {
+    dout(0) << "all pgs loaded at startup have been active; last "
+	    << timespan_str(now - up) << " after we were marked up" << dendl;
+  }
+}
+
 void OSDService::identify_splits_and_merges(
   OSDMapRef old_map,
   OSDMapRef new_map,
@@ -1745,13 +1762,16 @@ void OSDService::queue_for_scrub(PG *pg, bool with_high_priority)
     scrub_queue_priority = cct->_conf->osd_client_op_priority;
   }
   const auto epoch = pg->get_osdmap_epoch();
+  const auto pgid = pg->get_pgid();
   enqueue_back(
     OpSchedulerItem(
-      unique_ptr<OpSchedulerItem::OpQueueable>(new PGScrub(pg->get_pgid(), epoch)),
+      unique_ptr<OpSchedulerItem::OpQueueable>(
+	new PGScrub(pgid, epoch, pg->scrubber.get_step_bytes(cct))),
       cct->_conf->osd_scrub_cost,
       scrub_queue_priority,
       ceph_clock_now(),
-      0,
+      // owned by the pg so that mclock budgets each pg separately
+      (uint64_t(pgid.pool()) << 32) | pgid.ps(),
       epoch));
 }
 
@@ -2349,9 +2369,92 @@ int OSD::set_numa_affinity()
   } else {
     dout(1) << __func__ << " not setting numa affinity" << dendl;
   }
+  set_numa_subsystem_affinity();
   return 0;
 }
 
+void OSD::set_numa_subsystem_affinity()
+{
+  // pin a subsystem's threads to node, or leave them with the osd if < 0
+  auto place = [this](const char *what, int node,
+		      const std::set<std::string>& thread_names) {
+    if (node < 0) {
+      return;
+    }
+    size_t cpu_set_size = 0;
+    cpu_set_t cpu_set;
+    int r = get_numa_node_cpu_set(node, &cpu_set_size, &cpu_set);
+    if (r < 0) {
+      derr << __func__ << " unable to determine numa node " << node
+	   << " CPUs for " << what << dendl;
+      return;
+    }
+    unsigned n = 0;
+    r = set_cpu_affinity_threads(thread_names, cpu_set_size, &cpu_set, &n);
+    if (r < 0) {
+      derr << __func__ << " failed to set " << what << " numa affinity: "
+	   << cpp_strerror(r) << dendl;
+      return;
+    }
+    dout(1) << __func__ << " " << what << ": " << n << " threads on numa node "
+	    << node << dendl;
+  };
+  place("messenger",
+	cct->_conf.get_val<int64_t>("osd_numa_node_messenger"),
+	{"msgr-worker-"});
+  place("objectstore",
+	cct->_conf.get_val<int64_t>("osd_numa_node_objectstore"),
+	{"bstore_", "rocksdb:"});
+
+  // op shard workers apply their placement themselves, since memory
+  // policy can only be set for the calling thread
+  auto placement = pick_numa_placement(
+    cct->_conf.get_val<int64_t>("osd_numa_node_op_shards"),
+    numa_node,
+    cct->_conf.get_val<bool>("osd_numa_prefer_local_memory"));
+  numa_node_op_shards = placement.node;
+  if (numa_node_op_shards < 0) {
+    return;
+  }
+  size_t cpu_set_size = 0;
+  cpu_set_t cpu_set;
+  int r = get_numa_node_cpu_set(numa_node_op_shards, &cpu_set_size, &cpu_set);
+  if (r < 0) {
+    derr << __func__ << " unable to determine numa node "
+	 << numa_node_op_shards << " CPUs for op shards" << dendl;
+    numa_node_op_shards = -1;
+    return;
+  }
+  bool prefer_local_memory = placement.prefer_local_memory;
+  dout(1) << __func__ << " op shards on numa node " << numa_node_op_shards
+	  << (prefer_local_memory ? " with local memory" : "") << dendl;
+  for (auto shard : shards) {
+    shard->set_numa_placement(numa_node_op_shards, cpu_set_size, &cpu_set,
+			      prefer_local_memory);
+  }
+  get_numa_node_stat(numa_node_op_shards, &numa_last_stat);
+}
+
+void OSD::update_numa_stats()
+{
+  if (numa_node_op_shards < 0) {
+    return;
+  }
+  numa_node_stat_t stat;
+  if (get_numa_node_stat(numa_node_op_shards, &stat) < 0) {
+    return;
+  }
+  if (stat.local_node >= numa_last_stat.local_node) {
+    logger->inc(l_osd_numa_local_pages,
+		stat.local_node - numa_last_stat.local_node);
+  }
+  if (stat.other_node >= numa_last_stat.other_node) {
+    logger->inc(l_osd_numa_other_pages,
+		stat.other_node - numa_last_stat.other_node);
+  }
+  numa_last_stat = stat;
+}
+
 // asok
 
 class OSDSocketHook : public AdminSocketHook {
@@ -2390,6 +2493,198 @@ std::set<int64_t> OSD::get_mapped_pools()
   return pools;
 }
 
+int OSD::run_osd_bench_test(
+  int64_t count,
+  int64_t bsize,
+  int64_t osize,
+  int64_t onum,
+  double *elapsed,
+  double *bandwidth,
+  double *iops,
+  ostream &ss)
+{
+  uint32_t duration = cct->_conf->osd_bench_duration;
+
+  if (bsize > (int64_t) cct->_conf->osd_bench_max_block_size) {
+    // let us limit the block size because the next checks rely on it
+    // having a sane value.  If we allow any block size to be set things
+    // can still go sideways.
+    ss << "block 'size' values are capped at "
+       << byte_u_t(cct->_conf->osd_bench_max_block_size) << ". If you wish to use"
+       << " a higher value, please adjust 'osd_bench_max_block_size'";
+    return -EINVAL;
+  } else if (bsize < (int64_t) (1 << 20)) {
+    // entering the realm of small block sizes.
+    // limit the count to a sane value, assuming a configurable amount of
+    // IOPS and duration, so that the OSD doesn't get hung up on this,
+    // preventing timeouts from going off
+    int64_t max_count =
+      bsize * duration * cct->_conf->osd_bench_small_size_max_iops;
+    if (count > max_count) {
+      ss << "'count' values greater than " << max_count
+	 << " for a block size of " << byte_u_t(bsize) << ", assuming "
+	 << cct->_conf->osd_bench_small_size_max_iops << " IOPS,"
+	 << " for " << duration << " seconds,"
+	 << " can cause ill effects on osd. "
+	 << " Please adjust 'osd_bench_small_size_max_iops' with a higher"
+	 << " value if you wish to use a higher 'count'.";
+      return -EINVAL;
+    }
+  } else {
+    // 1MB block sizes are big enough so that we get more stuff done.
+    // However, to avoid the osd from getting hung on this and having
+    // timers being triggered, we are going to limit the count assuming
+    // a configurable throughput and duration.
+    // NOTE: max_count is the total amount of bytes that we believe we
+    //       will be able to write during 'duration' for the given
+    //       throughput.  The block size hardly impacts this unless it's
+    //       way too big.  Given we already check how big the block size
+    //       is, it's safe to assume everything will check out.
+    int64_t max_count =
+      cct->_conf->osd_bench_large_size_max_throughput * duration;
+    if (count > max_count) {
+      ss << "'count' values greater than " << max_count
+	 << " for a block size of " << byte_u_t(bsize) << ", assuming "
+	 << byte_u_t(cct->_conf->osd_bench_large_size_max_throughput) << "/s,"
+	 << " for " << duration << " seconds,"
+	 << " can cause ill effects on osd. "
+	 << " Please adjust 'osd_bench_large_size_max_throughput'"
+	 << " with a higher value if you wish to use a higher 'count'.";
+      return -EINVAL;
+    }
+  }
+
+  if (osize && bsize > osize)
+    bsize = osize;
+
+  dout(1) << " bench count " << count
+	  << " bsize " << byte_u_t(bsize) << dendl;
+
+  ObjectStore::Transaction cleanupt;
+
+  if (osize && onum) {
+    bufferlist bl;
+    bufferptr bp(osize);
+    bp.zero();
+    bl.push_back(std::move(bp));
+    bl.rebuild_page_aligned();
+    for (int i=0; i<onum; ++i) {
+      char nm[30];
+      snprintf(nm, sizeof(nm), "disk_bw_test_%d", i);
+      object_t oid(nm);
+      hobject_t soid(sobject_t(oid, 0));
+      ObjectStore::Transaction t;
+      t.write(coll_t::meta(), ghobject_t(soid), 0, osize, bl);
+      store->queue_transaction(service.meta_ch, std::move(t), NULL);
+      cleanupt.remove(coll_t::meta(), ghobject_t(soid));
+    }
+  }
+
+  bufferlist bl;
+  bufferptr bp(bsize);
+  bp.zero();
+  bl.push_back(std::move(bp));
+  bl.rebuild_page_aligned();
+
+  {
+    C_SaferCond waiter;
+    if (!service.meta_ch->flush_commit(&waiter)) {
+      waiter.wait();
+    }
+  }
+
+  utime_t start = ceph_clock_now();
+  for (int64_t pos = 0; pos < count; pos += bsize) {
+    char nm[30];
+    unsigned offset = 0;
+    if (onum && osize) {
+      snprintf(nm, sizeof(nm), "disk_bw_test_%d", (int)(rand() % onum));
+      offset = rand() % (osize / bsize) * bsize;
+    } else {
+      snprintf(nm, sizeof(nm), "disk_bw_test_%lld", (long long)pos);
+    }
+    object_t oid(nm);
+    hobject_t soid(sobject_t(oid, 0));
+    ObjectStore::Transaction t;
+    t.write(coll_t::meta(), ghobject_t(soid), offset, bsize, bl);
+    store->queue_transaction(service.meta_ch, std::move(t), NULL);
+    if (!onum || !osize)
+      cleanupt.remove(coll_t::meta(), ghobject_t(soid));
+  }
+
+  {
+    C_SaferCond waiter;
+    if (!service.meta_ch->flush_commit(&waiter)) {
+      waiter.wait();
+    }
+  }
+  utime_t end = ceph_clock_now();
+
+  // clean up
+  store->queue_transaction(service.meta_ch, std::move(cleanupt), NULL);
+  {
+    C_SaferCond waiter;
+    if (!service.meta_ch->flush_commit(&waiter)) {
+      waiter.wait();
+    }
+  }
+
+  *elapsed = end - start;
+  *bandwidth = count / *elapsed;
+  *iops = *bandwidth / bsize;
+  return 0;
+}
+
+void OSD::calibrate_mclock_cost_model()
+{
+  if (cct->_conf->osd_op_queue != "mclock_scheduler" ||
+      !cct->_conf.get_val<bool>("osd_mclock_cost_calibrate_on_start")) {
+    return;
+  }
+  double elapsed = 0.0;
+  double bandwidth = 0.0;
+  double iops = 0.0;
+  stringstream ss;
+  if (cct->_conf.get_val<double>("osd_mclock_max_capacity_iops") <= 0) {
+    // 4k random writes over a small set of preallocated objects, as many
+    // as the bench limits allow for this block size
+    int64_t bsize = 4096;
+    int64_t count = bsize * cct->_conf->osd_bench_small_size_max_iops *
+      cct->_conf->osd_bench_duration;
+    int r = run_osd_bench_test(count, bsize, 4 << 20, 16,
+			       &elapsed, &bandwidth, &iops, ss);
+    if (r < 0) {
+      derr << __func__ << " iops bench failed: " << ss.str() << dendl;
+    } else {
+      mclock_measured_iops = iops;
+      dout(1) << __func__ << " measured " << iops << " iops in "
+	      << elapsed << "s" << dendl;
+      cct->_conf.set_val("osd_mclock_max_capacity_iops", stringify(iops));
+    }
+  }
+  if (cct->_conf.get_val<Option::size_t>(
+	"osd_mclock_max_capacity_bandwidth") == 0) {
+    // 4m sequential writes to new objects
+    int64_t bsize = 4 << 20;
+    int64_t count = std::min<int64_t>(
+      100 << 20,
+      cct->_conf->osd_bench_large_size_max_throughput *
+      cct->_conf->osd_bench_duration);
+    int r = run_osd_bench_test(count, bsize, 0, 0,
+			       &elapsed, &bandwidth, &iops, ss);
+    if (r < 0) {
+      derr << __func__ << " bandwidth bench failed: " << ss.str() << dendl;
+    } else {
+      mclock_measured_bandwidth = bandwidth;
+      dout(1) << __func__ << " measured " << byte_u_t(bandwidth) << "/s in "
+	      << elapsed << "s" << dendl;
+      cct->_conf.set_val("osd_mclock_max_capacity_bandwidth",
+			 stringify(uint64_t(bandwidth)));
+    }
+  }
+  cct->_conf.apply_changes(nullptr);
+}
+
 void OSD::asok_command(
   std::string_view prefix, const cmdmap_t& cmdmap,
   Formatter *f,
@@ -2523,6 +2818,15 @@ will start to track new ops received afterwards.";
     f->open_object_section("pq");
     op_shardedwq.dump(f);
     f->close_section();
+  } else if (prefix == "dump_mclock_cost_model") {
+    mclock_cost_model_t model;
+    model.update_from_config(cct->_conf);
+    f->open_object_section("mclock_cost_model");
+    f->dump_string("op_queue", cct->_conf->osd_op_queue);
+    f->dump_float("measured_iops", mclock_measured_iops);
+    f->dump_float("measured_bandwidth", mclock_measured_bandwidth);
+    model.dump(f);
+    f->close_section();
   } else if (prefix == "dump_blacklist") {
     list<pair<entity_addr_t,utime_t> > bl;
     OSDMapRef curmap = service.get_osdmap();
@@ -2734,143 +3038,22 @@ will start to track new ops received afterwards.";
     cmd_getval(cct, cmdmap, "object_size", osize, (int64_t)0);
     cmd_getval(cct, cmdmap, "object_num", onum, (int64_t)0);
 
-    uint32_t duration = cct->_conf->osd_bench_duration;
-
-    if (bsize > (int64_t) cct->_conf->osd_bench_max_block_size) {
-      // let us limit the block size because the next checks rely on it
-      // having a sane value.  If we allow any block size to be set things
-      // can still go sideways.
-      ss << "block 'size' values are capped at "
-         << byte_u_t(cct->_conf->osd_bench_max_block_size) << ". If you wish to use"
-         << " a higher value, please adjust 'osd_bench_max_block_size'";
-      ret = -EINVAL;
+    double elapsed = 0.0;
+    double bandwidth = 0.0;
+    double iops = 0.0;
+    ret = run_osd_bench_test(count, bsize, osize, onum,
+			     &elapsed, &bandwidth, &iops, ss);
+    if (ret < 0) {
       goto out;
-    } else if (bsize < (int64_t) (1 << 20)) {
-      // entering the realm of small block sizes.
-      // limit the count to a sane value, assuming a configurable amount of
-      // IOPS and duration, so that the OSD doesn't get hung up on this,
-      // preventing timeouts from going off
-      int64_t max_count =
-        bsize * duration * cct->_conf->osd_bench_small_size_max_iops;
-      if (count > max_count) {
-        ss << "'count' values greater than " << max_count
-           << " for a block size of " << byte_u_t(bsize) << ", assuming "
-           << cct->_conf->osd_bench_small_size_max_iops << " IOPS,"
-           << " for " << duration << " seconds,"
-           << " can cause ill effects on osd. "
-           << " Please adjust 'osd_bench_small_size_max_iops' with a higher"
-           << " value if you wish to use a higher 'count'.";
-        ret = -EINVAL;
-        goto out;
-      }
-    } else {
-      // 1MB block sizes are big enough so that we get more stuff done.
-      // However, to avoid the osd from getting hung on this and having
-      // timers being triggered, we are going to limit the count assuming
-      // a configurable throughput and duration.
-      // NOTE: max_count is the total amount of bytes that we believe we
-      //       will be able to write during 'duration' for the given
-      //       throughput.  The block size hardly impacts this unless it's
-      //       way too big.  Given we already check how big the block size
-      //       is, it's safe to assume everything will check out.
-      int64_t max_count =
-        cct->_conf->osd_bench_large_size_max_throughput * duration;
-      if (count > max_count) {
-        ss << "'count' values greater than " << max_count
-           << " for a block size of " << byte_u_t(bsize) << ", assuming "
-           << byte_u_t(cct->_conf->osd_bench_large_size_max_throughput) << "/s,"
-           << " for " << duration << " seconds,"
-           << " can cause ill effects on osd. "
-           << " Please adjust 'osd_bench_large_size_max_throughput'"
-           << " with a higher value if you wish to use a higher 'count'.";
-        ret = -EINVAL;
-        goto out;
-      }
     }
-
     if (osize && bsize > osize)
       bsize = osize;
 
-    dout(1) << " bench count " << count
-            << " bsize " << byte_u_t(bsize) << dendl;
-
-    ObjectStore::Transaction cleanupt;
-
-    if (osize && onum) {
-      bufferlist bl;
-      bufferptr bp(osize);
-      bp.zero();
-      bl.push_back(std::move(bp));
-      bl.rebuild_page_aligned();
-      for (int i=0; i<onum; ++i) {
-	char nm[30];
-	snprintf(nm, sizeof(nm), "disk_bw_test_%d", i);
-	object_t oid(nm);
-	hobject_t soid(sobject_t(oid, 0));
-	ObjectStore::Transaction t;
-	t.write(coll_t(), ghobject_t(soid), 0, osize, bl);
-	store->queue_transaction(service.meta_ch, std::move(t), NULL);
-	cleanupt.remove(coll_t(), ghobject_t(soid));
-      }
-    }
-
-    bufferlist bl;
-    bufferptr bp(bsize);
-    bp.zero();
-    bl.push_back(std::move(bp));
-    bl.rebuild_page_aligned();
-
-    {
-      C_SaferCond waiter;
-      if (!service.meta_ch->flush_commit(&waiter)) {
-	waiter.wait();
-      }
-    }
-
-    utime_t start = ceph_clock_now();
-    for (int64_t pos = 0; pos < count; pos += bsize) {
-      char nm[30];
-      unsigned offset = 0;
-      if (onum && osize) {
-	snprintf(nm, sizeof(nm), "disk_bw_test_%d", (int)(rand() % onum));
-	offset = rand() % (osize / bsize) * bsize;
-      } else {
-	snprintf(nm, sizeof(nm), "disk_bw_test_%lld", (long long)pos);
-      }
-      object_t oid(nm);
-      hobject_t soid(sobject_t(oid, 0));
-      ObjectStore::Transaction t;
-      t.write(coll_t::meta(), ghobject_t(soid), offset, bsize, bl);
-      store->queue_transaction(service.meta_ch, std::move(t), NULL);
-      if (!onum || !osize)
-	cleanupt.remove(coll_t::meta(), ghobject_t(soid));
-    }
-
-    {
-      C_SaferCond waiter;
-      if (!service.meta_ch->flush_commit(&waiter)) {
-	waiter.wait();
-      }
-    }
-    utime_t end = ceph_clock_now();
-
-    // clean up
-    store->queue_transaction(service.meta_ch, std::move(cleanupt), NULL);
-    {
-      C_SaferCond waiter;
-      if (!service.meta_ch->flush_commit(&waiter)) {
-	waiter.wait();
-      }
-    }
-
-    double elapsed = end - start;
-    double rate = count / elapsed;
-    double iops = rate / bsize;
     f->open_object_section("osd_bench_results");
     f->dump_int("bytes_written", count);
     f->dump_int("blocksize", bsize);
     f->dump_float("elapsed_sec", elapsed);
-    f->dump_float("bytes_per_sec", rate);
+    f->dump_float("bytes_per_sec", bandwidth);
     f->dump_float("iops", iops);
     f->close_section();
   }
@@ -3488,13 +3671,13 @@ int OSD::init()
     shard->shard_osdmap = osdmap;
   }
 
+  create_logger();
+
   // load up pgs (as they previously existed)
   load_pgs();
 
   dout(2) << "superblock: I am osd." << superblock.whoami << dendl;
 
-  create_logger();
-
   // prime osd stats
   {
     struct store_statfs_t stbuf;
@@ -3606,6 +3789,10 @@ int OSD::init()
 
   osd_lock.unlock();
 
+  // the bench only touches the store; run it without osd_lock so that
+  // applying the measured capacities can notify our config observer
+  calibrate_mclock_cost_model();
+
   r = monc->authenticate();
   if (r < 0) {
     derr << __func__ << " authentication failed: " << cpp_strerror(r)
@@ -3719,6 +3906,11 @@ void OSD::final_init()
 				     asok_hook,
 				     "dump op priority queue state");
   ceph_assert(r == 0);
+  r = admin_socket->register_command("dump_mclock_cost_model",
+				     asok_hook,
+				     "dump device capacity and op costs used by "
+				     "the mclock scheduler");
+  ceph_assert(r == 0);
   r = admin_socket->register_command("dump_blacklist",
 				     asok_hook,
 				     "dump blacklisted clients and times");
@@ -4645,6 +4837,7 @@ void OSD::load_pgs()
 {
   ceph_assert(ceph_mutex_is_locked(osd_lock));
   dout(0) << "load_pgs" << dendl;
+  auto start = ceph::mono_clock::now();
 
   {
     auto pghist = make_pg_num_history_oid();
@@ -4663,90 +4856,134 @@ void OSD::load_pgs()
     derr << "failed to list pgs: " << cpp_strerror(-r) << dendl;
   }
 
-  int num = 0;
-  for (vector<coll_t>::iterator it = ls.begin();
-       it != ls.end();
-       ++it) {
+  // reading each pg's info, log and missing set dominates startup on an
+  // osd with many pgs, so do that in parallel.  collection removal and
+  // pg registration are done in order afterwards.
+  struct loaded_pg_t {
     spg_t pgid;
-    if (it->is_temp(&pgid) ||
-       (it->is_pg(&pgid) && PG::_has_removal_flag(store, pgid))) {
-      dout(10) << "load_pgs " << *it
-	       << " removing, legacy or flagged for removal pg" << dendl;
-      recursive_remove_collection(cct, store, pgid, *it);
-      continue;
+    PGRef pg;
+    bool remove = false;
+  };
+  vector<loaded_pg_t> loaded(ls.size());
+  std::atomic<size_t> next = {0};
+  auto load = [&]() {
+    for (size_t i = next++; i < ls.size(); i = next++) {
+      auto& l = loaded[i];
+      l.pg = _load_pg(ls[i], &l.pgid, &l.remove);
     }
+  };
+  size_t num_threads = std::min<size_t>(
+    cct->_conf.get_val<uint64_t>("osd_load_pgs_threads"), ls.size());
+  vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; ++i) {
+    threads.push_back(make_named_thread("load_pgs", load));
+  }
+  load();
+  for (auto& t : threads) {
+    t.join();
+  }
 
-    if (!it->is_pg(&pgid)) {
-      dout(10) << "load_pgs ignoring unrecognized " << *it << dendl;
+  int num = 0;
+  for (size_t i = 0; i < ls.size(); ++i) {
+    auto& l = loaded[i];
+    if (l.remove) {
+      recursive_remove_collection(cct, store, l.pgid, ls[i]);
       continue;
     }
-
-    dout(10) << "pgid " << pgid << " coll " << coll_t(pgid) << dendl;
-    epoch_t map_epoch = 0;
-    int r = PG::peek_map_epoch(store, pgid, &map_epoch);
-    if (r < 0) {
-      derr << __func__ << " unable to peek at " << pgid << " metadata, skipping"
-	   << dendl;
+    if (!l.pg) {
       continue;
     }
+    l.pg->boot_pending_active = true;
+    register_pg(l.pg);
+    ++num;
+  }
+  service.boot_pgs_pending = num;
+  logger->set(l_osd_boot_pgs_pending, num);
 
-    PGRef pg;
-    if (map_epoch > 0) {
-      OSDMapRef pgosdmap = service.try_get_map(map_epoch);
-      if (!pgosdmap) {
-	if (!osdmap->have_pg_pool(pgid.pool())) {
-	  derr << __func__ << ": could not find map for epoch " << map_epoch
-	       << " on pg " << pgid << ", but the pool is not present in the "
-	       << "current map, so this is probably a result of bug 10617.  "
-	       << "Skipping the pg for now, you can use ceph-objectstore-tool "
-	       << "to clean it up later." << dendl;
-	  continue;
-	} else {
-	  derr << __func__ << ": have pgid " << pgid << " at epoch "
-	       << map_epoch << ", but missing map.  Crashing."
-	       << dendl;
-	  ceph_abort_msg("Missing map in load_pgs");
-	}
-      }
-      pg = _make_pg(pgosdmap, pgid);
-    } else {
-      pg = _make_pg(osdmap, pgid);
-    }
-    if (!pg) {
-      recursive_remove_collection(cct, store, pgid, *it);
-      continue;
-    }
+  load_pgs_done = ceph::mono_clock::now();
+  logger->tinc(l_osd_boot_load_pgs_lat, load_pgs_done - start);
+  dout(0) << __func__ << " opened " << num << " pgs in "
+	  << timespan_str(load_pgs_done - start) << " with " << num_threads
+	  << " threads" << dendl;
+}
 
-    // there can be no waiters here, so we don't call _wake_pg_slot
+PGRef OSD::_load_pg(const coll_t& coll, spg_t *pgid, bool *remove)
+{
+  if (coll.is_temp(pgid) ||
+      (coll.is_pg(pgid) && PG::_has_removal_flag(store, *pgid))) {
+    dout(10) << "load_pgs " << coll
+	     << " removing, legacy or flagged for removal pg" << dendl;
+    *remove = true;
+    return nullptr;
+  }
 
-    pg->lock();
-    pg->ch = store->open_collection(pg->coll);
+  if (!coll.is_pg(pgid)) {
+    dout(10) << "load_pgs ignoring unrecognized " << coll << dendl;
+    return nullptr;
+  }
 
-    // read pg state, log
-    pg->read_state(store);
+  dout(10) << "pgid " << *pgid << " coll " << coll_t(*pgid) << dendl;
+  epoch_t map_epoch = 0;
+  int r = PG::peek_map_epoch(store, *pgid, &map_epoch);
+  if (r < 0) {
+    derr << __func__ << " unable to peek at " << *pgid << " metadata, skipping"
+	 << dendl;
+    return nullptr;
+  }
 
-    if (pg->dne())  {
-      dout(10) << "load_pgs " << *it << " deleting dne" << dendl;
-      pg->ch = nullptr;
-      pg->unlock();
-      recursive_remove_collection(cct, store, pgid, *it);
-      continue;
-    }
-    {
-      uint32_t shard_index = pgid.hash_to_shard(shards.size());
-      assert(NULL != shards[shard_index]);
-      store->set_collection_commit_queue(pg->coll, &(shards[shard_index]->context_queue));
+  PGRef pg;
+  if (map_epoch > 0) {
+    OSDMapRef pgosdmap = service.try_get_map(map_epoch);
+    if (!pgosdmap) {
+      if (!osdmap->have_pg_pool(pgid->pool())) {
+	derr << __func__ << ": could not find map for epoch " << map_epoch
+	     << " on pg " << *pgid << ", but the pool is not present in the "
+	     << "current map, so this is probably a result of bug 10617.  "
+	     << "Skipping the pg for now, you can use ceph-objectstore-tool "
+	     << "to clean it up later." << dendl;
+	return nullptr;
+      } else {
+	derr << __func__ << ": have pgid " << *pgid << " at epoch "
+	     << map_epoch << ", but missing map.  Crashing."
+	     << dendl;
+	ceph_abort_msg("Missing map in load_pgs");
+      }
     }
+    pg = _make_pg(pgosdmap, *pgid);
+  } else {
+    pg = _make_pg(osdmap, *pgid);
+  }
+  if (!pg) {
+    *remove = true;
+    return nullptr;
+  }
 
-    pg->reg_next_scrub();
+  // there can be no waiters here, so we don't call _wake_pg_slot
 
-    dout(10) << __func__ << " loaded " << *pg << dendl;
-    pg->unlock();
+  pg->lock();
+  pg->ch = store->open_collection(pg->coll);
 
-    register_pg(pg);
-    ++num;
+  // read pg state, log
+  pg->read_state(store);
+
+  if (pg->dne())  {
+    dout(10) << "load_pgs " << coll << " deleting dne" << dendl;
+    pg->ch = nullptr;
+    pg->unlock();
+    *remove = true;
+    return nullptr;
+  }
+  {
+    uint32_t shard_index = pgid->hash_to_shard(shards.size());
+    assert(NULL != shards[shard_index]);
+    store->set_collection_commit_queue(pg->coll, &(shards[shard_index]->context_queue));
   }
-  dout(0) << __func__ << " opened " << num << " pgs" << dendl;
+
+  pg->reg_next_scrub();
+
+  dout(10) << __func__ << " loaded " << *pg << dendl;
+  pg->unlock();
+  return pg;
 }
 
 
@@ -5848,6 +6085,7 @@ void OSD::tick_without_osd_lock()
   logger->set(l_osd_cached_crc, buffer::get_cached_crc());
   logger->set(l_osd_cached_crc_adjusted, buffer::get_cached_crc_adjusted());
   logger->set(l_osd_missed_crc, buffer::get_missed_crc());
+  update_numa_stats();
 
   // refresh osd stats
   struct store_statfs_t stbuf;
@@ -5893,6 +6131,7 @@ void OSD::tick_without_osd_lock()
       sched_scrub();
     }
     service.promote_throttle_recalibrate();
+    service.recovery_recalibrate();
     resume_creating_pg();
     bool need_send_beacon = false;
     const auto now = ceph::coarse_mono_clock::now();
@@ -6570,6 +6809,9 @@ void OSD::_collect_metadata(map<string,string> *pm)
     (*pm)["numa_node_cpus"] = cpu_set_to_str_list(numa_cpu_set_size,
 						  &numa_cpu_set);
   }
+  if (numa_node_op_shards >= 0) {
+    (*pm)["numa_node_op_shards"] = stringify(numa_node_op_shards);
+  }
 
   set<string> devnames;
   store->get_devices(&devnames);
@@ -8142,6 +8384,14 @@ void OSD::_committed_osd_maps(epoch_t first, epoch_t last, MOSDMap *m)
       dout(1) << "state: booting -> active" << dendl;
       set_state(STATE_ACTIVE);
       do_restart = false;
+      if (service.boot_up_stamp.load() == ceph::mono_time()) {
+	auto now = ceph::mono_clock::now();
+	service.boot_up_stamp = now;
+	logger->tinc(l_osd_boot_up_lat, now - load_pgs_done);
+	dout(0) << "marked up " << timespan_str(now - load_pgs_done)
+		<< " after loading pgs, " << service.boot_pgs_pending
+		<< " of them not yet active" << dendl;
+      }
 
       // set incarnation so that osd_reqid_t's we generate for our
       // objecter requests are unique across restarts.
@@ -9066,7 +9316,11 @@ void OSD::dispatch_context(PeeringCtx &ctx, PG *pg, OSDMapRef curmap,
       }
       service.maybe_share_map(con.get(), curmap);
       for (auto m : ls) {
-	con->send_message2(m);
+	if (pg && pg->osd_shard) {
+	  pg->osd_shard->peering_outbox.send(osd, con, std::move(m), logger);
+	} else {
+	  con->send_message2(m);
+	}
       }
       ls.clear();
     }
@@ -9363,7 +9617,7 @@ void OSDService::_maybe_queue_recovery() {
 	 _recover_now(&available_pushes)) {
     uint64_t to_start = std::min(
       available_pushes,
-      cct->_conf->osd_recovery_max_single_start);
+      cct->_conf->osd_recovery_max_single_start * recovery_batch);
     _queue_for_recovery(awaiting_throttle.front(), to_start);
     awaiting_throttle.pop_front();
     dout(10) << __func__ << " starting " << to_start
@@ -9388,11 +9642,12 @@ bool OSDService::_recover_now(uint64_t *available_pushes)
     return false;
   }
 
-  uint64_t max = osd->get_recovery_max_active();
+  uint64_t max = osd->get_recovery_max_active() * recovery_batch;
   if (max <= recovery_ops_active + recovery_ops_reserved) {
     dout(15) << __func__ << " active " << recovery_ops_active
 	     << " + reserved " << recovery_ops_reserved
 	     << " >= max " << max << dendl;
+    recovery_op_limited = true;
     return false;
   }
 
@@ -9506,6 +9761,7 @@ void OSDService::finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue)
   // adjust count
   ceph_assert(recovery_ops_active > 0);
   recovery_ops_active--;
+  osd->logger->inc(l_osd_robjects);
 
 #ifdef DEBUG_RECOVERY_OIDS
   dout(20) << "  active oids was " << recovery_oids[pg->pg_id] << dendl;
@@ -9516,6 +9772,77 @@ void OSDService::finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue)
   _maybe_queue_recovery();
 }
 
+void OSDService::recovery_recalibrate()
+{
+  utime_t now = ceph_clock_now();
+  double dur = now - last_recovery_recalibrate;
+  last_recovery_recalibrate = now;
+  uint64_t bytes = logger->get(l_osd_rbytes);
+  uint64_t objects = logger->get(l_osd_robjects);
+  uint64_t dbytes = bytes - last_recovery_bytes;
+  uint64_t dobjects = objects - last_recovery_objects;
+  last_recovery_bytes = bytes;
+  last_recovery_objects = objects;
+  if (dur <= 0) {
+    return;
+  }
+  uint64_t bytes_sec = dbytes / dur;
+  logger->set(l_osd_rbytes_sec, bytes_sec);
+  logger->set(l_osd_robjects_sec, dobjects / dur);
+
+  std::lock_guard l(recovery_lock);
+  bool op_limited = recovery_op_limited;
+  recovery_op_limited = false;
+  double defer = 0;
+  unsigned batch = calc_recovery_batch(cct, recovery_batch, op_limited,
+				       dbytes, dobjects, dur, &defer);
+  if (defer > 0) {
+    // make up for the excess before starting anything else
+    defer_recovery(std::min(defer, osd->OSD_TICK_INTERVAL));
+  }
+  dout(10) << __func__ << " " << dobjects << " objects, " << byte_u_t(dbytes)
+	   << " in " << dur << "s" << (op_limited ? " (op limited)" : "")
+	   << ", batch " << recovery_batch << " -> " << batch << dendl;
+  recovery_batch = batch;
+  logger->set(l_osd_recovery_batch, batch);
+}
+
+unsigned OSDService::calc_recovery_batch(
+  CephContext *cct,
+  unsigned batch,
+  bool op_limited,
+  uint64_t dbytes,
+  uint64_t dobjects,
+  double dur,
+  double *defer)
+{
+  unsigned max_batch = cct->_conf.get_val<uint64_t>("osd_recovery_max_batch");
+  uint64_t bytes_sec = dbytes / dur;
+  uint64_t target_bytes_sec =
+    cct->_conf.get_val<Option::size_t>("osd_recovery_max_bytes_per_sec");
+  // what a full push message of this batch would cost
+  uint64_t avg_cost = dobjects ?
+    dbytes / dobjects + cct->_conf->osd_push_per_object_cost : 0;
+  uint64_t push_objects = cct->_conf->osd_max_push_objects;
+  *defer = 0;
+  if (target_bytes_sec && bytes_sec > target_bytes_sec) {
+    if (batch > 1) {
+      batch /= 2;
+    } else {
+      *defer = (double)(dbytes - target_bytes_sec * dur) / target_bytes_sec;
+    }
+  } else if (dobjects && op_limited &&
+	     avg_cost * push_objects * (batch + 1) <=
+	     cct->_conf->osd_max_push_cost) {
+    // limited by op count, not bytes: let each op cover more small objects
+    ++batch;
+  } else if (dobjects &&
+	     avg_cost * push_objects * batch > cct->_conf->osd_max_push_cost) {
+    --batch;
+  }
+  return std::clamp(batch, 1u, std::max(max_batch, 1u));
+}
+
 bool OSDService::is_recovery_active()
 {
   if (cct->_conf->osd_debug_pretend_recovery_active) {
@@ -10330,6 +10657,59 @@ void OSDShard::unprime_split_children(spg_t parent, unsigned old_pg_num)
   }
 }
 
+void OSDShard::_drain_inbox()
+{
+  ceph_assert(ceph_mutex_is_locked_by_me(shard_lock));
+  inbox.drain([this](OpSchedulerItem&& item) {
+    scheduler->enqueue(std::move(item));
+  });
+}
+
+void OSDShard::set_numa_placement(
+  int node,
+  size_t cpu_set_size,
+  const cpu_set_t *cpu_set,
+  bool prefer_local_memory)
+{
+  std::lock_guard l(shard_lock);
+  numa_node = node;
+  numa_cpu_set_size = cpu_set_size;
+  numa_cpu_set = *cpu_set;
+  numa_prefer_local_memory = prefer_local_memory;
+  ++numa_gen;
+}
+
+void OSDShard::_apply_numa_placement()
+{
+  ceph_assert(ceph_mutex_is_locked_by_me(shard_lock));
+  if (numa_node < 0) {
+    return;
+  }
+  // affinity and memory policy set here apply to the calling thread only
+  if (sched_setaffinity(0, numa_cpu_set_size, &numa_cpu_set) < 0) {
+    int r = -errno;
+    derr << "failed to set affinity to numa node " << numa_node << ": "
+	 << cpp_strerror(r) << dendl;
+  }
+  if (numa_prefer_local_memory) {
+    int r = set_numa_memory_preferred(numa_node);
+    if (r < 0) {
+      derr << "failed to prefer memory on numa node " << numa_node << ": "
+	   << cpp_strerror(r) << dendl;
+    }
+  }
+}
+
+bool OSDShard::_is_numa_remote() const
+{
+  if (numa_node < 0) {
+    return false;
+  }
+  int cpu = sched_getcpu();
+  return cpu >= 0 && (size_t)cpu < numa_cpu_set_size &&
+    !CPU_ISSET(cpu, &numa_cpu_set);
+}
+
 OSDShard::OSDShard(
   int id,
   CephContext *cct,
@@ -10344,8 +10724,9 @@ OSDShard::OSDShard(
     osdmap_lock{make_mutex(osdmap_lock_name)},
     shard_lock_name(shard_name + "::shard_lock"),
     shard_lock{make_mutex(shard_lock_name)},
-    scheduler(ceph::osd::scheduler::make_scheduler(cct)),
-    context_queue(sdata_wait_lock, sdata_cond)
+    scheduler(ceph::osd::scheduler::make_scheduler(cct, id)),
+    context_queue(sdata_wait_lock, sdata_cond),
+    peering_outbox(cct, shard_name)
 {
   dout(0) << "using op scheduler " << *scheduler << dendl;
 }
@@ -10395,19 +10776,36 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 
   // peek at spg_t
   sdata->shard_lock.lock();
+  static thread_local unsigned numa_gen_seen = 0;
+  if (sdata->numa_gen != numa_gen_seen) {
+    numa_gen_seen = sdata->numa_gen;
+    sdata->_apply_numa_placement();
+  }
+  sdata->_drain_inbox();
+  if (sdata->scheduler->empty()) {
+    // nothing else to do for now; send what peering has batched up
+    sdata->peering_outbox.maybe_flush(true, osd->logger);
+  }
   if (sdata->scheduler->empty() &&
       (!is_smallest_thread_index || sdata->context_queue.empty())) {
     std::unique_lock wait_lock{sdata->sdata_wait_lock};
-    if (is_smallest_thread_index && !sdata->context_queue.empty()) {
-      // we raced with a context_queue addition, don't wait
+    // _enqueue pushes to inbox and then only notifies if num_waiting is
+    // nonzero, so count ourselves before the final check of inbox.
+    ++sdata->num_waiting;
+    if (!sdata->inbox.empty() ||
+	(is_smallest_thread_index && !sdata->context_queue.empty())) {
+      // we raced with an inbox or context_queue addition, don't wait
+      --sdata->num_waiting;
       wait_lock.unlock();
     } else if (!sdata->stop_waiting) {
       dout(20) << __func__ << " empty q, waiting" << dendl;
       osd->cct->get_heartbeat_map()->clear_timeout(hb);
       sdata->shard_lock.unlock();
       sdata->sdata_cond.wait(wait_lock);
+      --sdata->num_waiting;
       wait_lock.unlock();
       sdata->shard_lock.lock();
+      sdata->_drain_inbox();
       if (sdata->scheduler->empty() &&
          !(is_smallest_thread_index && !sdata->context_queue.empty())) {
 	sdata->shard_lock.unlock();
@@ -10417,6 +10815,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 	  osd->cct->_conf->threadpool_default_timeout, 0);
     } else {
       dout(20) << __func__ << " need return immediately" << dendl;
+      --sdata->num_waiting;
       wait_lock.unlock();
       sdata->shard_lock.unlock();
       return;
@@ -10443,6 +10842,10 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   }
 
   OpSchedulerItem item = sdata->scheduler->dequeue();
+  sdata->peering_outbox.maybe_flush(false, osd->logger);
+  if (sdata->_is_numa_remote()) {
+    osd->logger->inc(l_osd_numa_remote_op);
+  }
   if (osd->is_stopping()) {
     sdata->shard_lock.unlock();
     for (auto c : oncommits) {
@@ -10684,14 +11087,11 @@ void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
   OSDShard* sdata = osd->shards[shard_index];
   assert (NULL != sdata);
 
-  bool empty = true;
-  {
-    std::lock_guard l{sdata->shard_lock};
-    empty = sdata->scheduler->empty();
-    sdata->scheduler->enqueue(std::move(item));
-  }
-
-  if (empty) {
+  // hand the item off without shard_lock; the next _process on this
+  // shard moves it into the scheduler.  only wake a thread if one is
+  // (about to be) asleep, see _process.
+  sdata->inbox.push(std::move(item));
+  if (sdata->num_waiting > 0) {
     std::lock_guard l{sdata->sdata_wait_lock};
     sdata->sdata_cond.notify_one();
   }
@@ -26,6 +26,8 @@
 #include "common/config_cacher.h"
 #include "common/zipkin_trace.h"
 #include "common/ceph_timer.h"
+#include "common/mpsc_queue.h"
+#include "common/numa.h"
 
 #include "mgr/MgrClient.h"
 
@@ -58,6 +60,7 @@
 #include "messages/MOSDOp.h"
 #include "common/EventTrace.h"
 #include "osd/osd_perf_counters.h"
+#include "osd/PeeringOutbox.h"
 
 #define CEPH_OSD_PROTOCOL    10 /* cluster internal */
 
@@ -140,6 +143,14 @@ public:
 
   ceph::signedspan get_mnow();
 
+  // -- time to active after startup --
+  /// when we were first marked up
+  std::atomic<ceph::mono_time> boot_up_stamp = {ceph::mono_time()};
+  /// pgs loaded at startup that have not been active since
+  std::atomic<unsigned> boot_pgs_pending = {0};
+  /// a pg loaded at startup went active (or was deleted)
+  void boot_pg_active(spg_t pgid);
+
 private:
   // -- superblock --
   ceph::mutex publish_lock, pre_publish_lock; // pre-publish orders before publish
@@ -622,6 +633,12 @@ private:
   uint64_t recovery_ops_active;
   uint64_t recovery_ops_reserved;
   bool recovery_paused;
+  /// recovery was held back by the op limit since the last recalibrate
+  bool recovery_op_limited = false;
+  /// objects each recovery op slot may cover; see recovery_recalibrate()
+  std::atomic<unsigned> recovery_batch{1};
+  utime_t last_recovery_recalibrate;
+  uint64_t last_recovery_bytes = 0, last_recovery_objects = 0;
 #ifdef DEBUG_RECOVERY_OIDS
   map<spg_t, set<hobject_t> > recovery_oids;
 #endif
@@ -634,6 +651,25 @@ public:
   void finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue);
   bool is_recovery_active();
   void release_reserved_pushes(uint64_t pushes);
+  unsigned get_recovery_batch() const {
+    return recovery_batch;
+  }
+  /// measure recovery throughput and adjust recovery_batch
+  void recovery_recalibrate();
+  /**
+   * the recovery batch for the next interval, after dbytes in dobjects
+   * were recovered in dur seconds with the given batch.  *defer is set
+   * to how long recovery should pause when it went over
+   * osd_recovery_max_bytes_per_sec with nothing left to shrink.
+   */
+  static unsigned calc_recovery_batch(
+    CephContext *cct,
+    unsigned batch,
+    bool op_limited,
+    uint64_t dbytes,
+    uint64_t dobjects,
+    double dur,
+    double *defer);
   void defer_recovery(float defer_for) {
     defer_recovery_until = ceph_clock_now();
     defer_recovery_until += defer_for;
@@ -999,6 +1035,12 @@ struct OSDShard {
   string sdata_wait_lock_name;
   ceph::mutex sdata_wait_lock;
   ceph::condition_variable sdata_cond;
+  /// number of _process threads blocked (or about to block) on sdata_cond
+  std::atomic<unsigned> num_waiting = {0};
+
+  /// items queued by _enqueue without shard_lock; moved into the
+  /// scheduler by _drain_inbox
+  ceph::common::mpsc_queue<ceph::osd::scheduler::OpSchedulerItem> inbox;
 
   string osdmap_lock_name;
   ceph::mutex osdmap_lock;  ///< protect shard_osdmap updates vs users w/o shard_lock
@@ -1041,6 +1083,25 @@ struct OSDShard {
 
   ContextQueue context_queue;
 
+  /// move everything in inbox into scheduler (requires shard_lock)
+  void _drain_inbox();
+
+  /// peering notifies and queries from this shard's pgs, batched per peer
+  PeeringOutbox peering_outbox;
+
+  /// numa placement of our worker threads; each worker applies it to
+  /// itself from _process when numa_gen changes
+  unsigned numa_gen = 0;
+  int numa_node = -1;
+  size_t numa_cpu_set_size = 0;
+  cpu_set_t numa_cpu_set;
+  bool numa_prefer_local_memory = false;
+
+  void set_numa_placement(int node, size_t cpu_set_size,
+			  const cpu_set_t *cpu_set, bool prefer_local_memory);
+  void _apply_numa_placement();
+  bool _is_numa_remote() const;
+
   void _attach_pg(OSDShardPGSlot *slot, PG *pg);
   void _detach_pg(OSDShardPGSlot *slot);
 
@@ -1125,6 +1186,8 @@ protected:
   int numa_node = -1;
   size_t numa_cpu_set_size = 0;
   cpu_set_t numa_cpu_set;
+  int numa_node_op_shards = -1;
+  numa_node_stat_t numa_last_stat;
 
   bool store_is_rotational = true;
   bool journal_is_rotational = true;
@@ -1149,6 +1212,16 @@ protected:
     const bufferlist& inbl,
     std::function<void(int,const std::string&,bufferlist&)> on_finish);
 
+  // bench
+  int run_osd_bench_test(int64_t count, int64_t bsize,
+			 int64_t osize, int64_t onum,
+			 double *elapsed, double *bandwidth, double *iops,
+			 std::ostream &ss);
+  // mclock cost model capacity; measured at init unless configured
+  double mclock_measured_iops = 0;
+  double mclock_measured_bandwidth = 0;
+  void calibrate_mclock_cost_model();
+
 public:
   int get_nodeid() { return whoami; }
   
@@ -1639,6 +1712,7 @@ protected:
 	ceph_assert(NULL != sdata);
 
 	std::scoped_lock l{sdata->shard_lock};
+	sdata->_drain_inbox();
 	f->open_object_section(queue_name);
 	sdata->scheduler->dump(*f);
 	f->close_section();
@@ -1650,6 +1724,9 @@ protected:
       auto &&sdata = osd->shards[shard_index];
       ceph_assert(sdata);
       std::lock_guard l(sdata->shard_lock);
+      if (!sdata->inbox.empty()) {
+	return false;
+      }
       if (thread_index < osd->num_shards) {
 	return sdata->scheduler->empty() && sdata->context_queue.empty();
       } else {
@@ -1799,6 +1876,10 @@ protected:
   void resume_creating_pg();
 
   void load_pgs();
+  /// read one pg off disk; sets *remove if its collection should go
+  PGRef _load_pg(const coll_t& coll, spg_t *pgid, bool *remove);
+  /// when load_pgs finished, for boot_up_lat
+  ceph::mono_time load_pgs_done;
 
   /// build initial pg history and intervals on create
   void build_initial_pg_history(
@@ -2072,6 +2153,8 @@ public:
 
   int enable_disable_fuse(bool stop);
   int set_numa_affinity();
+  void set_numa_subsystem_affinity();
+  void update_numa_stats();
 
   void suicide(int exitcode);
   int shutdown();
@@ -1269,6 +1269,7 @@ void OSDMap::Incremental::generate_test_instances(list<Incremental*>& o)
 void OSDMap::set_epoch(epoch_t e)
 {
   epoch = e;
+  pg_mapping_cache.clear();
   for (auto &pool : pools)
     pool.second.last_change = e;
 }
@@ -1727,6 +1728,10 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
   if (o->osd_uuid->size() == n->osd_uuid->size() &&
       *o->osd_uuid == *n->osd_uuid)
     n->osd_uuid = o->osd_uuid;
+
+  // share whichever upmap chunks did not change
+  n->pg_upmap.dedup(o->pg_upmap);
+  n->pg_upmap_items.dedup(o->pg_upmap_items);
 }
 
 void OSDMap::clean_temps(CephContext *cct,
@@ -2003,6 +2008,7 @@ int OSDMap::apply_incremental(const Incremental &inc)
 
   epoch++;
   modified = inc.modified;
+  pg_mapping_cache.clear();
 
   // full map?
   if (inc.fullmap.length()) {
@@ -2592,7 +2598,8 @@ void OSDMap::pg_to_raw_up(pg_t pg, vector<int> *up, int *primary) const
 void OSDMap::_pg_to_up_acting_osds(
   const pg_t& pg, vector<int> *up, int *up_primary,
   vector<int> *acting, int *acting_primary,
-  bool raw_pg_to_pg) const
+  bool raw_pg_to_pg,
+  vector<int> *raw_upmap) const
 {
   const pg_pool_t *pool = get_pg_pool(pg.pool());
   if (!pool ||
@@ -2605,6 +2612,8 @@ void OSDMap::_pg_to_up_acting_osds(
       acting->clear();
     if (acting_primary)
       *acting_primary = -1;
+    if (raw_upmap)
+      raw_upmap->clear();
     return;
   }
   vector<int> raw;
@@ -2614,9 +2623,11 @@ void OSDMap::_pg_to_up_acting_osds(
   int _acting_primary;
   ps_t pps;
   _get_temp_osds(*pool, pg, &_acting, &_acting_primary);
-  if (_acting.empty() || up || up_primary) {
+  if (_acting.empty() || up || up_primary || raw_upmap) {
     _pg_to_raw_osds(*pool, pg, &raw, &pps);
     _apply_upmap(*pool, pg, &raw);
+    if (raw_upmap)
+      *raw_upmap = raw;
     _raw_to_up_osds(*pool, raw, &_up);
     _up_primary = _pick_primary(_up);
     _apply_primary_affinity(pps, *pool, &_up, &_up_primary);
@@ -2639,6 +2650,164 @@ void OSDMap::_pg_to_up_acting_osds(
     *acting_primary = _acting_primary;
 }
 
+bool OSDMap::pg_to_up_acting_osds_cached(
+  pg_t pg, vector<int> *up, int *up_primary,
+  vector<int> *acting, int *acting_primary) const
+{
+  const pg_pool_t *pool = get_pg_pool(pg.pool());
+  if (!pool) {
+    _pg_to_up_acting_osds(pg, up, up_primary, acting, acting_primary);
+    return false;
+  }
+  pg = pool->raw_pg_to_pg(pg);
+  if (pg_mapping_cache.get(pg, *pool, up, up_primary, acting,
+			   acting_primary)) {
+    return true;
+  }
+  _pg_to_up_acting_osds(pg, up, up_primary, acting, acting_primary);
+  pg_mapping_cache.put(pg, *pool, pool_max, *up, *up_primary,
+		       *acting, *acting_primary);
+  return false;
+}
+
+// PGMappingCache
+
+PGMappingCache::pool_t::pool_t(unsigned pg_num, unsigned width)
+  : pg_num(pg_num), width(width)
+{
+  unsigned num_chunks = (pg_num + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  chunks.reset(new std::atomic<chunk_t*>[num_chunks]);
+  for (unsigned i = 0; i < num_chunks; ++i) {
+    chunks[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+PGMappingCache::pool_t::~pool_t()
+{
+  unsigned num_chunks = (pg_num + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  for (unsigned i = 0; i < num_chunks; ++i) {
+    delete chunks[i].load(std::memory_order_relaxed);
+  }
+}
+
+PGMappingCache::table_t::table_t(int64_t num_pools)
+  : num_pools(num_pools),
+    pools(new std::atomic<pool_t*>[num_pools])
+{
+  for (int64_t i = 0; i < num_pools; ++i) {
+    pools[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+PGMappingCache::table_t::~table_t()
+{
+  for (int64_t i = 0; i < num_pools; ++i) {
+    delete pools[i].load(std::memory_order_relaxed);
+  }
+}
+
+PGMappingCache::pool_t *PGMappingCache::get_pool(
+  int64_t poolid, const pg_pool_t& pi, int64_t pool_max, bool create)
+{
+  table_t *t = table.load(std::memory_order_acquire);
+  if (!t) {
+    if (!create) {
+      return nullptr;
+    }
+    auto n = new table_t(std::max(pool_max, poolid) + 1);
+    if (table.compare_exchange_strong(t, n, std::memory_order_acq_rel)) {
+      t = n;
+    } else {
+      // lost the race; t is the winner's table
+      delete n;
+    }
+  }
+  if (poolid < 0 || poolid >= t->num_pools) {
+    return nullptr;
+  }
+  pool_t *p = t->pools[poolid].load(std::memory_order_acquire);
+  if (!p && create) {
+    auto n = new pool_t(pi.get_pg_num(), std::max(pi.get_size(), 1u));
+    if (t->pools[poolid].compare_exchange_strong(
+	  p, n, std::memory_order_acq_rel)) {
+      p = n;
+    } else {
+      delete n;
+    }
+  }
+  return p;
+}
+
+bool PGMappingCache::get(
+  const pg_t& pgid, const pg_pool_t& pi,
+  vector<int> *up, int *up_primary,
+  vector<int> *acting, int *acting_primary)
+{
+  pool_t *p = get_pool(pgid.pool(), pi, 0, false);
+  if (!p || pgid.ps() >= p->pg_num) {
+    return false;
+  }
+  chunk_t *c = p->chunks[pgid.ps() >> CHUNK_BITS].load(
+    std::memory_order_acquire);
+  if (!c) {
+    return false;
+  }
+  unsigned i = pgid.ps() & (CHUNK_SIZE - 1);
+  if (c->state[i].load(std::memory_order_acquire) != ENTRY_FULL) {
+    return false;
+  }
+  const int32_t *e = c->data.get() + i * p->entry_size();
+  const int32_t *o = e + 4;
+  up->assign(o, o + e[0]);
+  *up_primary = e[1];
+  o += p->width;
+  acting->assign(o, o + e[2]);
+  *acting_primary = e[3];
+  return true;
+}
+
+void PGMappingCache::put(
+  const pg_t& pgid, const pg_pool_t& pi, int64_t pool_max,
+  const vector<int>& up, int up_primary,
+  const vector<int>& acting, int acting_primary)
+{
+  pool_t *p = get_pool(pgid.pool(), pi, pool_max, true);
+  if (!p || pgid.ps() >= p->pg_num ||
+      up.size() > p->width || acting.size() > p->width) {
+    // e.g., a pg_temp longer than the pool size; just don't cache it
+    return;
+  }
+  auto& slot = p->chunks[pgid.ps() >> CHUNK_BITS];
+  chunk_t *c = slot.load(std::memory_order_acquire);
+  if (!c) {
+    auto n = new chunk_t(p->entry_size());
+    if (slot.compare_exchange_strong(c, n, std::memory_order_acq_rel)) {
+      c = n;
+    } else {
+      delete n;
+    }
+  }
+  unsigned i = pgid.ps() & (CHUNK_SIZE - 1);
+  uint8_t expected = ENTRY_EMPTY;
+  if (!c->state[i].compare_exchange_strong(expected, ENTRY_FILLING,
+					   std::memory_order_relaxed)) {
+    return;
+  }
+  int32_t *e = c->data.get() + i * p->entry_size();
+  e[0] = up.size();
+  e[1] = up_primary;
+  e[2] = acting.size();
+  e[3] = acting_primary;
+  std::copy(up.begin(), up.end(), e + 4);
+  std::copy(acting.begin(), acting.end(), e + 4 + p->width);
+  c->state[i].store(ENTRY_FULL, std::memory_order_release);
+}
+
+void PGMappingCache::clear()
+{
+  delete table.exchange(nullptr, std::memory_order_relaxed);
+}
+
 int OSDMap::calc_pg_role_broken(int osd, const vector<int>& acting, int nrep)
 {
   // This implementation is broken for EC PGs since the osd may appear
@@ -3164,6 +3333,7 @@ void OSDMap::decode_classic(ceph::buffer::list::const_iterator& p)
 void OSDMap::decode(ceph::buffer::list::const_iterator& bl)
 {
   using ceph::decode;
+  pg_mapping_cache.clear();
   /**
    * Older encodings of the OSDMap had a single struct_v which
    * covered the whole encoding, and was prior to our modern
@@ -24,6 +24,7 @@
  *   disks, disk groups, total # osds,
  *
  */
+#include <atomic>
 #include <vector>
 #include <list>
 #include <set>
@@ -32,6 +33,7 @@
 
 #include <boost/smart_ptr/local_shared_ptr.hpp>
 #include "include/btree_map.h"
+#include "include/cow_map.h"
 #include "include/types.h"
 #include "common/ceph_releases.h"
 #include "osd_types.h"
@@ -345,6 +347,81 @@ struct PGTempMap {
 };
 WRITE_CLASS_ENCODER(PGTempMap)
 
+/**
+ * PGMappingCache
+ *
+ * Lazily filled cache of pg -> up/acting mappings for one OSDMap epoch.
+ * Pools are split into chunks of pgs that are allocated on first use,
+ * so a client that only talks to a few pgs of a large pool only pays
+ * for those chunks.  Each entry is published once with a release store
+ * and never changes afterwards, so any number of threads may look up
+ * and fill entries concurrently without a lock.  clear() must not race
+ * with lookups; OSDMap calls it when the map itself changes.
+ */
+class PGMappingCache {
+  static constexpr unsigned CHUNK_BITS = 7;
+  static constexpr unsigned CHUNK_SIZE = 1u << CHUNK_BITS;
+  enum : uint8_t {
+    ENTRY_EMPTY = 0,
+    ENTRY_FILLING,
+    ENTRY_FULL,
+  };
+
+  // an entry is up_len, up_primary, acting_len, acting_primary,
+  // up[width], acting[width]
+  struct chunk_t {
+    std::atomic<uint8_t> state[CHUNK_SIZE];
+    std::unique_ptr<int32_t[]> data;
+    explicit chunk_t(unsigned entry_size)
+      : data(new int32_t[CHUNK_SIZE * entry_size]) {
+      for (auto& s : state) {
+	s.store(ENTRY_EMPTY, std::memory_order_relaxed);
+      }
+    }
+  };
+  struct pool_t {
+    const unsigned pg_num, width;
+    std::unique_ptr<std::atomic<chunk_t*>[]> chunks;
+    pool_t(unsigned pg_num, unsigned width);
+    ~pool_t();
+    unsigned entry_size() const {
+      return 4 + 2 * width;
+    }
+  };
+  struct table_t {
+    const int64_t num_pools;
+    std::unique_ptr<std::atomic<pool_t*>[]> pools;
+    explicit table_t(int64_t num_pools);
+    ~table_t();
+  };
+  std::atomic<table_t*> table = {nullptr};
+
+  pool_t *get_pool(int64_t poolid, const pg_pool_t& pi,
+		   int64_t pool_max, bool create);
+
+public:
+  PGMappingCache() = default;
+  // a copied OSDMap may be changed independently; start over
+  PGMappingCache(const PGMappingCache&) {}
+  PGMappingCache& operator=(const PGMappingCache&) {
+    clear();
+    return *this;
+  }
+  ~PGMappingCache() {
+    clear();
+  }
+
+  /// look up pgid (already folded to pg_num); false if not cached
+  bool get(const pg_t& pgid, const pg_pool_t& pi,
+	   std::vector<int> *up, int *up_primary,
+	   std::vector<int> *acting, int *acting_primary);
+  /// publish the mapping for pgid unless another thread got there first
+  void put(const pg_t& pgid, const pg_pool_t& pi, int64_t pool_max,
+	   const std::vector<int>& up, int up_primary,
+	   const std::vector<int>& acting, int acting_primary);
+  void clear();
+};
+
 /** OSDMap
  */
 class OSDMap {
@@ -564,9 +641,12 @@ private:
   std::shared_ptr< mempool::osdmap::map<pg_t,int32_t > > primary_temp;  // temp primary mapping (e.g. while we rebuild)
   std::shared_ptr< mempool::osdmap::vector<__u32> > osd_primary_affinity; ///< 16.16 fixed point, 0x10000 = baseline
 
-  // remap (post-CRUSH, pre-up)
-  mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>> pg_upmap; ///< remap pg
-  mempool::osdmap::map<pg_t,mempool::osdmap::vector<std::pair<int32_t,int32_t>>> pg_upmap_items; ///< remap osds in up set
+  // remap (post-CRUSH, pre-up); copy-on-write so consecutive epochs can
+  // share the (usually large, mostly unchanged) upmap tables
+  cow_map<pg_t,mempool::osdmap::vector<int32_t>,
+	  mempool::mempool_osdmap> pg_upmap; ///< remap pg
+  cow_map<pg_t,mempool::osdmap::vector<std::pair<int32_t,int32_t>>,
+	  mempool::mempool_osdmap> pg_upmap_items; ///< remap osds in up set
 
   mempool::osdmap::map<int64_t,pg_pool_t> pools;
   mempool::osdmap::map<int64_t,std::string> pool_name;
@@ -616,7 +696,10 @@ private:
 private:
   uint32_t crush_version = 1;
 
+  mutable PGMappingCache pg_mapping_cache;
+
   friend class OSDMonitor;
+  friend class OSDMapMapping;
 
  public:
   OSDMap() : epoch(0), 
@@ -1192,7 +1275,8 @@ private:
    */
   void _pg_to_up_acting_osds(const pg_t& pg, std::vector<int> *up, int *up_primary,
                              std::vector<int> *acting, int *acting_primary,
-			     bool raw_pg_to_pg = true) const;
+			     bool raw_pg_to_pg = true,
+			     std::vector<int> *raw_upmap = nullptr) const;
 
 public:
   /***
@@ -1232,6 +1316,28 @@ public:
     int up_primary, acting_primary;
     pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
   }
+  /**
+   * as pg_to_up_acting_osds, but remember the result for this epoch so
+   * that repeated lookups of the same pg are a copy out of an array.
+   * Only for maps that are changed solely by apply_incremental(),
+   * decode() and set_epoch(), which drop the cache.
+   * Each of these pointers must be non-NULL.
+   * @return true if the mapping was cached
+   */
+  bool pg_to_up_acting_osds_cached(
+    pg_t pg, std::vector<int> *up, int *up_primary,
+    std::vector<int> *acting, int *acting_primary) const;
+  /**
+   * as above, also returning the CRUSH mapping with upmaps applied that
+   * the up set is derived from (i.e., before down osds are removed).
+   */
+  void pg_to_raw_upmap_up_acting_osds(
+    pg_t pg, std::vector<int> *raw_upmap,
+    std::vector<int> *up, int *up_primary,
+    std::vector<int> *acting, int *acting_primary) const {
+    _pg_to_up_acting_osds(pg, up, up_primary, acting, acting_primary,
+			  true, raw_upmap);
+  }
   bool pg_is_ec(pg_t pg) const {
     auto i = pools.find(pg.pool());
     ceph_assert(i != pools.end());
@@ -15,6 +15,8 @@ MEMPOOL_DEFINE_OBJECT_FACTORY(OSDMapMapping, osdmapmapping,
 // the dimensions (pg_num and size) match up.
 void OSDMapMapping::_init_mappings(const OSDMap& osdmap)
 {
+  updating = true;
+  new_pools.clear();
   num_pgs = 0;
   auto q = pools.begin();
   for (auto& p : osdmap.get_pools()) {
@@ -37,6 +39,7 @@ void OSDMapMapping::_init_mappings(const OSDMap& osdmap)
     pools.emplace(p.first, PoolMapping(p.second.get_size(),
 				       p.second.get_pg_num(),
 				       p.second.is_erasure()));
+    new_pools.insert(p.first);
   }
   pools.erase(q, pools.end());
   ceph_assert(pools.size() == osdmap.get_pools().size());
@@ -48,6 +51,7 @@ void OSDMapMapping::update(const OSDMap& osdmap)
   for (auto& p : osdmap.get_pools()) {
     _update_range(osdmap, p.first, 0, p.second.get_pg_num());
   }
+  num_updated_pgs = num_pgs;
   _finish(osdmap);
   //_dump();  // for debugging
 }
@@ -57,6 +61,218 @@ void OSDMapMapping::update(const OSDMap& osdmap, pg_t pgid)
   _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
 }
 
+void OSDMapMapping::update(const OSDMap& osdmap,
+			   const OSDMap::Incremental& inc)
+{
+  bool can_inc = !updating && epoch && epoch + 1 == inc.epoch &&
+    osdmap.get_epoch() == inc.epoch;
+  _start(osdmap);
+  std::vector<pg_t> pgs;
+  if (!can_inc || !_get_affected_pgs(osdmap, inc, &pgs)) {
+    for (auto& p : osdmap.get_pools()) {
+      _update_range(osdmap, p.first, 0, p.second.get_pg_num());
+    }
+    num_updated_pgs = num_pgs;
+  } else {
+    _update_pgs(osdmap, pgs);
+    num_updated_pgs = pgs.size();
+  }
+  _finish(osdmap);
+}
+
+std::unique_ptr<OSDMapMapping::MappingJob> OSDMapMapping::start_update(
+  const OSDMap& osdmap,
+  const OSDMap::Incremental& inc,
+  ParallelPGMapper& mapper,
+  unsigned pgs_per_item)
+{
+  bool can_inc = !updating && epoch && epoch + 1 == inc.epoch &&
+    osdmap.get_epoch() == inc.epoch;
+  std::unique_ptr<MappingJob> job(new MappingJob(&osdmap, this));
+  std::vector<pg_t> pgs;
+  if (!can_inc || !_get_affected_pgs(osdmap, inc, &pgs)) {
+    num_updated_pgs = num_pgs;
+    mapper.queue(job.get(), pgs_per_item, {});
+  } else if (pgs.empty()) {
+    // nothing was remapped; there is nothing to queue and no worker
+    // will complete the job, so finish it here.
+    num_updated_pgs = 0;
+    job->finish = ceph_clock_now();
+    _finish(osdmap);
+  } else {
+    num_updated_pgs = pgs.size();
+    mapper.queue(job.get(), pgs_per_item, pgs);
+  }
+  return job;
+}
+
+bool OSDMapMapping::_get_affected_pgs(
+  const OSDMap& osdmap,
+  const OSDMap::Incremental& inc,
+  std::vector<pg_t> *pgs) const
+{
+  if (inc.fullmap.length() ||
+      inc.crush.length() ||
+      inc.new_max_osd >= 0) {
+    return false;
+  }
+
+  // osds whose weight or existence changed can change the crush mapping
+  // of any pg whose rule can reach them; osds that only went up or down
+  // (or changed primary affinity) only change pgs that already map to
+  // them, or whose pg_temp/primary_temp names them.
+  std::set<int> crush_osds, up_osds;
+  for (auto& [osd, bits] : inc.new_state) {
+    if (bits == 0 || (bits & CEPH_OSD_UP)) {
+      up_osds.insert(osd);
+    }
+    if (bits & CEPH_OSD_EXISTS) {
+      crush_osds.insert(osd);
+    }
+  }
+  for (auto& p : inc.new_up_client) {
+    up_osds.insert(p.first);
+  }
+  for (auto& p : inc.new_primary_affinity) {
+    up_osds.insert(p.first);
+  }
+  for (auto& p : inc.new_weight) {
+    crush_osds.insert(p.first);
+  }
+
+  std::set<int64_t> all_pools(new_pools);
+  for (auto& p : inc.new_pools) {
+    all_pools.insert(p.first);
+  }
+  if (!crush_osds.empty()) {
+    std::map<int, bool> rule_reaches;  // rule -> reaches any crush_osds
+    for (auto& [poolid, pool] : osdmap.get_pools()) {
+      int rule = pool.get_crush_rule();
+      auto r = rule_reaches.find(rule);
+      if (r == rule_reaches.end()) {
+	std::map<int, float> weights;
+	bool reaches = false;
+	if (osdmap.crush->get_rule_weight_osd_map(rule, &weights) < 0) {
+	  reaches = true;  // be conservative
+	} else {
+	  for (auto osd : crush_osds) {
+	    if (weights.count(osd)) {
+	      reaches = true;
+	      break;
+	    }
+	  }
+	}
+	r = rule_reaches.emplace(rule, reaches).first;
+      }
+      if (r->second) {
+	all_pools.insert(poolid);
+      }
+    }
+  }
+
+  std::set<pg_t> some_pgs;
+  auto add_pg = [&](pg_t pgid) {
+    if (all_pools.count(pgid.pool())) {
+      return;
+    }
+    auto pool = osdmap.get_pg_pool(pgid.pool());
+    if (pool && pgid.ps() < pool->get_pg_num()) {
+      some_pgs.insert(pgid);
+    }
+  };
+  for (auto& p : inc.new_pg_temp) {
+    add_pg(p.first);
+  }
+  for (auto& p : inc.new_primary_temp) {
+    add_pg(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap) {
+    add_pg(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap_items) {
+    add_pg(p.first);
+  }
+  for (auto& pgid : inc.old_pg_upmap) {
+    add_pg(pgid);
+  }
+  for (auto& pgid : inc.old_pg_upmap_items) {
+    add_pg(pgid);
+  }
+
+  std::set<int> changed_osds(up_osds);
+  changed_osds.insert(crush_osds.begin(), crush_osds.end());
+  if (!changed_osds.empty()) {
+    // temp mappings skip down osds, and upmaps skip out osds
+    for (const auto p : *osdmap.pg_temp) {
+      for (auto osd : p.second) {
+	if (changed_osds.count(osd)) {
+	  add_pg(p.first);
+	  break;
+	}
+      }
+    }
+    for (auto& [pgid, osd] : *osdmap.primary_temp) {
+      if (changed_osds.count(osd)) {
+	add_pg(pgid);
+      }
+    }
+    for (auto& [pgid, osds] : osdmap.pg_upmap) {
+      for (auto osd : osds) {
+	if (changed_osds.count(osd)) {
+	  add_pg(pgid);
+	  break;
+	}
+      }
+    }
+    for (auto& [pgid, items] : osdmap.pg_upmap_items) {
+      for (auto& item : items) {
+	if (changed_osds.count(item.second)) {
+	  add_pg(pgid);
+	  break;
+	}
+      }
+    }
+    // and whatever maps to them now
+    for (auto& [poolid, pm] : pools) {
+      if (all_pools.count(poolid)) {
+	continue;
+      }
+      for (unsigned ps = 0; ps < pm.pg_num; ++ps) {
+	for (auto osd : changed_osds) {
+	  if (pm.has_osd(ps, osd)) {
+	    some_pgs.insert(pg_t(ps, poolid));
+	    break;
+	  }
+	}
+      }
+    }
+  }
+
+  uint64_t num = some_pgs.size();
+  for (auto poolid : all_pools) {
+    auto pool = osdmap.get_pg_pool(poolid);
+    if (pool) {
+      num += pool->get_pg_num();
+    }
+  }
+  if (num > num_pgs / 2) {
+    // not worth the bookkeeping
+    return false;
+  }
+  pgs->reserve(num);
+  for (auto poolid : all_pools) {
+    auto pool = osdmap.get_pg_pool(poolid);
+    if (!pool) {
+      continue;
+    }
+    for (unsigned ps = 0; ps < pool->get_pg_num(); ++ps) {
+      pgs->push_back(pg_t(ps, poolid));
+    }
+  }
+  pgs->insert(pgs->end(), some_pgs.begin(), some_pgs.end());
+  return true;
+}
+
 void OSDMapMapping::_build_rmap(const OSDMap& osdmap)
 {
   acting_rmap.resize(osdmap.get_max_osd());
@@ -88,6 +304,7 @@ void OSDMapMapping::_finish(const OSDMap& osdmap)
 {
   _build_rmap(osdmap);
   epoch = osdmap.get_epoch();
+  updating = false;
 }
 
 void OSDMapMapping::_dump()
@@ -113,13 +330,21 @@ void OSDMapMapping::_update_range(
   ceph_assert(pg_begin <= pg_end);
   ceph_assert(pg_end <= i->second.pg_num);
   for (unsigned ps = pg_begin; ps < pg_end; ++ps) {
-    std::vector<int> up, acting;
+    std::vector<int> raw_upmap, up, acting;
     int up_primary, acting_primary;
-    osdmap.pg_to_up_acting_osds(
+    osdmap.pg_to_raw_upmap_up_acting_osds(
       pg_t(ps, pool),
-      &up, &up_primary, &acting, &acting_primary);
-    i->second.set(ps, std::move(up), up_primary,
-		  std::move(acting), acting_primary);
+      &raw_upmap, &up, &up_primary, &acting, &acting_primary);
+    i->second.set(ps, raw_upmap, up, up_primary, acting, acting_primary);
+  }
+}
+
+void OSDMapMapping::_update_pgs(
+  const OSDMap& osdmap,
+  const std::vector<pg_t>& pgs)
+{
+  for (auto& pgid : pgs) {
+    _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
   }
 }
 
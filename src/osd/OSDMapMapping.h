@@ -9,11 +9,10 @@
 #include <map>
 
 #include "osd/osd_types.h"
+#include "osd/OSDMap.h"
 #include "common/WorkQueue.h"
 #include "common/Cond.h"
 
-class OSDMap;
-
 /// work queue to perform work on batches of pgids on multiple CPUs
 class ParallelPGMapper {
 public:
@@ -187,7 +186,9 @@ private:
 	1 + // num acting
 	1 + // num up
 	size + // acting
-	size;  // up
+	size + // up
+	1 + // num raw_upmap
+	size;  // raw_upmap
     }
 
     PoolMapping(int s, int p, bool e)
@@ -223,12 +224,40 @@ private:
       }
     }
 
+    /// true if osd appears in the raw_upmap, up or acting set of ps
+    bool has_osd(size_t ps, int osd) const {
+      const int32_t *row = &table[row_size() * ps];
+      for (int i = 0; i < row[2]; ++i) {
+	if (row[4 + i] == osd) {
+	  return true;
+	}
+      }
+      for (int i = 0; i < row[3]; ++i) {
+	if (row[4 + size + i] == osd) {
+	  return true;
+	}
+      }
+      const int32_t *raw = row + 4 + 2 * size;
+      for (int i = 0; i < raw[0]; ++i) {
+	if (raw[1 + i] == osd) {
+	  return true;
+	}
+      }
+      return false;
+    }
+
     void set(size_t ps,
+	     const std::vector<int>& raw_upmap,
 	     const std::vector<int>& up,
 	     int up_primary,
 	     const std::vector<int>& acting,
 	     int acting_primary) {
       int32_t *row = &table[row_size() * ps];
+      int32_t *raw = row + 4 + 2 * size;
+      raw[0] = std::min<int32_t>(raw_upmap.size(), size);
+      for (int i = 0; i < raw[0]; ++i) {
+	raw[1 + i] = raw_upmap[i];
+      }
       row[0] = acting_primary;
       row[1] = up_primary;
       // these should always be <= the pool size, but just in case, avoid
@@ -251,12 +280,22 @@ private:
   //unused: mempool::osdmap_mapping::vector<std::vector<pg_t>> up_rmap;  // osd -> pg
   epoch_t epoch = 0;
   uint64_t num_pgs = 0;
+  uint64_t num_updated_pgs = 0;  ///< pgs recomputed by the last update
+  std::set<int64_t> new_pools;   ///< pools (re)created by _init_mappings
+  bool updating = false;         ///< an update started but did not finish
 
   void _init_mappings(const OSDMap& osdmap);
   void _update_range(
     const OSDMap& map,
     int64_t pool,
     unsigned pg_begin, unsigned pg_end);
+  void _update_pgs(
+    const OSDMap& map,
+    const std::vector<pg_t>& pgs);
+  bool _get_affected_pgs(
+    const OSDMap& osdmap,
+    const OSDMap::Incremental& inc,
+    std::vector<pg_t> *pgs) const;
 
   void _build_rmap(const OSDMap& osdmap);
 
@@ -275,7 +314,9 @@ private:
       : Job(osdmap), mapping(m) {
       mapping->_start(*osdmap);
     }
-    void process(const vector<pg_t>& pgs) override {}
+    void process(const vector<pg_t>& pgs) override {
+      mapping->_update_pgs(*osdmap, pgs);
+    }
     void process(int64_t pool, unsigned ps_begin, unsigned ps_end) override {
       mapping->_update_range(*osdmap, pool, ps_begin, ps_end);
     }
@@ -325,15 +366,29 @@ public:
 
   void update(const OSDMap& map);
   void update(const OSDMap& map, pg_t pgid);
+  /**
+   * update to map, which is the result of applying inc to the map we
+   * currently reflect, recomputing only the pgs inc may have remapped.
+   * falls back to a full update if inc does not follow our epoch or
+   * changes crush, max_osd or most pgs.
+   */
+  void update(const OSDMap& map, const OSDMap::Incremental& inc);
 
   std::unique_ptr<MappingJob> start_update(
     const OSDMap& map,
     ParallelPGMapper& mapper,
     unsigned pgs_per_item) {
     std::unique_ptr<MappingJob> job(new MappingJob(&map, this));
+    num_updated_pgs = num_pgs;
     mapper.queue(job.get(), pgs_per_item, {});
     return job;
   }
+  /// as update(map, inc), in the background
+  std::unique_ptr<MappingJob> start_update(
+    const OSDMap& map,
+    const OSDMap::Incremental& inc,
+    ParallelPGMapper& mapper,
+    unsigned pgs_per_item);
 
   epoch_t get_epoch() const {
     return epoch;
@@ -342,6 +397,10 @@ public:
   uint64_t get_num_pgs() const {
     return num_pgs;
   }
+
+  uint64_t get_num_updated_pgs() const {
+    return num_updated_pgs;
+  }
 };
 
 
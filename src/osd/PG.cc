@@ -285,6 +285,13 @@ PerfCounters &PG::get_perf_logger() {
 
 void PG::log_state_enter(const char *state) {
   osd->pg_recovery_stats.log_enter(state);
+  if (boot_pending_active &&
+      (strcmp(state, "Started/Primary/Active") == 0 ||
+       strcmp(state, "Started/ReplicaActive") == 0 ||
+       strcmp(state, "Started/ToDelete") == 0)) {
+    boot_pending_active = false;
+    osd->boot_pg_active(pg_id);
+  }
 }
 
 void PG::log_state_exit(
@@ -371,6 +378,48 @@ PG::Scrubber::Scrubber()
 
 PG::Scrubber::~Scrubber() {}
 
+bool PG::Scrubber::behind_schedule(CephContext *cct, utime_t now) const
+{
+  double target = cct->_conf.get_val<double>("osd_scrub_target_duration");
+  if (target <= 0 || work_expected == 0 ||
+      scrub_start_stamp == utime_t()) {
+    return false;
+  }
+  double done = std::min(1.0, (double)work_done / work_expected);
+  return done < (double)(now - scrub_start_stamp) / target;
+}
+
+void PG::Scrubber::update_pace(CephContext *cct, const ScrubMap &chunk)
+{
+  if (deep) {
+    for (auto& [soid, o] : chunk.objects) {
+      work_done += o.size;
+    }
+  } else {
+    work_done += chunk.objects.size();
+  }
+  if (cct->_conf.get_val<double>("osd_scrub_target_duration") <= 0) {
+    return;
+  }
+  utime_t now = ceph_clock_now();
+  double took = now - chunk_start_stamp;
+  if (took > cct->_conf.get_val<double>("osd_scrub_chunk_max_duration")) {
+    // writes to the chunk were blocked for too long
+    chunk_objects = std::max(1, chunk_objects / 2);
+  } else if (behind_schedule(cct, now)) {
+    chunk_objects += std::max(1, chunk_objects / 4);
+  }
+}
+
+uint64_t PG::Scrubber::get_step_bytes(CephContext *cct) const
+{
+  // only deep scrub steps read object data, a stride at a time
+  if (deep && (state == BUILD_MAP || state == BUILD_MAP_REPLICA)) {
+    return cct->_conf->osd_deep_scrub_stride;
+  }
+  return 0;
+}
+
 bool PG::op_has_sufficient_caps(OpRequestRef& op)
 {
   // only check MOSDOp
@@ -791,7 +840,14 @@ void PG::send_cluster_message(
   if (share_map_update) {
     osd->maybe_share_map(con.get(), get_osdmap());
   }
-  osd->send_message_osd_cluster(m, con.get());
+  if (osd_shard) {
+    // logs and reservations must not pass the notifies and queries we
+    // batched for the same peer
+    osd_shard->peering_outbox.send(target, con, MessageRef{m, false},
+				   osd->logger);
+  } else {
+    osd->send_message_osd_cluster(m, con.get());
+  }
 }
 
 void PG::clear_probe_targets()
@@ -2473,7 +2529,8 @@ void PG::scrub(epoch_t queued, ThreadPool::TPHandle &handle)
   if (scrub_sleep > 0 &&
       (scrubber.state == PG::Scrubber::NEW_CHUNK ||
        scrubber.state == PG::Scrubber::INACTIVE) &&
-       scrubber.needs_sleep) {
+       scrubber.needs_sleep &&
+       !scrubber.behind_schedule(cct, ceph_clock_now())) {
     ceph_assert(!scrubber.sleeping);
     dout(20) << __func__ << " state is INACTIVE|NEW_CHUNK, sleeping" << dendl;
 
@@ -2673,6 +2730,12 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 	scrubber.preempt_left = cct->_conf.get_val<uint64_t>(
 	  "osd_scrub_max_preemptions");
 	scrubber.preempt_divisor = 1;
+
+	scrubber.scrub_start_stamp = ceph_clock_now();
+	scrubber.work_expected = scrubber.deep ?
+	  info.stats.stats.sum.num_bytes : info.stats.stats.sum.num_objects;
+	scrubber.work_done = 0;
+	scrubber.chunk_objects = 0;
         break;
 
       case PG::Scrubber::NEW_CHUNK:
@@ -2710,6 +2773,17 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 				      scrubber.preempt_divisor);
 	  int max = std::max<int64_t>(min, cct->_conf->osd_scrub_chunk_max /
                                       scrubber.preempt_divisor);
+	  if (cct->_conf.get_val<double>("osd_scrub_target_duration") > 0) {
+	    if (scrubber.chunk_objects == 0) {
+	      scrubber.chunk_objects = min;
+	    }
+	    scrubber.chunk_objects = std::clamp(scrubber.chunk_objects,
+						min, max);
+	    min = max = scrubber.chunk_objects;
+	    dout(20) << __func__ << " adaptive chunk of " << min
+		     << " objects" << dendl;
+	  }
+	  scrubber.chunk_start_stamp = ceph_clock_now();
           hobject_t start = scrubber.start;
 	  hobject_t candidate_end;
 	  vector<hobject_t> objects;
@@ -2882,6 +2956,7 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 	  scrubber.subset_last_update);
         ceph_assert(scrubber.waiting_on_whom.empty());
 
+	scrubber.update_pace(cct, scrubber.primary_scrubmap);
         scrub_compare_maps();
 	scrubber.start = scrubber.end;
 	scrubber.run_callbacks();
@@ -182,6 +182,9 @@ public:
 
   ObjectStore::CollectionHandle ch;
 
+  /// loaded at startup and not active since (see OSDService::boot_pg_active)
+  bool boot_pending_active = false;
+
   // -- methods --
   std::ostream& gen_prefix(std::ostream& out) const override;
   CephContext *get_cct() const override {
@@ -1206,6 +1209,21 @@ public:
     int preempt_left;
     int preempt_divisor;
 
+    // adaptive pacing, see osd_scrub_target_duration
+    utime_t scrub_start_stamp;
+    utime_t chunk_start_stamp;
+    // progress is in bytes for deep scrubs, objects otherwise
+    uint64_t work_expected = 0;   ///< pg size when the scrub started
+    uint64_t work_done = 0;       ///< size of completed chunks
+    int chunk_objects = 0;        ///< adaptive chunk size, 0 until sized
+
+    /// true if osd_scrub_target_duration is set and we are behind it
+    bool behind_schedule(CephContext *cct, utime_t now) const;
+    /// account a completed chunk and adjust chunk_objects
+    void update_pace(CephContext *cct, const ScrubMap &chunk);
+    /// bytes of object data the next scrub step is expected to read
+    uint64_t get_step_bytes(CephContext *cct) const;
+
     list<Context*> callbacks;
     void add_callback(Context *context) {
       callbacks.push_back(context);
@@ -1282,6 +1300,11 @@ public:
       sleeping = false;
       needs_sleep = true;
       sleep_start = utime_t();
+      scrub_start_stamp = utime_t();
+      chunk_start_stamp = utime_t();
+      work_expected = 0;
+      work_done = 0;
+      chunk_objects = 0;
     }
 
     void create_results(const hobject_t& obj);
@@ -288,6 +288,8 @@ typedef std::shared_ptr<const OSDMap> OSDMapRef;
      virtual entity_name_t get_cluster_msgr_name() = 0;
 
      virtual PerfCounters *get_logger() = 0;
+     /// objects per recovery slot (and multiple of osd_max_push_objects)
+     virtual unsigned get_recovery_batch() = 0;
 
      virtual ceph_tid_t get_tid() = 0;
 
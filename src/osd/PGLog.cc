@@ -169,9 +169,66 @@ void PGLog::clear() {
   missing.clear();
   log.clear();
   log_keys_debug.clear();
+  modset = pg_modset_t();
+  dirty_modset = false;
   undirty();
 }
 
+void PGLog::note_modset(const pg_log_entry_t& e)
+{
+  if (modset.is_tracking() &&
+      modset.note(e, cct->_conf.get_val<uint64_t>("osd_pg_modset_entries")))
+    dirty_modset = true;
+}
+
+void PGLog::set_modset_split_bits(unsigned split_bits)
+{
+  unsigned bits = cct->_conf.get_val<uint64_t>("osd_pg_modset_bits");
+  if (!bits) {
+    if (modset.is_tracking()) {
+      dout(10) << __func__ << " no longer tracking modified buckets" << dendl;
+      modset = pg_modset_t();
+      dirty_modset = true;
+    }
+    return;
+  }
+  bits = std::min(bits, 32 - split_bits);
+  if (modset.is_tracking() &&
+      modset.get_split_bits() == split_bits &&
+      modset.cur.buckets.bits == bits)
+    return;
+  dout(10) << __func__ << " tracking " << (1u << bits)
+	   << " modified buckets from " << log.head
+	   << " (was " << modset << ")" << dendl;
+  modset.reset(split_bits, bits, log.head);
+  dirty_modset = true;
+}
+
+void PGLog::read_modset(
+  ObjectStore *store,
+  ObjectStore::CollectionHandle& ch,
+  const ghobject_t& pgmeta_oid,
+  const pg_info_t &info)
+{
+  modset = pg_modset_t();
+  dirty_modset = false;
+  map<string,bufferlist> values;
+  int r = store->omap_get_values(ch, pgmeta_oid, {"_modset"}, &values);
+  auto p = values.find("_modset");
+  if (r < 0 || p == values.end())
+    return;
+  try {
+    auto bp = p->second.cbegin();
+    decode(modset, bp);
+  } catch (ceph::buffer::error& e) {
+    derr << __func__ << " failed to decode modset: " << e.what() << dendl;
+    modset = pg_modset_t();
+    return;
+  }
+  modset.set_head(info.last_update);
+  dout(10) << __func__ << " " << modset << dendl;
+}
+
 void PGLog::clear_info_log(
   spg_t pgid,
   ObjectStore::Transaction *t) {
@@ -336,6 +393,7 @@ void PGLog::rewind_divergent_log(eversion_t newhead,
   if (!divergent.empty()) {
     mark_dirty_from(divergent.front().version);
   }
+  rewind_modset(newhead);
   for (auto &&entry: divergent) {
     dout(10) << "rewind_divergent_log future divergent " << entry << dendl;
   }
@@ -449,6 +507,7 @@ void PGLog::merge_log(pg_info_t &oinfo, pg_log_t &olog, pg_shard_t fromosd,
     eversion_t original_crt = log.get_can_rollback_to();
     dout(20) << __func__ << " original_crt = " << original_crt << dendl;
     auto divergent = log.rewind_from_head(lower_bound);
+    rewind_modset(lower_bound);
     // move aside divergent items
     for (auto &&oe: divergent) {
       dout(10) << "merge_log divergent " << oe << dendl;
@@ -465,6 +524,9 @@ void PGLog::merge_log(pg_info_t &oinfo, pg_log_t &olog, pg_shard_t fromosd,
       missing,
       rollbacker,
       this);
+    for (auto& e : new_entries) {
+      note_modset(e);
+    }
 
     _merge_divergent_entries(
       log,
@@ -645,7 +707,12 @@ void PGLog::write_log_and_missing(
       dirty_from_dups,
       write_from_dups,
       &may_include_deletes_in_missing_dirty,
-      (pg_log_debug ? &log_keys_debug : nullptr));
+      (pg_log_debug ? &log_keys_debug : nullptr),
+      cct->_conf.get_val<uint64_t>("osd_pg_log_dups_per_key"));
+    if (dirty_modset) {
+      encode(modset, (*km)["_modset"]);
+      dirty_modset = false;
+    }
     undirty();
   } else {
     dout(10) << "log is not dirty" << dendl;
@@ -692,7 +759,7 @@ void PGLog::write_log_and_missing(
     eversion_t::max(),
     eversion_t(),
     eversion_t(),
-    may_include_deletes_in_missing_dirty, nullptr);
+    may_include_deletes_in_missing_dirty, nullptr, 0);
 }
 
 // static
@@ -829,20 +896,17 @@ void PGLog::_write_log_and_missing(
   eversion_t dirty_from_dups,
   eversion_t write_from_dups,
   bool *may_include_deletes_in_missing_dirty, // in/out param
-  set<string> *log_keys_debug
+  set<string> *log_keys_debug,
+  unsigned dups_per_key
   ) {
   set<string> to_remove;
-  to_remove.swap(trimmed_dups);
   for (auto& t : trimmed) {
-    string key = t.get_key_name();
     if (log_keys_debug) {
-      auto it = log_keys_debug->find(key);
+      auto it = log_keys_debug->find(t.get_key_name());
       ceph_assert(it != log_keys_debug->end());
       log_keys_debug->erase(it);
     }
-    to_remove.emplace(std::move(key));
   }
-  trimmed.clear();
 
   if (touch_log)
     t.touch(coll, log_oid);
@@ -891,38 +955,43 @@ void PGLog::_write_log_and_missing(
 
   // process dups after log_keys_debug is filled, so dups do not
   // end up in that set
-  if (dirty_to_dups != eversion_t()) {
-    pg_log_dup_t min, dirty_to_dup;
-    dirty_to_dup.version = dirty_to_dups;
-    t.omap_rmkeyrange(
-      coll, log_oid,
-      min.get_key_name(), dirty_to_dup.get_key_name());
-  }
-  if (dirty_to_dups != eversion_t::max() && dirty_from_dups != eversion_t::max()) {
-    pg_log_dup_t max, dirty_from_dup;
-    max.version = eversion_t::max();
-    dirty_from_dup.version = dirty_from_dups;
-    t.omap_rmkeyrange(
-      coll, log_oid,
-      dirty_from_dup.get_key_name(), max.get_key_name());
-  }
+  if (dups_per_key) {
+    _write_dup_segments(t, km, log, coll, log_oid, dirty_to_dups,
+			dirty_from_dups, write_from_dups, dups_per_key);
+  } else {
+    if (dirty_to_dups != eversion_t()) {
+      pg_log_dup_t min, dirty_to_dup;
+      dirty_to_dup.version = dirty_to_dups;
+      t.omap_rmkeyrange(
+	coll, log_oid,
+	min.get_key_name(), dirty_to_dup.get_key_name());
+    }
+    if (dirty_to_dups != eversion_t::max() && dirty_from_dups != eversion_t::max()) {
+      pg_log_dup_t max, dirty_from_dup;
+      max.version = eversion_t::max();
+      dirty_from_dup.version = dirty_from_dups;
+      t.omap_rmkeyrange(
+	coll, log_oid,
+	dirty_from_dup.get_key_name(), max.get_key_name());
+    }
 
-  for (const auto& entry : log.dups) {
-    if (entry.version > dirty_to_dups)
-      break;
-    bufferlist bl;
-    encode(entry, bl);
-    (*km)[entry.get_key_name()].claim(bl);
-  }
+    for (const auto& entry : log.dups) {
+      if (entry.version > dirty_to_dups)
+	break;
+      bufferlist bl;
+      encode(entry, bl);
+      (*km)[entry.get_key_name()].claim(bl);
+    }
 
-  for (list<pg_log_dup_t>::reverse_iterator p = log.dups.rbegin();
-       p != log.dups.rend() &&
-	 (p->version >= dirty_from_dups || p->version >= write_from_dups) &&
-	 p->version >= dirty_to_dups;
-       ++p) {
-    bufferlist bl;
-    encode(*p, bl);
-    (*km)[p->get_key_name()].claim(bl);
+    for (list<pg_log_dup_t>::reverse_iterator p = log.dups.rbegin();
+	 p != log.dups.rend() &&
+	   (p->version >= dirty_from_dups || p->version >= write_from_dups) &&
+	   p->version >= dirty_to_dups;
+	 ++p) {
+      bufferlist bl;
+      encode(*p, bl);
+      (*km)[p->get_key_name()].claim(bl);
+    }
   }
 
   if (clear_divergent_priors) {
@@ -957,6 +1026,112 @@ void PGLog::_write_log_and_missing(
 
   if (!to_remove.empty())
     t.omap_rmkeys(coll, log_oid, to_remove);
+
+  // trimming only ever removes the oldest entries and dups, so drop
+  // everything up to the newest trimmed key with one range delete each
+  // rather than a delete per key.  The end bound sorts after that key
+  // (and after a dup segment keyed by it) but before any newer one.
+  if (!trimmed.empty()) {
+    t.omap_rmkeyrange(
+      coll, log_oid,
+      eversion_t().get_key_name(),
+      trimmed.rbegin()->get_key_name() + '\xff');
+    trimmed.clear();
+  }
+  if (!trimmed_dups.empty()) {
+    pg_log_dup_t min;
+    t.omap_rmkeyrange(
+      coll, log_oid,
+      min.get_key_name(), *trimmed_dups.rbegin() + '\xff');
+    trimmed_dups.clear();
+  }
+}
+
+// static
+void PGLog::_write_dup_segments(
+  ObjectStore::Transaction& t,
+  map<string,bufferlist> *km,
+  pg_log_t &log,
+  const coll_t& coll, const ghobject_t &log_oid,
+  eversion_t dirty_to_dups,
+  eversion_t dirty_from_dups,
+  eversion_t write_from_dups,
+  unsigned dups_per_key)
+{
+  // A segment that straddles dirty_to_dups or dirty_from_dups cannot be
+  // partly rewritten.  Those only move when peering merges dups, so
+  // rewrite them all then; otherwise just append the ones trim added.
+  auto first = log.dups.end();
+  if (dirty_to_dups != eversion_t() || dirty_from_dups != eversion_t::max()) {
+    pg_log_dup_t min, max;
+    max.version = eversion_t::max();
+    t.omap_rmkeyrange(
+      coll, log_oid,
+      min.get_key_name(), max.get_key_name() + '\xff');
+    first = log.dups.begin();
+  } else {
+    while (first != log.dups.begin() &&
+	   std::prev(first)->version >= write_from_dups) {
+      --first;
+    }
+  }
+
+  // keep the dups of one op (its extra reqids share its version) in one
+  // segment, so segment keys are unique
+  while (first != log.dups.end()) {
+    auto end = first;
+    uint32_t n = 0;
+    while (end != log.dups.end() &&
+	   (n < dups_per_key || std::prev(end)->version == end->version)) {
+      ++end;
+      ++n;
+    }
+    bufferlist bl;
+    ENCODE_START(1, 1, bl);
+    encode(n, bl);
+    for (auto p = first; p != end; ++p) {
+      encode(*p, bl);
+    }
+    ENCODE_FINISH(bl);
+    (*km)[get_dup_segment_key_name(*std::prev(end))].claim(bl);
+    first = end;
+  }
+}
+
+// static
+void PGLog::decode_dup_key(
+  const string& key,
+  bufferlist::const_iterator& bp,
+  std::list<pg_log_dup_t>& dups)
+{
+  if (!is_dup_segment_key(key)) {
+    pg_log_dup_t dup;
+    decode(dup, bp);
+    if (!dups.empty()) {
+      ceph_assert(dups.back().version < dup.version);
+    }
+    dups.push_back(dup);
+    return;
+  }
+  DECODE_START(1, bp);
+  uint32_t n;
+  decode(n, bp);
+  bool took = false;
+  while (n--) {
+    pg_log_dup_t dup;
+    decode(dup, bp);
+    if (took) {
+      // the extra reqids of one op share its version
+      ceph_assert(dups.back().version <= dup.version);
+    } else if (!dups.empty() && dup.version <= dups.back().version) {
+      // a partly trimmed segment left behind by a rewrite with one key
+      // per dup repeats older dups; those keys already have them
+      continue;
+    }
+    dups.push_back(dup);
+    took = true;
+  }
+  DECODE_FINISH(bp);
 }
 
 void PGLog::rebuild_missing_set_with_deletes(
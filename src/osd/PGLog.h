@@ -20,6 +20,7 @@
 #include "include/ceph_assert.h"
 #include "osd_types.h"
 #include "os/ObjectStore.h"
+#include "include/flat_index.h"
 #include <list>
 
 #ifdef WITH_SEASTAR
@@ -68,15 +69,40 @@ struct PGLog : DoutPrefixProvider {
   using LogEntryHandlerRef = unique_ptr<LogEntryHandler>;
 
 public:
+  // keys of the IndexedLog indexes, read back from the indexed entries
+  struct entry_soid_t {
+    const hobject_t& operator()(const pg_log_entry_t& e) const {
+      return e.soid;
+    }
+  };
+  struct entry_reqid_t {
+    const osd_reqid_t& operator()(const pg_log_entry_t& e) const {
+      return e.reqid;
+    }
+  };
+  struct dup_reqid_t {
+    const osd_reqid_t& operator()(const pg_log_dup_t& e) const {
+      return e.reqid;
+    }
+  };
+
   /**
    * IndexLog - adds in-memory index of the log, by oid.
    * plus some methods to manipulate it all.
+   *
+   * objects, caller_ops and dup_index are flat tables of pointers into
+   * log and dups (the keys are not copied), so they cost a few words per
+   * entry and are accounted to the osd_pglog mempool.
    */
   struct IndexedLog : public pg_log_t {
-    mutable ceph::unordered_map<hobject_t,pg_log_entry_t*> objects;  // ptrs into log.  be careful!
-    mutable ceph::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops;
+    // ptrs into log.  be careful!
+    mutable flat_index<hobject_t, pg_log_entry_t, entry_soid_t,
+		       mempool::mempool_osd_pglog> objects;
+    mutable flat_index<osd_reqid_t, pg_log_entry_t, entry_reqid_t,
+		       mempool::mempool_osd_pglog> caller_ops;
     mutable ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*> extra_caller_ops;
-    mutable ceph::unordered_map<osd_reqid_t,pg_log_dup_t*> dup_index;
+    mutable flat_index<osd_reqid_t, pg_log_dup_t, dup_reqid_t,
+		       mempool::mempool_osd_pglog> dup_index;
 
     // recovery pointers
     list<pg_log_entry_t>::iterator complete_to; // not inclusive of referenced item
@@ -273,16 +299,15 @@ public:
       ceph_assert(version);
       ceph_assert(user_version);
       ceph_assert(return_code);
-      ceph::unordered_map<osd_reqid_t,pg_log_entry_t*>::const_iterator p;
       if (!(indexed_data & PGLOG_INDEXED_CALLER_OPS)) {
         index_caller_ops();
       }
-      p = caller_ops.find(r);
-      if (p != caller_ops.end()) {
-	*version = p->second->version;
-	*user_version = p->second->user_version;
-	*return_code = p->second->return_code;
-	*op_returns = p->second->op_returns;
+      auto c = caller_ops.find(r);
+      if (c != caller_ops.end()) {
+	*version = c->second->version;
+	*user_version = c->second->user_version;
+	*return_code = c->second->return_code;
+	*op_returns = c->second->op_returns;
 	return true;
       }
 
@@ -291,7 +316,7 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS)) {
         index_extra_caller_ops();
       }
-      p = extra_caller_ops.find(r);
+      auto p = extra_caller_ops.find(r);
       if (p != extra_caller_ops.end()) {
 	uint32_t idx = 0;
 	for (auto i = p->second->extra_reqids.begin();
@@ -380,16 +405,21 @@ public:
       // IndexedLog (and indirectly through assignment operator)
       if (!to_index) return;
 
-      if (to_index & PGLOG_INDEXED_OBJECTS)
+      if (to_index & PGLOG_INDEXED_OBJECTS) {
 	objects.clear();
-      if (to_index & PGLOG_INDEXED_CALLER_OPS)
+	objects.reserve(log.size());
+      }
+      if (to_index & PGLOG_INDEXED_CALLER_OPS) {
 	caller_ops.clear();
+	caller_ops.reserve(log.size());
+      }
       if (to_index & PGLOG_INDEXED_EXTRA_CALLER_OPS)
 	extra_caller_ops.clear();
       if (to_index & PGLOG_INDEXED_DUPS) {
 	dup_index.clear();
+	dup_index.reserve(dups.size());
 	for (auto& i : dups) {
-	  dup_index[i.reqid] = const_cast<pg_log_dup_t*>(&i);
+	  dup_index.insert_or_assign(const_cast<pg_log_dup_t*>(&i));
 	}
       }
 
@@ -404,13 +434,13 @@ public:
 	     ++i) {
 	  if (to_index & PGLOG_INDEXED_OBJECTS) {
 	    if (i->object_is_indexed()) {
-	      objects[i->soid] = const_cast<pg_log_entry_t*>(&(*i));
+	      objects.insert_or_assign(const_cast<pg_log_entry_t*>(&(*i)));
 	    }
 	  }
 
 	  if (to_index & PGLOG_INDEXED_CALLER_OPS) {
 	    if (i->reqid_is_indexed()) {
-	      caller_ops[i->reqid] = const_cast<pg_log_entry_t*>(&(*i));
+	      caller_ops.insert_or_assign(const_cast<pg_log_entry_t*>(&(*i)));
 	    }
 	  }
 
@@ -446,14 +476,14 @@ public:
 
     void index(pg_log_entry_t& e) {
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
-        if (objects.count(e.soid) == 0 ||
-            objects[e.soid]->version < e.version)
-          objects[e.soid] = &e;
+        auto it = objects.find(e.soid);
+        if (it == objects.end() || it->second->version < e.version)
+          objects.insert_or_assign(&e);
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
 	// divergent merge_log indexes new before unindexing old
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &e;
+	  caller_ops.insert_or_assign(&e);
         }
       }
       if (indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS) {
@@ -507,7 +537,7 @@ public:
 
     void index(pg_log_dup_t& e) {
       if (indexed_data & PGLOG_INDEXED_DUPS) {
-	dup_index[e.reqid] = &e;
+	dup_index.insert_or_assign(&e);
       }
     }
 
@@ -542,11 +572,11 @@ public:
 
       // to our index
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
-        objects[e.soid] = &(log.back());
+        objects.insert_or_assign(&(log.back()));
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &(log.back());
+	  caller_ops.insert_or_assign(&(log.back()));
         }
       }
 
@@ -595,6 +625,8 @@ protected:
   bool dirty_log;
   bool clear_divergent_priors;
   bool may_include_deletes_in_missing_dirty = false;
+  pg_modset_t modset;          ///< buckets recent entries touched
+  bool dirty_modset = false;
 
   void mark_dirty_to(eversion_t to) {
     if (to > dirty_to)
@@ -632,7 +664,8 @@ public:
       (dirty_to_dups != eversion_t()) ||
       (dirty_from_dups != eversion_t::max()) ||
       (write_from_dups != eversion_t::max()) ||
-      may_include_deletes_in_missing_dirty;
+      may_include_deletes_in_missing_dirty ||
+      dirty_modset;
   }
 
   void mark_log_for_rewrite() {
@@ -665,6 +698,17 @@ protected:
   }
 
   void check();
+  void note_modset(const pg_log_entry_t& e);
+  void reset_modset(eversion_t head) {
+    if (modset.is_tracking()) {
+      modset.reset(modset.get_split_bits(), modset.cur.buckets.bits, head);
+      dirty_modset = true;
+    }
+  }
+  void rewind_modset(eversion_t newhead) {
+    if (modset.rewind(newhead))
+      dirty_modset = true;
+  }
   void undirty() {
     dirty_to = eversion_t();
     dirty_from = eversion_t::max();
@@ -733,8 +777,16 @@ public:
   void add(const pg_log_entry_t& e, bool applied = true) {
     mark_writeout_from(e.version);
     log.add(e, applied);
+    note_modset(e);
   }
 
+  //////////////////// modified buckets ////////////////////
+
+  const pg_modset_t& get_modset() const { return modset; }
+
+  /// (re)start tracking if the pg's split bits or our config changed
+  void set_modset_split_bits(unsigned split_bits);
+
   void reset_recovery_pointers() { log.reset_recovery_pointers(); }
 
   static void clear_info_log(
@@ -776,6 +828,7 @@ public:
     log.trim_rollback_info_to(log.head, h);
     log.claim_log_and_clear_rollback_info(o);
     missing.clear();
+    reset_modset(o.head);
     mark_dirty_to(eversion_t::max());
     mark_dirty_to_dups(eversion_t::max());
   }
@@ -806,6 +859,7 @@ public:
       slogs.push_back(&s->log);
     }
     log.merge_from(slogs, last_update);
+    reset_modset(last_update);
 
     index();
 
@@ -984,8 +1038,7 @@ protected:
 		       << " last_divergent_update: " << last_divergent_update
 		       << dendl;
 
-    ceph::unordered_map<hobject_t, pg_log_entry_t*>::const_iterator objiter =
-      log.objects.find(hoid);
+    auto objiter = log.objects.find(hoid);
     if (objiter != log.objects.end() &&
 	objiter->second->version >= first_divergent_update) {
       /// Case 1)
@@ -1246,6 +1299,9 @@ public:
       missing,
       rollbacker,
       this);
+    for (auto& e : entries) {
+      note_modset(e);
+    }
     if (!entries.empty()) {
       mark_writeout_from(entries.begin()->version);
       if (entries.begin()->is_lost_delete()) {
@@ -1324,9 +1380,38 @@ public:
     eversion_t dirty_from_dups,
     eversion_t write_from_dups,
     bool *may_include_deletes_in_missing_dirty,
-    set<string> *log_keys_debug
+    set<string> *log_keys_debug,
+    unsigned dups_per_key
     );
 
+  /**
+   * dups may be stored as segments of several dups per omap key,
+   * keyed by the last dup they hold, so that a key range delete up to
+   * the newest trimmed dup removes exactly the wholly trimmed segments
+   * (see osd_pg_log_dups_per_key).
+   */
+  static void _write_dup_segments(
+    ObjectStore::Transaction& t,
+    map<string,bufferlist>* km,
+    pg_log_t &log,
+    const coll_t& coll, const ghobject_t &log_oid,
+    eversion_t dirty_to_dups,
+    eversion_t dirty_from_dups,
+    eversion_t write_from_dups,
+    unsigned dups_per_key);
+  static std::string get_dup_segment_key_name(const pg_log_dup_t& last) {
+    return last.get_key_name() + ".seg";
+  }
+  static bool is_dup_segment_key(const std::string& key) {
+    return key.size() > 4 && key.compare(key.size() - 4, 4, ".seg") == 0;
+  }
+  /// decode the value of a dup_ key (one dup or a segment) onto dups,
+  /// which are read in key order and so must come out in version order
+  static void decode_dup_key(
+    const std::string& key,
+    ceph::buffer::list::const_iterator& bp,
+    std::list<pg_log_dup_t>& dups);
+
   void read_log_and_missing(
     ObjectStore *store,
     ObjectStore::CollectionHandle& ch,
@@ -1336,7 +1421,7 @@ public:
     bool tolerate_divergent_missing_log,
     bool debug_verify_stored_missing = false
     ) {
-    return read_log_and_missing(
+    read_log_and_missing(
       store, ch, pgmeta_oid, info,
       log, missing, oss,
       tolerate_divergent_missing_log,
@@ -1344,7 +1429,13 @@ public:
       this,
       (pg_log_debug ? &log_keys_debug : nullptr),
       debug_verify_stored_missing);
+    read_modset(store, ch, pgmeta_oid, info);
   }
+  void read_modset(
+    ObjectStore *store,
+    ObjectStore::CollectionHandle& ch,
+    const ghobject_t& pgmeta_oid,
+    const pg_info_t &info);
 
   template <typename missing_type>
   static void read_log_and_missing(
@@ -1410,12 +1501,7 @@ public:
 	  }
 	  missing.add(oid, std::move(item));
 	} else if (p->key().substr(0, 4) == string("dup_")) {
-	  pg_log_dup_t dup;
-	  decode(dup, bp);
-	  if (!dups.empty()) {
-	    ceph_assert(dups.back().version < dup.version);
-	  }
-	  dups.push_back(dup);
+	  decode_dup_key(p->key(), bp, dups);
 	} else {
 	  pg_log_entry_t e;
 	  e.decode_with_checksum(bp);
@@ -1654,12 +1740,7 @@ public:
 	}
 	missing.add(oid, std::move(item));
       } else if (p.first.substr(0, 4) == string("dup_")) {
-	pg_log_dup_t dup;
-	decode(dup, bp);
-	if (!dups.empty()) {
-	  ceph_assert(dups.back().version < dup.version);
-	}
-	dups.push_back(dup);
+	decode_dup_key(p.first, bp, dups);
       } else {
 	pg_log_entry_t e;
 	e.decode_with_checksum(bp);
@@ -1693,12 +1774,12 @@ public:
 	    });
 	}).then([this, reader{std::move(reader)}]() {
           log = IndexedLog(
-	     info.last_update,
-	     info.log_tail,
-	     on_disk_can_rollback_to,
-	     on_disk_rollback_info_trimmed_to,
-	     std::move(entries),
-	     std::move(dups));
+	    info.last_update,
+	    info.log_tail,
+	    on_disk_can_rollback_to,
+	    on_disk_rollback_info_trimmed_to,
+	    std::move(entries),
+	    std::move(dups));
           return seastar::now();
         });
     }
@@ -0,0 +1,135 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "PeeringOutbox.h"
+
+#include "common/dout.h"
+#include "common/perf_counters.h"
+#include "messages/MOSDPGNotify.h"
+#include "messages/MOSDPGNotify2.h"
+#include "messages/MOSDPGQuery.h"
+#include "messages/MOSDPGQuery2.h"
+#include "osd_perf_counters.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_osd
+#undef dout_prefix
+#define dout_prefix *_dout << lock_name << " "
+
+void PeeringOutbox::send(
+  int peer,
+  const ConnectionRef& con,
+  MessageRef m,
+  PerfCounters *logger)
+{
+  unsigned max = cct->_conf.get_val<uint64_t>("osd_peering_batch_max");
+  std::lock_guard l(lock);
+  auto p = batches.find(peer);
+  if (p != batches.end() && p->second.con != con) {
+    // reconnected; what we have goes (or is lost) with the old session
+    _flush(peer, p->second, logger);
+    batches.erase(p);
+    p = batches.end();
+  }
+  if (max <= 1 ||
+      (m->get_type() != MSG_OSD_PG_NOTIFY2 &&
+       m->get_type() != MSG_OSD_PG_QUERY2)) {
+    // anything we do not batch must not pass what its pg batched earlier
+    if (p != batches.end()) {
+      _flush(peer, p->second, logger);
+      batches.erase(p);
+    }
+    con->send_message2(std::move(m));
+    return;
+  }
+  if (p == batches.end()) {
+    p = batches.emplace(peer, batch_t()).first;
+    p->second.con = con;
+  }
+  auto& b = p->second;
+  if (m->get_type() == MSG_OSD_PG_NOTIFY2) {
+    auto n = static_cast<MOSDPGNotify2*>(m.get());
+    if (b.queries.count(n->spgid)) {
+      // keep this pg's query ahead of its notify
+      _flush(peer, b, logger);
+    }
+    b.notify_epoch = std::max(b.notify_epoch, n->notify.epoch_sent);
+    b.notifies.push_back(n->notify);
+    b.notify_pgs.insert(n->spgid);
+  } else {
+    auto q = static_cast<MOSDPGQuery2*>(m.get());
+    if (b.notify_pgs.count(q->spgid) || b.queries.count(q->spgid)) {
+      _flush(peer, b, logger);
+    }
+    b.query_epoch = std::max(b.query_epoch, q->query.epoch_sent);
+    b.queries.emplace(q->spgid, q->query);
+  }
+  if (since.load() == ceph::mono_time()) {
+    since = ceph::mono_clock::now();
+  }
+  if (b.size() >= max) {
+    _flush(peer, b, logger);
+    batches.erase(p);
+  }
+}
+
+void PeeringOutbox::maybe_flush(bool idle, PerfCounters *logger)
+{
+  auto s = since.load();
+  if (s == ceph::mono_time()) {
+    return;
+  }
+  if (!idle &&
+      ceph::mono_clock::now() - s < ceph::make_timespan(
+	cct->_conf.get_val<double>("osd_peering_batch_max_delay"))) {
+    return;
+  }
+  std::lock_guard l(lock);
+  for (auto& [peer, b] : batches) {
+    _flush(peer, b, logger);
+  }
+  batches.clear();
+  since = ceph::mono_time();
+}
+
+size_t PeeringOutbox::get_num_batched()
+{
+  std::lock_guard l(lock);
+  size_t n = 0;
+  for (auto& [peer, b] : batches) {
+    n += b.size();
+  }
+  return n;
+}
+
+void PeeringOutbox::_flush(int peer, batch_t& b, PerfCounters *logger)
+{
+  ceph_assert(ceph_mutex_is_locked_by_me(lock));
+  auto n = b.size();
+  if (n == 0) {
+    return;
+  }
+  dout(20) << __func__ << " osd." << peer << " " << b.notifies.size()
+	   << " notifies " << b.queries.size() << " queries" << dendl;
+  // the multi-pg messages predate MOSDPGNotify2/MOSDPGQuery2 and are
+  // still understood by every osd
+  unsigned msgs = 0;
+  if (!b.notifies.empty()) {
+    b.con->send_message2(
+      make_message<MOSDPGNotify>(b.notify_epoch, std::move(b.notifies)));
+    ++msgs;
+  }
+  if (!b.queries.empty()) {
+    b.con->send_message2(
+      make_message<MOSDPGQuery>(b.query_epoch, std::move(b.queries)));
+    ++msgs;
+  }
+  if (logger) {
+    logger->inc(l_osd_peering_batch_msgs, msgs);
+    logger->inc(l_osd_peering_batched, n);
+  }
+  b.notifies.clear();
+  b.notify_pgs.clear();
+  b.queries.clear();
+  b.notify_epoch = b.query_epoch = 0;
+}
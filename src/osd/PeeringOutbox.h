@@ -0,0 +1,72 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common/ceph_context.h"
+#include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
+#include "msg/Connection.h"
+#include "msg/Message.h"
+#include "osd_types.h"
+
+class PerfCounters;
+
+/**
+ * PeeringOutbox: peering notifies and queries from one shard's pgs
+ *
+ * MOSDPGNotify2/MOSDPGQuery2 sent to the same peer osd are held so they
+ * go out as one multi-pg MOSDPGNotify/MOSDPGQuery (see
+ * osd_peering_batch_max).  A pg's peering messages stay in order: the
+ * others it sends to a peer, from a PeeringCtx or PG::send_cluster_message
+ * (logs, infos, reservations), also go through here and flush that
+ * peer's batch first, a notify and a query for the same pg never share
+ * a batch, and batches are sent under the outbox lock.  Replication and
+ * recovery ops go straight out through OSDService; they only follow
+ * peering that has completed, by which time nothing for the interval
+ * is left batched.
+ *
+ * The logger passed to send() and maybe_flush() may be null.
+ */
+class PeeringOutbox {
+  struct batch_t {
+    ConnectionRef con;
+    epoch_t notify_epoch = 0;
+    std::vector<pg_notify_t> notifies;
+    std::set<spg_t> notify_pgs;
+    epoch_t query_epoch = 0;
+    std::map<spg_t,pg_query_t> queries;
+    size_t size() const {
+      return notifies.size() + queries.size();
+    }
+  };
+
+  CephContext *cct;
+  std::string lock_name;
+  ceph::mutex lock;
+  std::map<int,batch_t> batches;   ///< by peer osd
+  /// when the oldest batched message was queued, or zero
+  std::atomic<ceph::mono_time> since = {ceph::mono_time()};
+
+  void _flush(int peer, batch_t& b, PerfCounters *logger);
+
+public:
+  PeeringOutbox(CephContext *cct, const std::string& name)
+    : cct(cct),
+      lock_name(name + "::peering_outbox_lock"),
+      lock(ceph::make_mutex(lock_name)) {}
+
+  /// send (or batch) a peering message from one of our pgs to peer
+  void send(int peer, const ConnectionRef& con, MessageRef m,
+	    PerfCounters *logger);
+  /// send batched messages if idle or if they have waited long enough
+  void maybe_flush(bool idle, PerfCounters *logger);
+  /// messages currently held, for tests
+  size_t get_num_batched();
+};
@@ -749,6 +749,10 @@ void PeeringState::on_new_interval()
     pg_log.get_missing().may_include_deletes ==
     !perform_deletes_during_peering());
 
+  // a split or merge reshapes the modified buckets; start over
+  pg_log.set_modset_split_bits(
+    info.pgid.pgid.get_split_bits(pool.info.get_pg_num()));
+
   init_hb_stamps();
 
   // update lease bounds for a new interval
@@ -864,6 +868,7 @@ void PeeringState::clear_primary_state()
   peer_missing_requested.clear();
   peer_info.clear();
   peer_bytes.clear();
+  peer_backfill_dirty.clear();
   peer_missing.clear();
   peer_last_complete_ondisk.clear();
   peer_activated.clear();
@@ -2302,6 +2307,21 @@ void PeeringState::build_might_have_unfound()
   psdout(15) << __func__ << ": built " << might_have_unfound << dendl;
 }
 
+/**
+ * A replica that was complete at pi.last_update still holds what we held
+ * then, apart from the objects in its missing set.  If that version is on
+ * our history and the modified bucket set reaches back to it, backfill
+ * need only look at the buckets that changed since, plus the buckets of
+ * the objects it is missing (which GetMissing fetches for this).
+ */
+bool PeeringState::can_backfill_incrementally(const pg_info_t &pi) const
+{
+  return !pool.info.is_erasure() &&
+    !pi.is_empty() &&
+    pi.last_backfill.is_max() &&
+    pg_log.get_modset().covers(pi.last_update);
+}
+
 void PeeringState::activate(
   ObjectStore::Transaction& t,
   epoch_t activation_epoch,
@@ -2463,6 +2483,19 @@ void PeeringState::activate(
 			       << "] " << pi.last_backfill
 			       << " to " << info.last_update;
 
+	if (can_backfill_incrementally(pi)) {
+	  pg_bucket_set_t dirty = pg_log.get_modset().get_dirty(pi.last_update);
+	  for (auto& p : pm.get_items()) {
+	    dirty.insert(dirty.bucket_of(p.first));
+	  }
+	  psdout(10) << "activate peer osd." << peer
+		     << " only needs backfill of " << dirty
+		     << " changed since " << pi.last_update << dendl;
+	  peer_backfill_dirty[peer] = std::move(dirty);
+	} else {
+	  peer_backfill_dirty.erase(peer);
+	}
+
 	pi.last_update = info.last_update;
 	pi.last_complete = info.last_update;
 	pi.set_last_backfill(hobject_t());
@@ -6794,6 +6827,23 @@ PeeringState::GetMissing::GetMissing(my_context ctx)
     if (pi.is_empty())
       continue;                                // no pg data, nothing divergent
 
+    if (pi.last_update < ps->pg_log.get_tail() &&
+	ps->can_backfill_incrementally(pi)) {
+      // we only need its missing set, to know which objects it lacks
+      // in buckets that did not change
+      psdout(10) << " osd." << *i << " is not contiguous, requesting missing"
+		 << " for incremental backfill" << dendl;
+      context< PeeringMachine >().send_query(
+	i->osd,
+	pg_query_t(
+	  pg_query_t::LOG,
+	  i->shard, ps->pg_whoami.shard,
+	  pi.last_update, ps->info.history,
+	  ps->get_osdmap_epoch()));
+      peer_missing_requested.insert(*i);
+      ps->blocked_by.insert(i->osd);
+      continue;
+    }
     if (pi.last_update < ps->pg_log.get_tail()) {
       psdout(10) << " osd." << *i << " is not contiguous, will restart backfill" << dendl;
       ps->peer_missing[*i].clear();
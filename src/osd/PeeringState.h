@@ -1413,6 +1413,8 @@ public:
   set<pg_shard_t>    stray_set; ///< non-acting osds that have PG data.
   map<pg_shard_t, pg_info_t>    peer_info; ///< info from peers (stray or prior)
   map<pg_shard_t, int64_t>    peer_bytes; ///< Peer's num_bytes from peer_info
+  /// buckets a backfill target may lack; targets not here need them all
+  map<pg_shard_t, pg_bucket_set_t> peer_backfill_dirty;
   set<pg_shard_t> peer_purged; ///< peers purged
   map<pg_shard_t, pg_missing_t> peer_missing; ///< peer missing sets
   set<pg_shard_t> peer_log_requested; ///< logs i've requested (and start stamps)
@@ -1562,6 +1564,7 @@ public:
     PeeringCtxWrapper &rctx);
   void build_might_have_unfound();
   void log_weirdness();
+  bool can_backfill_incrementally(const pg_info_t &pi) const;
   void activate(
     ObjectStore::Transaction& t,
     epoch_t activation_epoch,
@@ -2195,6 +2198,11 @@ public:
   bool has_peer_info(pg_shard_t peer) const {
     return peer_info.count(peer);
   }
+  /// the buckets backfill must scan on peer, or nullptr for all of them
+  const pg_bucket_set_t *get_peer_backfill_dirty(pg_shard_t peer) const {
+    auto p = peer_backfill_dirty.find(peer);
+    return p == peer_backfill_dirty.end() ? nullptr : &p->second;
+  }
 
   bool needs_recovery() const;
   bool needs_backfill() const;
@@ -514,7 +514,8 @@ bool PrimaryLogPG::should_send_op(
   bool should_send =
       hoid.pool != (int64_t)info.pgid.pool() ||
       hoid <= last_backfill_started ||
-      hoid <= recovery_state.get_peer_info(peer).last_backfill;
+      hoid <= recovery_state.get_peer_info(peer).last_backfill ||
+      is_backfill_clean(peer, hoid);
   if (!should_send) {
     ceph_assert(is_backfill_target(peer));
     dout(10) << __func__ << " issue_repop shipping empty opt to osd." << peer
@@ -2008,6 +2009,7 @@ void PrimaryLogPG::do_op(OpRequestRef& op)
   // missing object?
   if (is_unreadable_object(head)) {
     if (!is_primary()) {
+      osd->logger->inc(l_osd_op_r_replica_bounced);
       osd->reply_op_error(op, -EAGAIN);
       return;
     }
@@ -2131,11 +2133,13 @@ void PrimaryLogPG::do_op(OpRequestRef& op)
       dout(20) << __func__ << ": oid " << oid
 	       << " unstable write on replica, bouncing to primary."
 	       << *m << dendl;
+      osd->logger->inc(l_osd_op_r_replica_bounced);
       osd->reply_op_error(op, -EAGAIN);
       return;
     } else {
       dout(20) << __func__ << ": serving replica read on oid" << oid
 	       << dendl;
+      osd->logger->inc(l_osd_op_r_replica);
     }
   }
 
@@ -4161,7 +4165,8 @@ void PrimaryLogPG::do_scan(
 	cct->_conf->osd_backfill_scan_min,
 	cct->_conf->osd_backfill_scan_max,
 	&bi,
-	handle);
+	handle,
+	m->dirty.is_tracking() ? &m->dirty : nullptr);
       MOSDPGScan *reply = new MOSDPGScan(
 	MOSDPGScan::OP_SCAN_DIGEST,
 	pg_whoami,
@@ -4188,6 +4193,18 @@ void PrimaryLogPG::do_scan(
       bi.clear_objects();
       ::decode_noclear(bi.objects, p);
 
+      if (auto dirty = recovery_state.get_peer_backfill_dirty(from)) {
+	// a peer that does not filter lists clean buckets too; it has
+	// the same objects there that we do
+	for (auto i = bi.objects.begin(); i != bi.objects.end(); ) {
+	  if (dirty->contains(i->first)) {
+	    ++i;
+	  } else {
+	    i = bi.objects.erase(i);
+	  }
+	}
+      }
+
       if (waiting_on_backfill.erase(from)) {
 	if (waiting_on_backfill.empty()) {
 	  ceph_assert(
@@ -12996,6 +13013,25 @@ uint64_t PrimaryLogPG::recover_backfill(
     }
     backfill_info.reset(last_backfill_started);
 
+    // we need only scan the buckets some target lacks
+    backfill_local_dirty = pg_bucket_set_t();
+    for (auto& bt : get_backfill_targets()) {
+      auto dirty = recovery_state.get_peer_backfill_dirty(bt);
+      if (!dirty) {
+	backfill_local_dirty = pg_bucket_set_t();
+	break;
+      }
+      if (backfill_local_dirty.is_tracking()) {
+	backfill_local_dirty.merge(*dirty);
+      } else {
+	backfill_local_dirty = *dirty;
+      }
+    }
+    if (backfill_local_dirty.is_tracking()) {
+      dout(10) << __func__ << " scanning only " << backfill_local_dirty
+	       << dendl;
+    }
+
     backfills_in_flight.clear();
     pending_backfill_updates.clear();
   }
@@ -13058,6 +13094,9 @@ uint64_t PrimaryLogPG::recover_backfill(
 	  MOSDPGScan::OP_SCAN_GET_DIGEST, pg_whoami, e, get_last_peering_reset(),
 	  spg_t(info.pgid.pgid, bt.shard),
 	  pbi.end, hobject_t());
+	if (auto dirty = recovery_state.get_peer_backfill_dirty(bt)) {
+	  m->dirty = *dirty;
+	}
 	osd->send_message_osd_cluster(bt.osd, m, get_osdmap_epoch());
 	ceph_assert(waiting_on_backfill.find(bt) == waiting_on_backfill.end());
 	waiting_on_backfill.insert(bt);
@@ -13117,6 +13156,7 @@ uint64_t PrimaryLogPG::recover_backfill(
       eversion_t& obj_v = backfill_info.objects.begin()->second;
 
       vector<pg_shard_t> need_ver_targs, missing_targs, keep_ver_targs, skip_targs;
+      vector<pg_shard_t> clean_targs;
       for (set<pg_shard_t>::const_iterator i = get_backfill_targets().begin();
 	   i != get_backfill_targets().end();
 	   ++i) {
@@ -13135,10 +13175,15 @@ uint64_t PrimaryLogPG::recover_backfill(
           // Only include peers that we've caught up to their backfill line
 	  // otherwise, they only appear to be missing this object
 	  // because their pbi.begin > backfill_info.begin.
-          if (backfill_info.begin > pinfo.last_backfill)
-	    missing_targs.push_back(bt);
-	  else
+          if (backfill_info.begin > pinfo.last_backfill) {
+	    // a peer that has the object intact does not list it
+	    if (is_backfill_clean(bt, backfill_info.begin))
+	      clean_targs.push_back(bt);
+	    else
+	      missing_targs.push_back(bt);
+	  } else {
 	    skip_targs.push_back(bt);
+	  }
 	}
       }
 
@@ -13185,7 +13230,8 @@ uint64_t PrimaryLogPG::recover_backfill(
 	       << " keep_ver_targs=" << keep_ver_targs << dendl;
       dout(20) << "backfill_targets=" << get_backfill_targets()
 	       << " missing_targs=" << missing_targs
-	       << " skip_targs=" << skip_targs << dendl;
+	       << " skip_targs=" << skip_targs
+	       << " clean_targs=" << clean_targs << dendl;
 
       last_backfill_started = backfill_info.begin;
       add_to_stat.insert(backfill_info.begin); // XXX: Only one for all pushes?
@@ -13360,7 +13406,9 @@ void PrimaryLogPG::update_range(
     dout(10) << __func__<< ": bi is old, rescanning local backfill_info"
 	     << dendl;
     bi->version = info.last_update;
-    scan_range(local_min, local_max, bi, handle);
+    scan_range(local_min, local_max, bi, handle,
+	       backfill_local_dirty.is_tracking() ? &backfill_local_dirty :
+	       nullptr);
   }
 
   if (bi->version >= projected_last_update) {
@@ -13414,16 +13462,41 @@ void PrimaryLogPG::update_range(
 
 void PrimaryLogPG::scan_range(
   int min, int max, BackfillInterval *bi,
-  ThreadPool::TPHandle &handle)
+  ThreadPool::TPHandle &handle,
+  const pg_bucket_set_t *dirty)
 {
   ceph_assert(is_locked());
-  dout(10) << "scan_range from " << bi->begin << dendl;
+  dout(10) << "scan_range from " << bi->begin;
+  if (dirty)
+    *_dout << " in " << *dirty;
+  *_dout << dendl;
   bi->clear_objects();
 
   vector<hobject_t> ls;
   ls.reserve(max);
-  int r = pgbackend->objects_list_partial(bi->begin, min, max, &ls, &bi->end);
-  ceph_assert(r >= 0);
+  if (!dirty) {
+    int r = pgbackend->objects_list_partial(bi->begin, min, max, &ls, &bi->end);
+    ceph_assert(r >= 0);
+  } else {
+    // jump over the buckets that are not in the set, and keep listing
+    // until we have min objects from those that are
+    hobject_t pg_start = info.pgid.pgid.get_hobj_start();
+    hobject_t pos = dirty->next_in_set(pg_start, bi->begin);
+    vector<hobject_t> got;
+    while (!pos.is_max() && ls.size() < (size_t)min) {
+      handle.reset_tp_timeout();
+      got.clear();
+      int r = pgbackend->objects_list_partial(
+	pos, min - ls.size(), max - ls.size(), &got, &pos);
+      ceph_assert(r >= 0);
+      for (auto& o : got) {
+	if (dirty->contains(o))
+	  ls.push_back(o);
+      }
+      pos = dirty->next_in_set(pg_start, pos);
+    }
+    bi->end = pos;
+  }
   dout(10) << " got " << ls.size() << " items, next " << bi->end << dendl;
   dout(20) << ls << dendl;
 
@@ -557,6 +557,9 @@ public:
   }
 
   PerfCounters *get_logger() override;
+  unsigned get_recovery_batch() override {
+    return osd->get_recovery_batch();
+  }
 
   ceph_tid_t get_tid() override { return osd->get_tid(); }
 
@@ -1172,6 +1175,14 @@ protected:
   /// last backfill operation started
   hobject_t last_backfill_started;
   bool new_backfill;
+  /// buckets we scan locally for backfill; all if not tracking
+  pg_bucket_set_t backfill_local_dirty;
+
+  /// peer already has obj: its bucket did not change (see PeeringState)
+  bool is_backfill_clean(pg_shard_t peer, const hobject_t& obj) const {
+    auto dirty = recovery_state.get_peer_backfill_dirty(peer);
+    return dirty && !dirty->contains(obj);
+  }
 
   int prep_object_replica_pushes(const hobject_t& soid, eversion_t v,
 				 PGBackend::RecoveryHandle *h,
@@ -1322,10 +1333,12 @@ protected:
    * @min return at least this many items, unless we are done
    * @max return no more than this many items
    * @bi [out] resulting map of objects to eversion_t's
+   * @dirty only list objects in these buckets, if given
    */
   void scan_range(
     int min, int max, BackfillInterval *bi,
-    ThreadPool::TPHandle &handle
+    ThreadPool::TPHandle &handle,
+    const pg_bucket_set_t *dirty = nullptr
     );
 
   /// Update a hash range to reflect changes since the last scan
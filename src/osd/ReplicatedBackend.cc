@@ -611,6 +611,44 @@ void ReplicatedBackend::do_repop_reply(OpRequestRef op)
   }
 }
 
+void ReplicatedBackend::be_prefetch_data_digests(
+  ScrubMapBuilder &pos,
+  uint64_t size,
+  uint32_t fadvise_flags)
+{
+  const uint64_t stride = cct->_conf->osd_deep_scrub_stride;
+  const uint64_t depth =
+    cct->_conf.get_val<uint64_t>("osd_deep_scrub_store_digest_queue_depth");
+  const shard_id_t shard = get_parent()->whoami_shard().shard;
+  std::vector<ObjectStore::crc32c_read_t> reqs;
+
+  // the rest of the current object, stride by stride (including the
+  // final short or empty one that tells us we are done)...
+  const hobject_t &poid = pos.ls[pos.pos];
+  for (uint64_t off = pos.data_pos; reqs.size() < depth; off += stride) {
+    reqs.emplace_back(ghobject_t(poid, ghobject_t::NO_GEN, shard), off, stride);
+    if (off + stride > size) {
+      break;
+    }
+  }
+  // ...then the first stride of the objects that follow
+  for (size_t i = pos.pos + 1;
+       i < pos.ls.size() && reqs.size() < depth;
+       ++i) {
+    reqs.emplace_back(ghobject_t(pos.ls[i], ghobject_t::NO_GEN, shard),
+		      0, stride);
+  }
+  store->read_crc32c(ch, reqs, fadvise_flags);
+
+  for (auto& req : reqs) {
+    dout(20) << __func__ << "  " << req.oid.hobj << " 0x" << std::hex
+	     << req.offset << " crc 0x" << req.crc << std::dec
+	     << " r " << req.r << dendl;
+    pos.data_digests[std::make_pair(req.oid.hobj, req.offset)] =
+      std::make_pair(req.r, req.crc);
+  }
+}
+
 int ReplicatedBackend::be_deep_scrub(
   const hobject_t &poid,
   ScrubMap &map,
@@ -636,23 +674,40 @@ int ReplicatedBackend::be_deep_scrub(
       pos.data_hash = bufferhash(-1);
     }
 
-    bufferlist bl;
-    r = store->read(
-      ch,
-      ghobject_t(
-	poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
-      pos.data_pos,
-      cct->_conf->osd_deep_scrub_stride, bl,
-      fadvise_flags);
+    if (cct->_conf.get_val<bool>("osd_deep_scrub_store_digest") &&
+	store->has_builtin_csum()) {
+      // let the store digest the data; it already checksums it anyway
+      auto p = pos.data_digests.find(std::make_pair(poid, pos.data_pos));
+      if (p == pos.data_digests.end()) {
+	be_prefetch_data_digests(pos, o.size, fadvise_flags);
+	p = pos.data_digests.find(std::make_pair(poid, pos.data_pos));
+	ceph_assert(p != pos.data_digests.end());
+      }
+      r = p->second.first;
+      if (r > 0) {
+	pos.data_hash = bufferhash(
+	  ceph_crc32c_extend(pos.data_hash.digest(), p->second.second, r));
+      }
+      pos.data_digests.erase(p);
+    } else {
+      bufferlist bl;
+      r = store->read(
+	ch,
+	ghobject_t(
+	  poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
+	pos.data_pos,
+	cct->_conf->osd_deep_scrub_stride, bl,
+	fadvise_flags);
+      if (r > 0) {
+	pos.data_hash << bl;
+      }
+    }
     if (r < 0) {
       dout(20) << __func__ << "  " << poid << " got "
 	       << r << " on read, read_error" << dendl;
       o.read_error = true;
       return 0;
     }
-    if (r > 0) {
-      pos.data_hash << bl;
-    }
     pos.data_pos += r;
     if (r == cct->_conf->osd_deep_scrub_stride) {
       dout(20) << __func__ << "  " << poid << " more data, digest so far 0x"
@@ -1943,6 +1998,10 @@ void ReplicatedBackend::send_pushes(int prio, map<pg_shard_t, vector<PushOp> > &
       get_osdmap_epoch());
     if (!con)
       continue;
+    // small objects are coalesced further while the osd is recovering in
+    // batches (see OSDService::recovery_recalibrate)
+    uint64_t max_pushes =
+      cct->_conf->osd_max_push_objects * get_parent()->get_recovery_batch();
     vector<PushOp>::iterator j = i->second.begin();
     while (j != i->second.end()) {
       uint64_t cost = 0;
@@ -1957,7 +2016,7 @@ void ReplicatedBackend::send_pushes(int prio, map<pg_shard_t, vector<PushOp> > &
       for (;
            (j != i->second.end() &&
 	    cost < cct->_conf->osd_max_push_cost &&
-	    pushes < cct->_conf->osd_max_push_objects) ;
+	    pushes < max_pushes) ;
 	   ++j) {
 	dout(20) << __func__ << ": sending push " << *j
 		 << " to osd." << i->first << dendl;
@@ -1966,6 +2025,7 @@ void ReplicatedBackend::send_pushes(int prio, map<pg_shard_t, vector<PushOp> > &
 	msg->pushes.push_back(*j);
       }
       msg->set_cost(cost);
+      get_parent()->get_logger()->inc(l_osd_push_objects, pushes);
       get_parent()->send_message_osd_cluster(msg, con);
     }
   }
@@ -431,6 +431,10 @@ private:
     ScrubMap &map,
     ScrubMapBuilder &pos,
     ScrubMap::object &o) override;
+  void be_prefetch_data_digests(
+    ScrubMapBuilder &pos,
+    uint64_t size,
+    uint32_t fadvise_flags);
   uint64_t be_get_ondisk_size(uint64_t logical_size) override { return logical_size; }
 };
 
@@ -123,6 +123,12 @@ PerfCounters *build_osd_logger(CephContext *cct) {
     "Latency of IO before calling queue(before really queue into ShardedOpWq)"); // client io before queue op_wq latency
   osd_plb.add_time_avg(l_osd_op_before_dequeue_op_lat, "op_before_dequeue_op_lat",
     "Latency of IO before calling dequeue_op(already dequeued and get PG lock)"); // client io before dequeue_op latency
+  osd_plb.add_u64_counter(
+    l_osd_op_r_replica, "op_r_replica",
+    "Balanced client reads served as a replica");
+  osd_plb.add_u64_counter(
+    l_osd_op_r_replica_bounced, "op_r_replica_bounced",
+    "Balanced client reads bounced to the primary (missing or unstable object)");
 
   osd_plb.add_u64_counter(
     l_osd_sop, "subop", "Suboperations");
@@ -159,6 +165,20 @@ PerfCounters *build_osd_logger(CephContext *cct) {
    l_osd_rbytes, "recovery_bytes",
    "recovery bytes",
    "rbt", PerfCountersBuilder::PRIO_INTERESTING);
+  osd_plb.add_u64_counter(
+    l_osd_robjects, "recovery_objects", "Finished recovery operations");
+  osd_plb.add_u64(
+    l_osd_rbytes_sec, "recovery_bytes_per_sec",
+    "Recovery bytes per second over the last tick", NULL, 0,
+    unit_t(UNIT_BYTES));
+  osd_plb.add_u64(
+    l_osd_robjects_sec, "recovery_objects_per_sec",
+    "Recovery operations finished per second over the last tick");
+  osd_plb.add_u64(
+    l_osd_recovery_batch, "recovery_batch",
+    "Objects each recovery slot may cover (see osd_recovery_max_batch)");
+  osd_plb.add_u64_avg(
+    l_osd_push_objects, "push_objects", "Objects per push message");
 
   osd_plb.add_u64(l_osd_loadavg, "loadavg", "CPU load");
   osd_plb.add_u64(
@@ -276,6 +296,39 @@ PerfCounters *build_osd_logger(CephContext *cct) {
   osd_plb.add_u64_counter(
     l_osd_pg_biginfo, "osd_pg_biginfo", "PG updated its biginfo attr");
 
+  osd_plb.add_u64_counter(
+    l_osd_numa_remote_op, "numa_remote_op",
+    "Items processed by an op shard thread running outside the shard's "
+    "numa node");
+  osd_plb.add_u64_counter(
+    l_osd_numa_local_pages, "numa_local_pages",
+    "Pages allocated on the op shard numa node by tasks running on it "
+    "(system-wide)");
+  osd_plb.add_u64_counter(
+    l_osd_numa_other_pages, "numa_other_pages",
+    "Pages allocated on the op shard numa node by tasks running on other "
+    "nodes (system-wide)");
+
+  osd_plb.add_time_avg(
+    l_osd_boot_load_pgs_lat, "boot_load_pgs_lat",
+    "Time spent reading PG metadata at startup");
+  osd_plb.add_time_avg(
+    l_osd_boot_up_lat, "boot_up_lat",
+    "Time from loading PGs at startup to being marked up");
+  osd_plb.add_time_avg(
+    l_osd_boot_pg_active_lat, "boot_pg_active_lat",
+    "Time from being marked up to each PG loaded at startup going active");
+  osd_plb.add_u64(
+    l_osd_boot_pgs_pending, "boot_pgs_pending",
+    "PGs loaded at startup that have not been active since");
+
+  osd_plb.add_u64_counter(
+    l_osd_peering_batched, "peering_batched",
+    "PG notifies and queries coalesced into per-OSD messages");
+  osd_plb.add_u64_counter(
+    l_osd_peering_batch_msgs, "peering_batch_msgs",
+    "Coalesced PG notify and query messages sent");
+
   return osd_plb.create_perf_counters();
 }
  
@@ -37,6 +37,8 @@ enum {
 
   l_osd_op_before_queue_op_lat,
   l_osd_op_before_dequeue_op_lat,
+  l_osd_op_r_replica,
+  l_osd_op_r_replica_bounced,
 
   l_osd_sop,
   l_osd_sop_inb,
@@ -56,6 +58,11 @@ enum {
 
   l_osd_rop,
   l_osd_rbytes,
+  l_osd_robjects,
+  l_osd_rbytes_sec,
+  l_osd_robjects_sec,
+  l_osd_recovery_batch,
+  l_osd_push_objects,
 
   l_osd_loadavg,
   l_osd_cached_crc,
@@ -117,6 +124,18 @@ enum {
   l_osd_pg_fastinfo,
   l_osd_pg_biginfo,
 
+  l_osd_numa_remote_op,
+  l_osd_numa_local_pages,
+  l_osd_numa_other_pages,
+
+  l_osd_boot_load_pgs_lat,
+  l_osd_boot_up_lat,
+  l_osd_boot_pg_active_lat,
+  l_osd_boot_pgs_pending,
+
+  l_osd_peering_batched,
+  l_osd_peering_batch_msgs,
+
   l_osd_last,
 };
 
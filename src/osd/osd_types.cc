@@ -5111,6 +5111,267 @@ ostream& pg_log_t::print(ostream& out) const
   return out;
 }
 
+// -- pg_bucket_set_t --
+
+bool pg_bucket_set_t::empty() const
+{
+  for (auto w : words) {
+    if (w)
+      return false;
+  }
+  return true;
+}
+
+unsigned pg_bucket_set_t::count() const
+{
+  unsigned n = 0;
+  for (auto w : words) {
+    n += __builtin_popcountll(w);
+  }
+  return n;
+}
+
+void pg_bucket_set_t::merge(const pg_bucket_set_t& o)
+{
+  ceph_assert(o.split_bits == split_bits && o.bits == bits);
+  for (unsigned i = 0; i < words.size(); ++i) {
+    words[i] |= o.words[i];
+  }
+}
+
+hobject_t pg_bucket_set_t::next_in_set(const hobject_t& pg_start,
+				       const hobject_t& pos) const
+{
+  if (!bits || pos.is_max()) {
+    return pos;
+  }
+  uint32_t b = bucket_of(pos);
+  if (test(b)) {
+    return pos;
+  }
+  for (++b; b < get_num_buckets(); ++b) {
+    if (test(b)) {
+      hobject_t start = pg_start;
+      start.set_bitwise_key_u32(
+	pg_start.get_bitwise_key_u32() | (b << (32 - split_bits - bits)));
+      return start;
+    }
+  }
+  return hobject_t::get_max();
+}
+
+void pg_bucket_set_t::encode(ceph::buffer::list &bl) const
+{
+  ENCODE_START(1, 1, bl);
+  encode(split_bits, bl);
+  encode(bits, bl);
+  encode(words, bl);
+  ENCODE_FINISH(bl);
+}
+
+void pg_bucket_set_t::decode(ceph::buffer::list::const_iterator &bl)
+{
+  DECODE_START(1, bl);
+  decode(split_bits, bl);
+  decode(bits, bl);
+  decode(words, bl);
+  DECODE_FINISH(bl);
+  if (split_bits + bits > 32 ||
+      words.size() != ((1u << bits) + 63) / 64) {
+    throw ceph::buffer::malformed_input("bad pg_bucket_set_t");
+  }
+}
+
+void pg_bucket_set_t::dump(Formatter *f) const
+{
+  f->dump_unsigned("split_bits", split_bits);
+  f->dump_unsigned("bits", bits);
+  f->dump_unsigned("count", count());
+}
+
+void pg_bucket_set_t::generate_test_instances(list<pg_bucket_set_t*>& o)
+{
+  o.push_back(new pg_bucket_set_t);
+  o.push_back(new pg_bucket_set_t(3, 10));
+  o.back()->insert(0);
+  o.back()->insert(700);
+}
+
+ostream& operator<<(ostream& out, const pg_bucket_set_t& s)
+{
+  if (!s.is_tracking()) {
+    return out << "buckets(all)";
+  }
+  return out << "buckets(" << s.count() << "/" << s.get_num_buckets() << ")";
+}
+
+// -- pg_modset_t --
+
+void pg_modset_t::reset(uint8_t split_bits, uint8_t bits, eversion_t h)
+{
+  cur = gen_t();
+  cur.since = h;
+  cur.buckets = pg_bucket_set_t(split_bits, bits);
+  prev = cur;
+  runs.clear();
+  head = h;
+}
+
+bool pg_modset_t::note(const pg_log_entry_t& e, uint32_t gen_entries)
+{
+  if (!is_tracking()) {
+    return false;
+  }
+  bool changed = false;
+  if (cur.entries >= gen_entries) {
+    prev = std::move(cur);
+    cur = gen_t();
+    cur.since = head;
+    cur.buckets = pg_bucket_set_t(prev.buckets.split_bits,
+				  prev.buckets.bits);
+    // older epochs only ran up to prev.since
+    runs.erase(runs.begin(), runs.lower_bound(prev.since.epoch));
+    changed = true;
+  }
+  ++cur.entries;
+  if (runs.empty() || runs.rbegin()->first < e.version.epoch) {
+    runs[e.version.epoch] = e.version.version;
+    changed = true;
+  }
+  if (cur.buckets.insert(cur.buckets.bucket_of(e.soid))) {
+    changed = true;
+  }
+  head = e.version;
+  return changed;
+}
+
+bool pg_modset_t::rewind(eversion_t newhead)
+{
+  if (!is_tracking() || newhead >= head) {
+    return false;
+  }
+  if (newhead < prev.since) {
+    reset(get_split_bits(), cur.buckets.bits, newhead);
+    return true;
+  }
+  runs.erase(runs.upper_bound(newhead.epoch), runs.end());
+  auto p = runs.find(newhead.epoch);
+  if (p != runs.end() && p->second > newhead.version) {
+    runs.erase(p);
+  }
+  // the marks of the divergent entries stay; they only cost us a
+  // little precision
+  if (newhead < cur.since) {
+    cur.since = newhead;
+  }
+  head = newhead;
+  return true;
+}
+
+bool pg_modset_t::covers(eversion_t v) const
+{
+  if (!is_tracking() || v < prev.since || v > head) {
+    return false;
+  }
+  if (v == prev.since) {
+    return true;
+  }
+  auto p = runs.find(v.epoch);
+  if (p == runs.end() || p->second > v.version) {
+    return false;
+  }
+  ++p;
+  return p == runs.end() || v.version < p->second;
+}
+
+pg_bucket_set_t pg_modset_t::get_dirty(eversion_t v) const
+{
+  ceph_assert(covers(v));
+  pg_bucket_set_t r = cur.buckets;
+  if (v < cur.since) {
+    r.merge(prev.buckets);
+  }
+  return r;
+}
+
+void pg_modset_t::gen_t::encode(ceph::buffer::list &bl) const
+{
+  ENCODE_START(1, 1, bl);
+  encode(since, bl);
+  encode(entries, bl);
+  encode(buckets, bl);
+  ENCODE_FINISH(bl);
+}
+
+void pg_modset_t::gen_t::decode(ceph::buffer::list::const_iterator &bl)
+{
+  DECODE_START(1, bl);
+  decode(since, bl);
+  decode(entries, bl);
+  decode(buckets, bl);
+  DECODE_FINISH(bl);
+}
+
+void pg_modset_t::encode(ceph::buffer::list &bl) const
+{
+  ENCODE_START(1, 1, bl);
+  encode(cur, bl);
+  encode(prev, bl);
+  encode(runs, bl);
+  ENCODE_FINISH(bl);
+}
+
+void pg_modset_t::decode(ceph::buffer::list::const_iterator &bl)
+{
+  DECODE_START(1, bl);
+  decode(cur, bl);
+  decode(prev, bl);
+  decode(runs, bl);
+  DECODE_FINISH(bl);
+}
+
+void pg_modset_t::dump(Formatter *f) const
+{
+  f->dump_stream("cur_since") << cur.since;
+  f->dump_unsigned("cur_entries", cur.entries);
+  f->open_object_section("cur_buckets");
+  cur.buckets.dump(f);
+  f->close_section();
+  f->dump_stream("prev_since") << prev.since;
+  f->dump_unsigned("prev_entries", prev.entries);
+  f->open_object_section("prev_buckets");
+  prev.buckets.dump(f);
+  f->close_section();
+  f->open_array_section("runs");
+  for (auto& [epoch, version] : runs) {
+    f->open_object_section("run");
+    f->dump_unsigned("epoch", epoch);
+    f->dump_unsigned("first", version);
+    f->close_section();
+  }
+  f->close_section();
+}
+
+void pg_modset_t::generate_test_instances(list<pg_modset_t*>& o)
+{
+  o.push_back(new pg_modset_t);
+  o.push_back(new pg_modset_t);
+  o.back()->reset(2, 8, eversion_t(3, 10));
+  pg_log_entry_t e;
+  e.soid = hobject_t(object_t("foo"), "", CEPH_NOSNAP, 0x1234, 1, "");
+  e.version = eversion_t(4, 11);
+  o.back()->note(e, 2);
+}
+
+ostream& operator<<(ostream& out, const pg_modset_t& m)
+{
+  if (!m.is_tracking()) {
+    return out << "modset(none)";
+  }
+  return out << "modset(" << m.prev.since << "," << m.cur.since << ","
+	     << m.head << " " << m.prev.buckets << "/" << m.cur.buckets << ")";
+}
+
 // -- pg_missing_t --
 
 ostream& operator<<(ostream& out, const pg_missing_item& i)
@@ -4431,6 +4431,147 @@ inline std::ostream& operator<<(std::ostream& out, const pg_log_t& log)
 }
 
 
+/**
+ * pg_bucket_set_t - a set of buckets of a pg's slice of the hash space
+ *
+ * A pg's objects share the leading split_bits of their (bitwise sorted)
+ * hash key; the next bits of the key cut the pg into 1 << bits buckets,
+ * each a contiguous range of the pg in sort order.  bits == 0 means we
+ * are not tracking anything, which callers take as "everything".
+ */
+struct pg_bucket_set_t {
+  uint8_t split_bits = 0;
+  uint8_t bits = 0;
+  std::vector<uint64_t> words;
+
+  pg_bucket_set_t() = default;
+  pg_bucket_set_t(uint8_t split_bits, uint8_t bits)
+    : split_bits(split_bits),
+      bits(std::min<unsigned>(bits, 32 - split_bits)),
+      words(((1u << this->bits) + 63) / 64) {}
+
+  bool is_tracking() const {
+    return bits > 0;
+  }
+  uint32_t get_num_buckets() const {
+    return bits ? 1u << bits : 0;
+  }
+  uint32_t bucket_of(const hobject_t& o) const {
+    ceph_assert(bits);
+    if (o.is_max()) {
+      return get_num_buckets() - 1;
+    }
+    return uint32_t(uint64_t(o.get_bitwise_key_u32()) << split_bits) >>
+      (32 - bits);
+  }
+  bool test(uint32_t b) const {
+    return words[b / 64] & (1ull << (b % 64));
+  }
+  /// true if the bucket was not in the set before
+  bool insert(uint32_t b) {
+    uint64_t m = 1ull << (b % 64);
+    if (words[b / 64] & m) {
+      return false;
+    }
+    words[b / 64] |= m;
+    return true;
+  }
+  bool contains(const hobject_t& o) const {
+    return !bits || test(bucket_of(o));
+  }
+  void clear() {
+    std::fill(words.begin(), words.end(), 0);
+  }
+  bool empty() const;
+  unsigned count() const;
+  /// add the buckets of another set cut the same way
+  void merge(const pg_bucket_set_t& o);
+
+  /**
+   * the first position at or after pos that may hold an object in the
+   * set: pos itself if its bucket is in the set, otherwise the start of
+   * the next bucket that is, or max.
+   *
+   * @param pg_start the first object of the pg (pg_t::get_hobj_start())
+   */
+  hobject_t next_in_set(const hobject_t& pg_start, const hobject_t& pos) const;
+
+  void encode(ceph::buffer::list &bl) const;
+  void decode(ceph::buffer::list::const_iterator &bl);
+  void dump(ceph::Formatter *f) const;
+  static void generate_test_instances(std::list<pg_bucket_set_t*>& o);
+};
+WRITE_CLASS_ENCODER(pg_bucket_set_t)
+
+std::ostream& operator<<(std::ostream& out, const pg_bucket_set_t& s);
+
+/**
+ * pg_modset_t - which buckets of a pg changed recently
+ *
+ * Every log entry marks the bucket of its object.  Marks are kept in two
+ * generations of up to osd_pg_modset_entries entries each, so that for
+ * any version back to the start of the older generation we can say
+ * which buckets may have changed since.  We also keep where each epoch's
+ * run of entries starts, so that we can tell whether a version some
+ * other osd reports is on our history at all.
+ *
+ * Backfill uses this to skip the buckets that a target which used to be
+ * complete still has intact (see PeeringState::activate()).
+ */
+struct pg_modset_t {
+  struct gen_t {
+    eversion_t since;     ///< the marks cover entries after this
+    uint32_t entries = 0;
+    pg_bucket_set_t buckets;
+
+    void encode(ceph::buffer::list &bl) const;
+    void decode(ceph::buffer::list::const_iterator &bl);
+  };
+
+  gen_t cur, prev;
+  /// first version of each epoch's run of entries after prev.since
+  std::map<epoch_t, version_t> runs;
+  eversion_t head;        ///< last entry seen; not encoded (see set_head())
+
+  bool is_tracking() const {
+    return cur.buckets.is_tracking();
+  }
+  uint8_t get_split_bits() const {
+    return cur.buckets.split_bits;
+  }
+
+  /// start over at head, forgetting everything before it
+  void reset(uint8_t split_bits, uint8_t bits, eversion_t head);
+  /// the log head, when we read the modset back with the log
+  void set_head(eversion_t h) {
+    head = h;
+  }
+  /**
+   * mark the bucket of an entry added to the head of the log
+   *
+   * @param gen_entries entries per generation
+   * @return true if the encoded state changed
+   */
+  bool note(const pg_log_entry_t& e, uint32_t gen_entries);
+  /// forget entries after newhead, which were divergent
+  bool rewind(eversion_t newhead);
+
+  /// true if v is on our history, and we know what changed after it
+  bool covers(eversion_t v) const;
+  /// the buckets that may have changed after v, which we cover
+  pg_bucket_set_t get_dirty(eversion_t v) const;
+
+  void encode(ceph::buffer::list &bl) const;
+  void decode(ceph::buffer::list::const_iterator &bl);
+  void dump(ceph::Formatter *f) const;
+  static void generate_test_instances(std::list<pg_modset_t*>& o);
+};
+WRITE_CLASS_ENCODER(pg_modset_t::gen_t)
+WRITE_CLASS_ENCODER(pg_modset_t)
+
+std::ostream& operator<<(std::ostream& out, const pg_modset_t& m);
+
+
 /**
  * pg_missing_t - summary of missing objects.
  *
@@ -5835,6 +5976,8 @@ struct ScrubMapBuilder {
   ceph::buffer::hash data_hash, omap_hash;  ///< accumulatinng hash value
   uint64_t omap_keys = 0;
   uint64_t omap_bytes = 0;
+  /// prefetched (bytes, crc32c) of each (object, offset) data stride
+  std::map<std::pair<hobject_t, uint64_t>, std::pair<int, uint32_t>> data_digests;
 
   bool empty() {
     return ls.empty();
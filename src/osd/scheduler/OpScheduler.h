@@ -55,7 +55,7 @@ public:
 std::ostream &operator<<(std::ostream &lhs, const OpScheduler &);
 using OpSchedulerRef = std::unique_ptr<OpScheduler>;
 
-OpSchedulerRef make_scheduler(CephContext *cct);
+OpSchedulerRef make_scheduler(CephContext *cct, uint32_t shard_id);
 
 /**
  * Implements OpScheduler in terms of OpQueue
@@ -32,6 +32,7 @@ namespace ceph::osd::scheduler {
 enum class op_scheduler_class : uint8_t {
   background_recovery = 0,
   background_best_effort,
+  background_scrub,
   immediate,
   client,
 };
@@ -75,6 +76,11 @@ public:
       return 0;
     }
 
+    /// bytes of object data the item is expected to read, if known
+    virtual uint64_t get_scrub_bytes() const {
+      return 0;
+    }
+
     virtual bool is_peering() const {
       return false;
     }
@@ -144,6 +150,9 @@ public:
   uint64_t get_reserved_pushes() const {
     return qitem->get_reserved_pushes();
   }
+  uint64_t get_scrub_bytes() const {
+    return qitem->get_scrub_bytes();
+  }
   void run(OSD *osd, OSDShard *sdata,PGRef& pg, ThreadPool::TPHandle &handle) {
     qitem->run(osd, sdata, pg, handle);
   }
@@ -178,6 +187,9 @@ public:
      if (item.get_reserved_pushes()) {
        out << " reserved_pushes " << item.get_reserved_pushes();
      }
+     if (item.get_scrub_bytes()) {
+       out << " scrub_bytes " << item.get_scrub_bytes();
+     }
     return out << ")";
   }
 }; // class OpSchedulerItem
@@ -305,23 +317,31 @@ public:
 
 class PGScrub : public PGOpQueueable {
   epoch_t epoch_queued;
+  uint64_t scrub_bytes;
 public:
   PGScrub(
     spg_t pg,
-    epoch_t epoch_queued)
-    : PGOpQueueable(pg), epoch_queued(epoch_queued) {}
+    epoch_t epoch_queued,
+    uint64_t scrub_bytes = 0)
+    : PGOpQueueable(pg),
+      epoch_queued(epoch_queued),
+      scrub_bytes(scrub_bytes) {}
   op_type_t get_op_type() const final {
     return op_type_t::bg_scrub;
   }
   ostream &print(ostream &rhs) const final {
     return rhs << "PGScrub(pgid=" << get_pgid()
 	       << "epoch_queued=" << epoch_queued
+	       << "scrub_bytes=" << scrub_bytes
 	       << ")";
   }
+  uint64_t get_scrub_bytes() const final {
+    return scrub_bytes;
+  }
   void run(
     OSD *osd, OSDShard *sdata, PGRef& pg, ThreadPool::TPHandle &handle) final;
   op_scheduler_class get_scheduler_class() const final {
-    return op_scheduler_class::background_best_effort;
+    return op_scheduler_class::background_scrub;
   }
 };
 
@@ -18,6 +18,7 @@
 
 #include "osd/scheduler/mClockScheduler.h"
 #include "common/dout.h"
+#include "common/perf_counters_collection.h"
 
 namespace dmc = crimson::dmclock;
 using namespace std::placeholders;
@@ -30,16 +31,137 @@ using namespace std::placeholders;
 
 namespace ceph::osd::scheduler {
 
-mClockScheduler::mClockScheduler(CephContext *cct) :
+mClockScheduler::mClockScheduler(CephContext *cct, uint32_t shard_id) :
   scheduler(
     std::bind(&mClockScheduler::ClientRegistry::get_info,
 	      &client_registry,
 	      _1),
     dmc::AtLimit::Allow,
-    cct->_conf.get_val<double>("osd_mclock_scheduler_anticipation_timeout"))
+    cct->_conf.get_val<double>("osd_mclock_scheduler_anticipation_timeout")),
+  cct(cct)
 {
   cct->_conf.add_observer(this);
   client_registry.update_from_config(cct->_conf);
+  cost_model.update_from_config(cct->_conf);
+  init_logger(shard_id);
+}
+
+mClockScheduler::~mClockScheduler()
+{
+  cct->_conf.remove_observer(this);
+  if (logger) {
+    cct->get_perfcounters_collection()->remove(logger);
+    delete logger;
+  }
+}
+
+void mClockScheduler::init_logger(uint32_t shard_id)
+{
+  static const char *names[num_classes][l_mclock_per_class] = {
+    { "background_recovery_queued",
+      "background_recovery_dequeued",
+      "background_recovery_cost",
+      "background_recovery_queue_lat" },
+    { "background_best_effort_queued",
+      "background_best_effort_dequeued",
+      "background_best_effort_cost",
+      "background_best_effort_queue_lat" },
+    { "background_scrub_queued",
+      "background_scrub_dequeued",
+      "background_scrub_cost",
+      "background_scrub_queue_lat" },
+    { "immediate_queued",
+      "immediate_dequeued",
+      "immediate_cost",
+      "immediate_queue_lat" },
+    { "client_queued",
+      "client_dequeued",
+      "client_cost",
+      "client_queue_lat" },
+  };
+
+  PerfCountersBuilder b(cct, "mclock-shard-" + std::to_string(shard_id),
+			l_mclock_first,
+			l_mclock_first + 1 + num_classes * l_mclock_per_class);
+  for (size_t i = 0; i < num_classes; ++i) {
+    auto c = static_cast<op_scheduler_class>(i);
+    b.add_u64(counter_idx(c, l_mclock_queued), names[i][l_mclock_queued],
+	      "Items waiting in the queue");
+    b.add_u64_counter(counter_idx(c, l_mclock_dequeued),
+		      names[i][l_mclock_dequeued],
+		      "Items dequeued");
+    b.add_u64_counter(counter_idx(c, l_mclock_cost),
+		      names[i][l_mclock_cost],
+		      "Cost of items dequeued (bytes for background_scrub)");
+    b.add_time_avg(counter_idx(c, l_mclock_queue_lat),
+		   names[i][l_mclock_queue_lat],
+		   "Time from enqueue to dequeue");
+  }
+  logger = b.create_perf_counters();
+  cct->get_perfcounters_collection()->add(logger);
+}
+
+uint64_t mClockScheduler::calc_cost(const OpSchedulerItem &item) const
+{
+  switch (item.get_scheduler_class()) {
+  case op_scheduler_class::background_scrub:
+    // scrub reservations and limits are in bytes/sec
+    return std::max<uint64_t>(item.get_scrub_bytes(), 1);
+  case op_scheduler_class::client:
+    // the item cost of a client op is its message payload, which is
+    // all we know about its size before it is decoded
+    return cost_model.get_cost(std::max(item.get_cost(), 0));
+  default:
+    // TODO: size background recovery items once they carry a byte count
+    return 1;
+  }
+}
+
+void mClockScheduler::account_enqueue(const OpSchedulerItem &item)
+{
+  auto c = item.get_scheduler_class();
+  logger->set(counter_idx(c, l_mclock_queued),
+	      ++queued[static_cast<size_t>(c)]);
+}
+
+void mClockScheduler::account_dequeue(const OpSchedulerItem &item)
+{
+  auto c = item.get_scheduler_class();
+  logger->set(counter_idx(c, l_mclock_queued),
+	      --queued[static_cast<size_t>(c)]);
+  logger->inc(counter_idx(c, l_mclock_dequeued));
+  logger->inc(counter_idx(c, l_mclock_cost), calc_cost(item));
+  logger->tinc(counter_idx(c, l_mclock_queue_lat),
+	       ceph_clock_now() - item.get_start_time());
+}
+
+uint64_t mclock_cost_model_t::get_cost(uint64_t bytes) const
+{
+  if (!is_valid()) {
+    return 1;
+  }
+  return 1 + static_cast<uint64_t>(bytes * iops / bandwidth);
+}
+
+void mclock_cost_model_t::update_from_config(const ConfigProxy &conf)
+{
+  iops = conf.get_val<double>("osd_mclock_max_capacity_iops");
+  bandwidth = conf.get_val<Option::size_t>("osd_mclock_max_capacity_bandwidth");
+}
+
+void mclock_cost_model_t::dump(ceph::Formatter *f) const
+{
+  f->dump_float("iops", iops);
+  f->dump_float("bandwidth", bandwidth);
+  f->dump_float("bytes_per_io", get_bytes_per_io());
+  f->open_array_section("sample_costs");
+  for (uint64_t bytes : {4096ull, 65536ull, 1ull << 20, 4ull << 20}) {
+    f->open_object_section("sample");
+    f->dump_unsigned("bytes", bytes);
+    f->dump_unsigned("cost", get_cost(bytes));
+    f->close_section();
+  }
+  f->close_section();
 }
 
 void mClockScheduler::ClientRegistry::update_from_config(const ConfigProxy &conf)
@@ -60,6 +182,12 @@ void mClockScheduler::ClientRegistry::update_from_config(const ConfigProxy &conf
     conf.get_val<uint64_t>("osd_mclock_scheduler_background_best_effort_res"),
     conf.get_val<uint64_t>("osd_mclock_scheduler_background_best_effort_wgt"),
     conf.get_val<uint64_t>("osd_mclock_scheduler_background_best_effort_lim"));
+
+  internal_client_infos[
+    static_cast<size_t>(op_scheduler_class::background_scrub)].update(
+    conf.get_val<Option::size_t>("osd_mclock_scheduler_background_scrub_res"),
+    conf.get_val<uint64_t>("osd_mclock_scheduler_background_scrub_wgt"),
+    conf.get_val<Option::size_t>("osd_mclock_scheduler_background_scrub_lim"));
 }
 
 const dmc::ClientInfo *mClockScheduler::ClientRegistry::get_external_client(
@@ -88,13 +216,29 @@ const dmc::ClientInfo *mClockScheduler::ClientRegistry::get_info(
 
 void mClockScheduler::dump(ceph::Formatter &f) const
 {
+  f.open_object_section("cost_model");
+  cost_model.dump(&f);
+  f.close_section();
+
+  f.open_object_section("queued");
+  static const char *class_names[num_classes] = {
+    "background_recovery",
+    "background_best_effort",
+    "background_scrub",
+    "immediate",
+    "client",
+  };
+  for (size_t i = 0; i < num_classes; ++i) {
+    f.dump_unsigned(class_names[i], queued[i]);
+  }
+  f.close_section();
 }
 
 void mClockScheduler::enqueue(OpSchedulerItem&& item)
 {
   auto id = get_scheduler_id(item);
-  // TODO: express cost, mclock params in terms of per-node capacity?
-  auto cost = 1; //std::max(item.get_cost(), 1);
+  auto cost = calc_cost(item);
+  account_enqueue(item);
 
   // TODO: move this check into OpSchedulerItem, handle backwards compat
   if (op_scheduler_class::immediate == item.get_scheduler_class()) {
@@ -109,6 +253,7 @@ void mClockScheduler::enqueue(OpSchedulerItem&& item)
 
 void mClockScheduler::enqueue_front(OpSchedulerItem&& item)
 {
+  account_enqueue(item);
   immediate.push_back(std::move(item));
   // TODO: item may not be immediate, update mclock machinery to permit
   // putting the item back in the queue
@@ -119,6 +264,7 @@ OpSchedulerItem mClockScheduler::dequeue()
   if (!immediate.empty()) {
     auto ret = std::move(immediate.back());
     immediate.pop_back();
+    account_dequeue(ret);
     return ret;
   } else {
     mclock_queue_t::PullReq result = scheduler.pull_request();
@@ -134,6 +280,7 @@ OpSchedulerItem mClockScheduler::dequeue()
       ceph_assert(result.is_retn());
 
       auto &retn = result.get_retn();
+      account_dequeue(*retn.request);
       return std::move(*retn.request);
     }
   }
@@ -151,6 +298,11 @@ const char** mClockScheduler::get_tracked_conf_keys() const
     "osd_mclock_scheduler_background_best_effort_res",
     "osd_mclock_scheduler_background_best_effort_wgt",
     "osd_mclock_scheduler_background_best_effort_lim",
+    "osd_mclock_scheduler_background_scrub_res",
+    "osd_mclock_scheduler_background_scrub_wgt",
+    "osd_mclock_scheduler_background_scrub_lim",
+    "osd_mclock_max_capacity_iops",
+    "osd_mclock_max_capacity_bandwidth",
     NULL
   };
   return KEYS;
@@ -161,6 +313,13 @@ void mClockScheduler::handle_conf_change(
   const std::set<std::string> &changed)
 {
   client_registry.update_from_config(conf);
+  if (changed.count("osd_mclock_max_capacity_iops") ||
+      changed.count("osd_mclock_max_capacity_bandwidth")) {
+    cost_model.update_from_config(conf);
+    dout(1) << __func__ << " cost model iops " << cost_model.iops
+	    << " bandwidth " << byte_u_t(cost_model.bandwidth) << "/s"
+	    << dendl;
+  }
 }
 
 }
@@ -28,6 +28,7 @@
 #include "include/cmp.h"
 #include "common/ceph_context.h"
 #include "common/mClockPriorityQueue.h"
+#include "common/perf_counters.h"
 #include "osd/scheduler/OpSchedulerItem.h"
 
 
@@ -53,10 +54,44 @@ struct scheduler_id_t {
 WRITE_EQ_OPERATORS_2(scheduler_id_t, class_id, client_profile_id)
 WRITE_CMP_OPERATORS_2(scheduler_id_t, class_id, client_profile_id)
 
+enum {
+  l_mclock_first = 942000,
+  // followed by l_mclock_per_class counters for each op_scheduler_class
+};
+
+/**
+ * Cost of an item in units of one small random IO on this OSD's device.
+ *
+ * With a device capable of iops small IOs/sec and bandwidth bytes/sec of
+ * large IO, an op of n bytes occupies the device for about
+ * 1/iops + n/bandwidth seconds, i.e. 1 + n / (bandwidth / iops) small IOs.
+ * Capacities come from osd_mclock_max_capacity_*, which the OSD measures
+ * at startup unless they are set explicitly.
+ */
+struct mclock_cost_model_t {
+  double iops = 0;       ///< small random IOs/sec
+  double bandwidth = 0;  ///< large IO bytes/sec
+
+  bool is_valid() const {
+    return iops > 0 && bandwidth > 0;
+  }
+  double get_bytes_per_io() const {
+    return is_valid() ? bandwidth / iops : 0;
+  }
+  uint64_t get_cost(uint64_t bytes) const;
+  void update_from_config(const ConfigProxy &conf);
+  void dump(ceph::Formatter *f) const;
+};
+
 /**
  * Scheduler implementation based on mclock.
  *
- * TODO: explain configs
+ * Each internal class is a dmclock client with the reservation, weight
+ * and limit given by osd_mclock_scheduler_background_*.  Scrub items are
+ * charged by the bytes they are expected to read, so the scrub class
+ * reservation and limit are in bytes/sec; scrub items are owned by their
+ * PG, so these apply to each scrubbing PG.  Client items are charged by
+ * mclock_cost_model_t according to their size.  Everything else costs 1.
  */
 class mClockScheduler : public OpScheduler, md_config_obs_t {
 
@@ -67,6 +102,7 @@ class mClockScheduler : public OpScheduler, md_config_obs_t {
     > internal_client_infos = {
       // Placeholder, gets replaced with configured values
       crimson::dmclock::ClientInfo(1, 1, 1),
+      crimson::dmclock::ClientInfo(1, 1, 1),
       crimson::dmclock::ClientInfo(1, 1, 1)
     };
 
@@ -90,6 +126,31 @@ class mClockScheduler : public OpScheduler, md_config_obs_t {
   mclock_queue_t scheduler;
   std::list<OpSchedulerItem> immediate;
 
+  // per op_scheduler_class counters, at
+  // l_mclock_first + 1 + class * l_mclock_per_class + offset
+  enum {
+    l_mclock_queued = 0,
+    l_mclock_dequeued,
+    l_mclock_cost,
+    l_mclock_queue_lat,
+    l_mclock_per_class,
+  };
+  static constexpr size_t num_classes =
+    static_cast<size_t>(op_scheduler_class::client) + 1;
+  static int counter_idx(op_scheduler_class c, int offset) {
+    return l_mclock_first + 1 + static_cast<int>(c) * l_mclock_per_class +
+      offset;
+  }
+  CephContext *cct;
+  PerfCounters *logger = nullptr;
+  std::array<uint64_t, num_classes> queued = {};
+  mclock_cost_model_t cost_model;
+
+  void init_logger(uint32_t shard_id);
+  uint64_t calc_cost(const OpSchedulerItem &item) const;
+  void account_enqueue(const OpSchedulerItem &item);
+  void account_dequeue(const OpSchedulerItem &item);
+
   static scheduler_id_t get_scheduler_id(const OpSchedulerItem &item) {
     return scheduler_id_t{
       item.get_scheduler_class(),
@@ -101,7 +162,8 @@ class mClockScheduler : public OpScheduler, md_config_obs_t {
   }
 
 public:
-  mClockScheduler(CephContext *cct);
+  mClockScheduler(CephContext *cct, uint32_t shard_id = 0);
+  ~mClockScheduler() override;
 
   // Enqueue op in the back of the regular queue
   void enqueue(OpSchedulerItem &&item) final;
@@ -100,6 +100,8 @@ enum {
   l_osdc_op_w,
   l_osdc_op_rmw,
   l_osdc_op_pg,
+  l_osdc_op_r_replica,
+  l_osdc_op_r_replica_bounced,
 
   l_osdc_osdop_stat,
   l_osdc_osdop_create,
@@ -278,6 +280,10 @@ void Objecter::init()
     pcb.add_u64_counter(l_osdc_op_rmw, "op_rmw", "Read-modify-write operations",
 			"rdwr", PerfCountersBuilder::PRIO_INTERESTING);
     pcb.add_u64_counter(l_osdc_op_pg, "op_pg", "PG operation");
+    pcb.add_u64_counter(l_osdc_op_r_replica, "op_r_replica",
+			"Read operations sent to a replica");
+    pcb.add_u64_counter(l_osdc_op_r_replica_bounced, "op_r_replica_bounced",
+			"Replica reads bounced back to the primary");
 
     pcb.add_u64_counter(l_osdc_osdop_stat, "osdop_stat", "Stat operations");
     pcb.add_u64_counter(l_osdc_osdop_create, "osdop_create",
@@ -413,7 +419,6 @@ void Objecter::start(const OSDMap* o)
   start_tick();
   if (o) {
     osdmap->deepish_copy_from(*o);
-    prune_pg_mapping(osdmap->get_pools());
   } else if (osdmap->get_epoch() == 0) {
     _maybe_request_map();
   }
@@ -1230,7 +1235,6 @@ void Objecter::handle_osd_map(MOSDMap *m)
 	}
 	logger->set(l_osdc_map_epoch, osdmap->get_epoch());
 
-        prune_pg_mapping(osdmap->get_pools());
 	cluster_full = cluster_full || _osdmap_full_flag();
 	update_pool_full_map(pool_full_map);
 
@@ -1271,7 +1275,6 @@ void Objecter::handle_osd_map(MOSDMap *m)
 	ldout(cct, 3) << "handle_osd_map decoding full epoch "
 		      << m->get_last() << dendl;
 	osdmap->decode(m->maps[m->get_last()]);
-        prune_pg_mapping(osdmap->get_pools());
 
 	_scan_requests(homeless_session, false, false, NULL,
 		       need_resend, need_resend_linger,
@@ -2858,20 +2861,8 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
   vector<int> up, acting;
   ps_t actual_ps = ceph_stable_mod(pgid.ps(), pg_num, pg_num_mask);
   pg_t actual_pgid(actual_ps, pgid.pool());
-  pg_mapping_t pg_mapping;
-  pg_mapping.epoch = osdmap->get_epoch();
-  if (lookup_pg_mapping(actual_pgid, &pg_mapping)) {
-    up = pg_mapping.up;
-    up_primary = pg_mapping.up_primary;
-    acting = pg_mapping.acting;
-    acting_primary = pg_mapping.acting_primary;
-  } else {
-    osdmap->pg_to_up_acting_osds(actual_pgid, &up, &up_primary,
-                                 &acting, &acting_primary);
-    pg_mapping_t pg_mapping(osdmap->get_epoch(),
-                            up, up_primary, acting, acting_primary);
-    update_pg_mapping(actual_pgid, std::move(pg_mapping));
-  }
+  osdmap->pg_to_up_acting_osds_cached(actual_pgid, &up, &up_primary,
+				      &acting, &acting_primary);
   bool sort_bitwise = osdmap->test_flag(CEPH_OSDMAP_SORTBITWISE);
   bool recovery_deletes = osdmap->test_flag(CEPH_OSDMAP_RECOVERY_DELETES);
   unsigned prev_seed = ceph_stable_mod(pgid.ps(), t->pg_num, t->pg_num_mask);
@@ -2955,11 +2946,17 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
       int osd;
       bool read = is_read && !is_write;
       if (read && (t->flags & CEPH_OSD_FLAG_BALANCE_READS)) {
-	int p = rand() % acting.size();
+	int p;
+	if (balance_reads_by_load && pi->is_replicated() &&
+	    acting.size() > 1) {
+	  p = _pick_balanced_read(acting);
+	} else {
+	  p = rand() % acting.size();
+	}
 	if (p)
 	  t->used_replica = true;
 	osd = acting[p];
-	ldout(cct, 10) << " chose random osd." << osd << " of " << acting
+	ldout(cct, 10) << " chose osd." << osd << " of " << acting
 		       << dendl;
       } else if (read && (t->flags & CEPH_OSD_FLAG_LOCALIZE_READS) &&
 		 acting.size() > 1) {
@@ -3003,6 +3000,35 @@ int Objecter::_calc_target(op_target_t *t, Connection *con, bool any_change)
   return RECALC_OP_TARGET_NO_ACTION;
 }
 
+/**
+ * pick the acting osd a balanced read should go to
+ *
+ * Compare two random members of the acting set and take the one with
+ * the lower expected wait (reply latency scaled by our ops queued on
+ * it).  Sampling two rather than taking the global minimum keeps
+ * clients with the same view from all piling onto the same replica.
+ * The latency of a replica we have not heard from lately decays, so
+ * one slow reply does not keep reads away from it for good.
+ */
+int Objecter::_pick_balanced_read(const vector<int>& acting)
+{
+  // rwlock is locked
+  auto now = ceph::mono_clock::now();
+  return pick_less_loaded_of_two(
+    acting.size(),
+    [] { return rand(); },
+    [&](int i) -> uint64_t {
+      auto p = osd_sessions.find(acting[i]);
+      uint64_t l = 0;  // nothing queued there yet
+      if (p != osd_sessions.end()) {
+	l = p->second->get_load(now);
+      }
+      ldout(cct, 20) << "_pick_balanced_read osd." << acting[i]
+		     << " load " << l << dendl;
+      return l;
+    });
+}
+
 int Objecter::_map_session(op_target_t *target, OSDSession **s,
 			   shunique_lock& sul)
 {
@@ -3019,6 +3045,7 @@ void Objecter::_session_op_assign(OSDSession *to, Op *op)
   get_session(to);
   op->session = to;
   to->ops[op->tid] = op;
+  to->num_ops = to->ops.size();
 
   if (to->is_homeless()) {
     num_homeless_ops++;
@@ -3037,6 +3064,7 @@ void Objecter::_session_op_remove(OSDSession *from, Op *op)
   }
 
   from->ops.erase(op->tid);
+  from->num_ops = from->ops.size();
   put_session(from);
   op->session = NULL;
 
@@ -3197,6 +3225,11 @@ MOSDOp *Objecter::_prepare_osd_op(Op *op)
 
   op->target.paused = false;
   op->stamp = ceph::coarse_mono_clock::now();
+  if (balance_reads_by_load &&
+      (op->target.flags & CEPH_OSD_FLAG_BALANCE_READS)) {
+    // coarse_mono_clock ticks in milliseconds, too slow for replies
+    op->sent_stamp = ceph::mono_clock::now();
+  }
 
   hobject_t hobj = op->target.get_hobj();
   MOSDOp *m = new MOSDOp(client_inc, op->tid,
@@ -3226,6 +3259,8 @@ MOSDOp *Objecter::_prepare_osd_op(Op *op)
   }
 
   logger->inc(l_osdc_op_send);
+  if (op->target.used_replica)
+    logger->inc(l_osdc_op_r_replica);
   ssize_t sum = 0;
   for (unsigned i = 0; i < m->ops.size(); i++) {
     sum += m->ops[i].indata.length();
@@ -3437,6 +3472,16 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
     // have, but that is better than doing callbacks out of order.
   }
 
+  if (balance_reads_by_load && op->attempts == 1 &&
+      (op->target.flags & CEPH_OSD_FLAG_BALANCE_READS) &&
+      !(op->target.flags & CEPH_OSD_FLAG_WRITE) &&
+      m->get_result() != -EAGAIN) {
+    // only reads that went straight to their osd and were served there
+    // measure its load: a resent op's time includes the resend, and a
+    // bounce says nothing about the replica
+    s->note_reply_latency(ceph::mono_clock::now() - op->sent_stamp);
+  }
+
   Context *onfinish = 0;
 
   int rc = m->get_result();
@@ -3463,6 +3508,8 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
 
   if (rc == -EAGAIN) {
     ldout(cct, 7) << " got -EAGAIN, resubmitting" << dendl;
+    if (op->target.used_replica)
+      logger->inc(l_osdc_op_r_replica_bounced);
     if (op->onfinish)
       num_in_flight--;
     _session_op_remove(s, op);
@@ -4997,7 +5044,8 @@ Objecter::Objecter(CephContext *cct_, Messenger *m, MonClient *mc,
   op_throttle_bytes(cct, "objecter_bytes",
 		    cct->_conf->objecter_inflight_op_bytes),
   op_throttle_ops(cct, "objecter_ops", cct->_conf->objecter_inflight_ops),
-  retry_writes_after_first_reply(cct->_conf->objecter_retry_writes_after_first_reply)
+  retry_writes_after_first_reply(cct->_conf->objecter_retry_writes_after_first_reply),
+  balance_reads_by_load(cct->_conf->objecter_balance_reads_by_load)
 {}
 
 Objecter::~Objecter()
@@ -1260,62 +1260,6 @@ private:
   // to be drained by consume_blacklist_events.
   bool blacklist_events_enabled = false;
   std::set<entity_addr_t> blacklist_events;
-  struct pg_mapping_t {
-    epoch_t epoch = 0;
-    std::vector<int> up;
-    int up_primary = -1;
-    std::vector<int> acting;
-    int acting_primary = -1;
-
-    pg_mapping_t() {}
-    pg_mapping_t(epoch_t epoch, std::vector<int> up, int up_primary,
-                 std::vector<int> acting, int acting_primary)
-               : epoch(epoch), up(up), up_primary(up_primary),
-                 acting(acting), acting_primary(acting_primary) {}
-  };
-  std::shared_mutex pg_mapping_lock;
-  // pool -> pg mapping
-  std::map<int64_t, std::vector<pg_mapping_t>> pg_mappings;
-
-  // convenient accessors
-  bool lookup_pg_mapping(const pg_t& pg, pg_mapping_t* pg_mapping) {
-    std::shared_lock l{pg_mapping_lock};
-    auto it = pg_mappings.find(pg.pool());
-    if (it == pg_mappings.end())
-      return false;
-    auto& mapping_array = it->second;
-    if (pg.ps() >= mapping_array.size())
-      return false;
-    if (mapping_array[pg.ps()].epoch != pg_mapping->epoch) // stale
-      return false;
-    *pg_mapping = mapping_array[pg.ps()];
-    return true;
-  }
-  void update_pg_mapping(const pg_t& pg, pg_mapping_t&& pg_mapping) {
-    std::lock_guard l{pg_mapping_lock};
-    auto& mapping_array = pg_mappings[pg.pool()];
-    ceph_assert(pg.ps() < mapping_array.size());
-    mapping_array[pg.ps()] = std::move(pg_mapping);
-  }
-  void prune_pg_mapping(const mempool::osdmap::map<int64_t,pg_pool_t>& pools) {
-    std::lock_guard l{pg_mapping_lock};
-    for (auto& pool : pools) {
-      auto& mapping_array = pg_mappings[pool.first];
-      size_t pg_num = pool.second.get_pg_num();
-      if (mapping_array.size() != pg_num) {
-        // catch both pg_num increasing & decreasing
-        mapping_array.resize(pg_num);
-      }
-    }
-    for (auto it = pg_mappings.begin(); it != pg_mappings.end(); ) {
-      if (!pools.count(it->first)) {
-        // pool is gone
-        pg_mappings.erase(it++);
-        continue;
-      }
-      it++;
-    }
-  }
 
 public:
   void maybe_request_map();
@@ -1456,6 +1400,8 @@ public:
     epoch_t *reply_epoch;
 
     ceph::coarse_mono_time stamp;
+    /// when a balanced read was last sent, for its reply latency
+    ceph::mono_time sent_stamp;
 
     epoch_t map_dne_bound;
 
@@ -1936,6 +1882,40 @@ public:
     using unique_completion_lock = std::unique_lock<
       decltype(completion_locks)::element_type>;
 
+    // load feedback for balanced reads: written under lock, read
+    // without it by _calc_target
+    std::atomic<uint32_t> num_ops{0};      ///< ops.size()
+    std::atomic<uint64_t> reply_lat_us{0}; ///< decaying avg reply latency
+    std::atomic<uint64_t> reply_stamp_ns{0}; ///< mono time of the last reply
+
+    /// a replica we stop reading from sends us no new samples, so the
+    /// latency we remember for it halves with every period of silence
+    /// until it looks good enough to be tried again
+    static constexpr ceph::timespan REPLY_LAT_HALF_LIFE =
+      std::chrono::seconds(1);
+
+    uint64_t get_reply_latency(ceph::mono_time now) const {
+      uint64_t lat = reply_lat_us;
+      uint64_t stamp = reply_stamp_ns;
+      uint64_t t = now.time_since_epoch().count();
+      if (t <= stamp) {
+	return lat;
+      }
+      uint64_t halvings = (t - stamp) / REPLY_LAT_HALF_LIFE.count();
+      return halvings < 64 ? lat >> halvings : 0;
+    }
+    void note_reply_latency(ceph::timespan lat,
+			    ceph::mono_time now = ceph::mono_clock::now()) {
+      uint64_t us =
+	std::chrono::duration_cast<std::chrono::microseconds>(lat).count();
+      uint64_t avg = get_reply_latency(now);
+      reply_lat_us = avg ? (avg * 7 + us) / 8 : us;
+      reply_stamp_ns = now.time_since_epoch().count();
+    }
+    /// expected wait for one more op, in arbitrary units
+    uint64_t get_load(ceph::mono_time now = ceph::mono_clock::now()) const {
+      return (get_reply_latency(now) + 1) * (num_ops + 1);
+    }
 
     OSDSession(CephContext *cct, int o) :
       osd(o), incarnation(0), con(NULL),
@@ -1950,6 +1930,19 @@ public:
   };
   std::map<int,OSDSession*> osd_sessions;
 
+  /**
+   * two-choice pick: sample two distinct indices below n with rand and
+   * return the one with the lower load(index), the first on a tie
+   */
+  template <typename Rand, typename Load>
+  static int pick_less_loaded_of_two(size_t n, Rand&& rand, Load&& load) {
+    int a = rand() % n;
+    int b = rand() % (n - 1);
+    if (b >= a)
+      ++b;
+    return load(b) < load(a) ? b : a;
+  }
+
   bool osdmap_full_flag() const;
   bool osdmap_pool_full(const int64_t pool_id) const;
 
@@ -2014,6 +2007,7 @@ public:
   bool target_should_be_paused(op_target_t *op);
   int _calc_target(op_target_t *t, Connection *con,
 		   bool any_change = false);
+  int _pick_balanced_read(const std::vector<int>& acting);
   int _map_session(op_target_t *op, OSDSession **s,
 		   shunique_lock& lc);
 
@@ -3122,6 +3116,7 @@ public:
 private:
   epoch_t epoch_barrier = 0;
   bool retry_writes_after_first_reply;
+  bool balance_reads_by_load;
 public:
   void set_epoch_barrier(epoch_t epoch);
 
@@ -22,6 +22,7 @@
 #include <limits.h>
 #include <errno.h>
 #include <sys/uio.h>
+#include <thread>
 
 #include "include/buffer.h"
 #include "include/buffer_raw.h"
@@ -1268,6 +1269,124 @@ TEST(BufferList, BenchAlloc) {
   bench_bufferlist_alloc(4, 100000, 16);
 }
 
+// the small appends, copies and claims that encoding makes
+void bench_bufferlist_churn(int num, int per)
+{
+  utime_t start = ceph_clock_now();
+  for (int i=0; i<num; ++i) {
+    bufferlist bl, copy, claimed;
+    for (int j=0; j<per; ++j) {
+      bl.append("0123456789abcdef", 16);
+      bl.append(buffer::create(128));
+    }
+    copy = bl;
+    claimed.claim_append(bl);
+    claimed.claim_append(copy);
+  }
+  utime_t end = ceph_clock_now();
+  cout << num << " bufferlists of " << per << " appends, copied and claimed"
+       << " in " << (end - start) << std::endl;
+}
+
+// a benchmark, not a check; run with --gtest_also_run_disabled_tests
+TEST(BufferList, DISABLED_BenchChurn) {
+  bench_bufferlist_churn(100000, 4);
+  bench_bufferlist_churn(100000, 16);
+  bench_bufferlist_churn(10000, 256);
+}
+
+// built on one thread and freed on another, as messages are; a
+// benchmark, not a check; run with --gtest_also_run_disabled_tests
+TEST(BufferList, DISABLED_BenchCrossThreadFree) {
+  constexpr int rounds = 100;
+  constexpr int batch = 1000;
+  utime_t start = ceph_clock_now();
+  for (int r = 0; r < rounds; ++r) {
+    std::vector<bufferlist> bls(batch);
+    std::thread producer([&] {
+      for (auto& bl : bls) {
+	for (int j = 0; j < 8; ++j) {
+	  bl.append("0123456789abcdef", 16);
+	  bl.append(buffer::create(256));
+	}
+      }
+    });
+    producer.join();
+    std::thread consumer([&] {
+      for (auto& bl : bls) {
+	EXPECT_EQ(8u * (16 + 256), bl.length());
+	bl.clear();
+      }
+    });
+    consumer.join();
+  }
+  utime_t end = ceph_clock_now();
+  cout << rounds * batch << " bufferlists freed on another thread"
+       << " in " << (end - start) << std::endl;
+}
+
+TEST(BufferList, SlabCacheAccounting) {
+  auto& pool = mempool::get_pool(mempool::mempool_buffer_slab);
+  std::vector<bufferlist> bls(100);
+  std::thread producer([&] {
+    for (auto& bl : bls) {
+      bl.append(buffer::create(100));
+    }
+  });
+  producer.join();
+
+  // freed on another thread: the blocks go back to the producer's
+  // cache, and are counted while they sit there
+  size_t before = pool.allocated_bytes();
+  std::thread consumer([&] {
+    for (auto& bl : bls) {
+      bl.clear();
+    }
+  });
+  consumer.join();
+  size_t cached = pool.allocated_bytes();
+  ASSERT_GT(cached, before);
+
+  // a thread that adopts that cache allocates them out of it
+  std::thread again([&] {
+    for (auto& bl : bls) {
+      bl.append(buffer::create(100));
+    }
+  });
+  again.join();
+  ASSERT_LT(pool.allocated_bytes(), cached);
+  for (auto& bl : bls) {
+    ASSERT_EQ(100u, bl.length());
+    bl.clear();
+  }
+}
+
+TEST(BufferList, SlabClassAccounting) {
+  auto charge = [](unsigned len, bufferlist *bl) {
+    size_t before = mempool::buffer_anon::allocated_bytes();
+    bl->append(buffer::create(len));
+    return mempool::buffer_anon::allocated_bytes() - before;
+  };
+  bufferlist one;
+  // the smallest block: the raw itself and the class it rounds up to
+  size_t overhead = charge(1, &one);
+  for (unsigned len = 50; len <= 8192; len = len * 9 / 8) {
+    bufferlist bl;
+    size_t c = charge(len, &bl);
+    // the whole block is charged, and the classes are fine enough that
+    // it is not much more than what was asked for
+    ASSERT_GE(c, len);
+    ASSERT_LE(c, len + len / 4 + 2 * overhead) << len;
+
+    // all of it moves with the buffer
+    size_t osd_before = mempool::osd::allocated_bytes();
+    bl.reassign_to_mempool(mempool::mempool_osd);
+    ASSERT_EQ(osd_before + c, mempool::osd::allocated_bytes());
+    bl.clear();
+    ASSERT_EQ(osd_before, mempool::osd::allocated_bytes());
+  }
+}
+
 TEST(BufferList, append_bench_with_size_hint) {
   std::array<char, 1048576> src = { 0, };
 
@@ -2392,6 +2511,89 @@ TEST(BufferList, crc32c_zeros) {
   }
 }
 
+TEST(BufferList, crc32c_cached_pieces) {
+  buffer::track_cached_crc(true);
+  const unsigned piece = 16384;
+  bufferptr big(4 * piece);
+  for (unsigned i = 0; i < big.length(); ++i) {
+    big.c_str()[i] = rand();
+  }
+  const uint32_t expected = ceph_crc32c(
+    111, (unsigned char*)big.c_str(), big.length());
+
+  // the whole range, from pieces cached with assorted seeds
+  for (unsigned i = 0; i < 4; ++i) {
+    bufferlist bl;
+    bl.append(big, i * piece, piece);
+    bl.crc32c(rand());
+  }
+  bufferlist whole;
+  whole.append(big);
+  uint64_t missed = buffer::get_missed_crc_bytes();
+  EXPECT_EQ(expected, whole.crc32c(111));
+  EXPECT_EQ(missed, buffer::get_missed_crc_bytes());
+
+  // only a leading piece is known
+  bufferptr other(4 * piece);
+  memcpy(other.c_str(), big.c_str(), big.length());
+  {
+    bufferlist bl;
+    bl.append(other, 0, piece);
+    bl.crc32c(-1);
+  }
+  bufferlist rest;
+  rest.append(other);
+  missed = buffer::get_missed_crc_bytes();
+  EXPECT_EQ(expected, rest.crc32c(111));
+  EXPECT_EQ(missed + 3 * piece, buffer::get_missed_crc_bytes());
+
+  // carried over a rebuild
+  bufferlist pieces;
+  for (unsigned i = 0; i < 4; ++i) {
+    bufferlist bl;
+    bl.append(big.c_str() + i * piece, piece);
+    bl.crc32c(rand());
+    pieces.claim_append(bl);
+  }
+  pieces.rebuild();
+  ASSERT_TRUE(pieces.is_contiguous());
+  missed = buffer::get_missed_crc_bytes();
+  EXPECT_EQ(expected, pieces.crc32c(111));
+  EXPECT_EQ(missed, buffer::get_missed_crc_bytes());
+}
+
+// Data as an OSD write sees it: checked page by page as it comes off the
+// wire, made contiguous for the object store, then checksummed whole for
+// the log.  Reports how many of the bytes checksummed had to be read.
+// A benchmark, not a check; run with --gtest_also_run_disabled_tests
+TEST(BufferList, DISABLED_crc32c_write_path_bench) {
+  buffer::track_cached_crc(true);
+  const unsigned pages = 1024;
+  const unsigned rounds = 100;
+  uint64_t crc_bytes = 0;
+  uint64_t missed = buffer::get_missed_crc_bytes();
+  utime_t start = ceph_clock_now();
+  for (unsigned r = 0; r < rounds; ++r) {
+    bufferlist data;
+    for (unsigned i = 0; i < pages; ++i) {
+      bufferptr p = buffer::create_page_aligned(CEPH_PAGE_SIZE);
+      memset(p.c_str(), r + i, CEPH_PAGE_SIZE);
+      bufferlist page;
+      page.push_back(std::move(p));
+      page.crc32c(-1);
+      data.claim_append(page);
+      crc_bytes += CEPH_PAGE_SIZE;
+    }
+    data.rebuild();
+    data.crc32c(-1);
+    crc_bytes += data.length();
+  }
+  utime_t end = ceph_clock_now();
+  cout << rounds << " writes of " << pages << " pages in " << (end - start)
+       << ", read " << buffer::get_missed_crc_bytes() - missed << " of "
+       << crc_bytes << " bytes checksummed" << std::endl;
+}
+
 TEST(BufferList, crc32c_append_perf) {
   int len = 256 * 1024 * 1024;
   bufferptr a(len);
@@ -121,6 +121,10 @@
      --set-subtree-class <bucket-name> <class>
                            set class for all items beneath bucket-name
      --compare <otherfile> compare two maps using --test parameters
+     -i mapfn --bench-mapping
+                           time single vs batched CRUSH mapping of the
+                           --test range of inputs (default 1M) and
+                           check that the results match
   
   Options for the output stage
   
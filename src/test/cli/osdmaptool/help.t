@@ -31,4 +31,8 @@
      --dump <format>         displays the map in plain text when <format> is 'plain', 'json' if specified format is not supported
      --tree                  displays a tree of the map
      --test-crush [--range-first <first> --range-last <last>] map pgs to acting osds
+     --test-mapping-inc <rounds> time full vs incremental OSDMapMapping
+                             updates over <rounds> random incrementals
+     --test-map-cache <epochs> report osdmap memory per cached epoch
+                             with and without dedup
   [1]
@@ -0,0 +1,122 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "include/cow_map.h"
+
+#include <map>
+#include <random>
+
+#include <gtest/gtest.h>
+
+typedef cow_map<int, int, mempool::mempool_osdmap> test_map_t;
+
+static void check_same(const std::map<int,int>& expect, const test_map_t& m)
+{
+  ASSERT_EQ(expect.size(), m.size());
+  auto p = expect.begin();
+  for (auto& [k, v] : m) {
+    ASSERT_EQ(p->first, k);
+    ASSERT_EQ(p->second, v);
+    ++p;
+  }
+  for (auto& [k, v] : expect) {
+    auto q = m.find(k);
+    ASSERT_NE(m.end(), q);
+    ASSERT_EQ(v, q->second);
+  }
+}
+
+TEST(CowMap, Basic)
+{
+  test_map_t m;
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(m.end(), m.find(1));
+  ASSERT_EQ(0u, m.erase(1));
+  m[3] = 30;
+  m[1] = 10;
+  m[2] = 20;
+  ASSERT_EQ(3u, m.size());
+  ASSERT_EQ(1u, m.count(2));
+  ASSERT_EQ(0u, m.count(4));
+  check_same({{1, 10}, {2, 20}, {3, 30}}, m);
+  ASSERT_EQ(1u, m.erase(2));
+  check_same({{1, 10}, {3, 30}}, m);
+  m.clear();
+  ASSERT_TRUE(m.empty());
+}
+
+TEST(CowMap, RandomOps)
+{
+  std::mt19937 rng(1234);
+  std::map<int,int> expect;
+  test_map_t m;
+  for (int i = 0; i < 50000; ++i) {
+    int k = rng() % 5000;
+    if (rng() % 3) {
+      expect[k] = i;
+      m[k] = i;
+    } else {
+      ASSERT_EQ(expect.erase(k), m.erase(k));
+    }
+  }
+  check_same(expect, m);
+
+  // the chunking depends only on the contents, not on the history
+  test_map_t fresh;
+  for (auto& [k, v] : expect) {
+    fresh[k] = v;
+  }
+  ASSERT_EQ(m.num_chunks(), fresh.num_chunks());
+  fresh.dedup(m);
+  ASSERT_EQ(m.num_chunks(), fresh.num_shared_chunks(m));
+}
+
+TEST(CowMap, CopyOnWrite)
+{
+  test_map_t a;
+  for (int i = 0; i < 10000; ++i) {
+    a[i] = i;
+  }
+  test_map_t b = a;
+  ASSERT_EQ(a.num_chunks(), b.num_shared_chunks(a));
+  b[5000] = -1;
+  b.erase(7000);
+  ASSERT_EQ(5000, a.find(5000)->second);
+  ASSERT_EQ(1u, a.count(7000));
+  ASSERT_EQ(-1, b.find(5000)->second);
+  ASSERT_EQ(0u, b.count(7000));
+  // only the chunks around the writes were cloned
+  ASSERT_GE(b.num_shared_chunks(a) + 4, b.num_chunks());
+}
+
+TEST(CowMap, EncodeDedup)
+{
+  // two maps decoded separately share chunks once deduped, except
+  // around the entries that differ
+  std::map<int,int> m;
+  for (int i = 0; i < 10000; i += 3) {
+    m[i] = i;
+  }
+  ceph::buffer::list bl;
+  encode(m, bl);
+  test_map_t a;
+  auto p = bl.cbegin();
+  decode(a, p);
+  m[4] = 4;
+  m.erase(9000);
+  bl.clear();
+  encode(m, bl);
+  test_map_t b;
+  p = bl.cbegin();
+  decode(b, p);
+  check_same(m, b);
+  ASSERT_EQ(0u, b.num_shared_chunks(a));
+  b.dedup(a);
+  ASSERT_GE(b.num_shared_chunks(a) + 2, b.num_chunks());
+  check_same(m, b);
+
+  // and encode like the std::map did
+  ceph::buffer::list bl2;
+  encode(b, bl2);
+  ASSERT_TRUE(bl.contents_equal(bl2));
+}
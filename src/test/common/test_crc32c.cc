@@ -271,6 +271,30 @@ TEST(Crc32c, RangeNull) {
   }
 }
 
+TEST(Crc32c, Extend) {
+  int len = 65536 + 17;
+  unsigned char *a = (unsigned char *)malloc(len);
+  for (int i = 0; i < len; i++) {
+    a[i] = rand();
+  }
+  uint32_t expected = ceph_crc32c(-1, a, len);
+  for (int split : {0, 1, 15, 16, 4096, 65536, len}) {
+    uint32_t head = ceph_crc32c(-1, a, split);
+    uint32_t tail = ceph_crc32c(-1, a + split, len - split);
+    ASSERT_EQ(expected, ceph_crc32c_extend(head, tail, len - split));
+  }
+  // composing fixed size chunks, as a checksummed store would
+  uint32_t crc = 1234;
+  uint32_t composed = crc;
+  for (int off = 0; off < len; off += 4096) {
+    int l = std::min(4096, len - off);
+    crc = ceph_crc32c(crc, a + off, l);
+    composed = ceph_crc32c_extend(composed, ceph_crc32c(-1, a + off, l), l);
+    ASSERT_EQ(crc, composed);
+  }
+  free(a);
+}
+
 double estimate_clock_resolution()
 {
   volatile char* p = (volatile char*)malloc(1024);
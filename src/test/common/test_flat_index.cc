@@ -0,0 +1,112 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "include/flat_index.h"
+
+#include <list>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+struct item_t {
+  std::string key;
+  int value;
+};
+struct item_key_t {
+  const std::string& operator()(const item_t& i) const {
+    return i.key;
+  }
+};
+typedef flat_index<std::string, item_t, item_key_t,
+		   mempool::mempool_unittest_1> index_t;
+
+void check(const index_t& idx,
+	   const std::unordered_map<std::string, item_t*>& ref)
+{
+  ASSERT_EQ(ref.size(), idx.size());
+  for (auto& p : ref) {
+    auto it = idx.find(p.first);
+    ASSERT_NE(idx.end(), it);
+    ASSERT_EQ(p.first, it->first);
+    ASSERT_EQ(p.second, it->second);
+  }
+  size_t n = 0;
+  for (auto it = idx.begin(); it != idx.end(); ++it, ++n) {
+    ASSERT_EQ(1u, ref.count(it->first));
+    ASSERT_EQ(ref.at(it->first), it->second);
+  }
+  ASSERT_EQ(ref.size(), n);
+}
+
+}
+
+TEST(FlatIndex, Basic)
+{
+  index_t idx;
+  ASSERT_TRUE(idx.empty());
+  ASSERT_EQ(idx.end(), idx.find("a"));
+  ASSERT_EQ(0u, idx.erase("a"));
+
+  item_t a{"a", 1}, b{"b", 2}, a2{"a", 3};
+  idx.insert_or_assign(&a);
+  idx.insert_or_assign(&b);
+  ASSERT_EQ(2u, idx.size());
+  ASSERT_EQ(&a, idx.find("a")->second);
+  idx.insert_or_assign(&a2);
+  ASSERT_EQ(2u, idx.size());
+  ASSERT_EQ(3, idx.find("a")->second->value);
+  ASSERT_EQ(1u, idx.count("b"));
+  idx.erase(idx.find("b"));
+  ASSERT_EQ(0u, idx.count("b"));
+  ASSERT_EQ(1u, idx.size());
+  idx.clear();
+  ASSERT_TRUE(idx.empty());
+  ASSERT_EQ(0u, idx.bytes());
+  ASSERT_EQ(idx.begin(), idx.end());
+}
+
+TEST(FlatIndex, RandomOps)
+{
+  std::mt19937 rng(42);
+  std::list<item_t> items;
+  index_t idx;
+  std::unordered_map<std::string, item_t*> ref;
+  for (int i = 0; i < 100000; ++i) {
+    std::string k = std::to_string(rng() % 5000);
+    if (rng() % 3) {
+      items.push_back(item_t{k, i});
+      idx.insert_or_assign(&items.back());
+      ref[k] = &items.back();
+    } else {
+      ASSERT_EQ(ref.erase(k), idx.erase(k));
+    }
+    if (i % 10000 == 0) {
+      check(idx, ref);
+    }
+  }
+  check(idx, ref);
+
+  // backward shift deletion must leave every survivor reachable
+  for (auto p = ref.begin(); p != ref.end(); ) {
+    if (rng() % 2) {
+      idx.erase(p->first);
+      p = ref.erase(p);
+    } else {
+      ++p;
+    }
+  }
+  check(idx, ref);
+
+  idx.clear();
+  idx.reserve(ref.size());
+  size_t bytes = idx.bytes();
+  for (auto& p : ref) {
+    idx.insert_or_assign(p.second);
+  }
+  ASSERT_EQ(bytes, idx.bytes());
+  check(idx, ref);
+}
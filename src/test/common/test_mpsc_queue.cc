@@ -0,0 +1,143 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "common/mpsc_queue.h"
+
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using ceph::common::mpsc_queue;
+
+TEST(MPSCQueue, Fifo)
+{
+  mpsc_queue<int> q;
+  ASSERT_TRUE(q.empty());
+  ASSERT_EQ(0u, q.drain([](int&&) {}));
+  for (int i = 0; i < 10; ++i) {
+    q.push(int(i));
+  }
+  ASSERT_FALSE(q.empty());
+  std::vector<int> out;
+  ASSERT_EQ(10u, q.drain([&](int&& i) { out.push_back(i); }));
+  ASSERT_TRUE(q.empty());
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(i, out[i]);
+  }
+}
+
+TEST(MPSCQueue, DestroyNonEmpty)
+{
+  auto p = std::make_shared<int>(0);
+  {
+    mpsc_queue<std::shared_ptr<int>> q;
+    q.push(std::shared_ptr<int>(p));
+    q.push(std::shared_ptr<int>(p));
+    ASSERT_EQ(3, p.use_count());
+  }
+  ASSERT_EQ(1, p.use_count());
+}
+
+TEST(MPSCQueue, PerProducerOrder)
+{
+  const unsigned num_producers = 8;
+  const unsigned num_items = 100000;
+  mpsc_queue<std::unique_ptr<std::pair<unsigned, unsigned>>> q;
+  std::vector<std::thread> producers;
+  for (unsigned p = 0; p < num_producers; ++p) {
+    producers.emplace_back([&q, p] {
+      for (unsigned i = 0; i < num_items; ++i) {
+	q.push(std::make_unique<std::pair<unsigned, unsigned>>(p, i));
+      }
+    });
+  }
+  std::vector<unsigned> next(num_producers, 0);
+  unsigned total = 0;
+  while (total < num_producers * num_items) {
+    total += q.drain([&](auto&& item) {
+      ASSERT_EQ(next[item->first], item->second);
+      ++next[item->first];
+    });
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  ASSERT_TRUE(q.empty());
+}
+
+// hand items from many producers to one consumer, the way messenger
+// threads hand ops to an OSD shard: the consumer dequeues items from a
+// "scheduler" under a shard lock, and producers either take that lock to
+// enqueue or push to an mpsc_queue that the consumer drains under it.
+struct handoff_shard_t {
+  std::mutex lock;
+  std::deque<unsigned> sched;
+  uint64_t sum = 0;
+
+  unsigned process(mpsc_queue<unsigned> *inbox) {
+    std::lock_guard l{lock};
+    if (inbox) {
+      inbox->drain([this](unsigned&& i) { sched.push_back(i); });
+    }
+    unsigned n = 0;
+    while (!sched.empty()) {
+      // a little work per item, as a scheduler dequeue would do
+      for (unsigned j = 0; j < 16; ++j) {
+	sum = sum * 31 + sched.front() + j;
+      }
+      sched.pop_front();
+      ++n;
+    }
+    return n;
+  }
+};
+
+static double handoff_rate(unsigned num_producers, unsigned num_items,
+			   bool lockfree)
+{
+  handoff_shard_t shard;
+  mpsc_queue<unsigned> inbox;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  for (unsigned p = 0; p < num_producers; ++p) {
+    producers.emplace_back([&] {
+      for (unsigned i = 0; i < num_items; ++i) {
+	if (lockfree) {
+	  inbox.push(unsigned(i));
+	} else {
+	  std::lock_guard l{shard.lock};
+	  shard.sched.push_back(i);
+	}
+      }
+    });
+  }
+  uint64_t total = 0;
+  while (total < uint64_t(num_producers) * num_items) {
+    total += shard.process(lockfree ? &inbox : nullptr);
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+  return total / elapsed.count();
+}
+
+// a benchmark, not a check; run with --gtest_also_run_disabled_tests
+TEST(MPSCQueue, DISABLED_BenchHandoff)
+{
+  const unsigned num_items = 100000;
+  for (unsigned num_producers : {1, 4, 16, 64}) {
+    double lockfree = handoff_rate(num_producers, num_items, true);
+    double locked = handoff_rate(num_producers, num_items, false);
+    std::cout << num_producers << " producers: mpsc_queue "
+	      << lockfree << " items/s, shard lock " << locked << " items/s"
+	      << std::endl;
+  }
+}
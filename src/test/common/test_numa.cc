@@ -70,3 +70,59 @@ TEST(cpu_set, round_trip_list)
   }
 }
 
+
+TEST(numa, pick_placement)
+{
+  // nothing set: left alone, and no memory policy without a node
+  auto p = pick_numa_placement(-1, -1, true);
+  ASSERT_EQ(-1, p.node);
+  ASSERT_FALSE(p.prefer_local_memory);
+
+  // follows the osd
+  p = pick_numa_placement(-1, 1, true);
+  ASSERT_EQ(1, p.node);
+  ASSERT_TRUE(p.prefer_local_memory);
+  p = pick_numa_placement(-1, 1, false);
+  ASSERT_EQ(1, p.node);
+  ASSERT_FALSE(p.prefer_local_memory);
+
+  // its own node wins, with or without an osd node
+  p = pick_numa_placement(0, 1, true);
+  ASSERT_EQ(0, p.node);
+  ASSERT_TRUE(p.prefer_local_memory);
+  p = pick_numa_placement(2, -1, false);
+  ASSERT_EQ(2, p.node);
+  ASSERT_FALSE(p.prefer_local_memory);
+}
+
+TEST(numa, thread_name_matches)
+{
+  std::set<std::string> prefixes = {"msgr-worker-", "bstore_"};
+  ASSERT_TRUE(thread_name_matches("msgr-worker-0", prefixes));
+  ASSERT_TRUE(thread_name_matches("bstore_kv_sync", prefixes));
+  ASSERT_FALSE(thread_name_matches("msgr-work", prefixes));
+  ASSERT_FALSE(thread_name_matches("tp_osd_tp", prefixes));
+  ASSERT_FALSE(thread_name_matches("", prefixes));
+  ASSERT_FALSE(thread_name_matches("bstore_aio", {}));
+}
+
+TEST(numa, parse_node_stat)
+{
+  numa_node_stat_t stat;
+  parse_numa_node_stat(
+    "numa_hit 123\n"
+    "numa_miss 4\n"
+    "numa_foreign 5\n"
+    "interleave_hit 6\n"
+    "local_node 1000\n"
+    "other_node 20\n", &stat);
+  ASSERT_EQ(1000u, stat.local_node);
+  ASSERT_EQ(20u, stat.other_node);
+
+  // no trailing newline; what is not there is left as it was
+  numa_node_stat_t stat2;
+  stat2.other_node = 7;
+  parse_numa_node_stat("local_node 42", &stat2);
+  ASSERT_EQ(42u, stat2.local_node);
+  ASSERT_EQ(7u, stat2.other_node);
+}
@@ -637,3 +637,64 @@ TEST(CRUSH, straw2_reweight) {
     cout << "     vs " << estddev << std::endl;
   }
 }
+
+TEST(CRUSH, hash32_3_n) {
+  // the batched hash must match the scalar one for every lane and tail
+  std::vector<__s32> ids(200);
+  for (auto& id : ids) {
+    id = rand() - RAND_MAX / 2;
+  }
+  std::vector<__u32> out(ids.size());
+  for (unsigned n = 0; n <= ids.size(); ++n) {
+    __u32 x = rand();
+    __u32 r = rand() % 50;
+    crush_hash32_3_n(CRUSH_HASH_RJENKINS1, x, ids.data(), r, out.data(), n);
+    for (unsigned i = 0; i < n; ++i) {
+      ASSERT_EQ(crush_hash32_3(CRUSH_HASH_RJENKINS1, x, ids[i], r), out[i]);
+    }
+  }
+}
+
+TEST(CRUSH, do_rule_batch) {
+  // a straw2 bucket with more items than a hash block, some of them
+  // weighted out, and a few devices marked out
+  const int n = 150;
+  std::unique_ptr<CrushWrapper> c(new CrushWrapper);
+  c->set_type_name(1, "root");
+  c->set_type_name(0, "osd");
+  int items[n], weights[n];
+  for (int i = 0; i < n; ++i) {
+    items[i] = i;
+    weights[i] = (i % 7) ? 0x10000 * (1 + i % 3) : 0;
+  }
+  c->set_max_devices(n);
+  crush_bucket *b = crush_make_bucket(c->get_crush_map(),
+				      CRUSH_BUCKET_STRAW2, CRUSH_HASH_RJENKINS1,
+				      1, n, items, weights);
+  int root;
+  EXPECT_EQ(0, crush_add_bucket(c->get_crush_map(), 0, b, &root));
+  EXPECT_EQ(0, c->set_item_name(root, "default"));
+  int rule = c->add_simple_rule("data", "default", "osd", "",
+				"firstn", pg_pool_t::TYPE_REPLICATED);
+  EXPECT_EQ(0, rule);
+  c->finalize();
+
+  vector<__u32> weight(n, 0x10000);
+  weight[3] = 0;
+  weight[10] = 0x8000;
+  vector<int> xs;
+  for (int x = 0; x < 10000; ++x) {
+    xs.push_back(x);
+  }
+  for (int numrep = 1; numrep <= 4; ++numrep) {
+    vector<vector<int>> batch;
+    c->do_rule_batch(rule, xs, &batch, numrep, weight, 0);
+    ASSERT_EQ(xs.size(), batch.size());
+    for (size_t i = 0; i < xs.size(); ++i) {
+      vector<int> out;
+      c->do_rule(rule, xs[i], out, numrep, weight, 0);
+      ASSERT_EQ(out, batch[i]);
+      ASSERT_EQ(numrep, (int)out.size());
+    }
+  }
+}
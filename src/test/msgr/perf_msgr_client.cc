@@ -27,7 +27,9 @@ using namespace std;
 #include "common/Cycles.h"
 #include "global/global_init.h"
 #include "msg/Messenger.h"
+#include "msg/async/AsyncMessenger.h"
 #include "messages/MOSDOp.h"
+#include "messages/MOSDOpReply.h"
 #include "auth/DummyAuth.h"
 
 #include <atomic>
@@ -84,7 +86,8 @@ class MessengerClient {
         msgr(m), concurrent(c), conn(con), oid("object-name"), oloc(1, 1), msg_len(len), ops(ops),
         dispatcher(think_time_us, this), inflight(0) {
       m->add_dispatcher_head(&dispatcher);
-      bufferptr ptr(msg_len);
+      // let the stack place the data where it can send it from directly
+      bufferptr ptr = static_cast<AsyncMessenger*>(m)->get_stack()->create_tx_buffer(msg_len);
       memset(ptr.c_str(), 0, msg_len);
       data.append(ptr);
     }
@@ -215,6 +218,11 @@ int main(int argc, char **argv)
   client.start();
   uint64_t stop = Cycles::rdtsc();
   cerr << " Total op " << ios << " run time " << Cycles::to_microseconds(stop - start) << "us." << std::endl;
+  double total_ops = (double)ios * numjobs;
+  cerr << " MOSDOp heap allocations per op "
+       << MessagePool<MOSDOp>::get_allocated() / total_ops << std::endl;
+  cerr << " MOSDOpReply heap allocations per op "
+       << MessagePool<MOSDOpReply>::get_allocated() / total_ops << std::endl;
 
   return 0;
 }
@@ -0,0 +1,153 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+#include "auth/DummyAuth.h"
+#include "common/ceph_argparse.h"
+#include "common/ceph_mutex.h"
+#include "common/Cycles.h"
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "messages/MPing.h"
+#include "msg/Messenger.h"
+
+// many threads sending on one connection, as the OSD's shard threads
+// do when replying to a busy client
+
+class CountingDispatcher : public Dispatcher {
+  ceph::mutex lock = ceph::make_mutex("CountingDispatcher::lock");
+  ceph::condition_variable cond;
+  uint64_t count = 0;
+
+ public:
+  CountingDispatcher() : Dispatcher(g_ceph_context) {}
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_PING;
+  }
+  void ms_fast_dispatch(Message *m) override {
+    m->put();
+    std::lock_guard l{lock};
+    ++count;
+    cond.notify_all();
+  }
+  bool ms_dispatch(Message *m) override { return true; }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  int ms_handle_authentication(Connection *con) override { return 1; }
+
+  void wait_for(uint64_t n) {
+    std::unique_lock l{lock};
+    cond.wait(l, [&] { return count >= n; });
+  }
+};
+
+void usage(const string &name) {
+  cerr << "Usage: " << name << " [threads] [messages per thread]" << std::endl;
+  cerr << "       [threads]: how many threads send on the connection" << std::endl;
+  cerr << "       [messages per thread]: how many messages each thread sends" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  if (args.size() < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  int threads = atoi(args[0]);
+  int msgs = atoi(args[1]);
+  string type = g_ceph_context->_conf.get_val<std::string>("ms_type");
+  cerr << " using ms-type " << type << std::endl;
+  cerr << "       threads " << threads << std::endl;
+  cerr << "       messages per thread " << msgs << std::endl;
+
+  DummyAuthClientServer dummy_auth(g_ceph_context);
+  dummy_auth.auth_registry.refresh_config();
+  CountingDispatcher srv_dispatcher, cli_dispatcher;
+
+  Messenger *server = Messenger::create(g_ceph_context, type,
+					entity_name_t::OSD(0), "server",
+					getpid(), 0);
+  server->set_default_policy(Messenger::Policy::stateless_server(0));
+  server->set_auth_client(&dummy_auth);
+  server->set_auth_server(&dummy_auth);
+  server->set_require_authorizer(false);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1");
+  server->bind(bind_addr);
+  server->add_dispatcher_head(&srv_dispatcher);
+  server->start();
+
+  Messenger *client = Messenger::create(g_ceph_context, type,
+					entity_name_t::CLIENT(-1), "client",
+					getpid(), 0);
+  client->set_default_policy(Messenger::Policy::lossy_client(0));
+  client->set_auth_client(&dummy_auth);
+  client->set_auth_server(&dummy_auth);
+  client->add_dispatcher_head(&cli_dispatcher);
+  client->start();
+
+  ConnectionRef conn = client->connect_to(server->get_mytype(),
+					  server->get_myaddrs());
+  conn->send_message(new MPing());
+  srv_dispatcher.wait_for(1);
+
+  Cycles::init();
+  uint64_t start = Cycles::rdtsc();
+  vector<std::thread> senders;
+  for (int i = 0; i < threads; ++i) {
+    senders.emplace_back([&] {
+      for (int j = 0; j < msgs; ++j) {
+	conn->send_message(new MPing());
+      }
+    });
+  }
+  for (auto& t : senders) {
+    t.join();
+  }
+  uint64_t queued = Cycles::rdtsc();
+  srv_dispatcher.wait_for(1 + (uint64_t)threads * msgs);
+  uint64_t stop = Cycles::rdtsc();
+
+  uint64_t total = (uint64_t)threads * msgs;
+  uint64_t us = Cycles::to_microseconds(stop - start);
+  cerr << " queued " << total << " messages in "
+       << Cycles::to_microseconds(queued - start) << "us, delivered in "
+       << us << "us, " << (us ? total * 1000000 / us : 0) << " msgs/s"
+       << std::endl;
+
+  client->shutdown();
+  client->wait();
+  server->shutdown();
+  server->wait();
+  delete client;
+  delete server;
+  return 0;
+}
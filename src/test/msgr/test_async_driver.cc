@@ -55,6 +55,9 @@
 #include "msg/async/EventKqueue.h"
 #endif
 #include "msg/async/EventSelect.h"
+#ifdef HAVE_LIBURING
+#include "msg/async/EventIoUring.h"
+#endif
 
 #include <gtest/gtest.h>
 
@@ -67,14 +70,21 @@ class EventDriverTest : public ::testing::TestWithParam<const char*> {
   void SetUp() override {
     cerr << __func__ << " start set up " << GetParam() << std::endl;
 #ifdef HAVE_EPOLL
-    if (strcmp(GetParam(), "epoll"))
+    if (!strcmp(GetParam(), "epoll"))
       driver = new EpollDriver(g_ceph_context);
 #endif
 #ifdef HAVE_KQUEUE
-    if (strcmp(GetParam(), "kqueue"))
+    if (!strcmp(GetParam(), "kqueue"))
       driver = new KqueueDriver(g_ceph_context);
 #endif
-    if (strcmp(GetParam(), "select"))
+#ifdef HAVE_LIBURING
+    if (!strcmp(GetParam(), "io_uring")) {
+      if (!IoUringDriver::supported())
+	GTEST_SKIP() << "kernel lacks io_uring multishot poll";
+      driver = new IoUringDriver(g_ceph_context);
+    }
+#endif
+    if (!strcmp(GetParam(), "select"))
       driver = new SelectDriver(g_ceph_context);
     driver->init(NULL, 100);
   }
@@ -339,6 +349,9 @@ INSTANTIATE_TEST_SUITE_P(
 #endif
 #ifdef HAVE_KQUEUE
     "kqueue",
+#endif
+#ifdef HAVE_LIBURING
+    "io_uring",
 #endif
     "select"
   )
@@ -333,6 +333,83 @@ TEST_P(NetworkWorkerTest, ListenTest) {
   ASSERT_EQ(-EADDRINUSE, r);
 }
 
+TEST_P(NetworkWorkerTest, ZeroCopySendTest) {
+  if (strcmp(GetParam(), "posix")) {
+    GTEST_SKIP() << "MSG_ZEROCOPY is only used by the posix stack";
+  }
+  g_ceph_context->_conf.set_val("ms_tcp_zerocopy_min_size", "65536");
+  Worker *worker = get_worker(0);
+  entity_addr_t bind_addr, cli_addr;
+  ASSERT_TRUE(bind_addr.parse(get_addr().c_str()));
+  SocketOptions options;
+  ServerSocket bind_socket;
+  ConnectedSocket cli_socket, srv_socket;
+  ASSERT_EQ(0, worker->listen(bind_addr, 0, options, &bind_socket));
+  ASSERT_EQ(0, worker->connect(bind_addr, options, &cli_socket));
+  int r = -EAGAIN;
+  for (int tries = 0; r == -EAGAIN && tries < 1000; ++tries) {
+    r = bind_socket.accept(&srv_socket, options, &cli_addr, worker);
+    if (r == -EAGAIN)
+      usleep(1000);
+  }
+  ASSERT_EQ(0, r);
+  r = 0;
+  for (int tries = 0; r == 0 && tries < 1000; ++tries) {
+    r = cli_socket.is_connected();
+    if (r == 0)
+      usleep(1000);
+  }
+  ASSERT_EQ(1, r);
+
+  // several rounds, so that later sends reap earlier completions; over
+  // loopback the kernel copies anyway and the socket gives up on zero
+  // copy, which must not disturb the data either
+  for (int round = 0; round < 3; ++round) {
+    const unsigned len = 4 << 20;
+    bufferlist bl;
+    for (unsigned off = 0; off < len; off += 65536) {
+      bufferptr bp(65536);
+      for (unsigned i = 0; i < bp.length(); ++i)
+	bp.c_str()[i] = (char)(off / 65536 + i + round);
+      bl.append(std::move(bp));
+    }
+    bufferlist expected = bl;
+    std::string got;
+    char buf[65536];
+    int idle = 0;
+    while (got.size() < len) {
+      bool progress = false;
+      if (bl.length()) {
+	ssize_t s = cli_socket.send(bl, false);
+	ASSERT_GE(s, 0);
+	progress = s > 0;
+      }
+      ssize_t n = srv_socket.read(buf, sizeof(buf));
+      if (n > 0) {
+	got.append(buf, n);
+	progress = true;
+      } else {
+	ASSERT_EQ(-EAGAIN, n);
+      }
+      if (!progress) {
+	ASSERT_LT(++idle, 10000);
+	usleep(100);
+      }
+    }
+    ASSERT_EQ(len, got.size());
+    ASSERT_EQ(0, memcmp(got.data(), expected.c_str(), len));
+  }
+  cerr << "zero copy bytes "
+       << worker->perf_logger->get(l_msgr_send_zerocopy_bytes)
+       << " fallback "
+       << worker->perf_logger->get(l_msgr_send_zerocopy_fallback)
+       << std::endl;
+  cli_socket.close();
+  srv_socket.close();
+  bind_socket.abort_accept();
+  g_ceph_context->_conf.set_val("ms_tcp_zerocopy_min_size", "0");
+}
+
 TEST_P(NetworkWorkerTest, AcceptAndCloseTest) {
   entity_addr_t bind_addr;
   ASSERT_TRUE(bind_addr.parse(get_addr().c_str()));
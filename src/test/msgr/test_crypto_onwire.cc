@@ -0,0 +1,185 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <gtest/gtest.h>
+
+#include "auth/Auth.h"
+#include "global/global_context.h"
+#include "include/random.h"
+#include "msg/async/crypto_onwire.h"
+
+using ceph::crypto::onwire::rxtx_t;
+
+class CryptoOnwireTest : public ::testing::Test {
+public:
+  rxtx_t us, peer;
+
+  void SetUp() override {
+    AuthConnectionMeta auth_meta;
+    auth_meta.con_mode = CEPH_CON_MODE_SECURE;
+    auth_meta.connection_secret.resize(
+      auth_meta.get_connection_secret_length());
+    for (auto& c : auth_meta.connection_secret) {
+      c = ceph::util::generate_random_number<char>();
+    }
+    us = rxtx_t::create_handler_pair(g_ceph_context, auth_meta, false);
+    peer = rxtx_t::create_handler_pair(g_ceph_context, auth_meta, true);
+  }
+
+  static bufferlist mk_plain(unsigned len, char seed) {
+    bufferlist bl;
+    bufferptr p(len);
+    for (unsigned i = 0; i < len; ++i) {
+      p.c_str()[i] = seed + i * 7;
+    }
+    bl.push_back(std::move(p));
+    return bl;
+  }
+
+  // ciphertext followed by the tag
+  bufferlist encrypt(const bufferlist& plain) {
+    us.tx->reset_tx_handler({plain.length()});
+    us.tx->authenticated_encrypt_update(plain);
+    return us.tx->authenticated_encrypt_final();
+  }
+
+  // as if read off the wire: the body into a sole-owned page-aligned
+  // buffer, the tag separately
+  static void split(const bufferlist& cnt, bufferlist *body,
+		    bufferlist *tag) {
+    unsigned len = cnt.length() - 16;
+    body->push_back(buffer::create_page_aligned(len));
+    cnt.begin().copy(len, body->c_str());
+    bufferlist t;
+    t.substr_of(cnt, len, 16);
+    tag->append(t.c_str(), t.length());
+  }
+};
+
+TEST_F(CryptoOnwireTest, RoundTrip) {
+  // small frames share the tx arena, a large one gets its own buffer
+  for (unsigned len : {16u, 100u, 4096u, 4096u, 1u << 20}) {
+    auto plain = mk_plain(len, len);
+    bufferlist cnt = encrypt(plain);
+    ASSERT_EQ(len + 16, cnt.length());
+
+    peer.rx->reset_rx_handler();
+    bufferlist out = peer.rx->authenticated_decrypt_update_final(
+      std::move(cnt), 16);
+    ASSERT_TRUE(out.contents_equal(plain));
+  }
+}
+
+TEST_F(CryptoOnwireTest, InPlaceDecrypt) {
+  const unsigned len = 2 * CEPH_PAGE_SIZE;
+  auto plain = mk_plain(len, 3);
+  bufferlist body, tag;
+  split(encrypt(plain), &body, &tag);
+  const char *where = body.front().c_str();
+  // cache the crc of the ciphertext on the raw buffer
+  uint32_t cipher_crc = body.crc32c(0);
+
+  peer.rx->reset_rx_handler();
+  bufferlist out = peer.rx->authenticated_decrypt_update(
+    std::move(body), CEPH_PAGE_SIZE);
+  peer.rx->authenticated_decrypt_update_final(std::move(tag), 16);
+  ASSERT_TRUE(out.contents_equal(plain));
+  // decrypted where it was received
+  ASSERT_EQ(1u, out.get_num_buffers());
+  ASSERT_EQ(where, out.front().c_str());
+  // and the stale crc of the ciphertext is not reused
+  ASSERT_EQ(plain.crc32c(0), out.crc32c(0));
+  ASSERT_NE(cipher_crc, out.crc32c(0));
+}
+
+TEST_F(CryptoOnwireTest, CopyDecryptShared) {
+  const unsigned len = CEPH_PAGE_SIZE;
+  auto plain = mk_plain(len, 5);
+  bufferlist body, tag;
+  split(encrypt(plain), &body, &tag);
+  // someone else still sees the ciphertext
+  bufferlist other = body;
+  bufferlist cipher;
+  cipher.append(body.c_str(), len);
+
+  peer.rx->reset_rx_handler();
+  bufferlist out = peer.rx->authenticated_decrypt_update(
+    std::move(body), CEPH_PAGE_SIZE);
+  peer.rx->authenticated_decrypt_update_final(std::move(tag), 16);
+  ASSERT_TRUE(out.contents_equal(plain));
+  ASSERT_NE(other.c_str(), out.c_str());
+  ASSERT_TRUE(other.contents_equal(cipher));
+}
+
+TEST_F(CryptoOnwireTest, CopyDecryptUnaligned) {
+  const unsigned len = 1000;
+  auto plain = mk_plain(len, 9);
+  bufferlist cnt = encrypt(plain);
+  // sole owner, but 16 bytes into a page
+  bufferptr p = buffer::create_page_aligned(len + 16);
+  cnt.begin().copy(len, p.c_str() + 16);
+  bufferlist body, tag;
+  body.push_back(bufferptr(p, 16, len));
+  p = bufferptr();
+  ASSERT_EQ(1, body.front().raw_nref());
+  tag.substr_of(cnt, len, 16);
+  const char *where = body.c_str();
+
+  peer.rx->reset_rx_handler();
+  bufferlist out = peer.rx->authenticated_decrypt_update(
+    std::move(body), CEPH_PAGE_SIZE);
+  peer.rx->authenticated_decrypt_update_final(std::move(tag), 16);
+  ASSERT_TRUE(out.contents_equal(plain));
+  ASSERT_NE(where, out.c_str());
+  ASSERT_TRUE(out.is_aligned(CEPH_PAGE_SIZE));
+}
+
+TEST_F(CryptoOnwireTest, CopyDecryptFragmented) {
+  const unsigned len = 3000;
+  auto plain = mk_plain(len, 11);
+  bufferlist cnt = encrypt(plain);
+  bufferlist body, tag;
+  body.append(cnt.c_str(), 1000);
+  body.push_back(buffer::copy(cnt.c_str() + 1000, len - 1000));
+  tag.substr_of(cnt, len, 16);
+  ASSERT_EQ(2u, body.get_num_buffers());
+
+  peer.rx->reset_rx_handler();
+  bufferlist out = peer.rx->authenticated_decrypt_update(
+    std::move(body), 16);
+  peer.rx->authenticated_decrypt_update_final(std::move(tag), 16);
+  ASSERT_TRUE(out.contents_equal(plain));
+}
+
+TEST_F(CryptoOnwireTest, Tampered) {
+  auto plain = mk_plain(512, 13);
+  bufferlist cnt = encrypt(plain);
+  cnt.c_str()[7] ^= 1;
+  peer.rx->reset_rx_handler();
+  ASSERT_THROW(
+    peer.rx->authenticated_decrypt_update_final(std::move(cnt), 16),
+    ceph::crypto::onwire::MsgAuthError);
+}
+
+TEST_F(CryptoOnwireTest, ReleaseTxBuffers) {
+  bufferlist a = encrypt(mk_plain(100, 1));
+  bufferlist b = encrypt(mk_plain(100, 2));
+  // both frames and the tx handler share the arena
+  ASSERT_EQ(3, a.front().raw_nref());
+  us.tx->release_tx_buffers();
+  ASSERT_EQ(2, a.front().raw_nref());
+  // the frames are intact
+  peer.rx->reset_rx_handler();
+  ASSERT_TRUE(peer.rx->authenticated_decrypt_update_final(
+		std::move(a), 16).contents_equal(mk_plain(100, 1)));
+  peer.rx->reset_rx_handler();
+  ASSERT_TRUE(peer.rx->authenticated_decrypt_update_final(
+		std::move(b), 16).contents_equal(mk_plain(100, 2)));
+
+  // and the next frame starts a new arena
+  bufferlist c = encrypt(mk_plain(100, 3));
+  ASSERT_EQ(2, c.front().raw_nref());
+  peer.rx->reset_rx_handler();
+  ASSERT_TRUE(peer.rx->authenticated_decrypt_update_final(
+		std::move(c), 16).contents_equal(mk_plain(100, 3)));
+}
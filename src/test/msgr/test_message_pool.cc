@@ -0,0 +1,128 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <set>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "common/ceph_mutex.h"
+#include "msg/MessagePool.h"
+
+// a type per test, so that each starts with an empty depot
+template <int N>
+struct Obj {
+  MESSAGE_POOL_CLASS_HELPERS(Obj);
+  uint64_t v[5] = {};
+};
+
+struct Bigger : public Obj<4> {
+  uint64_t w = 0;
+};
+
+template <typename T>
+static std::vector<T*> alloc_on_thread(unsigned n)
+{
+  std::vector<T*> v;
+  std::thread t([&] {
+    for (unsigned i = 0; i < n; ++i) {
+      v.push_back(new T);
+    }
+  });
+  t.join();
+  return v;
+}
+
+template <typename T>
+static void free_on_thread(std::vector<T*>& v)
+{
+  std::thread t([&] {
+    for (auto p : v) {
+      delete p;
+    }
+  });
+  t.join();
+  v.clear();
+}
+
+TEST(MessagePool, CrossThreadFree) {
+  using T = Obj<1>;
+  // 128 objects from one thread
+  auto objs = alloc_on_thread<T>(128);
+  ASSERT_EQ(128u, MessagePool<T>::get_allocated());
+  std::set<T*> addrs(objs.begin(), objs.end());
+
+  // freed by a thread that lives on: two batches reach the depot and
+  // two stay in its cache
+  ceph::mutex lock = ceph::make_mutex("CrossThreadFree");
+  ceph::condition_variable cond;
+  bool freed = false, done = false;
+  std::thread freer([&] {
+    for (auto p : objs) {
+      delete p;
+    }
+    std::unique_lock l{lock};
+    freed = true;
+    cond.notify_all();
+    cond.wait(l, [&] { return done; });
+  });
+  {
+    std::unique_lock l{lock};
+    cond.wait(l, [&] { return freed; });
+  }
+
+  // another thread gets the depot's objects back without the heap,
+  // and only then goes to the heap
+  auto again = alloc_on_thread<T>(64);
+  ASSERT_EQ(128u, MessagePool<T>::get_allocated());
+  for (auto p : again) {
+    ASSERT_TRUE(addrs.count(p));
+  }
+  auto more = alloc_on_thread<T>(1);
+  ASSERT_EQ(129u, MessagePool<T>::get_allocated());
+  ASSERT_FALSE(addrs.count(more[0]));
+  free_on_thread(more);
+
+  {
+    std::lock_guard l{lock};
+    done = true;
+    cond.notify_all();
+  }
+  freer.join();
+  free_on_thread(again);
+  ASSERT_EQ(0u, MessagePool<T>::get_released());
+}
+
+TEST(MessagePool, ThreadExit) {
+  using T = Obj<2>;
+  auto objs = alloc_on_thread<T>(40);
+  std::set<T*> addrs(objs.begin(), objs.end());
+  // fewer than a batch's worth of spare objects: all of them stay in the
+  // thread's cache until it exits, which gives them to the depot
+  free_on_thread(objs);
+  auto again = alloc_on_thread<T>(40);
+  ASSERT_EQ(40u, MessagePool<T>::get_allocated());
+  ASSERT_EQ(addrs, std::set<T*>(again.begin(), again.end()));
+  free_on_thread(again);
+  ASSERT_EQ(0u, MessagePool<T>::get_released());
+}
+
+TEST(MessagePool, DepotFull) {
+  using T = Obj<3>;
+  // the depot holds 64 batches of 32; the rest goes back to the heap
+  auto objs = alloc_on_thread<T>(3000);
+  free_on_thread(objs);
+  ASSERT_EQ(3000u, MessagePool<T>::get_allocated());
+  ASSERT_EQ(3000u - 64 * 32, MessagePool<T>::get_released());
+  auto again = alloc_on_thread<T>(64 * 32);
+  ASSERT_EQ(3000u, MessagePool<T>::get_allocated());
+  free_on_thread(again);
+}
+
+TEST(MessagePool, Subclass) {
+  // a subclass is bigger than the pooled type and bypasses the pool
+  auto objs = alloc_on_thread<Bigger>(10);
+  free_on_thread(objs);
+  ASSERT_EQ(0u, MessagePool<Obj<4>>::get_allocated());
+  ASSERT_EQ(0u, MessagePool<Obj<4>>::get_released());
+}
@@ -16,6 +16,7 @@
 
 #include <atomic>
 #include <iostream>
+#include <dirent.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <time.h>
@@ -110,6 +111,7 @@ class FakeDispatcher : public Dispatcher {
   bool loopback;
   entity_addrvec_t last_accept;
   ConnectionRef *last_accept_con_ptr = nullptr;
+  bool proxy_all = false;  ///< accepted peers may open channels for anyone
 
   explicit FakeDispatcher(bool s): Dispatcher(g_ceph_context),
                           is_server(s), got_new(false), got_remote_reset(false),
@@ -140,6 +142,9 @@ class FakeDispatcher : public Dispatcher {
   }
   void ms_handle_fast_accept(Connection *con) override {
     last_accept = con->get_peer_addrs();
+    if (proxy_all) {
+      con->get_peer_caps_info().allow_all = true;
+    }
     if (last_accept_con_ptr) {
       *last_accept_con_ptr = con;
     }
@@ -1045,6 +1050,287 @@ TEST_P(MessengerTest, TimeoutTest) {
   g_ceph_context->_conf.set_val("ms_connection_idle_timeout", "900");
 }
 
+TEST_P(MessengerTest, ChannelTest) {
+  FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1");
+  server_msgr->bind(bind_addr);
+  server_msgr->add_dispatcher_head(&srv_dispatcher);
+  server_msgr->start();
+  srv_dispatcher.proxy_all = true;
+
+  client_msgr->add_dispatcher_head(&cli_dispatcher);
+  client_msgr->start();
+
+  // 1. channels need an established connection
+  MPing *m = new MPing();
+  ConnectionRef conn = client_msgr->connect_to(server_msgr->get_mytype(),
+					       server_msgr->get_myaddrs());
+  {
+    ASSERT_EQ(conn->send_message(m), 0);
+    std::unique_lock l{cli_dispatcher.lock};
+    cli_dispatcher.cond.wait(l, [&] { return cli_dispatcher.got_new; });
+    cli_dispatcher.got_new = false;
+  }
+  ASSERT_TRUE(conn->is_connected());
+
+  // 2. each channel is a connection of its own to both ends
+  ConnectionRef server_chan[2];
+  ConnectionRef chan[2];
+  for (int i = 0; i < 2; ++i) {
+    srv_dispatcher.last_accept_con_ptr = &server_chan[i];
+    chan[i] = conn->open_channel(entity_name_t::CLIENT(100 + i),
+				 0x80000000 + i);
+    ASSERT_TRUE(chan[i]);
+    ASSERT_TRUE(chan[i]->is_connected());
+    ASSERT_TRUE(chan[i]->peer_is_osd());
+    for (int j = 0; j <= i; ++j) {
+      m = new MPing();
+      ASSERT_EQ(chan[i]->send_message(m), 0);
+      std::unique_lock l{cli_dispatcher.lock};
+      cli_dispatcher.cond.wait(l, [&] { return cli_dispatcher.got_new; });
+      cli_dispatcher.got_new = false;
+    }
+    ASSERT_EQ(i + 1u,
+	      static_cast<Session*>(chan[i]->get_priv().get())->get_count());
+    ASSERT_TRUE(server_chan[i]);
+    ASSERT_TRUE(server_chan[i]->peer_is_client());
+    ASSERT_EQ(100 + i, server_chan[i]->get_peer_id());
+    ASSERT_EQ(0x80000000u + i, server_chan[i]->get_peer_addr().get_nonce());
+    ASSERT_EQ(i + 1u, static_cast<Session*>(
+		server_chan[i]->get_priv().get())->get_count());
+  }
+  srv_dispatcher.last_accept_con_ptr = nullptr;
+  ASSERT_EQ(1u, static_cast<Session*>(conn->get_priv().get())->get_count());
+
+  // 3. closing a channel leaves the connection and the others alone
+  chan[0]->mark_down();
+  ASSERT_FALSE(chan[0]->is_connected());
+  CHECK_AND_WAIT_TRUE(!server_chan[0]->is_connected());
+  ASSERT_FALSE(server_chan[0]->is_connected());
+  ASSERT_TRUE(server_chan[1]->is_connected());
+  ASSERT_TRUE(conn->is_connected());
+  {
+    m = new MPing();
+    ASSERT_EQ(chan[1]->send_message(m), 0);
+    std::unique_lock l{cli_dispatcher.lock};
+    cli_dispatcher.cond.wait(l, [&] { return cli_dispatcher.got_new; });
+    cli_dispatcher.got_new = false;
+  }
+
+  // 4. the remaining channels go down with the connection
+  server_msgr->shutdown();
+  server_msgr->wait();
+  CHECK_AND_WAIT_TRUE(!chan[1]->is_connected());
+  ASSERT_FALSE(chan[1]->is_connected());
+
+  client_msgr->shutdown();
+  client_msgr->wait();
+}
+
+/**
+ * Scenario: a client that may only act for itself opens channels for
+ * other entities, or at addresses that are not its own.
+ */
+TEST_P(MessengerTest, ChannelForgedNameTest) {
+  FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1");
+  server_msgr->bind(bind_addr);
+  server_msgr->add_dispatcher_head(&srv_dispatcher);
+  server_msgr->start();
+
+  client_msgr->add_dispatcher_head(&cli_dispatcher);
+  client_msgr->start();
+
+  ConnectionRef server_conn;
+  srv_dispatcher.last_accept_con_ptr = &server_conn;
+  ConnectionRef conn = client_msgr->connect_to(server_msgr->get_mytype(),
+					       server_msgr->get_myaddrs());
+  {
+    MPing *m = new MPing();
+    ASSERT_EQ(conn->send_message(m), 0);
+    std::unique_lock l{cli_dispatcher.lock};
+    cli_dispatcher.cond.wait(l, [&] { return cli_dispatcher.got_new; });
+    cli_dispatcher.got_new = false;
+  }
+  ASSERT_TRUE(server_conn);
+  ASSERT_FALSE(server_conn->get_peer_caps_info().allow_all);
+  const int64_t gid = server_conn->get_peer_global_id();
+  const uint32_t parent_nonce = server_conn->get_peer_addr().get_nonce();
+  // above pid_max, so never the nonce of a messenger
+  const uint32_t nonce = 0x80000000;
+
+  auto check_refused = [&](const entity_name_t& name, uint32_t n) {
+    ConnectionRef server_chan;
+    srv_dispatcher.last_accept_con_ptr = &server_chan;
+    ConnectionRef chan = conn->open_channel(name, n);
+    ASSERT_TRUE(chan);
+    CHECK_AND_WAIT_TRUE(!chan->is_connected());
+    ASSERT_FALSE(chan->is_connected());
+    ASSERT_FALSE(server_chan);
+  };
+
+  // 1. another client's name, or another kind of entity, is refused
+  check_refused(entity_name_t::CLIENT(gid + 1), nonce);
+  check_refused(entity_name_t::OSD(0), nonce + 1);
+  // 2. so is an address that is not its own instance
+  check_refused(entity_name_t::CLIENT(gid), 0);
+  check_refused(entity_name_t::CLIENT(gid), parent_nonce);
+  ASSERT_TRUE(conn->is_connected());
+
+  // 3. its own name at an address of its own is fine
+  ConnectionRef server_chan;
+  srv_dispatcher.last_accept_con_ptr = &server_chan;
+  ConnectionRef chan = conn->open_channel(entity_name_t::CLIENT(gid),
+					  nonce + 2);
+  ASSERT_TRUE(chan);
+  {
+    MPing *m = new MPing();
+    ASSERT_EQ(chan->send_message(m), 0);
+    std::unique_lock l{cli_dispatcher.lock};
+    cli_dispatcher.cond.wait(l, [&] { return cli_dispatcher.got_new; });
+    cli_dispatcher.got_new = false;
+  }
+  ASSERT_TRUE(chan->is_connected());
+  ASSERT_TRUE(server_chan);
+  ASSERT_EQ(gid, server_chan->get_peer_id());
+  ASSERT_EQ(static_cast<uint64_t>(gid), server_chan->get_peer_global_id());
+  // the opener's address, with the channel's nonce
+  entity_addr_t addr = server_conn->get_peer_addr();
+  addr.set_nonce(nonce + 2);
+  ASSERT_EQ(addr, server_chan->get_peer_addr());
+  ASSERT_NE(server_conn->get_peer_addr(), server_chan->get_peer_addr());
+
+  // 4. but not at another channel's address
+  check_refused(entity_name_t::CLIENT(gid), nonce + 2);
+  ASSERT_TRUE(chan->is_connected());
+  srv_dispatcher.last_accept_con_ptr = nullptr;
+
+  chan->mark_down();
+  conn->mark_down();
+  server_msgr->shutdown();
+  server_msgr->wait();
+  client_msgr->shutdown();
+  client_msgr->wait();
+}
+
+static int count_open_fds()
+{
+  int n = 0;
+  DIR *d = opendir("/proc/self/fd");
+  if (!d)
+    return -1;
+  while (readdir(d))
+    ++n;
+  closedir(d);
+  return n;
+}
+
+static long get_rss_kb()
+{
+  long size = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (!f)
+    return -1;
+  if (fscanf(f, "%ld %ld", &size, &resident) != 2)
+    resident = -1;
+  fclose(f);
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * Scenario: many clients on one host reach the server over a
+ * connection each, then over channels of one connection.
+ */
+TEST_P(MessengerTest, ManyClientChannelTest) {
+  const int num_clients = 64;
+  FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
+  srv_dispatcher.proxy_all = true;
+  entity_addr_t bind_addr;
+  bind_addr.parse("v2:127.0.0.1");
+  server_msgr->bind(bind_addr);
+  server_msgr->add_dispatcher_head(&srv_dispatcher);
+  server_msgr->start();
+
+  auto ping = [&](ConnectionRef& con) {
+    MPing *m = new MPing();
+    ASSERT_EQ(con->send_message(m), 0);
+    std::unique_lock l{cli_dispatcher.lock};
+    cli_dispatcher.cond.wait(l, [&] { return cli_dispatcher.got_new; });
+    cli_dispatcher.got_new = false;
+  };
+
+  // 1. a connection (and messenger) per client
+  int fds = count_open_fds();
+  long rss = get_rss_kb();
+  vector<Messenger*> msgrs;
+  vector<ConnectionRef> conns;
+  for (int i = 0; i < num_clients; ++i) {
+    Messenger *msgr = Messenger::create(g_ceph_context, string(GetParam()),
+					entity_name_t::CLIENT(-1), "client",
+					getpid(), 0);
+    msgr->set_default_policy(Messenger::Policy::lossy_client(0));
+    msgr->set_auth_client(&dummy_auth);
+    msgr->set_auth_server(&dummy_auth);
+    msgr->add_dispatcher_head(&cli_dispatcher);
+    msgr->start();
+    msgrs.push_back(msgr);
+    conns.push_back(msgr->connect_to(server_msgr->get_mytype(),
+				     server_msgr->get_myaddrs()));
+    ping(conns.back());
+  }
+  int conn_fds = count_open_fds() - fds;
+  long conn_rss = get_rss_kb() - rss;
+  for (auto& con : conns) {
+    con->mark_down();
+  }
+  conns.clear();
+  for (auto msgr : msgrs) {
+    msgr->shutdown();
+    msgr->wait();
+    delete msgr;
+  }
+  CHECK_AND_WAIT_TRUE(count_open_fds() <= fds);
+
+  // 2. a channel per client over a single connection
+  client_msgr->add_dispatcher_head(&cli_dispatcher);
+  client_msgr->start();
+  fds = count_open_fds();
+  rss = get_rss_kb();
+  ConnectionRef conn = client_msgr->connect_to(server_msgr->get_mytype(),
+					       server_msgr->get_myaddrs());
+  ping(conn);
+  vector<ConnectionRef> chans;
+  for (int i = 0; i < num_clients; ++i) {
+    chans.push_back(conn->open_channel(entity_name_t::CLIENT(1000 + i),
+				       0x80000000 + i));
+    ASSERT_TRUE(chans.back());
+    ping(chans.back());
+  }
+  int chan_fds = count_open_fds() - fds;
+  long chan_rss = get_rss_kb() - rss;
+
+  lderr(g_ceph_context) << __func__ << " " << num_clients << " clients:"
+			<< " connections use " << conn_fds << " fds, "
+			<< conn_rss << " KiB;"
+			<< " channels use " << chan_fds << " fds, "
+			<< chan_rss << " KiB" << dendl;
+  // a socket on either end, however many clients
+  ASSERT_LE(chan_fds, 2);
+  ASSERT_GE(conn_fds, num_clients);
+
+  for (auto& chan : chans) {
+    chan->mark_down();
+  }
+  chans.clear();
+  conn->mark_down();
+  server_msgr->shutdown();
+  server_msgr->wait();
+  client_msgr->shutdown();
+  client_msgr->wait();
+}
+
 TEST_P(MessengerTest, StatefulTest) {
   Message *m;
   FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
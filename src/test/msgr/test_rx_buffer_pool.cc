@@ -0,0 +1,95 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "msg/async/RxBufferPool.h"
+
+static size_t pooled_bytes() {
+  return mempool::get_pool(mempool::mempool_msgr_rx_pool).allocated_bytes();
+}
+
+TEST(RxBufferPool, Recycle) {
+  RxBufferPool pool(1 << 20, 1 << 20);
+  bool hit;
+  auto bp = pool.get(5000, &hit);
+  ASSERT_FALSE(hit);
+  ASSERT_EQ(5000u, bp.length());
+  ASSERT_TRUE(bp.is_page_aligned());
+  const char *buf = bp.c_str();
+  ASSERT_EQ(0u, pool.get_free_bytes());
+
+  // whole pages go back to the pool, and are counted while there
+  bp = ceph::bufferptr();
+  ASSERT_EQ(2 * CEPH_PAGE_SIZE, pool.get_free_bytes());
+  ASSERT_EQ(2 * CEPH_PAGE_SIZE, pooled_bytes());
+
+  // another size does not fit them
+  auto other = pool.get(3 * CEPH_PAGE_SIZE, &hit);
+  ASSERT_FALSE(hit);
+  // the same number of pages does, whatever the length
+  bp = pool.get(2 * CEPH_PAGE_SIZE, &hit);
+  ASSERT_TRUE(hit);
+  ASSERT_EQ(buf, bp.c_str());
+  ASSERT_EQ(0u, pool.get_free_bytes());
+  ASSERT_EQ(0u, pooled_bytes());
+
+  // dropped on another thread, as messages often are
+  std::thread t([bp = std::move(bp)]() mutable { bp = ceph::bufferptr(); });
+  t.join();
+  other = ceph::bufferptr();
+  ASSERT_EQ(5 * CEPH_PAGE_SIZE, pool.get_free_bytes());
+  ASSERT_EQ(5 * CEPH_PAGE_SIZE, pooled_bytes());
+}
+
+TEST(RxBufferPool, SizeCap) {
+  RxBufferPool pool(4 * CEPH_PAGE_SIZE, 2 * CEPH_PAGE_SIZE);
+  bool hit;
+  // too big to recycle at all
+  auto big = pool.get(3 * CEPH_PAGE_SIZE, &hit);
+  ASSERT_TRUE(big.is_page_aligned());
+  big = ceph::bufferptr();
+  ASSERT_EQ(0u, pool.get_free_bytes());
+
+  // only max_bytes worth are kept
+  std::vector<ceph::bufferptr> bps;
+  for (int i = 0; i < 3; ++i) {
+    bps.push_back(pool.get(2 * CEPH_PAGE_SIZE, &hit));
+    ASSERT_FALSE(hit);
+  }
+  bps.clear();
+  ASSERT_EQ(4 * CEPH_PAGE_SIZE, pool.get_free_bytes());
+  ASSERT_EQ(4 * CEPH_PAGE_SIZE, pooled_bytes());
+  for (int i = 0; i < 3; ++i) {
+    bps.push_back(pool.get(2 * CEPH_PAGE_SIZE, &hit));
+    ASSERT_EQ(i < 2, hit);
+  }
+  bps.clear();
+}
+
+TEST(RxBufferPool, Disabled) {
+  RxBufferPool pool(0, 1 << 20);
+  bool hit;
+  auto bp = pool.get(100, &hit);
+  ASSERT_TRUE(bp.is_page_aligned());
+  bp = ceph::bufferptr();
+  ASSERT_EQ(0u, pool.get_free_bytes());
+  bp = pool.get(100, &hit);
+  ASSERT_FALSE(hit);
+  ASSERT_EQ(0u, pooled_bytes());
+}
+
+TEST(RxBufferPool, OutlivesPool) {
+  ceph::bufferptr bp;
+  {
+    RxBufferPool pool(1 << 20, 1 << 20);
+    bool hit;
+    bp = pool.get(100, &hit);
+    auto other = pool.get(100, &hit);
+  }
+  ASSERT_EQ(CEPH_PAGE_SIZE, pooled_bytes());
+  bp = ceph::bufferptr();
+  ASSERT_EQ(0u, pooled_bytes());
+}
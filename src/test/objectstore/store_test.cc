@@ -6195,6 +6195,163 @@ TEST_P(StoreTest, BluestoreOnOffCSumTest) {
     ASSERT_EQ(r, 0);
   }
 }
+
+// read_crc32c() must agree with read() followed by a crc32c, both with
+// the default seed and with one of our own
+static void check_read_crc32c(
+  ObjectStore *store,
+  ObjectStore::CollectionHandle& ch,
+  const ghobject_t& oid,
+  const vector<pair<uint64_t, uint64_t>>& ranges)
+{
+  vector<ObjectStore::crc32c_read_t> reqs;
+  vector<uint32_t> seeds;
+  for (auto& [off, len] : ranges) {
+    reqs.emplace_back(oid, off, len);
+    seeds.push_back(reqs.back().crc);
+    reqs.emplace_back(oid, off, len);
+    reqs.back().crc = 0x12345678;
+    seeds.push_back(reqs.back().crc);
+  }
+  store->read_crc32c(ch, reqs);
+  for (size_t i = 0; i < reqs.size(); ++i) {
+    auto& req = reqs[i];
+    bufferlist bl;
+    int r = store->read(ch, oid, req.offset, req.length, bl);
+    ASSERT_EQ(r, req.r) << oid << " 0x" << std::hex << req.offset
+			<< "~" << req.length;
+    uint32_t expected = r > 0 ? bl.crc32c(seeds[i]) : seeds[i];
+    ASSERT_EQ(expected, req.crc) << oid << " 0x" << std::hex << req.offset
+				 << "~" << req.length;
+  }
+}
+
+TEST_P(StoreTest, BluestoreReadCrc32c) {
+  if (string(GetParam()) != "bluestore")
+    return;
+  SetVal(g_conf(), "bluestore_csum_type", "crc32c");
+  SetVal(g_conf(), "bluestore_compression_mode", "none");
+  g_conf().apply_changes(nullptr);
+
+  int r;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  gen_type rng(0);
+  auto random_bl = [&](size_t len) {
+    bufferptr bp(len);
+    for (size_t i = 0; i < len; ++i) {
+      bp.c_str()[i] = rng();
+    }
+    bufferlist bl;
+    bl.append(bp);
+    return bl;
+  };
+  auto write = [&](const ghobject_t& oid, uint64_t off, bufferlist bl) {
+    ObjectStore::Transaction t;
+    t.write(cid, oid, off, bl.length(), bl);
+    return queue_transaction(store, ch, std::move(t));
+  };
+
+  const uint64_t size = 128 * 1024;
+  ghobject_t plain(hobject_t(sobject_t("plain", CEPH_NOSNAP)));
+  ASSERT_EQ(0, write(plain, 0, random_bl(size)));
+
+  // holes: never written, truncated up to, and zeroed
+  ghobject_t holes(hobject_t(sobject_t("holes", CEPH_NOSNAP)));
+  ASSERT_EQ(0, write(holes, 0, random_bl(16384)));
+  ASSERT_EQ(0, write(holes, 65536, random_bl(8192)));
+  ASSERT_EQ(0, write(holes, 100000, random_bl(1000)));
+  {
+    ObjectStore::Transaction t;
+    t.zero(cid, holes, 4096, 8192);
+    t.truncate(cid, holes, size);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+
+  // compressed, then partly overwritten uncompressed
+  SetVal(g_conf(), "bluestore_compression_algorithm", "snappy");
+  SetVal(g_conf(), "bluestore_compression_mode", "force");
+  g_conf().apply_changes(nullptr);
+  ghobject_t compressed(hobject_t(sobject_t("compressed", CEPH_NOSNAP)));
+  {
+    bufferlist bl;
+    for (uint64_t i = 0; i < size; i += 512) {
+      bl.append(string(512, 'a' + (i / 512) % 26));
+    }
+    ASSERT_EQ(0, write(compressed, 0, bl));
+  }
+  SetVal(g_conf(), "bluestore_compression_mode", "none");
+  g_conf().apply_changes(nullptr);
+  ASSERT_EQ(0, write(compressed, 32768, random_bl(4096)));
+
+  // checksums that cannot be composed into a crc32c, or none at all
+  SetVal(g_conf(), "bluestore_csum_type", "none");
+  g_conf().apply_changes(nullptr);
+  ghobject_t nocsum(hobject_t(sobject_t("nocsum", CEPH_NOSNAP)));
+  ASSERT_EQ(0, write(nocsum, 0, random_bl(size)));
+  SetVal(g_conf(), "bluestore_csum_type", "xxhash32");
+  g_conf().apply_changes(nullptr);
+  ghobject_t xxhash(hobject_t(sobject_t("xxhash", CEPH_NOSNAP)));
+  ASSERT_EQ(0, write(xxhash, 0, random_bl(size)));
+  SetVal(g_conf(), "bluestore_csum_type", "crc32c");
+  g_conf().apply_changes(nullptr);
+
+  const vector<pair<uint64_t, uint64_t>> ranges = {
+    {0, size},                  // everything
+    {0, 4096}, {8192, 16384},   // whole checksum chunks
+    {1000, 5000}, {4095, 2},    // partial chunks
+    {3000, 70000},              // partial at both ends, across blobs
+    {60000, 10000},             // into the middle of a hole
+    {size - 100, 100},          // up to the end
+    {size - 100, 1000},         // across the end
+    {size, 4096},               // past the end
+    {size + 8192, 4096},
+  };
+  // first from disk, then with whatever read() left in the cache
+  ch.reset();
+  ASSERT_EQ(0, store->umount());
+  ASSERT_EQ(0, store->mount());
+  ch = store->open_collection(cid);
+  for (int pass = 0; pass < 2; ++pass) {
+    for (auto& oid : {plain, holes, compressed, nocsum, xxhash}) {
+      check_read_crc32c(store.get(), ch, oid, ranges);
+    }
+  }
+
+  // several objects in one call, and one that does not exist
+  {
+    ghobject_t missing(hobject_t(sobject_t("missing", CEPH_NOSNAP)));
+    vector<ObjectStore::crc32c_read_t> reqs = {
+      {plain, 0, 8192}, {missing, 0, 4096}, {compressed, 1000, 40000},
+      {holes, 0, size},
+    };
+    store->read_crc32c(ch, reqs);
+    ASSERT_EQ(-ENOENT, reqs[1].r);
+    for (size_t i : {0, 2, 3}) {
+      bufferlist bl;
+      r = store->read(ch, reqs[i].oid, reqs[i].offset, reqs[i].length, bl);
+      ASSERT_EQ(r, reqs[i].r);
+      ASSERT_EQ(bl.crc32c(-1), reqs[i].crc);
+    }
+  }
+
+  {
+    ObjectStore::Transaction t;
+    for (auto& oid : {plain, holes, compressed, nocsum, xxhash}) {
+      t.remove(cid, oid);
+    }
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
 #endif
 
 INSTANTIATE_TEST_SUITE_P(
@@ -40,10 +40,13 @@ public:
 
   struct MockDmclockItem : public PGOpQueueable {
     op_scheduler_class scheduler_class;
+    uint64_t scrub_bytes;
 
-    MockDmclockItem(op_scheduler_class _scheduler_class) :
+    MockDmclockItem(op_scheduler_class _scheduler_class,
+		    uint64_t _scrub_bytes = 0) :
       PGOpQueueable(spg_t()),
-      scheduler_class(_scheduler_class) {}
+      scheduler_class(_scheduler_class),
+      scrub_bytes(_scrub_bytes) {}
 
     MockDmclockItem()
       : MockDmclockItem(op_scheduler_class::background_best_effort) {}
@@ -62,6 +65,10 @@ public:
       return scheduler_class;
     }
 
+    uint64_t get_scrub_bytes() const final {
+      return scrub_bytes;
+    }
+
     void run(OSD *osd, OSDShard *sdata, PGRef& pg, ThreadPool::TPHandle &handle) final {}
   };
 };
@@ -154,3 +161,46 @@ TEST_F(mClockSchedulerTest, TestMultiClientOrderedEnqueueDequeue) {
   }
   ASSERT_TRUE(q.empty());
 }
+
+TEST_F(mClockSchedulerTest, TestScrubClass) {
+  // scrub items are charged by bytes; each owner (pg) keeps its order
+  const unsigned NUM = 100;
+  for (unsigned i = 0; i < NUM; ++i) {
+    q.enqueue(create_item(i, client1, op_scheduler_class::background_scrub,
+			  512 << 10));
+    q.enqueue(create_item(i, client2, op_scheduler_class::background_scrub));
+    q.enqueue(create_item(i, client3, op_scheduler_class::client));
+  }
+
+  std::map<uint64_t, epoch_t> next;
+  for (auto &&c: {client1, client2, client3}) {
+    next[c] = 0;
+  }
+  for (unsigned i = 0; i < NUM * 3; ++i) {
+    ASSERT_FALSE(q.empty());
+    auto r = q.dequeue();
+    auto niter = next.find(r.get_owner());
+    ASSERT_FALSE(niter == next.end());
+    ASSERT_EQ(niter->second, r.get_map_epoch());
+    niter->second++;
+  }
+  ASSERT_TRUE(q.empty());
+}
+
+TEST(mClockCostModel, Cost) {
+  mclock_cost_model_t model;
+  // no capacity known: flat cost
+  ASSERT_FALSE(model.is_valid());
+  ASSERT_EQ(1u, model.get_cost(0));
+  ASSERT_EQ(1u, model.get_cost(4 << 20));
+
+  // 1000 iops, 100 MB/s: an io is worth 100 KB
+  model.iops = 1000;
+  model.bandwidth = 100000000;
+  ASSERT_TRUE(model.is_valid());
+  ASSERT_EQ(100000.0, model.get_bytes_per_io());
+  ASSERT_EQ(1u, model.get_cost(0));
+  ASSERT_EQ(1u, model.get_cost(4096));
+  ASSERT_EQ(2u, model.get_cost(100000));
+  ASSERT_EQ(42u, model.get_cost(4 << 20));
+}
@@ -10,6 +10,7 @@
 #include "common/ceph_argparse.h"
 
 #include <iostream>
+#include <thread>
 
 using namespace std;
 
@@ -525,6 +526,197 @@ TEST_F(OSDMapTest, PrimaryAffinity) {
   }
 }
 
+TEST_F(OSDMapTest, IncrementalMapping) {
+  set_up_map(12);
+  mapping.update(osdmap);
+
+  auto apply_and_check = [&](OSDMap::Incremental& inc) {
+    ASSERT_EQ(0, osdmap.apply_incremental(inc));
+    mapping.update(osdmap, inc);
+    ASSERT_EQ(osdmap.get_epoch(), mapping.get_epoch());
+    OSDMapMapping full;
+    full.update(osdmap);
+    for (auto& p : osdmap.get_pools()) {
+      for (unsigned ps = 0; ps < p.second.get_pg_num(); ++ps) {
+	pg_t pgid(ps, p.first);
+	vector<int> up, acting, up2, acting2;
+	int up_primary, acting_primary, up_primary2, acting_primary2;
+	full.get(pgid, &up, &up_primary, &acting, &acting_primary);
+	mapping.get(pgid, &up2, &up_primary2, &acting2, &acting_primary2);
+	ASSERT_EQ(up, up2) << pgid;
+	ASSERT_EQ(up_primary, up_primary2) << pgid;
+	ASSERT_EQ(acting, acting2) << pgid;
+	ASSERT_EQ(acting_primary, acting_primary2) << pgid;
+      }
+    }
+  };
+
+  pg_t pgid = osdmap.raw_pg_to_pg(pg_t(0, my_rep_pool));
+  vector<int> up;
+  osdmap.pg_to_raw_up(pgid, &up, nullptr);
+  ASSERT_EQ(3u, up.size());
+  int other = -1;
+  for (int i = 0; i < (int)get_num_osds(); ++i) {
+    if (std::find(up.begin(), up.end(), i) == up.end()) {
+      other = i;
+      break;
+    }
+  }
+  ASSERT_NE(-1, other);
+
+  {
+    // mark an osd down: only pgs mapped to it change
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.fsid = osdmap.get_fsid();
+    inc.new_state[up[0]] = CEPH_OSD_UP;
+    apply_and_check(inc);
+    ASSERT_GT(mapping.get_num_pgs(), mapping.get_num_updated_pgs());
+  }
+  {
+    // and back up again
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.fsid = osdmap.get_fsid();
+    inc.new_state[up[0]] = CEPH_OSD_UP;
+    entity_addrvec_t addrs;
+    addrs.v.push_back(entity_addr_t());
+    inc.new_up_client[up[0]] = addrs;
+    inc.new_up_cluster[up[0]] = addrs;
+    inc.new_hb_back_up[up[0]] = addrs;
+    inc.new_hb_front_up[up[0]] = addrs;
+    apply_and_check(inc);
+  }
+  {
+    // an upmap and a pg_temp
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.fsid = osdmap.get_fsid();
+    inc.new_pg_upmap_items[pgid].push_back(make_pair(up[1], other));
+    inc.new_pg_temp[pg_t(1, my_ec_pool)] =
+      mempool::osdmap::vector<int>(up.begin(), up.end());
+    apply_and_check(inc);
+    ASSERT_EQ(2u, mapping.get_num_updated_pgs());
+  }
+  {
+    // the upmap target goes down
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.fsid = osdmap.get_fsid();
+    inc.new_state[other] = CEPH_OSD_UP;
+    apply_and_check(inc);
+  }
+  {
+    // mark an osd out, which changes crush placement
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.fsid = osdmap.get_fsid();
+    inc.new_weight[up[2]] = CEPH_OSD_OUT;
+    inc.old_pg_upmap_items.insert(pgid);
+    apply_and_check(inc);
+  }
+  {
+    // primary affinity
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.fsid = osdmap.get_fsid();
+    inc.new_primary_affinity[up[1]] = 0;
+    apply_and_check(inc);
+  }
+}
+
+TEST_F(OSDMapTest, CachedMapping) {
+  set_up_map();
+
+  auto check_all = [&]() {
+    for (auto& p : osdmap.get_pools()) {
+      for (unsigned ps = 0; ps < p.second.get_pg_num() * 2; ++ps) {
+	pg_t pgid(ps, p.first);
+	vector<int> up, acting, up2, acting2;
+	int up_primary, acting_primary, up_primary2, acting_primary2;
+	osdmap.pg_to_up_acting_osds(pgid, &up, &up_primary,
+				    &acting, &acting_primary);
+	osdmap.pg_to_up_acting_osds_cached(pgid, &up2, &up_primary2,
+					   &acting2, &acting_primary2);
+	ASSERT_EQ(up, up2) << pgid;
+	ASSERT_EQ(up_primary, up_primary2) << pgid;
+	ASSERT_EQ(acting, acting2) << pgid;
+	ASSERT_EQ(acting_primary, acting_primary2) << pgid;
+      }
+    }
+  };
+
+  pg_t pgid(0, my_rep_pool);
+  vector<int> up, acting;
+  int up_primary, acting_primary;
+  ASSERT_FALSE(osdmap.pg_to_up_acting_osds_cached(
+    pgid, &up, &up_primary, &acting, &acting_primary));
+  ASSERT_TRUE(osdmap.pg_to_up_acting_osds_cached(
+    pgid, &up, &up_primary, &acting, &acting_primary));
+  check_all();
+
+  // a pg_temp longer than the pool size is not cached, but still mapped
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.fsid = osdmap.get_fsid();
+    inc.new_pg_temp[pgid] = {0, 1, 2, 3, 4};
+    ASSERT_EQ(0, osdmap.apply_incremental(inc));
+  }
+  // the incremental dropped the cache
+  ASSERT_FALSE(osdmap.pg_to_up_acting_osds_cached(
+    pg_t(1, my_rep_pool), &up, &up_primary, &acting, &acting_primary));
+  ASSERT_FALSE(osdmap.pg_to_up_acting_osds_cached(
+    pgid, &up, &up_primary, &acting, &acting_primary));
+  ASSERT_FALSE(osdmap.pg_to_up_acting_osds_cached(
+    pgid, &up, &up_primary, &acting, &acting_primary));
+  ASSERT_EQ(5u, acting.size());
+  check_all();
+
+  // fill from many threads at once
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.fsid = osdmap.get_fsid();
+    inc.new_pg_temp[pgid].clear();
+    ASSERT_EQ(0, osdmap.apply_incremental(inc));
+  }
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([this] {
+      for (unsigned ps = 0; ps < 64; ++ps) {
+	vector<int> up, acting;
+	int up_primary, acting_primary;
+	osdmap.pg_to_up_acting_osds_cached(pg_t(ps, my_ec_pool),
+					   &up, &up_primary,
+					   &acting, &acting_primary);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  check_all();
+}
+
+// a benchmark, not a check; run with --gtest_also_run_disabled_tests
+TEST_F(OSDMapTest, DISABLED_BenchCachedMapping) {
+  // the lookup Objecter::_calc_target does for every op it submits
+  set_up_map();
+  const unsigned lookups = 1000000;
+  for (bool cached : {false, true}) {
+    utime_t start = ceph_clock_now();
+    for (unsigned i = 0; i < lookups; ++i) {
+      vector<int> up, acting;
+      int up_primary, acting_primary;
+      pg_t pgid(i % 64, my_rep_pool);
+      if (cached) {
+	osdmap.pg_to_up_acting_osds_cached(pgid, &up, &up_primary,
+					   &acting, &acting_primary);
+      } else {
+	osdmap.pg_to_up_acting_osds(pgid, &up, &up_primary,
+				    &acting, &acting_primary);
+      }
+    }
+    utime_t elapsed = ceph_clock_now() - start;
+    cout << (cached ? "cached" : "uncached") << ": "
+	 << (double)elapsed * 1000000000 / lookups << " ns/lookup"
+	 << std::endl;
+  }
+}
+
 TEST_F(OSDMapTest, get_osd_crush_node_flags) {
   set_up_map();
 
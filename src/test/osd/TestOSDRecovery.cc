@@ -0,0 +1,91 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <gtest/gtest.h>
+
+#include "global/global_context.h"
+#include "osd/OSD.h"
+
+class RecoveryBatchTest : public ::testing::Test {
+public:
+  CephContext *cct = g_ceph_context;
+  std::vector<std::pair<std::string, std::string>> saved;
+
+  void set_conf(const char *key, const char *val) {
+    std::string old;
+    cct->_conf.get_val(key, &old);
+    saved.emplace_back(key, old);
+    cct->_conf.set_val_or_die(key, val);
+    cct->_conf.apply_changes(nullptr);
+  }
+  void TearDown() override {
+    for (auto& [key, val] : saved) {
+      cct->_conf.set_val_or_die(key, val);
+    }
+    cct->_conf.apply_changes(nullptr);
+  }
+
+  // one recalibration interval of 1s
+  unsigned step(unsigned batch, bool op_limited, uint64_t objects,
+		uint64_t object_size, double *defer = nullptr) {
+    double d;
+    unsigned r = OSDService::calc_recovery_batch(
+      cct, batch, op_limited, objects * object_size, objects, 1.0, &d);
+    if (defer) {
+      *defer = d;
+    }
+    return r;
+  }
+};
+
+TEST_F(RecoveryBatchTest, OffByDefault) {
+  // osd_recovery_max_batch is 1: ops cover one object each, as before
+  ASSERT_EQ(1u, step(1, true, 1000, 4096));
+  ASSERT_EQ(1u, step(4, true, 1000, 4096));
+}
+
+TEST_F(RecoveryBatchTest, GrowsWhileOpLimited) {
+  set_conf("osd_recovery_max_batch", "16");
+  unsigned batch = 1;
+  for (unsigned i = 1; i < 16; ++i) {
+    batch = step(batch, true, 1000, 4096);
+    ASSERT_EQ(i + 1, batch);
+  }
+  // capped by osd_recovery_max_batch
+  ASSERT_EQ(16u, step(batch, true, 1000, 4096));
+  // held while recovery is not waiting for op slots
+  ASSERT_EQ(16u, step(batch, false, 1000, 4096));
+  // and nothing recovered tells us nothing
+  ASSERT_EQ(3u, step(3, true, 0, 0));
+
+  set_conf("osd_recovery_max_batch", "4");
+  ASSERT_EQ(4u, step(batch, false, 1000, 4096));
+}
+
+TEST_F(RecoveryBatchTest, PushCostLimit) {
+  set_conf("osd_recovery_max_batch", "16");
+  set_conf("osd_max_push_objects", "10");
+  set_conf("osd_push_per_object_cost", "0");
+  set_conf("osd_max_push_cost", "1048576");
+  // 10 objects of 32k per push, 3 pushes per op fit in 1M; 4 do not
+  ASSERT_EQ(3u, step(2, true, 100, 32768));
+  ASSERT_EQ(3u, step(3, true, 100, 32768));
+  // objects grew: shrink back towards the push cost
+  ASSERT_EQ(7u, step(8, false, 100, 1 << 20));
+  ASSERT_EQ(1u, step(1, false, 100, 1 << 20));
+}
+
+TEST_F(RecoveryBatchTest, BytesTarget) {
+  set_conf("osd_recovery_max_batch", "16");
+  set_conf("osd_recovery_max_bytes_per_sec", "1048576");
+  double defer;
+  // over the target: halve the batch first
+  ASSERT_EQ(4u, step(8, true, 64, 65536, &defer));
+  ASSERT_EQ(0, defer);
+  // then pause for the excess
+  ASSERT_EQ(1u, step(1, true, 64, 65536, &defer));
+  ASSERT_DOUBLE_EQ(3.0, defer);
+  // under the target, op limited: grow again
+  ASSERT_EQ(2u, step(1, true, 8, 65536, &defer));
+  ASSERT_EQ(0, defer);
+}
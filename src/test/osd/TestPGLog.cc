@@ -25,6 +25,7 @@
 #include "osd/PGLog.h"
 #include "osd/OSDMap.h"
 #include "include/coredumpctl.h"
+#include "include/stringify.h"
 #include "../objectstore/store_test_fixture.h"
 
 
@@ -2233,7 +2234,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(modify);
 
   EXPECT_TRUE(log.logged_object(oid));
-  pg_log_entry_t *entry = log.objects[oid];
+  pg_log_entry_t *entry = log.objects.find(oid)->second;
   EXPECT_EQ(modify.op, entry->op);
   EXPECT_EQ(modify.version, entry->version);
   EXPECT_EQ(modify.prior_version, entry->prior_version);
@@ -2247,7 +2248,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(del);
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.objects.find(oid)->second;
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2260,7 +2261,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
 		   utime_t(20,1), -ENOENT));
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.objects.find(oid)->second;
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2673,6 +2674,203 @@ TEST_F(PGLogMergeDupsTest, Superset) {
 }
 
 
+class PGLogPersistTest : protected PGLog, public PGLogTestBase,
+			 public StoreTestFixture {
+public:
+  explicit PGLogPersistTest(const char *type = "memstore")
+    : PGLog(g_ceph_context), StoreTestFixture(type) {}
+
+  void SetUp() override {
+    StoreTestFixture::SetUp();
+    ObjectStore::Transaction t;
+    test_coll = coll_t(spg_t(pg_t(1, 1)));
+    ch = store->create_new_collection(test_coll);
+    t.create_collection(test_coll, 0);
+    ASSERT_EQ(0, store->queue_transaction(ch, std::move(t)));
+    hobject_t hoid;
+    hoid.pool = 1;
+    hoid.oid = "log";
+    log_oid = ghobject_t(hoid);
+  }
+
+  void TearDown() override {
+    clear();
+    // put back what set_conf changed before the next test runs
+    PopSettings(0);
+    StoreTestFixture::TearDown();
+  }
+
+  // SetVal remembers the previous value for PopSettings
+  void set_conf(const char *key, const char *val) {
+    SetVal(g_conf(), key, val);
+    g_conf().apply_changes(nullptr);
+  }
+
+  // one client op: add its entry, trim like the primary does, persist
+  void op(unsigned log_len, unsigned trim_min, unsigned extra) {
+    static const entity_name_t client = entity_name_t::CLIENT(777);
+    eversion_t v = mk_evt(1, info.last_update.version + 1);
+    pg_log_entry_t e = mk_ple_mod(mk_obj(v.version % 100), v,
+				  info.last_update,
+				  osd_reqid_t(client, 8, v.version));
+    for (unsigned i = 0; i < extra; ++i) {
+      e.extra_reqids.push_back(
+	make_pair(osd_reqid_t(client, 9, v.version * 10 + i), v.version));
+    }
+    add(e);
+    info.last_update = info.last_complete = v;
+    if (log.log.size() >= log_len + trim_min) {
+      auto p = log.log.rbegin();
+      std::advance(p, log_len);
+      trim(p->version, info);
+    }
+
+    ObjectStore::Transaction t;
+    map<string,bufferlist> km;
+    write_log_and_missing(t, &km, test_coll, log_oid, false);
+    keys_set += km.size();
+    if (!km.empty()) {
+      t.omap_setkeys(test_coll, log_oid, km);
+    }
+    ASSERT_EQ(0, store->queue_transaction(ch, std::move(t)));
+  }
+
+  // the stored log must read back as the in-memory one; dups from a
+  // partly trimmed segment may come back too, but only older ones
+  void check_roundtrip() {
+    IndexedLog rlog;
+    pg_missing_tracker_t rmissing;
+    ostringstream err;
+    read_log_and_missing(store.get(), ch, log_oid, info, rlog, rmissing,
+			 err, false);
+    ASSERT_EQ(log.log.size(), rlog.log.size());
+    auto r = rlog.log.begin();
+    for (auto& e : log.log) {
+      ASSERT_EQ(e.version, r->version);
+      ASSERT_EQ(e.reqid, r->reqid);
+      ++r;
+    }
+    ASSERT_LE(log.dups.size(), rlog.dups.size());
+    auto d = rlog.dups.rbegin();
+    for (auto p = log.dups.rbegin(); p != log.dups.rend(); ++p, ++d) {
+      ASSERT_EQ(*p, *d);
+    }
+    for (auto& i : rlog.dups) {
+      ASSERT_LE(i.version, log.tail);
+    }
+  }
+
+  size_t num_keys() {
+    size_t n = 0;
+    auto p = store->get_omap_iterator(ch, log_oid);
+    for (p->seek_to_first(); p->valid(); p->next()) {
+      ++n;
+    }
+    return n;
+  }
+
+  pg_info_t info;
+  coll_t test_coll;
+  ghobject_t log_oid;
+  size_t keys_set = 0;
+};
+
+TEST_F(PGLogPersistTest, DupSegments) {
+  set_conf("osd_pg_log_dups_per_key", "8");
+  set_conf("osd_pg_log_dups_tracked", "60");
+  for (unsigned i = 0; i < 400; ++i) {
+    // every 7th op carries extra reqids, whose dups share its version
+    op(20, 10, i % 7 == 0 ? 3 : 0);
+    if (i % 10 == 0) {
+      check_roundtrip();
+    }
+  }
+  check_roundtrip();
+  // the trimmed entries and wholly trimmed segments are gone
+  ASSERT_GT(log.dups.size(), 0u);
+  ASSERT_LT(num_keys(), log.log.size() + log.dups.size() / 8 + 10);
+
+  // a full rewrite (as after a split) goes back to whole segments
+  mark_log_for_rewrite();
+  op(20, 10, 0);
+  check_roundtrip();
+}
+
+TEST_F(PGLogPersistTest, LegacyDupKeys) {
+  // dups written one per key are still read, and segments written
+  // after them sort and trim with them
+  set_conf("osd_pg_log_dups_per_key", "0");
+  set_conf("osd_pg_log_dups_tracked", "60");
+  for (unsigned i = 0; i < 100; ++i) {
+    op(20, 10, 0);
+  }
+  check_roundtrip();
+  set_conf("osd_pg_log_dups_per_key", "8");
+  for (unsigned i = 0; i < 100; ++i) {
+    op(20, 10, 0);
+    check_roundtrip();
+  }
+}
+
+TEST_F(PGLogPersistTest, LegacyRewriteOverSegments) {
+  // a partial rewrite with one key per dup leaves behind the segment
+  // holding the newest rewritten dup; its older dups are not read twice
+  set_conf("osd_pg_log_dups_per_key", "8");
+  set_conf("osd_pg_log_dups_tracked", "60");
+  for (unsigned i = 0; i < 100; ++i) {
+    op(20, 10, 0);
+  }
+  check_roundtrip();
+  set_conf("osd_pg_log_dups_per_key", "0");
+  auto mid = log.dups.begin();
+  std::advance(mid, log.dups.size() / 2);
+  mark_dirty_to_dups(mid->version);
+  op(20, 10, 0);
+  check_roundtrip();
+  for (unsigned i = 0; i < 100; ++i) {
+    op(20, 10, 0);
+    check_roundtrip();
+  }
+}
+
+#if defined(WITH_BLUESTORE)
+class PGLogPersistBenchTest : public PGLogPersistTest {
+public:
+  PGLogPersistBenchTest() : PGLogPersistTest("bluestore") {}
+};
+
+// client ops at the default log length, comparing one key per dup with
+// dup segments.  A benchmark, not a check; run with
+// --gtest_also_run_disabled_tests.
+TEST_F(PGLogPersistBenchTest, DISABLED_DupsPerKey) {
+  const unsigned ops = 20000;
+  static const char *settings[] = { "0", "64" };
+  for (auto dups_per_key : settings) {
+    set_conf("osd_pg_log_dups_per_key", dups_per_key);
+    clear();
+    info = pg_info_t();
+    keys_set = 0;
+    hobject_t hoid;
+    hoid.pool = 1;
+    hoid.oid = string("log_") + dups_per_key;
+    log_oid = ghobject_t(hoid);
+    mark_log_for_rewrite();
+
+    auto start = ceph::mono_clock::now();
+    for (unsigned i = 0; i < ops; ++i) {
+      op(3000, 100, 0);
+    }
+    double secs = std::chrono::duration<double>(
+      ceph::mono_clock::now() - start).count();
+    check_roundtrip();
+    std::cout << "dups_per_key " << dups_per_key << ": " << ops
+	      << " ops in " << secs << "s (" << ops / secs << " ops/s), "
+	      << double(keys_set) / ops << " keys set/op, "
+	      << num_keys() << " omap keys" << std::endl;
+  }
+}
+#endif
+
 struct PGLogTrimTest :
   public ::testing::Test,
   public PGLogTestBase,
@@ -3243,6 +3441,118 @@ TEST_F(PGLogTrimTest, TestCopyAfter2) {
   EXPECT_EQ(7u, copy.dups.size()) << copy;
 }
 
+// append and trim at steady state, the way a busy pg does
+static void append_trim(CephContext *cct, PGLog::IndexedLog& log,
+			const std::vector<hobject_t>& objs,
+			unsigned num_ops, unsigned log_len)
+{
+  entity_name_t client = entity_name_t::CLIENT(777);
+  eversion_t prev;
+  for (unsigned i = 1; i <= num_ops; ++i) {
+    eversion_t v = PGLogTestBase::mk_evt(1, i);
+    log.add(PGLogTestBase::mk_ple_mod(objs[i % objs.size()], v, prev,
+				      osd_reqid_t(client, 8, i)));
+    prev = v;
+    if (i % 100 == 0 && i > log_len) {
+      log.trim(cct, PGLogTestBase::mk_evt(1, i - log_len),
+	       nullptr, nullptr, nullptr);
+    }
+  }
+}
+
+static std::vector<hobject_t> mk_rbd_objs(unsigned num_objects)
+{
+  std::vector<hobject_t> objs;
+  for (unsigned i = 0; i < num_objects; ++i) {
+    hobject_t o = PGLogTestBase::mk_obj(i);
+    o.oid = "rbd_data.10236b8b4567.0000000000000" + stringify(i);
+    objs.push_back(o);
+  }
+  return objs;
+}
+
+TEST_F(PGLogTrimTest, AppendTrimIndexes)
+{
+  const unsigned log_len = 300;
+  const unsigned num_ops = 5000;
+  SetUp(log_len);
+  PGLog::IndexedLog log;
+  log.index();
+  auto objs = mk_rbd_objs(100);
+  append_trim(cct, log, objs, num_ops, log_len);
+
+  ASSERT_EQ(log.objects.size(), std::min(log.log.size(), objs.size()));
+  ASSERT_EQ(log.caller_ops.size(), log.log.size());
+  ASSERT_EQ(log.dup_index.size(), log.dups.size());
+  for (auto& e : log.log) {
+    auto p = log.caller_ops.find(e.reqid);
+    ASSERT_TRUE(p != log.caller_ops.end());
+    ASSERT_EQ(&e, p->second);
+  }
+  for (auto& d : log.dups) {
+    auto p = log.dup_index.find(d.reqid);
+    ASSERT_TRUE(p != log.dup_index.end());
+    ASSERT_EQ(&d, p->second);
+  }
+  // every object's index entry is its newest entry in the log
+  for (auto& o : objs) {
+    auto p = log.objects.find(o);
+    ASSERT_TRUE(p != log.objects.end());
+    for (auto& e : log.log) {
+      if (e.soid == o) {
+	ASSERT_LE(e.version, p->second->version);
+      }
+    }
+  }
+}
+
+// report the append/trim rate and what the log and its indexes cost per
+// entry.  The indexes are compared against node-based unordered_maps
+// with copied keys, which is what they used to be.  A benchmark, not a
+// check; run with --gtest_also_run_disabled_tests.
+TEST_F(PGLogTrimTest, DISABLED_BenchAppendTrim)
+{
+  const unsigned log_len = 3000;
+  const unsigned num_objects = 1000;
+  const unsigned num_ops = 200000;
+  SetUp(log_len);
+  PGLog::IndexedLog log;
+  log.index();
+  auto objs = mk_rbd_objs(num_objects);
+
+  auto start = ceph::mono_clock::now();
+  append_trim(cct, log, objs, num_ops, log_len);
+  double secs = std::chrono::duration<double>(
+    ceph::mono_clock::now() - start).count();
+  ASSERT_EQ(log.objects.size(), std::min(log.log.size(), size_t(num_objects)));
+  ASSERT_EQ(log.caller_ops.size(), log.log.size());
+  ASSERT_EQ(log.dup_index.size(), log.dups.size());
+
+  size_t entries = log.log.size() + log.dups.size();
+  size_t flat = log.objects.bytes() + log.caller_ops.bytes() +
+    log.dup_index.bytes();
+  size_t before = mempool::osd_pglog::allocated_bytes();
+  {
+    mempool::osd_pglog::unordered_map<hobject_t,pg_log_entry_t*> objects;
+    mempool::osd_pglog::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops;
+    mempool::osd_pglog::unordered_map<osd_reqid_t,pg_log_dup_t*> dup_index;
+    for (auto& e : log.log) {
+      objects[e.soid] = &e;
+      caller_ops[e.reqid] = &e;
+    }
+    for (auto& d : log.dups) {
+      dup_index[d.reqid] = &d;
+    }
+    size_t node = mempool::osd_pglog::allocated_bytes() - before;
+    std::cout << num_ops << " appends in " << secs << "s ("
+	      << num_ops / secs << "/s), " << log.log.size() << " entries + "
+	      << log.dups.size() << " dups, " << before / entries
+	      << " pglog bytes/entry; indexes " << flat / entries
+	      << " bytes/entry (unordered_map " << node / entries << ")"
+	      << std::endl;
+  }
+}
+
 // Local Variables:
 // compile-command: "cd ../.. ; make unittest_pglog ; ./unittest_pglog --log-to-stderr=true  --debug-osd=20 # --gtest_filter=*.* "
 // End:
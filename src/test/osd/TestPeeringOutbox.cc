@@ -0,0 +1,225 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <gtest/gtest.h>
+
+#include "global/global_context.h"
+#include "common/ceph_context.h"
+#include "messages/MOSDPGNotify.h"
+#include "messages/MOSDPGNotify2.h"
+#include "messages/MOSDPGQuery.h"
+#include "messages/MOSDPGQuery2.h"
+#include "messages/MPing.h"
+#include "messages/MRecoveryReserve.h"
+#include "osd/PeeringOutbox.h"
+
+// keeps what is sent on it, in order
+struct RecordingConnection : public Connection {
+  std::vector<MessageRef> sent;
+
+  int send_message(Message *m) override {
+    sent.push_back(MessageRef(m, false));
+    return 0;
+  }
+  void send_keepalive() override {}
+  void mark_down() override {}
+  void mark_disposable() override {}
+  bool is_connected() override { return true; }
+  entity_addr_t get_peer_socket_addr() const override {
+    return entity_addr_t();
+  }
+
+private:
+  FRIEND_MAKE_REF(RecordingConnection);
+  explicit RecordingConnection(CephContext *cct)
+    : Connection(cct, nullptr) {}
+};
+
+static spg_t mk_pgid(unsigned ps)
+{
+  return spg_t(pg_t(ps, 1));
+}
+
+static MessageRef mk_notify(unsigned ps, epoch_t e)
+{
+  pg_info_t info(mk_pgid(ps));
+  return make_message<MOSDPGNotify2>(
+    mk_pgid(ps),
+    pg_notify_t(shard_id_t::NO_SHARD, shard_id_t::NO_SHARD, e, e, info,
+		PastIntervals()));
+}
+
+static MessageRef mk_query(unsigned ps, epoch_t e)
+{
+  return make_message<MOSDPGQuery2>(
+    mk_pgid(ps),
+    pg_query_t(pg_query_t::INFO, shard_id_t::NO_SHARD, shard_id_t::NO_SHARD,
+	       pg_history_t(), e));
+}
+
+// the pgs of the notifies in a MOSDPGNotify, in order
+static std::vector<unsigned> notified(const MessageRef& m)
+{
+  std::vector<unsigned> ps;
+  EXPECT_EQ(MSG_OSD_PG_NOTIFY, m->get_type());
+  for (auto& n : static_cast<MOSDPGNotify*>(m.get())->get_pg_list()) {
+    ps.push_back(n.info.pgid.ps());
+  }
+  return ps;
+}
+
+static std::vector<unsigned> queried(const MessageRef& m)
+{
+  std::vector<unsigned> ps;
+  EXPECT_EQ(MSG_OSD_PG_QUERY, m->get_type());
+  for (auto& [pgid, q] : static_cast<MOSDPGQuery*>(m.get())->pg_list) {
+    ps.push_back(pgid.ps());
+  }
+  return ps;
+}
+
+class PeeringOutboxTest : public ::testing::Test {
+public:
+  PeeringOutbox outbox{g_ceph_context, "test"};
+  ceph::ref_t<RecordingConnection> con =
+    ceph::make_ref<RecordingConnection>(g_ceph_context);
+
+  void set_conf(const char *key, const char *val) {
+    std::string old;
+    g_conf().get_val(key, &old);
+    saved.emplace_back(key, old);
+    g_conf().set_val_or_die(key, val);
+    g_conf().apply_changes(nullptr);
+  }
+  void TearDown() override {
+    for (auto& [key, val] : saved) {
+      g_conf().set_val_or_die(key, val);
+    }
+    g_conf().apply_changes(nullptr);
+  }
+
+  std::vector<std::pair<std::string, std::string>> saved;
+};
+
+TEST_F(PeeringOutboxTest, BatchesPerPeer) {
+  set_conf("osd_peering_batch_max", "16");
+  auto con2 = ceph::make_ref<RecordingConnection>(g_ceph_context);
+  outbox.send(1, con, mk_notify(1, 10), nullptr);
+  outbox.send(2, con2, mk_notify(2, 10), nullptr);
+  outbox.send(1, con, mk_notify(3, 11), nullptr);
+  outbox.send(1, con, mk_notify(4, 10), nullptr);
+  outbox.send(2, con2, mk_query(5, 12), nullptr);
+  ASSERT_EQ(5u, outbox.get_num_batched());
+  ASSERT_TRUE(con->sent.empty());
+  ASSERT_TRUE(con2->sent.empty());
+
+  outbox.maybe_flush(true, nullptr);
+  ASSERT_EQ(0u, outbox.get_num_batched());
+  ASSERT_EQ(1u, con->sent.size());
+  ASSERT_EQ(std::vector<unsigned>({1, 3, 4}), notified(con->sent[0]));
+  // the batch carries the newest epoch of its messages
+  ASSERT_EQ(11u, static_cast<MOSDPGNotify*>(con->sent[0].get())->get_epoch());
+  ASSERT_EQ(2u, con2->sent.size());
+  ASSERT_EQ(std::vector<unsigned>({2}), notified(con2->sent[0]));
+  ASSERT_EQ(std::vector<unsigned>({5}), queried(con2->sent[1]));
+}
+
+TEST_F(PeeringOutboxTest, FlushAtMax) {
+  set_conf("osd_peering_batch_max", "4");
+  for (unsigned i = 0; i < 3; ++i) {
+    outbox.send(1, con, mk_notify(i, 10), nullptr);
+  }
+  ASSERT_TRUE(con->sent.empty());
+  outbox.send(1, con, mk_query(3, 10), nullptr);
+  ASSERT_EQ(0u, outbox.get_num_batched());
+  ASSERT_EQ(2u, con->sent.size());
+  ASSERT_EQ(std::vector<unsigned>({0, 1, 2}), notified(con->sent[0]));
+  ASSERT_EQ(std::vector<unsigned>({3}), queried(con->sent[1]));
+}
+
+TEST_F(PeeringOutboxTest, QueryThenNotifySamePg) {
+  set_conf("osd_peering_batch_max", "16");
+  outbox.send(1, con, mk_query(1, 10), nullptr);
+  outbox.send(1, con, mk_notify(2, 10), nullptr);
+  ASSERT_TRUE(con->sent.empty());
+  // the notify would go out ahead of the query it follows
+  outbox.send(1, con, mk_notify(1, 11), nullptr);
+  ASSERT_EQ(2u, con->sent.size());
+  ASSERT_EQ(std::vector<unsigned>({2}), notified(con->sent[0]));
+  ASSERT_EQ(std::vector<unsigned>({1}), queried(con->sent[1]));
+  outbox.maybe_flush(true, nullptr);
+  ASSERT_EQ(3u, con->sent.size());
+  ASSERT_EQ(std::vector<unsigned>({1}), notified(con->sent[2]));
+}
+
+TEST_F(PeeringOutboxTest, NotifyThenQuerySamePg) {
+  set_conf("osd_peering_batch_max", "16");
+  outbox.send(1, con, mk_notify(1, 10), nullptr);
+  outbox.send(1, con, mk_query(1, 11), nullptr);
+  ASSERT_EQ(1u, con->sent.size());
+  ASSERT_EQ(std::vector<unsigned>({1}), notified(con->sent[0]));
+  // a second query for the same pg does not replace the first
+  outbox.send(1, con, mk_query(1, 12), nullptr);
+  ASSERT_EQ(2u, con->sent.size());
+  ASSERT_EQ(std::vector<unsigned>({1}), queried(con->sent[1]));
+  ASSERT_EQ(11u, static_cast<MOSDPGQuery*>(con->sent[1].get())->get_epoch());
+  outbox.maybe_flush(true, nullptr);
+  ASSERT_EQ(3u, con->sent.size());
+  ASSERT_EQ(12u, static_cast<MOSDPGQuery*>(con->sent[2].get())->get_epoch());
+}
+
+TEST_F(PeeringOutboxTest, OtherMessagesFlushFirst) {
+  set_conf("osd_peering_batch_max", "16");
+  outbox.send(1, con, mk_notify(1, 10), nullptr);
+  outbox.send(1, con, make_message<MPing>(), nullptr);
+  ASSERT_EQ(2u, con->sent.size());
+  ASSERT_EQ(std::vector<unsigned>({1}), notified(con->sent[0]));
+  ASSERT_EQ(CEPH_MSG_PING, con->sent[1]->get_type());
+}
+
+TEST_F(PeeringOutboxTest, ReserveAfterQuery) {
+  // as PG::send_cluster_message sends it, behind the pg's query
+  set_conf("osd_peering_batch_max", "16");
+  outbox.send(1, con, mk_query(1, 10), nullptr);
+  outbox.send(1, con, make_message<MRecoveryReserve>(
+		MRecoveryReserve::REQUEST, mk_pgid(1), 10), nullptr);
+  ASSERT_EQ(0u, outbox.get_num_batched());
+  ASSERT_EQ(2u, con->sent.size());
+  ASSERT_EQ(std::vector<unsigned>({1}), queried(con->sent[0]));
+  ASSERT_EQ(MSG_OSD_RECOVERY_RESERVE, con->sent[1]->get_type());
+}
+
+TEST_F(PeeringOutboxTest, Reconnect) {
+  set_conf("osd_peering_batch_max", "16");
+  auto con2 = ceph::make_ref<RecordingConnection>(g_ceph_context);
+  outbox.send(1, con, mk_notify(1, 10), nullptr);
+  outbox.send(1, con2, mk_notify(2, 11), nullptr);
+  ASSERT_EQ(1u, con->sent.size());
+  ASSERT_EQ(std::vector<unsigned>({1}), notified(con->sent[0]));
+  outbox.maybe_flush(true, nullptr);
+  ASSERT_EQ(1u, con->sent.size());
+  ASSERT_EQ(1u, con2->sent.size());
+  ASSERT_EQ(std::vector<unsigned>({2}), notified(con2->sent[0]));
+}
+
+TEST_F(PeeringOutboxTest, Disabled) {
+  set_conf("osd_peering_batch_max", "1");
+  outbox.send(1, con, mk_notify(1, 10), nullptr);
+  outbox.send(1, con, mk_query(2, 10), nullptr);
+  ASSERT_EQ(0u, outbox.get_num_batched());
+  ASSERT_EQ(2u, con->sent.size());
+  ASSERT_EQ(MSG_OSD_PG_NOTIFY2, con->sent[0]->get_type());
+  ASSERT_EQ(MSG_OSD_PG_QUERY2, con->sent[1]->get_type());
+}
+
+TEST_F(PeeringOutboxTest, MaxDelay) {
+  set_conf("osd_peering_batch_max", "16");
+  set_conf("osd_peering_batch_max_delay", "1000");
+  outbox.send(1, con, mk_notify(1, 10), nullptr);
+  // a busy shard holds the batch until it is old enough
+  outbox.maybe_flush(false, nullptr);
+  ASSERT_TRUE(con->sent.empty());
+  set_conf("osd_peering_batch_max_delay", "0");
+  outbox.maybe_flush(false, nullptr);
+  ASSERT_EQ(1u, con->sent.size());
+}
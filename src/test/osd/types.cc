@@ -1888,6 +1888,105 @@ TEST_F(PITest, past_intervals_ec_lost) {
 }
 
 
+TEST(pg_bucket_set_t, next_in_set) {
+  pg_t pgid(1, 3);  // seed 1 of pg_num 4
+  hobject_t start = pgid.get_hobj_start();
+  pg_bucket_set_t s(pgid.get_split_bits(4), 4);
+  ASSERT_EQ(16u, s.get_num_buckets());
+  ASSERT_EQ(0u, s.bucket_of(start));
+
+  vector<hobject_t> objs;
+  for (unsigned i = 0; i < 64; ++i) {
+    objs.push_back(hobject_t(object_t("o" + stringify(i)), "", CEPH_NOSNAP,
+			     (i << 2) | 1, 3, ""));
+  }
+  std::sort(objs.begin(), objs.end());
+  // buckets are contiguous in sort order
+  for (unsigned i = 1; i < objs.size(); ++i) {
+    ASSERT_LE(s.bucket_of(objs[i - 1]), s.bucket_of(objs[i]));
+  }
+  ASSERT_EQ(15u, s.bucket_of(objs.back()));
+
+  const hobject_t& in = objs[40];
+  uint32_t b = s.bucket_of(in);
+  ASSERT_TRUE(s.empty());
+  ASSERT_TRUE(s.insert(b));
+  ASSERT_FALSE(s.insert(b));
+  for (auto& o : objs) {
+    hobject_t next = s.next_in_set(start, o);
+    if (s.bucket_of(o) < b) {
+      ASSERT_LT(o, next);
+      ASSERT_LE(next, in);
+      ASSERT_EQ(b, s.bucket_of(next));
+    } else if (s.bucket_of(o) == b) {
+      ASSERT_EQ(o, next);
+    } else {
+      ASSERT_TRUE(next.is_max());
+    }
+  }
+}
+
+TEST(pg_modset_t, note_covers_rewind) {
+  auto entry = [](unsigned hash, eversion_t v) {
+    pg_log_entry_t e;
+    e.soid = hobject_t(object_t("o"), "", CEPH_NOSNAP, hash, 1, "");
+    e.version = v;
+    return e;
+  };
+  pg_modset_t m;
+  ASSERT_FALSE(m.note(entry(1, eversion_t(5, 11)), 100));
+  ASSERT_FALSE(m.covers(eversion_t()));
+
+  // no split bits, so the low 4 bits of the hash pick the bucket
+  m.reset(0, 4, eversion_t(5, 10));
+  ASSERT_TRUE(m.note(entry(1, eversion_t(5, 11)), 100));
+  ASSERT_FALSE(m.note(entry(1, eversion_t(5, 12)), 100));
+  ASSERT_TRUE(m.note(entry(2, eversion_t(6, 13)), 100));
+  ASSERT_TRUE(m.covers(eversion_t(5, 10)));
+  ASSERT_TRUE(m.covers(eversion_t(5, 12)));
+  ASSERT_TRUE(m.covers(eversion_t(6, 13)));
+  ASSERT_FALSE(m.covers(eversion_t(5, 9)));   // too old
+  ASSERT_FALSE(m.covers(eversion_t(5, 13)));  // not on our history
+  ASSERT_FALSE(m.covers(eversion_t(6, 12)));
+  ASSERT_FALSE(m.covers(eversion_t(6, 14)));  // in the future
+  ASSERT_EQ(2u, m.get_dirty(eversion_t(5, 10)).count());
+
+  // the next entry starts a new generation
+  ASSERT_TRUE(m.note(entry(4, eversion_t(6, 14)), 3));
+  ASSERT_EQ(1u, m.get_dirty(eversion_t(6, 13)).count());
+  ASSERT_EQ(3u, m.get_dirty(eversion_t(5, 10)).count());
+  m.note(entry(5, eversion_t(6, 15)), 3);
+  m.note(entry(6, eversion_t(6, 16)), 3);
+  ASSERT_TRUE(m.note(entry(8, eversion_t(6, 17)), 3));
+  ASSERT_FALSE(m.covers(eversion_t(5, 12)));
+  ASSERT_TRUE(m.covers(eversion_t(6, 13)));
+  ASSERT_EQ(4u, m.get_dirty(eversion_t(6, 13)).count());
+  ASSERT_EQ(1u, m.get_dirty(eversion_t(6, 16)).count());
+
+  bufferlist bl;
+  encode(m, bl);
+  pg_modset_t d;
+  auto p = bl.cbegin();
+  decode(d, p);
+  d.set_head(m.head);
+  ASSERT_TRUE(d.covers(eversion_t(6, 14)));
+  ASSERT_EQ(4u, d.get_dirty(eversion_t(6, 13)).count());
+
+  ASSERT_TRUE(m.rewind(eversion_t(6, 15)));
+  ASSERT_FALSE(m.covers(eversion_t(6, 16)));
+  ASSERT_TRUE(m.covers(eversion_t(6, 15)));
+  // a divergent entry's bucket stays marked
+  ASSERT_EQ(1u, m.get_dirty(eversion_t(6, 15)).count());
+  ASSERT_TRUE(m.note(entry(8, eversion_t(7, 16)), 3));
+  ASSERT_TRUE(m.covers(eversion_t(7, 16)));
+
+  // back past what we remember
+  ASSERT_TRUE(m.rewind(eversion_t(5, 11)));
+  ASSERT_TRUE(m.covers(eversion_t(5, 11)));
+  ASSERT_FALSE(m.covers(eversion_t(6, 13)));
+  ASSERT_EQ(0u, m.get_dirty(eversion_t(5, 11)).count());
+}
+
 /*
  * Local Variables:
  * compile-command: "cd ../.. ;
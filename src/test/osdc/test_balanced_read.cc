@@ -0,0 +1,130 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <map>
+#include <random>
+#include <set>
+#include <gtest/gtest.h>
+
+#include "global/global_context.h"
+#include "osdc/Objecter.h"
+
+using namespace std::chrono_literals;
+
+// hands out a fixed sequence of "random" numbers
+struct seq_rand {
+  std::vector<int> v;
+  size_t i = 0;
+  int operator()() {
+    return v.at(i++);
+  }
+};
+
+TEST(BalancedRead, SamplesTwoDistinct) {
+  std::vector<uint64_t> load = {5, 5, 5};
+  std::map<std::set<int>, unsigned> seen;
+  for (int a = 0; a < 3; ++a) {
+    for (int b = 0; b < 2; ++b) {
+      seq_rand r{{a, b}};
+      std::vector<int> asked;
+      int p = Objecter::pick_less_loaded_of_two(
+	3, r, [&](int i) { asked.push_back(i); return load[i]; });
+      ASSERT_EQ(2u, asked.size());
+      ASSERT_NE(asked[0], asked[1]);
+      ++seen[std::set<int>(asked.begin(), asked.end())];
+      // a tie goes to the first sample
+      ASSERT_EQ(a, p);
+    }
+  }
+  // every pair is sampled, once with each member first
+  ASSERT_EQ(3u, seen.size());
+  for (auto& [pair, n] : seen) {
+    ASSERT_EQ(2u, n);
+  }
+}
+
+TEST(BalancedRead, PicksLessLoaded) {
+  std::vector<uint64_t> load = {100, 10, 50};
+  auto pick = [&](int a, int b) {
+    seq_rand r{{a, b}};
+    return Objecter::pick_less_loaded_of_two(
+      load.size(), r, [&](int i) { return load[i]; });
+  };
+  ASSERT_EQ(1, pick(0, 0));   // 0 vs 1
+  ASSERT_EQ(2, pick(0, 1));   // 0 vs 2
+  ASSERT_EQ(1, pick(1, 0));   // 1 vs 0
+  ASSERT_EQ(1, pick(1, 1));   // 1 vs 2
+  ASSERT_EQ(1, pick(2, 1));   // 2 vs 1
+  ASSERT_EQ(2, pick(2, 0));   // 2 vs 0
+}
+
+TEST(BalancedRead, SpreadsLoad) {
+  // the busiest member is only chosen when both samples are it, which
+  // cannot happen; the idlest wins every comparison it is part of
+  std::vector<uint64_t> load = {1000, 100, 10};
+  std::mt19937 gen(42);
+  std::vector<unsigned> hits(load.size());
+  const unsigned n = 30000;
+  for (unsigned i = 0; i < n; ++i) {
+    ++hits[Objecter::pick_less_loaded_of_two(
+	load.size(), [&] { return (int)(gen() & 0x7fffffff); },
+	[&](int j) { return load[j]; })];
+  }
+  ASSERT_EQ(0u, hits[0]);
+  // 2 wins both of the pairs it is in (2/3), 1 wins against 0 (1/3)
+  ASSERT_NEAR(n * 2 / 3, hits[2], n / 30);
+  ASSERT_NEAR(n / 3, hits[1], n / 30);
+}
+
+TEST(BalancedRead, SessionLoad) {
+  auto s = new Objecter::OSDSession(g_ceph_context, 1);
+  // idle and never measured
+  ASSERT_EQ(1u, s->get_load());
+  s->num_ops = 3;
+  ASSERT_EQ(4u, s->get_load());
+
+  // latency is kept in microseconds, so sub-millisecond replies count
+  s->note_reply_latency(400us);
+  ASSERT_EQ(400u, s->reply_lat_us.load());
+  s->note_reply_latency(1200us);
+  ASSERT_EQ(500u, s->reply_lat_us.load());
+  ASSERT_EQ(501u * 4, s->get_load());
+  s->put();
+}
+
+TEST(BalancedRead, StaleLatencyDecays) {
+  auto slow = new Objecter::OSDSession(g_ceph_context, 1);
+  auto fast = new Objecter::OSDSession(g_ceph_context, 2);
+  auto t0 = ceph::mono_clock::now();
+
+  // one slow reply, after which we stop reading from it
+  slow->note_reply_latency(100ms, t0);
+  ASSERT_EQ(100000u, slow->get_reply_latency(t0));
+  ASSERT_EQ(100000u, slow->get_reply_latency(t0 + 999ms));
+
+  // while the other keeps replying quickly
+  for (int i = 0; i <= 10; ++i) {
+    fast->note_reply_latency(1ms, t0 + i * 1s);
+    if (i == 5) {
+      ASSERT_GT(slow->get_load(t0 + 5s), fast->get_load(t0 + 5s));
+    }
+  }
+  ASSERT_EQ(1000u, fast->get_reply_latency(t0 + 10s));
+
+  // after long enough without samples the slow one is worth a try again
+  ASSERT_EQ(100000u >> 10, slow->get_reply_latency(t0 + 10s));
+  ASSERT_LT(slow->get_load(t0 + 10s), fast->get_load(t0 + 10s));
+  std::vector<Objecter::OSDSession*> s = {slow, fast};
+  seq_rand r{{0, 0}};
+  ASSERT_EQ(0, Objecter::pick_less_loaded_of_two(
+	      2, r, [&](int i) { return s[i]->get_load(t0 + 10s); }));
+  ASSERT_EQ(0u, slow->get_reply_latency(t0 + 100s));
+
+  // and a fresh sample averages with what is left, not the stale value
+  slow->note_reply_latency(800us, t0 + 10s);
+  ASSERT_EQ((97u * 7 + 800) / 8, slow->reply_lat_us.load());
+  ASSERT_EQ((97u * 7 + 800) / 8, slow->get_reply_latency(t0 + 10s));
+
+  slow->put();
+  fast->put();
+}
@@ -229,6 +229,10 @@ void usage()
   cout << "   --set-subtree-class <bucket-name> <class>\n";
   cout << "                         set class for all items beneath bucket-name\n";
   cout << "   --compare <otherfile> compare two maps using --test parameters\n";
+  cout << "   -i mapfn --bench-mapping\n";
+  cout << "                         time single vs batched CRUSH mapping of the\n";
+  cout << "                         --test range of inputs (default 1M) and\n";
+  cout << "                         check that the results match\n";
   cout << "\n";
   cout << "Options for the output stage\n";
   cout << "\n";
@@ -385,6 +389,7 @@ int main(int argc, const char **argv)
   bool check = false;
   int max_id = -1;
   bool test = false;
+  bool bench = false;
   bool display = false;
   bool tree = false;
   bool bucket_tree = false;
@@ -534,6 +539,8 @@ int main(int argc, const char **argv)
       check = true;
     } else if (ceph_argparse_flag(args, i, "-t", "--test", (char*)NULL)) {
       test = true;
+    } else if (ceph_argparse_flag(args, i, "--bench-mapping", (char*)NULL)) {
+      bench = true;
     } else if (ceph_argparse_witharg(args, i, &full_location, err, "--show-location", (char*)NULL)) {
     } else if (ceph_argparse_flag(args, i, "-s", "--simulate", (char*)NULL)) {
       tester.set_random_placement();
@@ -834,7 +841,7 @@ int main(int argc, const char **argv)
     cerr << "cannot specify more than one of compile, decompile, and build" << std::endl;
     return EXIT_FAILURE;
   }
-  if (!check && !compile && !decompile && !build && !test && !reweight && !adjust && !tree && !dump &&
+  if (!check && !compile && !decompile && !build && !test && !bench && !reweight && !adjust && !tree && !dump &&
       add_item < 0 && !add_bucket && !move_item && !add_rule && !del_rule && full_location < 0 &&
       !bucket_tree &&
       !reclassify && !rebuild_class_roots &&
@@ -1278,6 +1285,12 @@ int main(int argc, const char **argv)
       return EXIT_FAILURE;
   }
 
+  if (bench) {
+    int r = tester.bench();
+    if (r < 0)
+      return EXIT_FAILURE;
+  }
+
   if (compare.size()) {
     CrushWrapper crush2;
     bufferlist in;
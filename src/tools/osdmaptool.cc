@@ -23,6 +23,7 @@
 
 #include "global/global_init.h"
 #include "osd/OSDMap.h"
+#include "osd/OSDMapMapping.h"
 
 
 void usage()
@@ -59,6 +60,10 @@ void usage()
   cout << "   --dump <format>         displays the map in plain text when <format> is 'plain', 'json' if specified format is not supported" << std::endl;
   cout << "   --tree                  displays a tree of the map" << std::endl;
   cout << "   --test-crush [--range-first <first> --range-last <last>] map pgs to acting osds" << std::endl;
+  cout << "   --test-mapping-inc <rounds> time full vs incremental OSDMapMapping" << std::endl;
+  cout << "                           updates over <rounds> random incrementals" << std::endl;
+  cout << "   --test-map-cache <epochs> report osdmap memory per cached epoch" << std::endl;
+  cout << "                           with and without dedup" << std::endl;
   exit(1);
 }
 
@@ -93,6 +98,200 @@ void print_inc_upmaps(const OSDMap::Incremental& pending_inc, int fd)
   }
 }
 
+// apply a stream of small random incrementals (an osd flapping, an upmap
+// being set or removed) and time a full OSDMapMapping recalculation
+// against an incremental one for each, checking that they agree.
+void test_mapping_inc(const OSDMap& orig, int rounds)
+{
+  OSDMap osdmap;
+  osdmap.deepish_copy_from(orig);
+  OSDMapMapping full, inc;
+  full.update(osdmap);
+  inc.update(osdmap);
+
+  std::vector<pg_t> all_pgs;
+  for (auto& p : osdmap.get_pools()) {
+    for (unsigned ps = 0; ps < p.second.get_pg_num(); ++ps) {
+      all_pgs.push_back(pg_t(ps, p.first));
+    }
+  }
+  if (all_pgs.empty() || osdmap.get_max_osd() == 0) {
+    cerr << "need pools and osds to test mapping" << std::endl;
+    exit(1);
+  }
+
+  double full_time = 0, inc_time = 0;
+  uint64_t inc_pgs = 0;
+  for (int round = 0; round < rounds; ++round) {
+    OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+    pending_inc.fsid = osdmap.get_fsid();
+    const char *what;
+    switch (round % 3) {
+    case 0:
+    case 1:
+      {
+	int osd = rand() % osdmap.get_max_osd();
+	if (!osdmap.exists(osd)) {
+	  what = "nop";
+	  break;
+	}
+	pending_inc.new_state[osd] = CEPH_OSD_UP;
+	what = osdmap.is_up(osd) ? "down" : "up";
+      }
+      break;
+    default:
+      {
+	pg_t pgid = all_pgs[rand() % all_pgs.size()];
+	if (osdmap.have_pg_upmaps(pgid)) {
+	  pending_inc.old_pg_upmap_items.insert(pgid);
+	  what = "rm-upmap";
+	} else {
+	  vector<int> up;
+	  osdmap.pg_to_raw_up(pgid, &up, nullptr);
+	  int to = rand() % osdmap.get_max_osd();
+	  if (up.empty() || std::count(up.begin(), up.end(), to)) {
+	    what = "nop";
+	    break;
+	  }
+	  pending_inc.new_pg_upmap_items[pgid].push_back(
+	    make_pair(up[0], to));
+	  what = "upmap";
+	}
+      }
+    }
+    int r = osdmap.apply_incremental(pending_inc);
+    ceph_assert(r == 0);
+
+    utime_t start = ceph_clock_now();
+    full.update(osdmap);
+    utime_t mid = ceph_clock_now();
+    inc.update(osdmap, pending_inc);
+    utime_t end = ceph_clock_now();
+    full_time += mid - start;
+    inc_time += end - mid;
+    inc_pgs += inc.get_num_updated_pgs();
+    cout << "e" << osdmap.get_epoch() << " " << what
+	 << " full " << (mid - start) << " inc " << (end - mid)
+	 << " (" << inc.get_num_updated_pgs() << "/" << inc.get_num_pgs()
+	 << " pgs)" << std::endl;
+
+    for (auto pgid : all_pgs) {
+      vector<int> fup, fact, iup, iact;
+      int fupp, factp, iupp, iactp;
+      full.get(pgid, &fup, &fupp, &fact, &factp);
+      inc.get(pgid, &iup, &iupp, &iact, &iactp);
+      if (fup != iup || fupp != iupp || fact != iact || factp != iactp) {
+	cerr << pgid << " mismatch: full " << fup << "/" << fact
+	     << " inc " << iup << "/" << iact << std::endl;
+	exit(1);
+      }
+    }
+  }
+  cout << rounds << " rounds: full " << full_time << "s, incremental "
+       << inc_time << "s, avg " << (rounds ? inc_pgs / rounds : 0)
+       << " pgs/round of " << all_pgs.size() << std::endl;
+}
+
+// build a chain of epochs the way an OSD fills its map cache (decode
+// the previous full map, apply the next incremental, dedup against the
+// previous epoch) and report the osdmap mempool bytes each cached epoch
+// costs, with and without dedup.  Each epoch changes a few upmaps and
+// flaps one osd; pgs get an upmap item first if the map has few.
+void test_map_cache(const OSDMap& orig, int epochs)
+{
+  const uint64_t features = CEPH_FEATURES_SUPPORTED_DEFAULT |
+    CEPH_FEATURE_RESERVED;
+  auto base = std::make_unique<OSDMap>();
+  base->deepish_copy_from(orig);
+
+  std::vector<pg_t> all_pgs;
+  for (auto& p : base->get_pools()) {
+    for (unsigned ps = 0; ps < p.second.get_pg_num(); ++ps) {
+      all_pgs.push_back(pg_t(ps, p.first));
+    }
+  }
+  if (all_pgs.empty() || base->get_max_osd() < 2) {
+    cerr << "need pools and osds to test the map cache" << std::endl;
+    exit(1);
+  }
+  auto make_upmap = [&](const OSDMap& m, pg_t pgid,
+			OSDMap::Incremental *inc) {
+    vector<int> up;
+    m.pg_to_raw_up(pgid, &up, nullptr);
+    if (up.empty()) {
+      return;
+    }
+    int to = rand() % m.get_max_osd();
+    if (std::count(up.begin(), up.end(), to)) {
+      return;
+    }
+    inc->new_pg_upmap_items[pgid].push_back(make_pair(up[0], to));
+  };
+  {
+    OSDMap::Incremental inc(base->get_epoch() + 1);
+    inc.fsid = base->get_fsid();
+    for (auto pgid : all_pgs) {
+      if (!base->have_pg_upmaps(pgid)) {
+	make_upmap(*base, pgid, &inc);
+      }
+    }
+    base->apply_incremental(inc);
+  }
+  cout << "map has " << all_pgs.size() << " pgs, "
+       << base->get_max_osd() << " osds" << std::endl;
+
+  std::vector<std::unique_ptr<OSDMap::Incremental>> incs;
+  {
+    OSDMap tmp;
+    tmp.deepish_copy_from(*base);
+    for (int e = 0; e < epochs; ++e) {
+      auto inc = std::make_unique<OSDMap::Incremental>(tmp.get_epoch() + 1);
+      inc->fsid = tmp.get_fsid();
+      for (int i = 0; i < 16; ++i) {
+	pg_t pgid = all_pgs[rand() % all_pgs.size()];
+	if (inc->new_pg_upmap_items.count(pgid) ||
+	    inc->old_pg_upmap_items.count(pgid)) {
+	  continue;
+	}
+	if (tmp.have_pg_upmaps(pgid) && rand() % 2) {
+	  inc->old_pg_upmap_items.insert(pgid);
+	} else {
+	  make_upmap(tmp, pgid, inc.get());
+	}
+      }
+      int osd = rand() % tmp.get_max_osd();
+      if (tmp.exists(osd)) {
+	inc->new_state[osd] = CEPH_OSD_UP;
+      }
+      tmp.apply_incremental(*inc);
+      incs.push_back(std::move(inc));
+    }
+  }
+
+  for (bool dedup : {false, true}) {
+    size_t before = mempool::osdmap::allocated_bytes();
+    std::vector<std::unique_ptr<OSDMap>> cache;
+    bufferlist bl;
+    base->encode(bl, features);
+    for (auto& inc : incs) {
+      auto m = std::make_unique<OSDMap>();
+      m->decode(bl);
+      m->apply_incremental(*inc);
+      if (dedup && !cache.empty()) {
+	OSDMap::dedup(cache.back().get(), m.get());
+      }
+      bl.clear();
+      m->encode(bl, features);
+      cache.push_back(std::move(m));
+    }
+    size_t bytes = mempool::osdmap::allocated_bytes() - before;
+    cout << (dedup ? "dedup:    " : "no dedup: ") << cache.size()
+	 << " epochs, " << bytes << " bytes, "
+	 << bytes / std::max<size_t>(cache.size(), 1) << " bytes/epoch"
+	 << std::endl;
+  }
+}
+
 int main(int argc, const char **argv)
 {
   vector<const char*> args;
@@ -148,6 +347,8 @@ int main(int argc, const char **argv)
   int64_t pg_num = -1;
   bool test_map_pgs_dump_all = false;
   bool debug = false;
+  int test_mapping_inc_rounds = 0;
+  int test_map_cache_epochs = 0;
 
   std::string val;
   std::ostringstream err;
@@ -227,6 +428,8 @@ int main(int argc, const char **argv)
       test_map_pg = val;
     } else if (ceph_argparse_witharg(args, i, &val, "--test_map_object", (char*)NULL)) {
       test_map_object = val;
+    } else if (ceph_argparse_witharg(args, i, &test_mapping_inc_rounds, err, "--test-mapping-inc", (char*)NULL)) {
+    } else if (ceph_argparse_witharg(args, i, &test_map_cache_epochs, err, "--test-map-cache", (char*)NULL)) {
     } else if (ceph_argparse_flag(args, i, "--test_crush", (char*)NULL)) {
       test_crush = true;
     } else if (ceph_argparse_witharg(args, i, &val, err, "--pg_num", (char*)NULL)) {
@@ -712,11 +915,19 @@ skip_upmap:
     }
   }
 
+  if (test_mapping_inc_rounds > 0) {
+    test_mapping_inc(osdmap, test_mapping_inc_rounds);
+  }
+  if (test_map_cache_epochs > 0) {
+    test_map_cache(osdmap, test_map_cache_epochs);
+  }
+
   if (!print && !health && !tree && !modified &&
       export_crush.empty() && import_crush.empty() && 
       test_map_pg.empty() && test_map_object.empty() &&
       !test_map_pgs && !test_map_pgs_dump && !test_map_pgs_dump_all &&
-      !upmap && !upmap_cleanup) {
+      !upmap && !upmap_cleanup && !test_mapping_inc_rounds &&
+      !test_map_cache_epochs) {
     cerr << me << ": no action specified?" << std::endl;
     usage();
   }